@@ -110,6 +110,17 @@
 #define DB_VM_BYTECODE_SIZE		128
 #endif /* DB_VM_BYTECODE_SIZE */
 
+/* The size of the pages that rows are read in from storage. A
+   sequential scan serves the rows of a cached page from RAM. */
+#ifndef DB_STORAGE_PAGE_SIZE
+#define DB_STORAGE_PAGE_SIZE		128
+#endif /* DB_STORAGE_PAGE_SIZE */
+
+/* The number of row pages cached in RAM, shared by all relations. */
+#ifndef DB_STORAGE_CACHE_PAGES
+#define DB_STORAGE_CACHE_PAGES		2
+#endif /* DB_STORAGE_CACHE_PAGES */
+
 /*----------------------------------------------------------------------------*/
 
 /* Language options. */
@@ -178,6 +189,11 @@
 #define REMOVE_RELATION			"db-remove"
 #endif /* REMOVE_RELATION */
 
+/* The file name prefix of the partitions spilled by a hash join. */
+#ifndef JOIN_RELATION
+#define JOIN_RELATION			"db-join"
+#endif /* JOIN_RELATION */
+
 /*----------------------------------------------------------------------------*/
 
 /* Index options. */
@@ -206,6 +222,50 @@
 #define DB_HEAP_CACHE_LIMIT		1
 #endif /* DB_HEAP_CACHE_LIMIT */
 
+/* The maximum number of B+-tree indexes. */
+#ifndef DB_BTREE_INDEX_LIMIT
+#define DB_BTREE_INDEX_LIMIT		2
+#endif /* DB_BTREE_INDEX_LIMIT */
+
+/* The size of a B+-tree node in bytes. */
+#ifndef DB_BTREE_NODE_SIZE
+#define DB_BTREE_NODE_SIZE		128
+#endif /* DB_BTREE_NODE_SIZE */
+
+/* The maximum number of nodes in a B+-tree, which determines the
+   storage space reserved for it. */
+#ifndef DB_BTREE_MAX_NODES
+#define DB_BTREE_MAX_NODES		256
+#endif /* DB_BTREE_MAX_NODES */
+
+/* The number of B+-tree nodes cached in RAM, shared by all B+-trees. */
+#ifndef DB_BTREE_CACHE_NODES
+#define DB_BTREE_CACHE_NODES		4
+#endif /* DB_BTREE_CACHE_NODES */
+
+/*----------------------------------------------------------------------------*/
+
+/* Join options. */
+
+/* The memory reserved for the build side of a hash join. The rows of
+   the smaller relation are loaded into this buffer in chunks. */
+#ifndef DB_JOIN_HASH_MEMORY
+#define DB_JOIN_HASH_MEMORY		512
+#endif /* DB_JOIN_HASH_MEMORY */
+
+/* The number of hash chains in the hash join table. */
+#ifndef DB_JOIN_HASH_BUCKETS
+#define DB_JOIN_HASH_BUCKETS		16
+#endif /* DB_JOIN_HASH_BUCKETS */
+
+/* The maximum number of partitions that a hash join spills to storage
+   when the build relation does not fit in DB_JOIN_HASH_MEMORY. Each
+   partition needs one open file while the relations are partitioned.
+   Must be less than 10. */
+#ifndef DB_JOIN_MAX_PARTITIONS
+#define DB_JOIN_MAX_PARTITIONS		4
+#endif /* DB_JOIN_MAX_PARTITIONS */
+
 /*----------------------------------------------------------------------------*/
 
 /* LVM options. */
@@ -222,6 +282,17 @@
 #define LVM_MAX_VARIABLE_ID		AQL_ATTRIBUTE_LIMIT - 1
 #endif /* LVM_MAX_VARIABLE_ID */
 
+/* The maximum number of instructions in a compiled LVM predicate.
+   Longer predicates are interpreted. */
+#ifndef LVM_MAX_INSTRUCTIONS
+#define LVM_MAX_INSTRUCTIONS		16
+#endif /* LVM_MAX_INSTRUCTIONS */
+
+/* The depth of the value stack used for running compiled predicates. */
+#ifndef LVM_STACK_SIZE
+#define LVM_STACK_SIZE			8
+#endif /* LVM_STACK_SIZE */
+
 /* Specify whether floats should be used or not inside the LVM. */
 #ifndef LVM_USE_FLOATS
 #define LVM_USE_FLOATS			DB_FEATURE_FLOATS
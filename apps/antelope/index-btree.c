@@ -0,0 +1,749 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *     A B+-tree index for flash memory.
+ *
+ *     The B+-tree keeps the (key, tuple ID) pairs sorted in leaves that
+ *     are linked from left to right, so that a range query descends to
+ *     the first key once and then reads the leaves sequentially. The
+ *     nodes are stored in a single file and are never moved. New nodes
+ *     are always allocated at the end of the file.
+ *
+ *     Sensor data is typically indexed on a timestamp or another key
+ *     that only increases. A key appended after the last key of the
+ *     rightmost leaf therefore does not split the full leaf in half,
+ *     but starts a new leaf, so that all leaves are filled completely
+ *     and every old leaf stays untouched. Only the bytes that change in
+ *     a node are written, which for an appended key are the new pair
+ *     and the node header.
+ *
+ *     A small cache of nodes, shared by all B+-tree indexes, serves
+ *     the descents through the upper levels of the tree from RAM.
+ */
+
+#include <string.h>
+
+#include "cfs/cfs.h"
+#include "lib/memb.h"
+
+#include "db-options.h"
+#include "index.h"
+#include "result.h"
+#include "storage.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+/* The maximum height of the tree. */
+#define MAX_DEPTH	8
+
+typedef int32_t btree_key_t;
+typedef uint16_t btree_node_id_t;
+
+/* Node 0 holds the metadata of the tree, so it doubles as a null
+   reference. */
+#define NO_NODE		0
+
+struct btree_pair {
+  btree_key_t key;
+  tuple_id_t value;
+};
+
+struct btree_node_header {
+  /* Leaves are at level 0. */
+  uint8_t level;
+  uint8_t count;
+  /* The next leaf to the right. */
+  btree_node_id_t next;
+};
+
+#define LEAF_CAPACITY							\
+  ((DB_BTREE_NODE_SIZE - sizeof(struct btree_node_header)) /		\
+   sizeof(struct btree_pair))
+#define INNER_CAPACITY							\
+  ((DB_BTREE_NODE_SIZE - sizeof(struct btree_node_header) -		\
+    sizeof(btree_node_id_t)) /						\
+   (sizeof(btree_key_t) + sizeof(btree_node_id_t)))
+
+/*
+ * An inner node with n keys has n + 1 children. All keys in child i
+ * are smaller than or equal to key i, and all keys in child i + 1 are
+ * greater than or equal to it. Equal keys may thus span several
+ * leaves.
+ */
+struct btree_node {
+  struct btree_node_header header;
+  union {
+    struct btree_pair pairs[LEAF_CAPACITY];
+    struct {
+      btree_key_t keys[INNER_CAPACITY];
+      btree_node_id_t children[INNER_CAPACITY + 1];
+    } inner;
+  } u;
+};
+
+struct btree_meta {
+  btree_node_id_t root;
+  btree_node_id_t nodes;
+};
+
+struct btree {
+  db_storage_id_t storage;
+  struct btree_meta meta;
+};
+typedef struct btree btree_t;
+
+struct node_cache {
+  btree_t *tree;
+  btree_node_id_t id;
+  uint16_t stamp;
+  struct btree_node node;
+};
+
+static struct node_cache node_cache[DB_BTREE_CACHE_NODES];
+static uint16_t cache_clock;
+MEMB(btrees, btree_t, DB_BTREE_INDEX_LIMIT);
+
+/* Scratch space for splitting a full inner node. */
+static btree_key_t split_keys[INNER_CAPACITY + 1];
+static btree_node_id_t split_children[INNER_CAPACITY + 2];
+
+static db_result_t create(index_t *);
+static db_result_t destroy(index_t *);
+static db_result_t load(index_t *);
+static db_result_t release(index_t *);
+static db_result_t insert(index_t *, attribute_value_t *, tuple_id_t);
+static db_result_t delete(index_t *, attribute_value_t *);
+static tuple_id_t get_next(index_iterator_t *);
+
+index_api_t index_btree = {
+  INDEX_BTREE,
+  INDEX_API_EXTERNAL | INDEX_API_RANGE_QUERIES,
+  create,
+  destroy,
+  load,
+  release,
+  insert,
+  delete,
+  get_next
+};
+
+static unsigned long
+node_offset(btree_node_id_t id)
+{
+  return (unsigned long)id * DB_BTREE_NODE_SIZE;
+}
+
+static struct btree_node *
+node_get(btree_t *tree, btree_node_id_t id)
+{
+  struct node_cache *cache;
+  struct node_cache *victim;
+
+  victim = &node_cache[0];
+  for(cache = node_cache; cache < &node_cache[DB_BTREE_CACHE_NODES]; cache++) {
+    if(cache->tree == tree && cache->id == id) {
+      cache->stamp = ++cache_clock;
+      return &cache->node;
+    }
+    if(cache->tree == NULL ||
+       (victim->tree != NULL &&
+        (uint16_t)(cache_clock - cache->stamp) >
+        (uint16_t)(cache_clock - victim->stamp))) {
+      victim = cache;
+    }
+  }
+
+  victim->tree = NULL;
+  if(DB_ERROR(storage_read(tree->storage, &victim->node,
+                           node_offset(id), sizeof(victim->node)))) {
+    PRINTF("DB: Failed to read B+-tree node %u\n", (unsigned)id);
+    return NULL;
+  }
+
+  victim->tree = tree;
+  victim->id = id;
+  victim->stamp = ++cache_clock;
+
+  return &victim->node;
+}
+
+/* Write a part of a node that has been changed in the cache. */
+static db_result_t
+node_write(btree_t *tree, btree_node_id_t id, struct btree_node *node,
+           void *start, unsigned length)
+{
+  unsigned offset;
+
+  offset = (unsigned char *)start - (unsigned char *)node;
+  return storage_write(tree->storage, start, node_offset(id) + offset, length);
+}
+
+/* Allocate a node at the end of the file and write it in full. */
+static btree_node_id_t
+node_append(btree_t *tree, struct btree_node *node)
+{
+  btree_node_id_t id;
+
+  if(tree->meta.nodes >= DB_BTREE_MAX_NODES) {
+    PRINTF("DB: The B+-tree is full\n");
+    return NO_NODE;
+  }
+
+  id = tree->meta.nodes;
+  if(DB_ERROR(storage_write(tree->storage, node, node_offset(id),
+                            sizeof(*node)))) {
+    return NO_NODE;
+  }
+
+  tree->meta.nodes++;
+  if(DB_ERROR(storage_write(tree->storage, &tree->meta, 0,
+                            sizeof(tree->meta)))) {
+    return NO_NODE;
+  }
+
+  return id;
+}
+
+static void
+invalidate_nodes(btree_t *tree)
+{
+  struct node_cache *cache;
+
+  for(cache = node_cache; cache < &node_cache[DB_BTREE_CACHE_NODES]; cache++) {
+    if(cache->tree == tree) {
+      cache->tree = NULL;
+    }
+  }
+}
+
+/* Get the number of keys in an inner node that are smaller than the
+   key, or smaller than or equal to it if upper is set. This is the
+   index of the child to descend into. */
+static unsigned
+inner_position(struct btree_node *node, long key, int upper)
+{
+  unsigned min, max, center;
+
+  min = 0;
+  max = node->header.count;
+  while(min < max) {
+    center = min + (max - min) / 2;
+    if(node->u.inner.keys[center] < key ||
+       (upper && node->u.inner.keys[center] == key)) {
+      min = center + 1;
+    } else {
+      max = center;
+    }
+  }
+
+  return min;
+}
+
+/* The same as inner_position(), but for the pairs in a leaf. */
+static unsigned
+leaf_position(struct btree_node *node, long key, int upper)
+{
+  unsigned min, max, center;
+
+  min = 0;
+  max = node->header.count;
+  while(min < max) {
+    center = min + (max - min) / 2;
+    if(node->u.pairs[center].key < key ||
+       (upper && node->u.pairs[center].key == key)) {
+      min = center + 1;
+    } else {
+      max = center;
+    }
+  }
+
+  return min;
+}
+
+/* Descend to the leftmost leaf that may contain the key, or the
+   rightmost one if upper is set. The path is recorded if requested. */
+static btree_node_id_t
+descend(btree_t *tree, long key, int upper,
+        btree_node_id_t *path, int *depth)
+{
+  struct btree_node *node;
+  btree_node_id_t id;
+  int level;
+
+  id = tree->meta.root;
+  for(level = 0; level < MAX_DEPTH; level++) {
+    node = node_get(tree, id);
+    if(node == NULL) {
+      return NO_NODE;
+    }
+    if(path != NULL) {
+      path[level] = id;
+      *depth = level;
+    }
+    if(node->header.level == 0) {
+      return id;
+    }
+    id = node->u.inner.children[inner_position(node, key, upper)];
+  }
+
+  return NO_NODE;
+}
+
+/* Split a full leaf, and insert the pair into the left or the right
+   part. The right part is returned in the sibling buffer. Returns
+   whether the pairs in the leaf have changed. */
+static int
+leaf_split(struct btree_node *node, struct btree_node *sibling,
+           struct btree_pair *pair)
+{
+  struct btree_node *target;
+  unsigned half;
+  unsigned position;
+
+  memset(sibling, 0, sizeof(*sibling));
+
+  if(node->header.next == NO_NODE &&
+     pair->key >= node->u.pairs[node->header.count - 1].key) {
+    /* Appending to the rightmost leaf starts a new leaf. */
+    sibling->u.pairs[0] = *pair;
+    sibling->header.count = 1;
+    return 0;
+  }
+
+  half = node->header.count / 2;
+  sibling->header.count = node->header.count - half;
+  memcpy(sibling->u.pairs, &node->u.pairs[half],
+         sibling->header.count * sizeof(struct btree_pair));
+  node->header.count = half;
+
+  target = pair->key < sibling->u.pairs[0].key ? node : sibling;
+  position = leaf_position(target, pair->key, 1);
+  memmove(&target->u.pairs[position + 1], &target->u.pairs[position],
+          (target->header.count - position) * sizeof(struct btree_pair));
+  target->u.pairs[position] = *pair;
+  target->header.count++;
+
+  return target == node;
+}
+
+/* Split a full inner node while inserting the separator and the child
+   to the right of it. The key that separates the two halves is
+   returned, and the right half is returned in the sibling buffer. */
+static btree_key_t
+inner_split(struct btree_node *node, struct btree_node *sibling,
+            btree_key_t separator, btree_node_id_t child)
+{
+  unsigned count;
+  unsigned position;
+  unsigned half;
+
+  memset(sibling, 0, sizeof(*sibling));
+  sibling->header.level = node->header.level;
+
+  count = node->header.count;
+  position = inner_position(node, separator, 1);
+  if(position == count) {
+    /* A new rightmost child starts a new node without keys. */
+    sibling->u.inner.children[0] = child;
+    return separator;
+  }
+
+  memcpy(split_keys, node->u.inner.keys, position * sizeof(btree_key_t));
+  split_keys[position] = separator;
+  memcpy(&split_keys[position + 1], &node->u.inner.keys[position],
+         (count - position) * sizeof(btree_key_t));
+  memcpy(split_children, node->u.inner.children,
+         (position + 1) * sizeof(btree_node_id_t));
+  split_children[position + 1] = child;
+  memcpy(&split_children[position + 2], &node->u.inner.children[position + 1],
+         (count - position) * sizeof(btree_node_id_t));
+  count++;
+
+  half = count / 2;
+  node->header.count = half;
+  memcpy(node->u.inner.keys, split_keys, half * sizeof(btree_key_t));
+  memcpy(node->u.inner.children, split_children,
+         (half + 1) * sizeof(btree_node_id_t));
+
+  sibling->header.count = count - half - 1;
+  memcpy(sibling->u.inner.keys, &split_keys[half + 1],
+         sibling->header.count * sizeof(btree_key_t));
+  memcpy(sibling->u.inner.children, &split_children[half + 1],
+         (sibling->header.count + 1) * sizeof(btree_node_id_t));
+
+  return split_keys[half];
+}
+
+static db_result_t
+tree_insert(btree_t *tree, btree_key_t key, tuple_id_t value)
+{
+  btree_node_id_t path[MAX_DEPTH];
+  struct btree_node *node;
+  struct btree_node sibling;
+  struct btree_pair pair;
+  btree_node_id_t id;
+  btree_node_id_t new_id;
+  btree_key_t separator;
+  unsigned position;
+  int depth;
+  int changed;
+
+  pair.key = key;
+  pair.value = value;
+
+  if(tree->meta.root == NO_NODE) {
+    memset(&sibling, 0, sizeof(sibling));
+    sibling.u.pairs[0] = pair;
+    sibling.header.count = 1;
+    id = node_append(tree, &sibling);
+    if(id == NO_NODE) {
+      return DB_STORAGE_ERROR;
+    }
+    tree->meta.root = id;
+    return storage_write(tree->storage, &tree->meta, 0, sizeof(tree->meta));
+  }
+
+  id = descend(tree, key, 1, path, &depth);
+  node = id == NO_NODE ? NULL : node_get(tree, id);
+  if(node == NULL) {
+    return DB_INDEX_ERROR;
+  }
+
+  if(node->header.count < LEAF_CAPACITY) {
+    position = leaf_position(node, key, 1);
+    memmove(&node->u.pairs[position + 1], &node->u.pairs[position],
+            (node->header.count - position) * sizeof(struct btree_pair));
+    node->u.pairs[position] = pair;
+    node->header.count++;
+
+    /* Write the pairs from the inserted one onwards, then the header. */
+    if(DB_ERROR(node_write(tree, id, node, &node->u.pairs[position],
+                           (node->header.count - position) *
+                           sizeof(struct btree_pair))) ||
+       DB_ERROR(node_write(tree, id, node, &node->header,
+                           sizeof(node->header)))) {
+      return DB_STORAGE_ERROR;
+    }
+    return DB_OK;
+  }
+
+  PRINTF("DB: Split B+-tree leaf %u\n", (unsigned)id);
+
+  changed = leaf_split(node, &sibling, &pair);
+  sibling.header.next = node->header.next;
+  separator = sibling.u.pairs[0].key;
+
+  new_id = node_append(tree, &sibling);
+  if(new_id == NO_NODE) {
+    invalidate_nodes(tree);
+    return DB_STORAGE_ERROR;
+  }
+
+  node = node_get(tree, id);
+  if(node == NULL) {
+    return DB_STORAGE_ERROR;
+  }
+  node->header.next = new_id;
+
+  /* The pairs that were moved out of the leaf remain on storage, but
+     are beyond the count in the header. */
+  if(DB_ERROR(node_write(tree, id, node, &node->header,
+                         changed ? sizeof(*node) : sizeof(node->header)))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  /* Insert the separator into the ancestors, splitting them when they
+     are full. */
+  while(--depth >= 0) {
+    id = path[depth];
+    node = node_get(tree, id);
+    if(node == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+
+    if(node->header.count < INNER_CAPACITY) {
+      position = inner_position(node, separator, 1);
+      memmove(&node->u.inner.keys[position + 1], &node->u.inner.keys[position],
+              (node->header.count - position) * sizeof(btree_key_t));
+      memmove(&node->u.inner.children[position + 2],
+              &node->u.inner.children[position + 1],
+              (node->header.count - position) * sizeof(btree_node_id_t));
+      node->u.inner.keys[position] = separator;
+      node->u.inner.children[position + 1] = new_id;
+      node->header.count++;
+      return storage_write(tree->storage, node, node_offset(id),
+                           sizeof(*node));
+    }
+
+    separator = inner_split(node, &sibling, separator, new_id);
+    if(DB_ERROR(storage_write(tree->storage, node, node_offset(id),
+                              sizeof(*node)))) {
+      return DB_STORAGE_ERROR;
+    }
+    new_id = node_append(tree, &sibling);
+    if(new_id == NO_NODE) {
+      invalidate_nodes(tree);
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  /* The root was split, so the tree grows by one level. */
+  node = node_get(tree, tree->meta.root);
+  if(node == NULL) {
+    return DB_STORAGE_ERROR;
+  }
+  if(node->header.level + 1 >= MAX_DEPTH) {
+    return DB_INDEX_ERROR;
+  }
+  memset(&sibling, 0, sizeof(sibling));
+  sibling.header.level = node->header.level + 1;
+  sibling.header.count = 1;
+  sibling.u.inner.keys[0] = separator;
+  sibling.u.inner.children[0] = tree->meta.root;
+  sibling.u.inner.children[1] = new_id;
+
+  id = node_append(tree, &sibling);
+  if(id == NO_NODE) {
+    return DB_STORAGE_ERROR;
+  }
+  tree->meta.root = id;
+
+  return storage_write(tree->storage, &tree->meta, 0, sizeof(tree->meta));
+}
+
+static db_result_t
+create(index_t *index)
+{
+  char *filename;
+  btree_t *tree;
+
+  filename = storage_generate_file("btree",
+                                   (unsigned long)DB_BTREE_MAX_NODES *
+                                   DB_BTREE_NODE_SIZE);
+  if(filename == NULL) {
+    PRINTF("DB: Failed to generate a B+-tree file\n");
+    return DB_INDEX_ERROR;
+  }
+  memcpy(index->descriptor_file, filename, sizeof(index->descriptor_file));
+
+  index->opaque_data = tree = memb_alloc(&btrees);
+  if(tree == NULL) {
+    PRINTF("DB: Failed to allocate a B+-tree\n");
+    cfs_remove(index->descriptor_file);
+    return DB_ALLOCATION_ERROR;
+  }
+
+  tree->meta.root = NO_NODE;
+  tree->meta.nodes = 1;
+
+  tree->storage = storage_open(index->descriptor_file);
+  if(tree->storage < 0 ||
+     DB_ERROR(storage_write(tree->storage, &tree->meta, 0,
+                            sizeof(tree->meta)))) {
+    storage_close(tree->storage);
+    memb_free(&btrees, tree);
+    cfs_remove(index->descriptor_file);
+    return DB_STORAGE_ERROR;
+  }
+
+  PRINTF("DB: Created a B+-tree index in %s\n", index->descriptor_file);
+
+  return DB_OK;
+}
+
+/* The index has been released before it is destroyed. */
+static db_result_t
+destroy(index_t *index)
+{
+  cfs_remove(index->descriptor_file);
+  return DB_OK;
+}
+
+static db_result_t
+load(index_t *index)
+{
+  btree_t *tree;
+
+  index->opaque_data = tree = memb_alloc(&btrees);
+  if(tree == NULL) {
+    PRINTF("DB: Failed to allocate a B+-tree\n");
+    return DB_ALLOCATION_ERROR;
+  }
+
+  tree->storage = storage_open(index->descriptor_file);
+  if(tree->storage < 0 ||
+     DB_ERROR(storage_read(tree->storage, &tree->meta, 0,
+                           sizeof(tree->meta)))) {
+    storage_close(tree->storage);
+    memb_free(&btrees, tree);
+    return DB_STORAGE_ERROR;
+  }
+
+  PRINTF("DB: Loaded a B+-tree index with %u nodes from %s\n",
+         (unsigned)tree->meta.nodes, index->descriptor_file);
+
+  return DB_OK;
+}
+
+static db_result_t
+release(index_t *index)
+{
+  btree_t *tree;
+
+  tree = index->opaque_data;
+
+  invalidate_nodes(tree);
+  storage_close(tree->storage);
+  memb_free(&btrees, tree);
+
+  return DB_OK;
+}
+
+static db_result_t
+insert(index_t *index, attribute_value_t *key, tuple_id_t value)
+{
+  return tree_insert(index->opaque_data, db_value_to_long(key), value);
+}
+
+/* Remove all pairs with the key. The leaves are not merged, so a
+   leaf may become empty. */
+static db_result_t
+delete(index_t *index, attribute_value_t *value)
+{
+  btree_t *tree;
+  struct btree_node *node;
+  btree_node_id_t id;
+  long key;
+  unsigned start;
+  unsigned end;
+
+  tree = index->opaque_data;
+  if(tree->meta.root == NO_NODE) {
+    return DB_OK;
+  }
+
+  key = db_value_to_long(value);
+  for(id = descend(tree, key, 0, NULL, NULL); id != NO_NODE;
+      id = node->header.next) {
+    node = node_get(tree, id);
+    if(node == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+
+    start = leaf_position(node, key, 0);
+    end = leaf_position(node, key, 1);
+    if(start < end) {
+      memmove(&node->u.pairs[start], &node->u.pairs[end],
+              (node->header.count - end) * sizeof(struct btree_pair));
+      node->header.count -= end - start;
+      if(DB_ERROR(storage_write(tree->storage, node, node_offset(id),
+                                sizeof(*node)))) {
+        return DB_STORAGE_ERROR;
+      }
+    }
+
+    if(start < node->header.count) {
+      /* A larger key follows in this leaf. */
+      break;
+    }
+  }
+
+  return DB_OK;
+}
+
+static tuple_id_t
+get_next(index_iterator_t *iterator)
+{
+  /* The current leaf is copied, so that the iteration does not
+     depend on the node cache. */
+  struct iteration_cache {
+    index_iterator_t *index_iterator;
+    struct btree_node leaf;
+    uint8_t slot;
+    long max;
+  };
+  static struct iteration_cache cache;
+  btree_t *tree;
+  struct btree_node *node;
+  struct btree_pair *pair;
+  btree_node_id_t id;
+  long min;
+
+  tree = (btree_t *)iterator->index->opaque_data;
+
+  if(cache.index_iterator != iterator || iterator->next_item_no == 0) {
+    /* Find the first key of the range. */
+    cache.index_iterator = iterator;
+    cache.leaf.header.count = 0;
+    cache.leaf.header.next = NO_NODE;
+    cache.slot = 0;
+    cache.max = db_value_to_long(&iterator->max_value);
+    min = db_value_to_long(&iterator->min_value);
+    if(tree->meta.root != NO_NODE) {
+      id = descend(tree, min, 0, NULL, NULL);
+      node = id == NO_NODE ? NULL : node_get(tree, id);
+      if(node != NULL) {
+        cache.leaf = *node;
+        cache.slot = leaf_position(node, min, 0);
+      }
+    }
+  }
+
+  for(;;) {
+    if(cache.slot < cache.leaf.header.count) {
+      pair = &cache.leaf.u.pairs[cache.slot];
+      if(pair->key > cache.max) {
+        break;
+      }
+      cache.slot++;
+      iterator->next_item_no++;
+      return pair->value;
+    }
+
+    /* Continue in the next leaf. */
+    if(cache.leaf.header.next == NO_NODE) {
+      break;
+    }
+    node = node_get(tree, cache.leaf.header.next);
+    if(node == NULL) {
+      break;
+    }
+    cache.leaf = *node;
+    cache.slot = 0;
+  }
+
+  cache.leaf.header.count = 0;
+  cache.leaf.header.next = NO_NODE;
+  return INVALID_TUPLE;
+}
@@ -49,7 +49,7 @@
 #include "storage.h"
 
 static index_api_t *index_components[] = {&index_inline,
-	&index_maxheap};
+	&index_maxheap, &index_btree};
 
 LIST(indices);
 MEMB(index_memb, index_t, DB_INDEX_POOL_SIZE);
@@ -131,7 +131,9 @@ index_create(index_type_t index_type, relation_t *rel, attribute_t *attr)
   attr->index = index;
   list_push(indices, index);
 
-  if(index->descriptor_file[0] != '\0' &&
+  /* Inline indexes have no descriptor file, but their index record is
+     needed to restore them when the relation is loaded again. */
+  if((index->descriptor_file[0] != '\0' || index_type == INDEX_INLINE) &&
      DB_ERROR(storage_put_index(index))) {
     api->destroy(index);
     memb_free(&index_memb, index);
@@ -157,12 +159,20 @@ index_create(index_type_t index_type, relation_t *rel, attribute_t *attr)
 db_result_t
 index_destroy(index_t *index)
 {
-  if(DB_ERROR(index_release(index)) ||
-     DB_ERROR(index->api->destroy(index))) {
+  db_result_t result;
+
+  /* Release the index, but keep the index object until its storage
+     has been destroyed. */
+  if(DB_ERROR(index->api->release(index))) {
     return DB_INDEX_ERROR;
   }
+  result = index->api->destroy(index);
 
-  return DB_OK;
+  index->attr->index = NULL;
+  list_remove(indices, index);
+  memb_free(&index_memb, index);
+
+  return DB_ERROR(result) ? DB_INDEX_ERROR : DB_OK;
 }
 
 db_result_t
@@ -708,6 +708,372 @@ lvm_get_derived_range(lvm_instance_t *p, char *name,
   return INVALID_IDENTIFIER;
 }
 
+static int
+to_opcode(operator_t op)
+{
+  switch(op) {
+  case LVM_ADD:
+    return LVM_OP_ADD;
+  case LVM_SUB:
+    return LVM_OP_SUB;
+  case LVM_MUL:
+    return LVM_OP_MUL;
+  case LVM_DIV:
+    return LVM_OP_DIV;
+  case LVM_EQ:
+    return LVM_OP_EQ;
+  case LVM_NEQ:
+    return LVM_OP_NEQ;
+  case LVM_GE:
+    return LVM_OP_GE;
+  case LVM_GEQ:
+    return LVM_OP_GEQ;
+  case LVM_LE:
+    return LVM_OP_LE;
+  case LVM_LEQ:
+    return LVM_OP_LEQ;
+  default:
+    return -1;
+  }
+}
+
+/* Get the opcode that gives the same result as the operator when
+   its operands are swapped, or -1 if there is no such opcode. */
+static int
+to_mirrored_opcode(operator_t op)
+{
+  switch(op) {
+  case LVM_ADD:
+  case LVM_MUL:
+  case LVM_EQ:
+  case LVM_NEQ:
+    return to_opcode(op);
+  case LVM_GE:
+    return LVM_OP_LE;
+  case LVM_GEQ:
+    return LVM_OP_LEQ;
+  case LVM_LE:
+    return LVM_OP_GE;
+  case LVM_LEQ:
+    return LVM_OP_GEQ;
+  default:
+    return -1;
+  }
+}
+
+static lvm_status_t
+emit(lvm_program_t *program, int opcode, uint8_t arg, long value)
+{
+  lvm_insn_t *insn;
+
+  if(program->length >= LVM_MAX_INSTRUCTIONS) {
+    return STACK_OVERFLOW;
+  }
+
+  insn = &program->code[program->length++];
+  insn->opcode = opcode;
+  insn->arg = arg;
+  insn->value = value;
+
+  if(opcode == LVM_OP_VARIABLE) {
+    program->unbound++;
+  }
+
+  return TRUE;
+}
+
+/* Consume a constant operand if there is one at the current position. */
+static int
+get_constant(lvm_instance_t *p, long *value)
+{
+  lvm_ip_t ip;
+  operand_t operand;
+
+  ip = p->ip;
+  if(get_type(p) == LVM_OPERAND) {
+    get_operand(p, &operand);
+    if(operand.type != LVM_VARIABLE) {
+      *value = operand_to_long(&operand);
+      return 1;
+    }
+  }
+  p->ip = ip;
+
+  return 0;
+}
+
+static lvm_status_t compile_operand(lvm_instance_t *p,
+                                    lvm_program_t *program, int depth);
+
+/* Compile the operands of a binary operator, followed by the operator.
+   A constant operand is folded into the operator instruction, so that
+   the common comparison of an attribute with a constant becomes a load
+   and a compare. */
+static lvm_status_t
+compile_binary(lvm_instance_t *p, lvm_program_t *program,
+               operator_t op, int depth)
+{
+  int opcode;
+  long value;
+  lvm_status_t r;
+
+  opcode = to_opcode(op);
+  if(opcode < 0) {
+    return EXECUTION_ERROR;
+  }
+
+  if(get_constant(p, &value)) {
+    if(to_mirrored_opcode(op) >= 0) {
+      r = compile_operand(p, program, depth);
+      if(LVM_ERROR(r)) {
+        return r;
+      }
+      return emit(program, to_mirrored_opcode(op), LVM_ARG_IMMEDIATE, value);
+    }
+    r = emit(program, LVM_OP_CONST, 0, value);
+  } else {
+    r = compile_operand(p, program, depth);
+    if(!LVM_ERROR(r) && get_constant(p, &value)) {
+      return emit(program, opcode, LVM_ARG_IMMEDIATE, value);
+    }
+  }
+  if(LVM_ERROR(r)) {
+    return r;
+  }
+
+  r = compile_operand(p, program, depth + 1);
+  if(LVM_ERROR(r)) {
+    return r;
+  }
+
+  return emit(program, opcode, 0, 0);
+}
+
+/* Compile an operand that pushes one value onto a stack holding
+   depth values. */
+static lvm_status_t
+compile_operand(lvm_instance_t *p, lvm_program_t *program, int depth)
+{
+  operator_t *operator;
+  operand_t operand;
+
+  if(depth >= LVM_STACK_SIZE) {
+    return STACK_OVERFLOW;
+  }
+
+  switch(get_type(p)) {
+  case LVM_ARITH_OP:
+    operator = get_operator(p);
+    return compile_binary(p, program, *operator, depth);
+  case LVM_OPERAND:
+    get_operand(p, &operand);
+    if(operand.type == LVM_VARIABLE) {
+      return emit(program, LVM_OP_VARIABLE, operand.value.id, 0);
+    }
+    return emit(program, LVM_OP_CONST, 0, operand_to_long(&operand));
+  default:
+    return SEMANTIC_ERROR;
+  }
+}
+
+static lvm_status_t
+compile_logic(lvm_instance_t *p, lvm_program_t *program,
+              operator_t op, int depth)
+{
+  int i;
+  unsigned arguments;
+  operator_t *operator;
+  lvm_status_t r;
+  uint8_t jump;
+
+  if(!IS_CONNECTIVE(op)) {
+    if(to_opcode(op) < LVM_OP_EQ) {
+      return EXECUTION_ERROR;
+    }
+    return compile_binary(p, program, op, depth);
+  }
+
+  /* The right operand of a connective is skipped if the left
+     operand decides the result. */
+  jump = 0;
+  arguments = op == LVM_NOT ? 1 : 2;
+  for(i = 0; i < arguments; i++) {
+    if(get_type(p) != LVM_CMP_OP) {
+      return SEMANTIC_ERROR;
+    }
+    operator = get_operator(p);
+    r = compile_logic(p, program, *operator, depth);
+    if(LVM_ERROR(r)) {
+      return r;
+    }
+    if(i == 0 && arguments == 2) {
+      jump = program->length;
+      r = emit(program, op == LVM_AND ? LVM_OP_JUMP_FALSE : LVM_OP_JUMP_TRUE,
+               0, 0);
+      if(LVM_ERROR(r)) {
+        return r;
+      }
+    }
+  }
+
+  if(op == LVM_NOT) {
+    return emit(program, LVM_OP_NOT, 0, 0);
+  }
+
+  program->code[jump].arg = program->length;
+  return TRUE;
+}
+
+lvm_status_t
+lvm_compile(lvm_instance_t *p, lvm_program_t *program)
+{
+  operator_t *operator;
+  lvm_status_t status;
+
+  program->length = 0;
+  program->unbound = 0;
+
+  p->ip = 0;
+  if(get_type(p) != LVM_CMP_OP) {
+    PRINTF("Error: The code must start with a relational operator\n");
+    return SEMANTIC_ERROR;
+  }
+  operator = get_operator(p);
+  status = compile_logic(p, program, *operator, 0);
+  if(LVM_ERROR(status)) {
+    PRINTF("Compilation error: %d\n", (int)status);
+  } else {
+    PRINTF("Compiled %u instructions\n", (unsigned)program->length);
+  }
+
+  return status;
+}
+
+lvm_status_t
+lvm_bind_variable(lvm_program_t *program, char *name,
+                  unsigned offset, unsigned length)
+{
+  variable_id_t id;
+  lvm_insn_t *insn;
+
+  id = lookup(name);
+  if(id >= LVM_MAX_VARIABLE_ID) {
+    return INVALID_IDENTIFIER;
+  }
+
+  if(offset > UINT8_MAX || (length != 2 && length != 4)) {
+    return TYPE_ERROR;
+  }
+
+  for(insn = program->code; insn < program->code + program->length; insn++) {
+    if(insn->opcode == LVM_OP_VARIABLE && insn->arg == id) {
+      insn->opcode = length == 2 ? LVM_OP_LOAD_INT : LVM_OP_LOAD_LONG;
+      insn->arg = offset;
+      program->unbound--;
+    }
+  }
+
+  return TRUE;
+}
+
+lvm_status_t
+lvm_run(const lvm_program_t *program, const unsigned char *row)
+{
+  const lvm_insn_t *insn;
+  const lvm_insn_t *end;
+  const unsigned char *ptr;
+  long stack[LVM_STACK_SIZE];
+  long *sp;
+  long operand;
+
+  sp = stack;
+  end = program->code + program->length;
+  for(insn = program->code; insn < end; insn++) {
+    switch(insn->opcode) {
+    case LVM_OP_CONST:
+      *sp++ = insn->value;
+      continue;
+    case LVM_OP_LOAD_INT:
+      ptr = row + insn->arg;
+      *sp++ = ptr[0] << 8 | ptr[1];
+      continue;
+    case LVM_OP_LOAD_LONG:
+      ptr = row + insn->arg;
+      *sp++ = (uint32_t)ptr[0] << 24 | (uint32_t)ptr[1] << 16 |
+              (uint32_t)ptr[2] << 8 | ptr[3];
+      continue;
+    case LVM_OP_NOT:
+      sp[-1] = !sp[-1];
+      continue;
+    case LVM_OP_JUMP_FALSE:
+      if(sp[-1] == 0) {
+        insn = program->code + insn->arg - 1;
+      } else {
+        sp--;
+      }
+      continue;
+    case LVM_OP_JUMP_TRUE:
+      if(sp[-1] != 0) {
+        insn = program->code + insn->arg - 1;
+      } else {
+        sp--;
+      }
+      continue;
+    case LVM_OP_VARIABLE:
+      return EXECUTION_ERROR;
+    default:
+      break;
+    }
+
+    /* A binary operator. */
+    if(insn->arg == LVM_ARG_IMMEDIATE) {
+      operand = insn->value;
+    } else {
+      operand = *--sp;
+    }
+
+    switch(insn->opcode) {
+    case LVM_OP_ADD:
+      sp[-1] += operand;
+      break;
+    case LVM_OP_SUB:
+      sp[-1] -= operand;
+      break;
+    case LVM_OP_MUL:
+      sp[-1] *= operand;
+      break;
+    case LVM_OP_DIV:
+      if(operand == 0) {
+        return MATH_ERROR;
+      }
+      sp[-1] /= operand;
+      break;
+    case LVM_OP_EQ:
+      sp[-1] = sp[-1] == operand;
+      break;
+    case LVM_OP_NEQ:
+      sp[-1] = sp[-1] != operand;
+      break;
+    case LVM_OP_GE:
+      sp[-1] = sp[-1] > operand;
+      break;
+    case LVM_OP_GEQ:
+      sp[-1] = sp[-1] >= operand;
+      break;
+    case LVM_OP_LE:
+      sp[-1] = sp[-1] < operand;
+      break;
+    case LVM_OP_LEQ:
+      sp[-1] = sp[-1] <= operand;
+      break;
+    default:
+      return EXECUTION_ERROR;
+    }
+  }
+
+  return stack[0] ? TRUE : FALSE;
+}
+
 #if DEBUG
 static lvm_ip_t
 print_operator(lvm_instance_t *p, lvm_ip_t index)
@@ -40,6 +40,7 @@
 #ifndef LVM_H
 #define LVM_H
 
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "db-options.h"
@@ -120,6 +121,53 @@ struct operand {
 };
 typedef struct operand operand_t;
 
+/*
+ * A predicate can be compiled into a flat program in postfix order,
+ * whose variables are bound to attribute offsets in a row. Running the
+ * program on a row does not require the variables to be set by name,
+ * and avoids decoding the tree of the bytecode for each row.
+ */
+enum lvm_opcode {
+  LVM_OP_CONST,
+  LVM_OP_VARIABLE,
+  LVM_OP_LOAD_INT,
+  LVM_OP_LOAD_LONG,
+  LVM_OP_ADD,
+  LVM_OP_SUB,
+  LVM_OP_MUL,
+  LVM_OP_DIV,
+  LVM_OP_EQ,
+  LVM_OP_NEQ,
+  LVM_OP_GE,
+  LVM_OP_GEQ,
+  LVM_OP_LE,
+  LVM_OP_LEQ,
+  LVM_OP_NOT,
+  LVM_OP_JUMP_FALSE,
+  LVM_OP_JUMP_TRUE
+};
+
+/* The argument of a binary operator that takes its right operand
+   from the instruction instead of the stack. */
+#define LVM_ARG_IMMEDIATE	1
+
+struct lvm_insn {
+  uint8_t opcode;
+  /* A row offset for loads, a variable ID, a jump target, or
+     LVM_ARG_IMMEDIATE for binary operators. */
+  uint8_t arg;
+  long value;
+};
+typedef struct lvm_insn lvm_insn_t;
+
+struct lvm_program {
+  lvm_insn_t code[LVM_MAX_INSTRUCTIONS];
+  uint8_t length;
+  /* The number of variable loads not yet bound to a row offset. */
+  uint8_t unbound;
+};
+typedef struct lvm_program lvm_program_t;
+
 void lvm_reset(lvm_instance_t *p, unsigned char *code, lvm_ip_t size);
 void lvm_clone(lvm_instance_t *dst, lvm_instance_t *src);
 lvm_status_t lvm_derive(lvm_instance_t *p);
@@ -128,6 +176,10 @@ lvm_status_t lvm_get_derived_range(lvm_instance_t *p, char *name,
                                    operand_value_t *max);
 void lvm_print_derivations(lvm_instance_t *p);
 lvm_status_t lvm_execute(lvm_instance_t *p);
+lvm_status_t lvm_compile(lvm_instance_t *p, lvm_program_t *program);
+lvm_status_t lvm_bind_variable(lvm_program_t *program, char *name,
+                               unsigned offset, unsigned length);
+lvm_status_t lvm_run(const lvm_program_t *program, const unsigned char *row);
 lvm_status_t lvm_register_variable(char *name, operand_type_t type);
 lvm_status_t lvm_set_variable_value(char *name, operand_value_t value);
 void lvm_print_code(lvm_instance_t *p);
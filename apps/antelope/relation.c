@@ -35,6 +35,7 @@
  */
 
 #include <limits.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "lib/crc16.h"
@@ -68,6 +69,10 @@ struct source_dest_map {
 
 static struct source_dest_map attr_map[AQL_ATTRIBUTE_LIMIT];
 
+/* The predicate of the current selection, compiled to read the
+   attribute values directly from the source row. */
+static lvm_program_t select_program;
+
 #if DB_FEATURE_JOIN
 /*
  * The source_map structure is used for mapping attributes to
@@ -79,6 +84,82 @@ struct source_map {
 };
 
 static struct source_map source_map[AQL_ATTRIBUTE_LIMIT];
+
+/*
+ * The join methods that relation_join() chooses from. The index join
+ * looks up each left row in an index over the right join attribute.
+ * The merge join scans two relations that are sorted on the join
+ * attribute, which is the case when both have an inline index over
+ * it. The hash join loads the smaller relation into a hash table in
+ * chunks of DB_JOIN_HASH_MEMORY bytes, and probes the table with each
+ * row of the larger relation. If the smaller relation needs several
+ * chunks, both relations are first partitioned into files on storage,
+ * so that each pair of partitions can be joined separately. If the
+ * partitions cannot be written, e.g. because skewed keys fill one of
+ * them beyond the storage available, the relations are joined in
+ * chunks without partitioning.
+ */
+typedef enum {
+  JOIN_INDEX = 0,
+  JOIN_MERGE = 1,
+  JOIN_HASH = 2
+} join_method_t;
+
+#define JOIN_END		0xff
+
+#define JOIN_BUCKET(hash)	(((hash) >> 24) % DB_JOIN_HASH_BUCKETS)
+#define JOIN_PARTITION(hash, n)	((((hash) >> 16) & 0xff) % (n))
+
+struct join_entry {
+  long key;
+  uint8_t next;
+};
+
+struct hash_join {
+  relation_t *build_input;
+  relation_t *probe_input;
+  attribute_t *build_attr;
+  attribute_t *probe_attr;
+  unsigned char *build_row;
+  unsigned char *probe_row;
+  tuple_id_t build_next;
+  tuple_id_t probe_next;
+  long probe_key;
+  uint8_t build_offset;
+  uint8_t probe_offset;
+  uint8_t entry_size;
+  uint8_t capacity;
+  uint8_t entry;
+  uint8_t probing;
+  uint8_t partition;
+  uint8_t partitions;
+  uint8_t buckets[DB_JOIN_HASH_BUCKETS];
+};
+
+struct merge_join {
+  tuple_id_t left_next;
+  tuple_id_t right_next;
+  tuple_id_t right_pos;
+  tuple_id_t group_start;
+  tuple_id_t group_end;
+  long group_key;
+  uint8_t left_offset;
+  uint8_t right_offset;
+};
+
+static struct {
+  void *handle;
+  join_method_t method;
+  union {
+    struct hash_join hash;
+    struct merge_join merge;
+  } u;
+} join;
+
+/* The partitions of the build and the probe relation. */
+static relation_t join_partitions[2];
+
+static long join_memory[DB_JOIN_HASH_MEMORY / sizeof(long)];
 #endif /* DB_FEATURE_JOIN */
 
 static unsigned char row[DB_MAX_ATTRIBUTES_PER_RELATION * DB_MAX_ELEMENT_SIZE];
@@ -451,6 +532,7 @@ db_result_t
 relation_remove(char *name, int remove_tuples)
 {
   relation_t *rel;
+  attribute_t *attr;
   db_result_t result;
 
   rel = relation_load(name);
@@ -467,6 +549,15 @@ relation_remove(char *name, int remove_tuples)
     return DB_BUSY_ERROR;
   }
 
+  if(remove_tuples) {
+    /* Indexes that are stored separately are removed as well. */
+    for(attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+      if(attr->index != NULL) {
+        index_destroy(attr->index);
+      }
+    }
+  }
+
   result = storage_drop_relation(rel, remove_tuples);
   relation_free(rel);
   return result;
@@ -636,26 +727,39 @@ select_index(db_handle_t *handle, lvm_instance_t *lvm_instance)
   operand_value_t max;
   attribute_value_t av_min;
   attribute_value_t av_max;
-  long range;
+  unsigned long range;
   unsigned long min_range;
+  int emulated;
+  int min_emulated;
 
   index = NULL;
   min_range = ULONG_MAX;
+  min_emulated = 1;
 
-  /* Find all indexed and derived attributes, and select the index of 
-     the attribute with the smallest range. */
+  /*
+   * Find all indexed and derived attributes, and select the index of
+   * the attribute with the smallest range. A range is preferably
+   * searched in an index that supports range queries, which reads the
+   * matching keys in order. Other indexes emulate a range query by
+   * looking up each value in it.
+   */
   for(attr = list_head(handle->rel->attributes);
       attr != NULL;
       attr = attr->next) {
     if(attr->index != NULL &&
        !LVM_ERROR(lvm_get_derived_range(lvm_instance, attr->name, &min, &max))) {
       range = (unsigned long)max.l - (unsigned long)min.l;
-      PRINTF("DB: The search range for attribute \"%s\" comprises %ld values\n",
+      PRINTF("DB: The search range for attribute \"%s\" comprises %lu values\n",
              attr->name, range + 1);
 
-      if(range <= min_range) {
+      emulated = range > 0 &&
+        !(((index_t *)attr->index)->api->flags & INDEX_API_RANGE_QUERIES);
+      if(emulated < min_emulated ||
+         (emulated == min_emulated && range < min_range)) {
         index = attr->index;
-        av_min.domain = av_max.domain = DOMAIN_INT;
+        min_range = range;
+        min_emulated = emulated;
+        av_min.domain = av_max.domain = DOMAIN_LONG;
         VALUE_LONG(&av_min) = min.l;
         VALUE_LONG(&av_max) = max.l;
       }
@@ -671,6 +775,36 @@ select_index(db_handle_t *handle, lvm_instance_t *lvm_instance)
   }
 }
 
+static void
+compile_predicate(db_handle_t *handle, lvm_instance_t *lvm_instance,
+                  unsigned attribute_count)
+{
+  struct source_dest_map *attr_map_ptr;
+  attribute_t *attr;
+
+  if(LVM_ERROR(lvm_compile(lvm_instance, &select_program))) {
+    return;
+  }
+
+  /* Bind the variables of the predicate to the attributes in the
+     source row. If any variable remains unbound, the interpreter
+     is used instead. */
+  for(attr_map_ptr = attr_map;
+      attr_map_ptr < attr_map + attribute_count;
+      attr_map_ptr++) {
+    attr = attr_map_ptr->to_attr;
+    if(attr->domain == DOMAIN_INT || attr->domain == DOMAIN_LONG) {
+      lvm_bind_variable(&select_program, attr->name,
+                        attr_map_ptr->from_offset,
+                        attr->domain == DOMAIN_INT ? 2 : 4);
+    }
+  }
+
+  if(select_program.unbound == 0) {
+    handle->flags |= DB_HANDLE_FLAG_COMPILED;
+  }
+}
+
 static db_result_t
 generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
 {
@@ -701,6 +835,8 @@ generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
     if(!LVM_ERROR(lvm_derive(adt->lvm_instance))) {
       select_index(handle, adt->lvm_instance);
     }
+
+    compile_predicate(handle, adt->lvm_instance, attribute_count);
   }
 
   handle->flags |= DB_HANDLE_FLAG_PROCESSING;
@@ -746,6 +882,7 @@ relation_process_select(void *handle_ptr)
   uint8_t intbuf[2];
   attribute_value_t value;
   lvm_status_t wanted_result;
+  int interpret;
 
   handle = (db_handle_t *)handle_ptr;
   adt = (aql_adt_t *)handle->adt;
@@ -783,16 +920,32 @@ relation_process_select(void *handle_ptr)
     return DB_FINISHED;
   }
 
+  wanted_result = TRUE;
+  if(AQL_GET_FLAGS(adt) & AQL_FLAG_INVERSE_LOGIC) {
+    wanted_result = FALSE;
+  }
+
+  /* A compiled predicate reads the row directly, so rows that do not
+     fulfill it are skipped before any attribute is processed. */
+  if(handle->flags & DB_HANDLE_FLAG_COMPILED) {
+    if(lvm_run(&select_program, row) != wanted_result) {
+      return DB_OK;
+    }
+    interpret = 0;
+  } else {
+    interpret = adt->lvm_instance != NULL;
+  }
+
   /* Process the attributes in the result relation. */
   for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
     from_ptr = row + attr_map_ptr->from_offset;
     result_attr = attr_map_ptr->to_attr;
 
     /* Update the internal state of the PLE. */
-    if(result_attr->domain == DOMAIN_INT) {
+    if(interpret && result_attr->domain == DOMAIN_INT) {
       operand_value.l = from_ptr[0] << 8 | from_ptr[1];
       lvm_set_variable_value(result_attr->name, operand_value);
-    } else if(result_attr->domain == DOMAIN_LONG) {
+    } else if(interpret && result_attr->domain == DOMAIN_LONG) {
       operand_value.l = (uint32_t)from_ptr[0] << 24 |
                         (uint32_t)from_ptr[1] << 16 |
                         (uint32_t)from_ptr[2] << 8 |
@@ -813,14 +966,8 @@ relation_process_select(void *handle_ptr)
     }
   }
 
-  wanted_result = TRUE;
-  if(AQL_GET_FLAGS(adt) & AQL_FLAG_INVERSE_LOGIC) {
-    wanted_result = FALSE;
-  }
-
   /* Check whether the given predicate is true for this tuple. */
-  if(adt->lvm_instance == NULL ||
-     lvm_execute(adt->lvm_instance) == wanted_result) {
+  if(!interpret || lvm_execute(adt->lvm_instance) == wanted_result) {
     if(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) {
       for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
         from_ptr = row + attr_map_ptr->from_offset;
@@ -880,6 +1027,7 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
   attribute_t *attr;
   int i;
   int normal_attributes;
+  int aggregated_attributes;
 
   adt = (aql_adt_t *)adt_ptr;
 
@@ -903,6 +1051,7 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
     return DB_ALLOCATION_ERROR;
   }
 
+  aggregated_attributes = 0;
   for(i = normal_attributes = 0; i < AQL_ATTRIBUTE_COUNT(adt); i++) {
     attribute_name = adt->attributes[i].name;
 
@@ -944,14 +1093,16 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
       attr->aggregation_value = 0;
       break;
     }
+    if(attr->aggregator != AQL_NONE) {
+      aggregated_attributes++;
+    }
 
     attr->flags = adt->attributes[i].flags;
   }
 
   /* Preclude mixes of normal attributes and aggregated ones in 
      selection results. */
-  if(normal_attributes > 0 &&
-     handle->result_rel->attribute_count > normal_attributes) {
+  if(normal_attributes > 0 && aggregated_attributes > 0) {
      return DB_RELATIONAL_ERROR;
   }
 
@@ -959,24 +1110,67 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
 }
 
 #if DB_FEATURE_JOIN
-db_result_t
-relation_process_join(void *handle_ptr)
+static uint32_t
+join_hash(long key)
+{
+  /* Multiplicative hashing spreads both sequential and strided keys
+     over the high-order bits. */
+  return (uint32_t)key * 2654435761UL;
+}
+
+static long
+join_key(attribute_t *attr, unsigned char *ptr)
+{
+  attribute_value_t value;
+
+  if(DB_ERROR(db_phy_to_value(&value, attr, ptr))) {
+    return 0;
+  }
+  return db_value_to_long(&value);
+}
+
+static db_result_t
+emit_join_row(db_handle_t *handle)
 {
-  db_handle_t *handle;
-  db_result_t result;
-  relation_t *left_rel;
-  relation_t *right_rel;
   relation_t *join_rel;
   unsigned char *join_next_attribute_ptr;
   size_t element_size;
+  int i;
+
+  join_rel = handle->join_rel;
+
+  /* Use the source attribute map to fill in the physical representation
+     of the resulting tuple. */
+  join_next_attribute_ptr = join_row;
+
+  for(i = 0; i < join_rel->attribute_count; i++) {
+    element_size = source_map[i].attr->element_size;
+
+    memcpy(join_next_attribute_ptr, source_map[i].from_ptr, element_size);
+    join_next_attribute_ptr += element_size;
+  }
+
+  if(((aql_adt_t *)handle->adt)->flags & AQL_FLAG_ASSIGN) {
+    if(DB_ERROR(storage_put_row(join_rel, join_row))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  handle->current_row++;
+  return DB_GOT_ROW;
+}
+
+static db_result_t
+process_index_join(db_handle_t *handle)
+{
+  db_result_t result;
+  relation_t *left_rel;
+  relation_t *right_rel;
   tuple_id_t right_tuple_id;
   attribute_value_t value;
-  int i;
 
-  handle = (db_handle_t *)handle_ptr;
   left_rel = handle->left_rel;
   right_rel = handle->right_rel;
-  join_rel = handle->join_rel;
 
   if(!(handle->flags & DB_HANDLE_FLAG_INDEX_STEP)) {
     goto inner_loop;
@@ -1030,31 +1224,526 @@ inner_loop:
         return DB_IMPLEMENTATION_ERROR;
       }
 
-      /* Use the source attribute map to fill in the physical representation
-	 of the resulting tuple. */
-      join_next_attribute_ptr = join_row;
+      return emit_join_row(handle);
+    }
+  }
 
-      for(i = 0; i < join_rel->attribute_count; i++) {
-	element_size = source_map[i].attr->element_size;
+  return DB_OK;
+}
 
-	memcpy(join_next_attribute_ptr, source_map[i].from_ptr, element_size);
-	join_next_attribute_ptr += element_size;
+static db_result_t
+process_merge_join(db_handle_t *handle)
+{
+  struct merge_join *mj;
+  db_result_t result;
+  long key;
+  long right_key;
+
+  mj = &join.u.merge;
+
+  for(;;) {
+    /* Pair the current left row with each row in the group of right
+       rows that have the same key. */
+    if(mj->right_pos < mj->group_end) {
+      result = storage_get_row(handle->right_rel, &mj->right_pos, right_row);
+      if(result != DB_OK) {
+        return DB_ERROR(result) ? result : DB_IMPLEMENTATION_ERROR;
       }
+      mj->right_pos++;
+      return emit_join_row(handle);
+    }
 
-      if(((aql_adt_t *)handle->adt)->flags & AQL_FLAG_ASSIGN) {
-        if(DB_ERROR(storage_put_row(join_rel, join_row))) {
-          return DB_STORAGE_ERROR;
-        }
+    result = storage_get_row(handle->left_rel, &mj->left_next, left_row);
+    if(result != DB_OK) {
+      return result;
+    }
+    mj->left_next++;
+
+    key = join_key(handle->left_join_attr, left_row + mj->left_offset);
+    if(mj->group_end > mj->group_start && key == mj->group_key) {
+      /* Duplicate left key: rescan the group. */
+      mj->right_pos = mj->group_start;
+      continue;
+    }
+
+    /* Advance in the right relation to the group of rows that
+       have the new key, if there is one. */
+    mj->group_start = mj->right_next;
+    for(;;) {
+      result = storage_get_row(handle->right_rel, &mj->right_next, right_row);
+      if(DB_ERROR(result)) {
+        return result;
+      } else if(result == DB_FINISHED) {
+        break;
       }
 
-      handle->current_row++;
-      return DB_GOT_ROW;
+      right_key = join_key(handle->right_join_attr,
+                           right_row + mj->right_offset);
+      if(right_key > key) {
+        break;
+      }
+      mj->right_next++;
+      if(right_key < key) {
+        mj->group_start = mj->right_next;
+      }
+    }
+
+    mj->group_end = mj->right_next;
+    mj->group_key = key;
+    mj->right_pos = mj->group_start;
+
+    if(result == DB_FINISHED && mj->group_end == mj->group_start) {
+      /* The remaining left rows have larger keys than any right row. */
+      return DB_FINISHED;
+    }
+  }
+}
+
+static void
+name_partition(relation_t *part, unsigned side, unsigned partition)
+{
+  snprintf(part->tuple_filename, sizeof(part->tuple_filename), "%s.%c%c",
+           JOIN_RELATION, side == 0 ? 'b' : 'p', '0' + partition);
+}
+
+/*
+ * Estimate the cost in row reads of a hash join of build rows, in
+ * chunks of capacity rows, with probe rows, and choose the number of
+ * partitions for it. Without partitions, the probe rows are read once
+ * per chunk. With them, writing the partitions and reading them back
+ * costs two passes over both relations, and each partition is probed
+ * once per chunk of its build rows. Keys are rarely spread evenly, so
+ * the largest partition is assumed to get twice its share of the rows,
+ * which is also the room write_partitions() reserves for it.
+ */
+static unsigned long
+hash_join_cost(unsigned long build, unsigned long probe,
+               unsigned long capacity, unsigned *partitions)
+{
+  unsigned long chunks;
+  unsigned long cost;
+  unsigned long spill_cost;
+  unsigned n;
+
+  chunks = (build + capacity - 1) / capacity;
+  cost = build + probe * (chunks > 0 ? chunks : 1);
+  *partitions = 1;
+
+  if(chunks > 1) {
+    n = chunks > DB_JOIN_MAX_PARTITIONS ? DB_JOIN_MAX_PARTITIONS : chunks;
+    spill_cost = 2 * (build + probe) + build +
+                 probe * ((2 * chunks + n - 1) / n);
+    if(spill_cost < cost) {
+      cost = spill_cost;
+      *partitions = n;
+    }
+  }
+
+  return cost;
+}
+
+static void
+remove_partitions(void)
+{
+  unsigned side;
+  unsigned partition;
+
+  for(side = 0; side < 2; side++) {
+    for(partition = 0; partition < join.u.hash.partitions; partition++) {
+      name_partition(&join_partitions[side], side, partition);
+      storage_remove_temporary(&join_partitions[side]);
+    }
+  }
+}
+
+static db_result_t
+open_partition(struct hash_join *hj)
+{
+  unsigned side;
+
+  for(side = 0; side < 2; side++) {
+    if(hj->partition > 0) {
+      /* The previous partition has been joined completely. */
+      name_partition(&join_partitions[side], side, hj->partition - 1);
+      storage_remove_temporary(&join_partitions[side]);
+    }
+    name_partition(&join_partitions[side], side, hj->partition);
+    if(DB_ERROR(storage_load(&join_partitions[side]))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  hj->build_next = 0;
+
+  return DB_OK;
+}
+
+/* Spread the rows of a relation over the partition files of one side
+   of the join, by the hash of their join keys. */
+static db_result_t
+write_partitions(relation_t *rel, unsigned side, attribute_t *attr,
+                 unsigned offset, unsigned char *buf)
+{
+  struct hash_join *hj;
+  relation_t *part;
+  db_storage_id_t fd[DB_JOIN_MAX_PARTITIONS];
+  tuple_id_t tuple_id;
+  unsigned long size;
+  db_result_t result;
+  unsigned partition;
+  unsigned opened;
+
+  hj = &join.u.hash;
+  part = &join_partitions[side];
+
+  /* Reserve room for twice the expected share of the rows, to
+     leave some space for skewed keys. Coffee extends a file that
+     outgrows its reservation; if even that fails, the caller joins
+     without partitions. */
+  size = 2 * (relation_cardinality(rel) / hj->partitions + 1) *
+         rel->row_length;
+
+  result = DB_OK;
+  for(opened = 0; opened < hj->partitions; opened++) {
+    name_partition(part, side, opened);
+    part->tuple_storage = -1;
+    result = storage_create_temporary(part, size);
+    if(DB_ERROR(result)) {
+      break;
+    }
+    fd[opened] = part->tuple_storage;
+  }
+
+  for(tuple_id = 0; !DB_ERROR(result); tuple_id++) {
+    result = storage_get_row(rel, &tuple_id, buf);
+    if(result != DB_OK) {
+      break;
+    }
+
+    partition = JOIN_PARTITION(join_hash(join_key(attr, buf + offset)),
+                               hj->partitions);
+    part->tuple_storage = fd[partition];
+    result = storage_put_row(part, buf);
+  }
+
+  while(opened-- > 0) {
+    part->tuple_storage = fd[opened];
+    storage_unload(part);
+  }
+
+  return DB_ERROR(result) ? result : DB_OK;
+}
+
+/* Load the next chunk of build rows into the hash table. */
+static db_result_t
+build_hash_table(struct hash_join *hj)
+{
+  struct join_entry *entry;
+  db_result_t result;
+  unsigned bucket;
+  uint8_t count;
+
+  memset(hj->buckets, JOIN_END, sizeof(hj->buckets));
+
+  for(count = 0; count < hj->capacity;) {
+    entry = (struct join_entry *)((unsigned char *)join_memory +
+                                  count * hj->entry_size);
+    result = storage_get_row(hj->build_input, &hj->build_next,
+                             (unsigned char *)(entry + 1));
+    if(DB_ERROR(result)) {
+      return result;
+    } else if(result == DB_FINISHED) {
+      if(count > 0) {
+        break;
+      }
+      if(++hj->partition >= hj->partitions) {
+        return DB_FINISHED;
+      }
+      if(DB_ERROR(open_partition(hj))) {
+        return DB_STORAGE_ERROR;
+      }
+      continue;
+    }
+    hj->build_next++;
+
+    entry->key = join_key(hj->build_attr,
+                          (unsigned char *)(entry + 1) + hj->build_offset);
+    bucket = JOIN_BUCKET(join_hash(entry->key));
+    entry->next = hj->buckets[bucket];
+    hj->buckets[bucket] = count++;
+  }
+
+  PRINTF("DB: Loaded %u rows into the hash join table\n", (unsigned)count);
+
+  return DB_OK;
+}
+
+static db_result_t
+process_hash_join(db_handle_t *handle)
+{
+  struct hash_join *hj;
+  struct join_entry *entry;
+  db_result_t result;
+
+  hj = &join.u.hash;
+
+  for(;;) {
+    /* Emit the remaining matches for the current probe row. */
+    while(hj->entry != JOIN_END) {
+      entry = (struct join_entry *)((unsigned char *)join_memory +
+                                    hj->entry * hj->entry_size);
+      hj->entry = entry->next;
+      if(entry->key == hj->probe_key) {
+        memcpy(hj->build_row, entry + 1, hj->build_input->row_length);
+        return emit_join_row(handle);
+      }
+    }
+
+    if(hj->probing) {
+      result = storage_get_row(hj->probe_input, &hj->probe_next,
+                               hj->probe_row);
+      if(DB_ERROR(result)) {
+        return result;
+      } else if(result == DB_OK) {
+        hj->probe_next++;
+        hj->probe_key = join_key(hj->probe_attr,
+                                 hj->probe_row + hj->probe_offset);
+        hj->entry = hj->buckets[JOIN_BUCKET(join_hash(hj->probe_key))];
+        continue;
+      }
+    }
+
+    /* All probe rows have been matched against the current chunk. */
+    hj->probing = 0;
+    result = build_hash_table(hj);
+    if(result != DB_OK) {
+      relation_join_release(handle);
+      return result;
     }
+    hj->probe_next = 0;
+    hj->probing = 1;
+  }
+}
+
+static db_result_t
+prepare_hash_join(db_handle_t *handle)
+{
+  struct hash_join *hj;
+  relation_t *build_rel;
+  relation_t *probe_rel;
+  unsigned partitions;
+  int build_offset;
+  int probe_offset;
+  unsigned entry_size;
+  unsigned capacity;
+
+  hj = &join.u.hash;
+
+  /* Build the hash table from the smaller relation. */
+  if(relation_cardinality(handle->right_rel) <
+     relation_cardinality(handle->left_rel)) {
+    build_rel = handle->right_rel;
+    probe_rel = handle->left_rel;
+    hj->build_attr = handle->right_join_attr;
+    hj->probe_attr = handle->left_join_attr;
+    hj->build_row = right_row;
+    hj->probe_row = left_row;
+  } else {
+    build_rel = handle->left_rel;
+    probe_rel = handle->right_rel;
+    hj->build_attr = handle->left_join_attr;
+    hj->probe_attr = handle->right_join_attr;
+    hj->build_row = left_row;
+    hj->probe_row = right_row;
+  }
+
+  build_offset = get_attribute_value_offset(build_rel, hj->build_attr);
+  probe_offset = get_attribute_value_offset(probe_rel, hj->probe_attr);
+  if(build_offset < 0 || probe_offset < 0) {
+    return DB_IMPLEMENTATION_ERROR;
+  }
+  hj->build_offset = build_offset;
+  hj->probe_offset = probe_offset;
+
+  entry_size = (sizeof(struct join_entry) + build_rel->row_length +
+                sizeof(long) - 1) & ~(sizeof(long) - 1);
+  capacity = DB_JOIN_HASH_MEMORY / entry_size;
+  if(capacity >= JOIN_END) {
+    capacity = JOIN_END - 1;
+  } else if(capacity == 0) {
+    PRINTF("DB: The hash join memory cannot hold a row of %s\n",
+           build_rel->name);
+    return DB_ALLOCATION_ERROR;
+  }
+  hj->entry_size = entry_size;
+  hj->capacity = capacity;
+
+  hash_join_cost(relation_cardinality(build_rel),
+                 relation_cardinality(probe_rel), capacity, &partitions);
+  hj->partitions = partitions;
+  hj->partition = 0;
+  hj->probing = 0;
+  hj->entry = JOIN_END;
+  hj->build_next = 0;
+  hj->build_input = build_rel;
+  hj->probe_input = probe_rel;
+
+  if(hj->partitions == 1) {
+    return DB_OK;
+  }
+
+  PRINTF("DB: Spilling the hash join into %u partitions\n",
+         (unsigned)hj->partitions);
+
+  join_partitions[0].tuple_storage = join_partitions[1].tuple_storage = -1;
+  join_partitions[0].row_length = build_rel->row_length;
+  join_partitions[1].row_length = probe_rel->row_length;
+
+  if(DB_ERROR(write_partitions(build_rel, 0, hj->build_attr, build_offset,
+                               hj->build_row)) ||
+     DB_ERROR(write_partitions(probe_rel, 1, hj->probe_attr, probe_offset,
+                               hj->probe_row)) ||
+     DB_ERROR(open_partition(hj))) {
+    /* Slower, but needs no storage. */
+    PRINTF("DB: Failed to partition the relations to join, joining them in chunks\n");
+    remove_partitions();
+    hj->partitions = 1;
+    hj->partition = 0;
+    hj->build_next = 0;
+    return DB_OK;
+  }
+
+  hj->build_input = &join_partitions[0];
+  hj->probe_input = &join_partitions[1];
+
+  return DB_OK;
+}
+
+static db_result_t
+prepare_merge_join(db_handle_t *handle)
+{
+  struct merge_join *mj;
+  int left_offset;
+  int right_offset;
+
+  mj = &join.u.merge;
+
+  left_offset = get_attribute_value_offset(handle->left_rel,
+                                           handle->left_join_attr);
+  right_offset = get_attribute_value_offset(handle->right_rel,
+                                            handle->right_join_attr);
+  if(left_offset < 0 || right_offset < 0) {
+    return DB_IMPLEMENTATION_ERROR;
   }
 
+  memset(mj, 0, sizeof(*mj));
+  mj->left_offset = left_offset;
+  mj->right_offset = right_offset;
+
   return DB_OK;
 }
 
+static int
+is_sorted(attribute_t *attr)
+{
+  return index_exists(attr) &&
+         ((index_t *)attr->index)->type == INDEX_INLINE;
+}
+
+/*
+ * Choose the join method with the lowest estimated cost, counted in
+ * row reads. An index lookup is assumed to cost as much as reading
+ * DB_INDEX_COST rows.
+ */
+static join_method_t
+select_join_method(db_handle_t *handle)
+{
+  tuple_id_t left_cardinality;
+  tuple_id_t right_cardinality;
+  unsigned long build;
+  unsigned long probe;
+  unsigned long capacity;
+  unsigned partitions;
+  unsigned long cost;
+  unsigned long min_cost;
+  join_method_t method;
+
+  left_cardinality = relation_cardinality(handle->left_rel);
+  right_cardinality = relation_cardinality(handle->right_rel);
+
+  if(left_cardinality < right_cardinality) {
+    build = left_cardinality;
+    probe = right_cardinality;
+    capacity = handle->left_rel->row_length;
+  } else {
+    build = right_cardinality;
+    probe = left_cardinality;
+    capacity = handle->right_rel->row_length;
+  }
+  capacity = DB_JOIN_HASH_MEMORY /
+             ((sizeof(struct join_entry) + capacity + sizeof(long) - 1) &
+              ~(sizeof(long) - 1));
+  if(capacity >= JOIN_END) {
+    capacity = JOIN_END - 1;
+  }
+
+  method = JOIN_HASH;
+  min_cost = ULONG_MAX;
+  if(capacity > 0) {
+    min_cost = hash_join_cost(build, probe, capacity, &partitions);
+  }
+
+  if(is_sorted(handle->left_join_attr) && is_sorted(handle->right_join_attr)) {
+    cost = left_cardinality + right_cardinality;
+    if(cost <= min_cost) {
+      method = JOIN_MERGE;
+      min_cost = cost;
+    }
+  }
+
+  if(index_exists(handle->right_join_attr)) {
+    cost = left_cardinality * (unsigned long)DB_INDEX_COST;
+    if(cost < min_cost) {
+      method = JOIN_INDEX;
+      min_cost = cost;
+    }
+  }
+
+  PRINTF("DB: Join method %d selected for %lu x %lu rows (cost %lu)\n",
+         (int)method, (unsigned long)left_cardinality,
+         (unsigned long)right_cardinality, min_cost);
+
+  return method;
+}
+
+db_result_t
+relation_process_join(void *handle_ptr)
+{
+  switch(join.method) {
+  case JOIN_MERGE:
+    return process_merge_join(handle_ptr);
+  case JOIN_HASH:
+    return process_hash_join(handle_ptr);
+  default:
+    return process_index_join(handle_ptr);
+  }
+}
+
+void
+relation_join_release(void *handle_ptr)
+{
+  if(handle_ptr == NULL || join.handle != handle_ptr) {
+    return;
+  }
+
+  if(join.method == JOIN_HASH && join.u.hash.partitions > 1) {
+    remove_partitions();
+    join.u.hash.partitions = 0;
+  }
+
+  join.handle = NULL;
+}
+
 static db_result_t
 generate_join_result(db_handle_t *handle)
 {
@@ -1120,6 +1809,7 @@ relation_join(void *query_result, void *adt_ptr)
   int i;
   char *attribute_name;
   attribute_t *attr;
+  db_result_t result;
 
   adt = (aql_adt_t *)adt_ptr;
 
@@ -1158,11 +1848,22 @@ relation_join(void *query_result, void *adt_ptr)
     return DB_RELATIONAL_ERROR;
   }
 
-  if(!index_exists(handle->right_join_attr)) {
-    PRINTF("DB: The attribute to join on is not indexed\n");
-    return DB_INDEX_ERROR;
+  if(relation_cardinality(left_rel) == INVALID_TUPLE ||
+     relation_cardinality(right_rel) == INVALID_TUPLE) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if((handle->left_join_attr->domain != DOMAIN_INT &&
+      handle->left_join_attr->domain != DOMAIN_LONG) ||
+     (handle->right_join_attr->domain != DOMAIN_INT &&
+      handle->right_join_attr->domain != DOMAIN_LONG)) {
+    PRINTF("DB: Cannot join on a non-number attribute\n");
+    return DB_RELATIONAL_ERROR;
   }
 
+  relation_join_release(join.handle);
+  join.method = select_join_method(handle);
+
   /*
    * Define the resulting relation. We start from 1 when counting attributes
    * because the first attribute is only the one to join, and is not included
@@ -1189,7 +1890,21 @@ relation_join(void *query_result, void *adt_ptr)
     handle->ncolumns++;
   }
 
-  return generate_join_result(handle);
+  result = generate_join_result(handle);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  join.handle = handle;
+
+  switch(join.method) {
+  case JOIN_MERGE:
+    return prepare_merge_join(handle);
+  case JOIN_HASH:
+    return prepare_hash_join(handle);
+  default:
+    return DB_OK;
+  }
 }
 #endif /* DB_FEATURE_JOIN */
 
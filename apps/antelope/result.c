@@ -178,6 +178,9 @@ db_free(db_handle_t *handle)
   if(handle->right_rel != NULL) {
     relation_release(handle->right_rel);
   }
+#if DB_FEATURE_JOIN
+  relation_join_release(handle);
+#endif /* DB_FEATURE_JOIN */
 
   handle->flags = 0;
 
@@ -68,6 +68,25 @@ struct index_record {
 
 #define ROW_XOR 0xf6U
 
+/*
+ * Rows are read from storage one page at a time into a small cache
+ * that is shared by all relations. A scan over a relation therefore
+ * accesses the file system once per page instead of once per row.
+ * Pages are identified by the file descriptor of the relation, and
+ * are invalidated when rows are appended to the relation or when the
+ * file is closed.
+ */
+struct row_page {
+  unsigned long number;
+  db_storage_id_t fd;
+  uint16_t length;
+  uint16_t stamp;
+  unsigned char data[DB_STORAGE_PAGE_SIZE];
+};
+
+static struct row_page row_pages[DB_STORAGE_CACHE_PAGES];
+static uint16_t page_clock;
+
 static void
 merge_strings(char *dest, char *prefix, char *suffix)
 {
@@ -75,6 +94,67 @@ merge_strings(char *dest, char *prefix, char *suffix)
   strcat(dest, suffix);
 }
 
+/* Invalidate the cached pages of a file, starting at the page
+   that contains the given offset. */
+static void
+invalidate_pages(db_storage_id_t fd, unsigned long offset)
+{
+  struct row_page *page;
+
+  for(page = row_pages; page < &row_pages[DB_STORAGE_CACHE_PAGES]; page++) {
+    if(page->fd == fd &&
+       page->number >= offset / DB_STORAGE_PAGE_SIZE) {
+      page->length = 0;
+    }
+  }
+}
+
+static struct row_page *
+get_page(db_storage_id_t fd, unsigned long number)
+{
+  struct row_page *page;
+  struct row_page *victim;
+  int r;
+
+  victim = row_pages;
+  for(page = row_pages; page < &row_pages[DB_STORAGE_CACHE_PAGES]; page++) {
+    if(page->length > 0 && page->fd == fd && page->number == number) {
+      page->stamp = ++page_clock;
+      return page;
+    }
+    /* Replace an empty page, or else the least recently used one. */
+    if(victim->length > 0 &&
+       (page->length == 0 ||
+        (uint16_t)(page_clock - page->stamp) >
+        (uint16_t)(page_clock - victim->stamp))) {
+      victim = page;
+    }
+  }
+
+  victim->length = 0;
+  if(cfs_seek(fd, number * DB_STORAGE_PAGE_SIZE, CFS_SEEK_SET) ==
+     (cfs_offset_t)-1) {
+    return NULL;
+  }
+
+  do {
+    r = cfs_read(fd, victim->data + victim->length,
+                 DB_STORAGE_PAGE_SIZE - victim->length);
+    if(r < 0) {
+      PRINTF("DB: Reading failed on fd %d\n", fd);
+      victim->length = 0;
+      return NULL;
+    }
+    victim->length += r;
+  } while(r > 0 && victim->length < DB_STORAGE_PAGE_SIZE);
+
+  victim->fd = fd;
+  victim->number = number;
+  victim->stamp = ++page_clock;
+
+  return victim;
+}
+
 char *
 storage_generate_file(char *prefix, unsigned long size)
 {
@@ -120,6 +200,7 @@ storage_unload(relation_t *rel)
   if(RELATION_HAS_TUPLES(rel)) {
     PRINTF("DB: Unload tuple file %s\n", rel->tuple_filename);
 
+    invalidate_pages(rel->tuple_storage, 0);
     cfs_close(rel->tuple_storage);
     rel->tuple_storage = -1;
   }
@@ -279,12 +360,46 @@ storage_put_attribute(relation_t *rel, attribute_t *attr)
 db_result_t
 storage_drop_relation(relation_t *rel, int remove_tuples)
 {
+  char filename[INDEX_NAME_LENGTH];
+
   if(remove_tuples && RELATION_HAS_TUPLES(rel)) {
     cfs_remove(rel->tuple_filename);
   }
+  if(remove_tuples) {
+    merge_strings(filename, rel->name, INDEX_NAME_SUFFIX);
+    cfs_remove(filename);
+  }
   return cfs_remove(rel->name) < 0 ? DB_STORAGE_ERROR : DB_OK;
 }
 
+/*
+ * Temporary relations have no catalog entry, only a tuple file.
+ * The caller names the file in rel->tuple_filename and sets the
+ * row length.
+ */
+db_result_t
+storage_create_temporary(relation_t *rel, unsigned long size)
+{
+  cfs_remove(rel->tuple_filename);
+
+#if DB_FEATURE_COFFEE
+  PRINTF("DB: Reserving %lu bytes in %s\n", size, rel->tuple_filename);
+  if(cfs_coffee_reserve(rel->tuple_filename, size) < 0) {
+    PRINTF("DB: Failed to reserve\n");
+    return DB_STORAGE_ERROR;
+  }
+#endif /* DB_FEATURE_COFFEE */
+
+  return storage_load(rel);
+}
+
+void
+storage_remove_temporary(relation_t *rel)
+{
+  storage_unload(rel);
+  cfs_remove(rel->tuple_filename);
+}
+
 #if DB_FEATURE_REMOVE
 db_result_t
 storage_rename_relation(char *old_name, char *new_name)
@@ -403,31 +518,33 @@ storage_put_index(index_t *index)
 db_result_t
 storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
 {
-  int r;
-  tuple_id_t nrows;
-
-  if(DB_ERROR(storage_get_row_amount(rel, &nrows))) {
-    return DB_STORAGE_ERROR;
-  }
-
-  if(*tuple_id >= nrows) {
-    return DB_FINISHED;
-  }
+  struct row_page *page;
+  unsigned long offset;
+  unsigned start;
+  unsigned copied;
+  unsigned length;
+
+  offset = (unsigned long)*tuple_id * rel->row_length;
+
+  /* A row may span two pages. */
+  for(copied = 0; copied < rel->row_length; copied += length) {
+    page = get_page(rel->tuple_storage,
+                    (offset + copied) / DB_STORAGE_PAGE_SIZE);
+    if(page == NULL) {
+      return DB_STORAGE_ERROR;
+    }
 
-  if(cfs_seek(rel->tuple_storage, *tuple_id * rel->row_length, CFS_SEEK_SET) ==
-              (cfs_offset_t)-1) {
-    return DB_STORAGE_ERROR;
-  }
+    start = (offset + copied) % DB_STORAGE_PAGE_SIZE;
+    if(start >= page->length) {
+      /* The row is beyond the end of the file, or incomplete. */
+      return DB_FINISHED;
+    }
 
-  r = cfs_read(rel->tuple_storage, row, rel->row_length);
-  if(r < 0) {
-    PRINTF("DB: Reading failed on fd %d\n", rel->tuple_storage);
-    return DB_STORAGE_ERROR;
-  } else if(r == 0) {
-    return DB_FINISHED;
-  } else if(r < rel->row_length) {
-    PRINTF("DB: Incomplete record: %d < %d\n", r, rel->row_length);
-    return DB_STORAGE_ERROR;
+    length = page->length - start;
+    if(length > rel->row_length - copied) {
+      length = rel->row_length - copied;
+    }
+    memcpy(row + copied, page->data + start, length);
   }
 
   row[rel->row_length - 1] ^= ROW_XOR;
@@ -454,6 +571,8 @@ storage_put_row(relation_t *rel, storage_row_t row)
     return DB_STORAGE_ERROR;
   }
 
+  invalidate_pages(rel->tuple_storage, end);
+
 #if DB_FEATURE_INTEGRITY
   missing_bytes = end % rel->row_length;
   if(missing_bytes > 0) {
@@ -525,6 +644,7 @@ storage_open(const char *filename)
 void
 storage_close(db_storage_id_t fd)
 {
+  invalidate_pages(fd, 0);
   cfs_close(fd);
 }
 
@@ -565,6 +685,8 @@ storage_write(db_storage_id_t fd,
   char *ptr;
   int r;
 
+  invalidate_pages(fd, offset);
+
   if(cfs_seek(fd, offset, CFS_SEEK_SET) == (cfs_offset_t)-1) {
     return DB_STORAGE_ERROR;
   }
@@ -59,6 +59,8 @@ db_result_t storage_get_relation(relation_t *, char *);
 db_result_t storage_put_relation(relation_t *);
 db_result_t storage_drop_relation(relation_t *, int);
 db_result_t storage_rename_relation(char *, char *);
+db_result_t storage_create_temporary(relation_t *, unsigned long);
+void storage_remove_temporary(relation_t *);
 
 db_result_t storage_put_attribute(relation_t *, attribute_t *);
 db_result_t storage_get_index(index_t *, relation_t *, attribute_t *);
@@ -88,28 +88,32 @@ coap_block1_handler(void *request, void *response, uint8_t *target, size_t *len,
     return -1;
   }
 
-  coap_packet_t *packet = (coap_packet_t *)request;
+  uint32_t num = 0;
+  uint8_t more = 0;
+  uint16_t size = 0;
+  uint32_t offset = 0;
+  int has_block1 = coap_get_header_block1(request, &num, &more, &size, &offset);
 
-  if(packet->block1_offset + pay_len > max_len) {
+  if(offset + pay_len > max_len) {
     erbium_status_code = REST.status.REQUEST_ENTITY_TOO_LARGE;
     coap_error_message = "Message to big";
     return -1;
   }
 
   if(target && len) {
-    memcpy(target + packet->block1_offset, payload, pay_len);
-    *len = packet->block1_offset + pay_len;
+    memcpy(target + offset, payload, pay_len);
+    *len = offset + pay_len;
   }
 
-  if(IS_OPTION(packet, COAP_OPTION_BLOCK1)) {
+  if(has_block1) {
     PRINTF("Blockwise: block 1 request: Num: %u, More: %u, Size: %u, Offset: %u\n",
-           packet->block1_num,
-           packet->block1_more,
-           packet->block1_size,
-           packet->block1_offset);
+           num,
+           more,
+           size,
+           offset);
 
-    coap_set_header_block1(response, packet->block1_num, packet->block1_more, packet->block1_size);
-    if(packet->block1_more) {
+    coap_set_header_block1(response, num, more, size);
+    if(more) {
       coap_set_status_code(response, CONTINUE_2_31);
       return 1;
     }
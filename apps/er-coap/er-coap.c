@@ -218,7 +218,7 @@ coap_serialize_array_option(unsigned int number, unsigned int current_number,
 }
 /*---------------------------------------------------------------------------*/
 static void
-coap_merge_multi_option(char **dst, size_t *dst_len, uint8_t *option,
+coap_merge_multi_option(char **dst, uint16_t *dst_len, uint8_t *option,
                         size_t option_len, char separator)
 {
   /* merge multiple options */
@@ -238,6 +238,120 @@ coap_merge_multi_option(char **dst, size_t *dst_len, uint8_t *option,
   }
 }
 /*---------------------------------------------------------------------------*/
+static uint8_t *
+coap_parse_option_header(uint8_t *current_option, unsigned int *option_number,
+                         size_t *option_length)
+{
+  unsigned int option_delta = current_option[0] >> 4;
+  size_t length = current_option[0] & 0x0F;
+
+  ++current_option;
+
+  if(option_delta == 13) {
+    option_delta += current_option[0];
+    ++current_option;
+  } else if(option_delta == 14) {
+    option_delta += 255;
+    option_delta += current_option[0] << 8;
+    ++current_option;
+    option_delta += current_option[0];
+    ++current_option;
+  }
+
+  if(length == 13) {
+    length += current_option[0];
+    ++current_option;
+  } else if(length == 14) {
+    length += 255;
+    length += current_option[0] << 8;
+    ++current_option;
+    length += current_option[0];
+    ++current_option;
+  }
+
+  *option_number += option_delta;
+  *option_length = length;
+
+  return current_option;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+coap_get_lazy_option(coap_packet_t *coap_pkt, unsigned int lazy,
+                     size_t *option_length)
+{
+  unsigned int option_number = 0;
+
+  return coap_parse_option_header(coap_pkt->buffer + coap_pkt->lazy[lazy],
+                                  &option_number, option_length);
+}
+/*---------------------------------------------------------------------------*/
+static void
+coap_decode_block_option(uint8_t *option, size_t option_len, uint32_t *num,
+                         uint8_t *more, uint16_t *size)
+{
+  uint32_t block = coap_parse_int_option(option, option_len);
+
+  *num = block >> 4;
+  *more = (block & 0x08) >> 3;
+  *size = 16 << (block & 0x07);
+}
+/*---------------------------------------------------------------------------*/
+static void
+coap_decode_lazy_option(coap_packet_t *coap_pkt, unsigned int lazy,
+                        uint8_t *option, size_t option_len)
+{
+  switch(lazy) {
+  case COAP_LAZY_IF_MATCH:
+    /* TODO support multiple ETags */
+    coap_pkt->if_match_len = MIN(COAP_ETAG_LEN, option_len);
+    memcpy(coap_pkt->if_match, option, coap_pkt->if_match_len);
+    break;
+  case COAP_LAZY_ETAG:
+    coap_pkt->etag_len = MIN(COAP_ETAG_LEN, option_len);
+    memcpy(coap_pkt->etag, option, coap_pkt->etag_len);
+    break;
+  case COAP_LAZY_BLOCK2:
+    coap_decode_block_option(option, option_len, &coap_pkt->block2_num,
+                             &coap_pkt->block2_more, &coap_pkt->block2_size);
+    PRINTF("Block2 [%lu%s (%u B/blk)]\n",
+           (unsigned long)coap_pkt->block2_num,
+           coap_pkt->block2_more ? "+" : "", coap_pkt->block2_size);
+    break;
+  case COAP_LAZY_BLOCK1:
+    coap_decode_block_option(option, option_len, &coap_pkt->block1_num,
+                             &coap_pkt->block1_more, &coap_pkt->block1_size);
+    PRINTF("Block1 [%lu%s (%u B/blk)]\n",
+           (unsigned long)coap_pkt->block1_num,
+           coap_pkt->block1_more ? "+" : "", coap_pkt->block1_size);
+    break;
+  }
+  coap_pkt->lazy[lazy] = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+coap_defer_option(coap_packet_t *coap_pkt, unsigned int lazy,
+                  uint8_t *header, uint8_t *option, size_t option_len)
+{
+  /* offsets must fit the lazy slot; decode options further in right away */
+  if(header - coap_pkt->buffer <= 0xFF) {
+    coap_pkt->lazy[lazy] = header - coap_pkt->buffer;
+  } else {
+    coap_decode_lazy_option(coap_pkt, lazy, option, option_len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+coap_decode_lazy(coap_packet_t *coap_pkt, unsigned int lazy)
+{
+  uint8_t *option;
+  size_t option_len;
+
+  if(coap_pkt->lazy[lazy]) {
+    option = coap_get_lazy_option(coap_pkt, lazy, &option_len);
+    coap_decode_lazy_option(coap_pkt, lazy, option, option_len);
+  }
+}
+/*---------------------------------------------------------------------------*/
 static int
 coap_get_variable(const char *buffer, size_t length, const char *name,
                   const char **output)
@@ -313,6 +427,12 @@ coap_serialize_message(void *packet, uint8_t *buffer)
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
   uint8_t *option;
   unsigned int current_number = 0;
+  unsigned int lazy;
+
+  /* a parsed packet still refers to its old buffer for some options */
+  for(lazy = 0; lazy < COAP_LAZY_OPTIONS; ++lazy) {
+    coap_decode_lazy(coap_pkt, lazy);
+  }
 
   /* Initialize */
   coap_pkt->buffer = buffer;
@@ -444,8 +564,19 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
 
-  /* initialize packet */
-  memset(coap_pkt, 0, sizeof(coap_packet_t));
+  /*
+   * initialize packet: option fields are only valid while their bit in the
+   * option map is set, so clearing the maps and the payload is sufficient
+   */
+  memset(coap_pkt->options, 0, sizeof(coap_pkt->options));
+  memset(coap_pkt->lazy, 0, sizeof(coap_pkt->lazy));
+  coap_pkt->payload = NULL;
+  coap_pkt->payload_len = 0;
+  /* multi-options are merged into these */
+  coap_pkt->location_path_len = 0;
+  coap_pkt->uri_path_len = 0;
+  coap_pkt->uri_query_len = 0;
+  coap_pkt->location_query_len = 0;
 
   /* pointer to packet bytes */
   coap_pkt->buffer = data;
@@ -480,12 +611,11 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
          );                     /*FIXME always prints 8 bytes */
 
   /* parse options */
-  memset(coap_pkt->options, 0, sizeof(coap_pkt->options));
   current_option += coap_pkt->token_len;
 
   unsigned int option_number = 0;
-  unsigned int option_delta = 0;
   size_t option_length = 0;
+  uint8_t *option_header;
 
   while(current_option < data + data_len) {
     /* payload marker 0xFF, currently only checking for 0xF* because rest is reserved */
@@ -503,36 +633,11 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
       break;
     }
 
-    option_delta = current_option[0] >> 4;
-    option_length = current_option[0] & 0x0F;
-    ++current_option;
-
-    if(option_delta == 13) {
-      option_delta += current_option[0];
-      ++current_option;
-    } else if(option_delta == 14) {
-      option_delta += 255;
-      option_delta += current_option[0] << 8;
-      ++current_option;
-      option_delta += current_option[0];
-      ++current_option;
-    }
-
-    if(option_length == 13) {
-      option_length += current_option[0];
-      ++current_option;
-    } else if(option_length == 14) {
-      option_length += 255;
-      option_length += current_option[0] << 8;
-      ++current_option;
-      option_length += current_option[0];
-      ++current_option;
-    }
+    option_header = current_option;
+    current_option = coap_parse_option_header(current_option, &option_number,
+                                              &option_length);
 
-    option_number += option_delta;
-
-    PRINTF("OPTION %u (delta %u, len %zu): ", option_number, option_delta,
-           option_length);
+    PRINTF("OPTION %u (len %zu): ", option_number, option_length);
 
     SET_OPTION(coap_pkt, option_number);
 
@@ -548,32 +653,20 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
       PRINTF("Max-Age [%lu]\n", (unsigned long)coap_pkt->max_age);
       break;
     case COAP_OPTION_ETAG:
-      coap_pkt->etag_len = MIN(COAP_ETAG_LEN, option_length);
-      memcpy(coap_pkt->etag, current_option, coap_pkt->etag_len);
-      PRINTF("ETag %u [0x%02X%02X%02X%02X%02X%02X%02X%02X]\n",
-             coap_pkt->etag_len, coap_pkt->etag[0], coap_pkt->etag[1],
-             coap_pkt->etag[2], coap_pkt->etag[3], coap_pkt->etag[4],
-             coap_pkt->etag[5], coap_pkt->etag[6], coap_pkt->etag[7]
-             );                 /*FIXME always prints 8 bytes */
+      coap_defer_option(coap_pkt, COAP_LAZY_ETAG, option_header,
+                        current_option, option_length);
+      PRINTF("ETag (len %zu)\n", option_length);
       break;
     case COAP_OPTION_ACCEPT:
       coap_pkt->accept = coap_parse_int_option(current_option, option_length);
       PRINTF("Accept [%u]\n", coap_pkt->accept);
       break;
     case COAP_OPTION_IF_MATCH:
-      /* TODO support multiple ETags */
-      coap_pkt->if_match_len = MIN(COAP_ETAG_LEN, option_length);
-      memcpy(coap_pkt->if_match, current_option, coap_pkt->if_match_len);
-      PRINTF("If-Match %u [0x%02X%02X%02X%02X%02X%02X%02X%02X]\n",
-             coap_pkt->if_match_len, coap_pkt->if_match[0],
-             coap_pkt->if_match[1], coap_pkt->if_match[2],
-             coap_pkt->if_match[3], coap_pkt->if_match[4],
-             coap_pkt->if_match[5], coap_pkt->if_match[6],
-             coap_pkt->if_match[7]
-             ); /* FIXME always prints 8 bytes */
+      coap_defer_option(coap_pkt, COAP_LAZY_IF_MATCH, option_header,
+                        current_option, option_length);
+      PRINTF("If-Match (len %zu)\n", option_length);
       break;
     case COAP_OPTION_IF_NONE_MATCH:
-      coap_pkt->if_none_match = 1;
       PRINTF("If-None-Match\n");
       break;
 
@@ -648,28 +741,12 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
       PRINTF("Observe [%lu]\n", (unsigned long)coap_pkt->observe);
       break;
     case COAP_OPTION_BLOCK2:
-      coap_pkt->block2_num = coap_parse_int_option(current_option,
-                                                   option_length);
-      coap_pkt->block2_more = (coap_pkt->block2_num & 0x08) >> 3;
-      coap_pkt->block2_size = 16 << (coap_pkt->block2_num & 0x07);
-      coap_pkt->block2_offset = (coap_pkt->block2_num & ~0x0000000F)
-        << (coap_pkt->block2_num & 0x07);
-      coap_pkt->block2_num >>= 4;
-      PRINTF("Block2 [%lu%s (%u B/blk)]\n",
-             (unsigned long)coap_pkt->block2_num,
-             coap_pkt->block2_more ? "+" : "", coap_pkt->block2_size);
+      coap_defer_option(coap_pkt, COAP_LAZY_BLOCK2, option_header,
+                        current_option, option_length);
       break;
     case COAP_OPTION_BLOCK1:
-      coap_pkt->block1_num = coap_parse_int_option(current_option,
-                                                   option_length);
-      coap_pkt->block1_more = (coap_pkt->block1_num & 0x08) >> 3;
-      coap_pkt->block1_size = 16 << (coap_pkt->block1_num & 0x07);
-      coap_pkt->block1_offset = (coap_pkt->block1_num & ~0x0000000F)
-        << (coap_pkt->block1_num & 0x07);
-      coap_pkt->block1_num >>= 4;
-      PRINTF("Block1 [%lu%s (%u B/blk)]\n",
-             (unsigned long)coap_pkt->block1_num,
-             coap_pkt->block1_more ? "+" : "", coap_pkt->block1_size);
+      coap_defer_option(coap_pkt, COAP_LAZY_BLOCK1, option_header,
+                        current_option, option_length);
       break;
     case COAP_OPTION_SIZE2:
       coap_pkt->size2 = coap_parse_int_option(current_option, option_length);
@@ -815,6 +892,13 @@ coap_get_header_etag(void *packet, const uint8_t **etag)
   if(!IS_OPTION(coap_pkt, COAP_OPTION_ETAG)) {
     return 0;
   }
+  if(coap_pkt->lazy[COAP_LAZY_ETAG]) {
+    /* refer to the received ETag in place instead of copying it */
+    size_t etag_len;
+
+    *etag = coap_get_lazy_option(coap_pkt, COAP_LAZY_ETAG, &etag_len);
+    return MIN(COAP_ETAG_LEN, etag_len);
+  }
   *etag = coap_pkt->etag;
   return coap_pkt->etag_len;
 }
@@ -827,6 +911,7 @@ coap_set_header_etag(void *packet, const uint8_t *etag, size_t etag_len)
   memcpy(coap_pkt->etag, etag, coap_pkt->etag_len);
 
   SET_OPTION(coap_pkt, COAP_OPTION_ETAG);
+  coap_pkt->lazy[COAP_LAZY_ETAG] = 0;
   return coap_pkt->etag_len;
 }
 /*---------------------------------------------------------------------------*/
@@ -839,6 +924,12 @@ coap_get_header_if_match(void *packet, const uint8_t **etag)
   if(!IS_OPTION(coap_pkt, COAP_OPTION_IF_MATCH)) {
     return 0;
   }
+  if(coap_pkt->lazy[COAP_LAZY_IF_MATCH]) {
+    size_t etag_len;
+
+    *etag = coap_get_lazy_option(coap_pkt, COAP_LAZY_IF_MATCH, &etag_len);
+    return MIN(COAP_ETAG_LEN, etag_len);
+  }
   *etag = coap_pkt->if_match;
   return coap_pkt->if_match_len;
 }
@@ -851,6 +942,7 @@ coap_set_header_if_match(void *packet, const uint8_t *etag, size_t etag_len)
   memcpy(coap_pkt->if_match, etag, coap_pkt->if_match_len);
 
   SET_OPTION(coap_pkt, COAP_OPTION_IF_MATCH);
+  coap_pkt->lazy[COAP_LAZY_IF_MATCH] = 0;
   return coap_pkt->if_match_len;
 }
 /*---------------------------------------------------------------------------*/
@@ -1057,6 +1149,8 @@ coap_get_header_block2(void *packet, uint32_t *num, uint8_t *more,
   if(!IS_OPTION(coap_pkt, COAP_OPTION_BLOCK2)) {
     return 0;
   }
+  coap_decode_lazy(coap_pkt, COAP_LAZY_BLOCK2);
+
   /* pointers may be NULL to get only specific block parameters */
   if(num != NULL) {
     *num = coap_pkt->block2_num;
@@ -1068,7 +1162,7 @@ coap_get_header_block2(void *packet, uint32_t *num, uint8_t *more,
     *size = coap_pkt->block2_size;
   }
   if(offset != NULL) {
-    *offset = coap_pkt->block2_offset;
+    *offset = coap_pkt->block2_num * coap_pkt->block2_size;
   }
   return 1;
 }
@@ -1092,6 +1186,7 @@ coap_set_header_block2(void *packet, uint32_t num, uint8_t more,
   coap_pkt->block2_size = size;
 
   SET_OPTION(coap_pkt, COAP_OPTION_BLOCK2);
+  coap_pkt->lazy[COAP_LAZY_BLOCK2] = 0;
   return 1;
 }
 /*---------------------------------------------------------------------------*/
@@ -1104,6 +1199,8 @@ coap_get_header_block1(void *packet, uint32_t *num, uint8_t *more,
   if(!IS_OPTION(coap_pkt, COAP_OPTION_BLOCK1)) {
     return 0;
   }
+  coap_decode_lazy(coap_pkt, COAP_LAZY_BLOCK1);
+
   /* pointers may be NULL to get only specific block parameters */
   if(num != NULL) {
     *num = coap_pkt->block1_num;
@@ -1115,7 +1212,7 @@ coap_get_header_block1(void *packet, uint32_t *num, uint8_t *more,
     *size = coap_pkt->block1_size;
   }
   if(offset != NULL) {
-    *offset = coap_pkt->block1_offset;
+    *offset = coap_pkt->block1_num * coap_pkt->block1_size;
   }
   return 1;
 }
@@ -1139,6 +1236,7 @@ coap_set_header_block1(void *packet, uint32_t num, uint8_t more,
   coap_pkt->block1_size = size;
 
   SET_OPTION(coap_pkt, COAP_OPTION_BLOCK1);
+  coap_pkt->lazy[COAP_LAZY_BLOCK1] = 0;
   return 1;
 }
 /*---------------------------------------------------------------------------*/
@@ -79,6 +79,15 @@ enum { OPTION_MAP_SIZE = sizeof(uint8_t) * 8 };
 #define SET_OPTION(packet, opt) ((packet)->options[opt / OPTION_MAP_SIZE] |= 1 << (opt % OPTION_MAP_SIZE))
 #define IS_OPTION(packet, opt) ((packet)->options[opt / OPTION_MAP_SIZE] & (1 << (opt % OPTION_MAP_SIZE)))
 
+/* options that are left encoded in the buffer by coap_parse_message() */
+enum {
+  COAP_LAZY_IF_MATCH,
+  COAP_LAZY_ETAG,
+  COAP_LAZY_BLOCK2,
+  COAP_LAZY_BLOCK1,
+  COAP_LAZY_OPTIONS
+};
+
 /* parsed message struct */
 typedef struct {
   uint8_t *buffer; /* pointer to CoAP header / incoming packet buffer / memory to serialize packet */
@@ -92,23 +101,24 @@ typedef struct {
   uint8_t token[COAP_TOKEN_LEN];
 
   uint8_t options[COAP_OPTION_SIZE1 / OPTION_MAP_SIZE + 1]; /* bitmap to check if option is set */
+  uint8_t lazy[COAP_LAZY_OPTIONS]; /* offset of a not yet decoded option header in buffer, 0 if decoded */
 
   uint16_t content_format; /* parse options once and store; allows setting options in random order  */
   uint32_t max_age;
   uint8_t etag_len;
   uint8_t etag[COAP_ETAG_LEN];
-  size_t proxy_uri_len;
+  uint16_t proxy_uri_len;
   const char *proxy_uri;
-  size_t proxy_scheme_len;
+  uint16_t proxy_scheme_len;
   const char *proxy_scheme;
-  size_t uri_host_len;
+  uint16_t uri_host_len;
   const char *uri_host;
-  size_t location_path_len;
+  uint16_t location_path_len;
   const char *location_path;
   uint16_t uri_port;
-  size_t location_query_len;
+  uint16_t location_query_len;
   const char *location_query;
-  size_t uri_path_len;
+  uint16_t uri_path_len;
   const char *uri_path;
   int32_t observe;
   uint16_t accept;
@@ -117,16 +127,13 @@ typedef struct {
   uint32_t block2_num;
   uint8_t block2_more;
   uint16_t block2_size;
-  uint32_t block2_offset;
   uint32_t block1_num;
   uint8_t block1_more;
   uint16_t block1_size;
-  uint32_t block1_offset;
   uint32_t size2;
   uint32_t size1;
-  size_t uri_query_len;
+  uint16_t uri_query_len;
   const char *uri_query;
-  uint8_t if_none_match;
 
   uint16_t payload_len;
   uint8_t *payload;
@@ -49,6 +49,9 @@
 #define ORCHESTRA_RULES { &eb_per_time_source, &unicast_per_neighbor_rpl_storing, &default_common }
 /* Example configuration for RPL non-storing mode: */
 /* #define ORCHESTRA_RULES { &eb_per_time_source, &unicast_per_neighbor_rpl_ns, &default_common } */
+/* Example configuration with extra cells to the RPL parent under load
+ * (the traffic-adaptive rule must come before the unicast one): */
+/* #define ORCHESTRA_RULES { &eb_per_time_source, &unicast_traffic_adaptive, &unicast_per_neighbor_rpl_storing, &default_common } */
 
 #endif /* ORCHESTRA_CONF_RULES */
 
@@ -72,6 +75,56 @@
 #define ORCHESTRA_UNICAST_PERIOD                  17
 #endif /* ORCHESTRA_CONF_UNICAST_PERIOD */
 
+/* Length of the slotframe of the traffic-adaptive rule. Prime, so that
+ * the cells of a sender never overlap (see orchestra_adaptive_timeslot) */
+#ifdef ORCHESTRA_CONF_ADAPTIVE_PERIOD
+#define ORCHESTRA_ADAPTIVE_PERIOD                 ORCHESTRA_CONF_ADAPTIVE_PERIOD
+#else /* ORCHESTRA_CONF_ADAPTIVE_PERIOD */
+#define ORCHESTRA_ADAPTIVE_PERIOD                 13
+#endif /* ORCHESTRA_CONF_ADAPTIVE_PERIOD */
+
+/* The maximum number of extra cells from a node to its parent */
+#ifdef ORCHESTRA_CONF_ADAPTIVE_MAX_CELLS
+#define ORCHESTRA_ADAPTIVE_MAX_CELLS              ORCHESTRA_CONF_ADAPTIVE_MAX_CELLS
+#else /* ORCHESTRA_CONF_ADAPTIVE_MAX_CELLS */
+#define ORCHESTRA_ADAPTIVE_MAX_CELLS              4
+#endif /* ORCHESTRA_CONF_ADAPTIVE_MAX_CELLS */
+
+/* The maximum number of children with extra cells to us */
+#ifdef ORCHESTRA_CONF_ADAPTIVE_MAX_CHILDREN
+#define ORCHESTRA_ADAPTIVE_MAX_CHILDREN           ORCHESTRA_CONF_ADAPTIVE_MAX_CHILDREN
+#else /* ORCHESTRA_CONF_ADAPTIVE_MAX_CHILDREN */
+#define ORCHESTRA_ADAPTIVE_MAX_CHILDREN           8
+#endif /* ORCHESTRA_CONF_ADAPTIVE_MAX_CHILDREN */
+
+/* Ask for one more cell when that many frames to the parent are already queued */
+#ifdef ORCHESTRA_CONF_ADAPTIVE_QUEUE_HIGH
+#define ORCHESTRA_ADAPTIVE_QUEUE_HIGH             ORCHESTRA_CONF_ADAPTIVE_QUEUE_HIGH
+#else /* ORCHESTRA_CONF_ADAPTIVE_QUEUE_HIGH */
+#define ORCHESTRA_ADAPTIVE_QUEUE_HIGH             2
+#endif /* ORCHESTRA_CONF_ADAPTIVE_QUEUE_HIGH */
+
+/* Hysteresis: number of consecutive delivered frames asking for one
+ * more (UP) or one less (DOWN) cell before the cells change */
+#ifdef ORCHESTRA_CONF_ADAPTIVE_UP
+#define ORCHESTRA_ADAPTIVE_UP                     ORCHESTRA_CONF_ADAPTIVE_UP
+#else /* ORCHESTRA_CONF_ADAPTIVE_UP */
+#define ORCHESTRA_ADAPTIVE_UP                     2
+#endif /* ORCHESTRA_CONF_ADAPTIVE_UP */
+
+#ifdef ORCHESTRA_CONF_ADAPTIVE_DOWN
+#define ORCHESTRA_ADAPTIVE_DOWN                   ORCHESTRA_CONF_ADAPTIVE_DOWN
+#else /* ORCHESTRA_CONF_ADAPTIVE_DOWN */
+#define ORCHESTRA_ADAPTIVE_DOWN                   4
+#endif /* ORCHESTRA_CONF_ADAPTIVE_DOWN */
+
+/* Extra cells of a link with no frame delivered for that many slots are removed */
+#ifdef ORCHESTRA_CONF_ADAPTIVE_TIMEOUT
+#define ORCHESTRA_ADAPTIVE_TIMEOUT                ORCHESTRA_CONF_ADAPTIVE_TIMEOUT
+#else /* ORCHESTRA_CONF_ADAPTIVE_TIMEOUT */
+#define ORCHESTRA_ADAPTIVE_TIMEOUT                4096
+#endif /* ORCHESTRA_CONF_ADAPTIVE_TIMEOUT */
+
 /* Is the per-neighbor unicast slotframe sender-based (if not, it is receiver-based).
  * Note: sender-based works only with RPL storing mode as it relies on DAO and
  * routing entries to keep track of children and parents. */
@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Orchestra: a slotframe of extra unicast cells from nodes to their
+ *         RPL parent, added and removed as their traffic to it varies.
+ *         Each node sets the frame pending bit of its frames to the parent to
+ *         ask for one more cell (queue building up or Tx rate close to the
+ *         capacity of its cells), one less (Tx rate under half the capacity
+ *         of one less cell), or alternates it to keep its cells. Both the
+ *         node and its parent count the delivered frames asking for a change,
+ *         with hysteresis, and so agree on the cells.
+ *         The cells of a node are at orchestra_adaptive_timeslot(node, k)
+ *         for k below its number of extra cells. The parent may listen to
+ *         more cells than the node uses, never to fewer.
+ */
+
+#include "contiki.h"
+#include "orchestra.h"
+#include "net/packetbuf.h"
+#include "net/ipv6/sicslowpan.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include <string.h>
+
+#if ORCHESTRA_COLLISION_FREE_HASH
+#define ADAPTIVE_SLOT_SHARED_FLAG    ((ORCHESTRA_ADAPTIVE_PERIOD < (ORCHESTRA_MAX_HASH + 1)) ? LINK_OPTION_SHARED : 0)
+#else
+#define ADAPTIVE_SLOT_SHARED_FLAG    LINK_OPTION_SHARED
+#endif
+
+/* Longest gap between queued frames accounted for, in slots */
+#define MAX_GAP                      (0xffff / 8)
+/* Marks the frames counted at the sender, in PACKETBUF_ATTR_PENDING */
+#define COUNTED                      2
+
+static uint16_t slotframe_handle = 0;
+static uint16_t channel_offset = 0;
+static struct tsch_slotframe *sf_adaptive;
+
+/* Our link to the parent, and the links from our children */
+static struct orchestra_adaptive_link parent;
+static struct orchestra_adaptive_link children[ORCHESTRA_ADAPTIVE_MAX_CHILDREN];
+
+/*---------------------------------------------------------------------------*/
+uint16_t
+orchestra_adaptive_timeslot(const linkaddr_t *sender, int cell)
+{
+  uint16_t hash = ORCHESTRA_LINKADDR_HASH(sender);
+  /* Double hashing: the step depends on the sender too, so that senders
+   * whose first cells collide do not collide on the next ones */
+  uint16_t step = 1 + hash % (ORCHESTRA_ADAPTIVE_PERIOD - 1);
+  return (hash + cell * step) % ORCHESTRA_ADAPTIVE_PERIOD;
+}
+/*---------------------------------------------------------------------------*/
+/* Average slots between the cells to the parent, times 8 */
+static uint32_t
+cell_gap(int level)
+{
+  return 8UL * ORCHESTRA_UNICAST_PERIOD * ORCHESTRA_ADAPTIVE_PERIOD
+         / (ORCHESTRA_ADAPTIVE_PERIOD + level * ORCHESTRA_UNICAST_PERIOD);
+}
+/*---------------------------------------------------------------------------*/
+int
+orchestra_adaptive_queued(struct orchestra_adaptive_link *l, uint32_t asn, int queue_len)
+{
+  uint32_t gap = asn - l->last_queued_asn;
+
+  /* Tx rate, as a moving average of the gap between frames */
+  l->last_queued_asn = asn;
+  l->gap = l->gap - l->gap / 8 + MIN(gap, MAX_GAP);
+
+  if(queue_len >= ORCHESTRA_ADAPTIVE_QUEUE_HIGH
+     || 3 * l->gap < 4 * cell_gap(l->level)) {
+    /* Queue building up or over 3/4 of the capacity: one more cell */
+    l->pending = 1;
+  } else if(l->level > 0 && queue_len == 0
+            && l->gap > 2 * cell_gap(l->level - 1)) {
+    /* Under half the capacity of one cell less: one less */
+    l->pending = 0;
+  } else {
+    /* Keep the cells: no two consecutive frames ask for the same */
+    l->pending = l->level > 0 ? !l->pending : 0;
+  }
+  return l->pending;
+}
+/*---------------------------------------------------------------------------*/
+int
+orchestra_adaptive_delivered(struct orchestra_adaptive_link *l, uint32_t asn, int pending, uint32_t timeout)
+{
+  uint8_t level = l->level;
+
+  if(asn - l->last_asn > timeout) {
+    /* Silent for too long, start over */
+    l->level = 0;
+    l->up = 0;
+    l->down = 0;
+  }
+  l->last_asn = asn;
+
+  if(pending) {
+    l->down = 0;
+    if(++l->up >= ORCHESTRA_ADAPTIVE_UP) {
+      l->up = 0;
+      if(l->level < ORCHESTRA_ADAPTIVE_MAX_CELLS) {
+        l->level++;
+      }
+    }
+  } else {
+    l->up = 0;
+    if(l->level > 0 && ++l->down >= ORCHESTRA_ADAPTIVE_DOWN) {
+      l->down = 0;
+      l->level--;
+    }
+  }
+  return l->level != level;
+}
+/*---------------------------------------------------------------------------*/
+int
+orchestra_adaptive_tx_cells(const struct orchestra_adaptive_link *l)
+{
+  /* The parent may have seen one more frame asking for one less cell than
+   * we did (a frame it received but we never got an ACK for). Stop using
+   * the last cell one frame before it would go. */
+  if(l->level > 0 && l->down + 1 >= ORCHESTRA_ADAPTIVE_DOWN) {
+    return l->level - 1;
+  }
+  return l->level;
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_links(void)
+{
+  uint8_t link_options[ORCHESTRA_ADAPTIVE_PERIOD];
+  uint16_t timeslot;
+  int i, k;
+
+  memset(link_options, 0, sizeof(link_options));
+  for(k = 0; k < orchestra_adaptive_tx_cells(&parent); k++) {
+    link_options[orchestra_adaptive_timeslot(&linkaddr_node_addr, k)] |= LINK_OPTION_TX | LINK_OPTION_EXTRA_TX | ADAPTIVE_SLOT_SHARED_FLAG;
+  }
+  for(i = 0; i < ORCHESTRA_ADAPTIVE_MAX_CHILDREN; i++) {
+    for(k = 0; k < children[i].level; k++) {
+      link_options[orchestra_adaptive_timeslot(&children[i].addr, k)] |= LINK_OPTION_RX;
+    }
+  }
+
+  for(timeslot = 0; timeslot < ORCHESTRA_ADAPTIVE_PERIOD; timeslot++) {
+    struct tsch_link *l = tsch_schedule_get_link_by_timeslot(sf_adaptive, timeslot);
+    /* Tx cells are extra links to the parent, so that they carry any packet
+     * to it and the parent keeps its other cells */
+    const linkaddr_t *addr = (link_options[timeslot] & LINK_OPTION_TX) ? &parent.addr : &tsch_broadcast_address;
+    if(link_options[timeslot] == 0) {
+      if(l != NULL) {
+        tsch_schedule_remove_link(sf_adaptive, l);
+      }
+    } else if(l == NULL || l->link_options != link_options[timeslot]
+              || !linkaddr_cmp(&l->addr, addr)) {
+      tsch_schedule_add_link(sf_adaptive, link_options[timeslot], LINK_TYPE_NORMAL, addr,
+                             timeslot, channel_offset);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Remove the cells of the links silent for too long. The parent waits
+ * longer than the child, so that it never stops listening first. */
+static int
+expire(void)
+{
+  int i, changed = 0;
+
+  if(parent.level > 0 && current_asn.ls4b - parent.last_asn > ORCHESTRA_ADAPTIVE_TIMEOUT * 3 / 4) {
+    parent.level = 0;
+    changed = 1;
+  }
+  for(i = 0; i < ORCHESTRA_ADAPTIVE_MAX_CHILDREN; i++) {
+    if(children[i].level > 0 && current_asn.ls4b - children[i].last_asn > ORCHESTRA_ADAPTIVE_TIMEOUT) {
+      children[i].level = 0;
+      changed = 1;
+    }
+  }
+  return changed;
+}
+/*---------------------------------------------------------------------------*/
+/* Is the frame in packetbuf a 6LoWPAN fragment? Only whole packets
+ * are seen by the parent, so only those count. */
+static int
+is_fragment(const uint8_t *dispatch)
+{
+  return (dispatch[0] & 0xf8) == SICSLOWPAN_DISPATCH_FRAG1
+         || (dispatch[0] & 0xf8) == SICSLOWPAN_DISPATCH_FRAGN;
+}
+/*---------------------------------------------------------------------------*/
+static int
+select_packet(uint16_t *slotframe, uint16_t *timeslot)
+{
+  /* Set the frame pending bit of data packets to the parent. The frame
+   * is already built, update its header too. */
+  const linkaddr_t *dest = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
+  if(packetbuf_attr(PACKETBUF_ATTR_FRAME_TYPE) == FRAME802154_DATAFRAME
+     && !linkaddr_cmp(&parent.addr, &linkaddr_null)
+     && linkaddr_cmp(&parent.addr, dest)
+     && !is_fragment(packetbuf_dataptr())) {
+    uint8_t *fcf = packetbuf_hdrptr();
+    if(orchestra_adaptive_queued(&parent, current_asn.ls4b, tsch_queue_packet_count(dest))) {
+      fcf[0] |= 0x10;
+      packetbuf_set_attr(PACKETBUF_ATTR_PENDING, COUNTED | 1);
+    } else {
+      fcf[0] &= ~0x10;
+      packetbuf_set_attr(PACKETBUF_ATTR_PENDING, COUNTED);
+    }
+  }
+  /* Let the other rules select a slotframe: our Tx cells are extra links
+   * to the parent (LINK_OPTION_EXTRA_TX), which carry any packet to it and
+   * add to the cells the packet was selected for */
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+packet_sent(int mac_status)
+{
+  int changed = expire();
+  if(mac_status == MAC_TX_OK
+     && (packetbuf_attr(PACKETBUF_ATTR_PENDING) & COUNTED)
+     && linkaddr_cmp(&parent.addr, packetbuf_addr(PACKETBUF_ADDR_RECEIVER))) {
+    changed |= orchestra_adaptive_delivered(&parent, current_asn.ls4b,
+                                            packetbuf_attr(PACKETBUF_ATTR_PENDING) & 1,
+                                            ORCHESTRA_ADAPTIVE_TIMEOUT * 3 / 4);
+  }
+  if(changed) {
+    update_links();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+packet_received(void)
+{
+  const linkaddr_t *sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+  struct orchestra_adaptive_link *l = NULL;
+  int changed = expire();
+  int i;
+
+  if(packetbuf_attr(PACKETBUF_ATTR_FRAME_TYPE) == FRAME802154_DATAFRAME
+     && linkaddr_cmp(&linkaddr_node_addr, packetbuf_addr(PACKETBUF_ADDR_RECEIVER))
+     && !is_fragment(packetbuf_dataptr())) {
+    int pending = packetbuf_attr(PACKETBUF_ATTR_PENDING);
+    for(i = 0; i < ORCHESTRA_ADAPTIVE_MAX_CHILDREN; i++) {
+      if(linkaddr_cmp(&children[i].addr, sender)) {
+        l = &children[i];
+        break;
+      }
+      /* A link with no extra cells and no frame asking for one is as good as none */
+      if(l == NULL && children[i].level == 0 && children[i].up == 0) {
+        l = &children[i];
+      }
+    }
+    if(l != NULL && (pending || linkaddr_cmp(&l->addr, sender))) {
+      if(!linkaddr_cmp(&l->addr, sender)) {
+        memset(l, 0, sizeof(*l));
+        linkaddr_copy(&l->addr, sender);
+      }
+      changed |= orchestra_adaptive_delivered(l, current_asn.ls4b, pending, ORCHESTRA_ADAPTIVE_TIMEOUT);
+    }
+  }
+  if(changed) {
+    update_links();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+new_time_source(const struct tsch_neighbor *old, const struct tsch_neighbor *new)
+{
+  if(new != old) {
+    /* Start over with the new parent, the old one will remove its cells */
+    memset(&parent, 0, sizeof(parent));
+    parent.gap = 8 * MAX_GAP;
+    linkaddr_copy(&parent.addr, new != NULL ? &new->addr : &linkaddr_null);
+    update_links();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(uint16_t sf_handle)
+{
+  slotframe_handle = sf_handle;
+  channel_offset = sf_handle;
+  memset(&parent, 0, sizeof(parent));
+  parent.gap = 8 * MAX_GAP;
+  memset(children, 0, sizeof(children));
+  /* Slotframe for the extra cells, empty until there is traffic */
+  sf_adaptive = tsch_schedule_add_slotframe(slotframe_handle, ORCHESTRA_ADAPTIVE_PERIOD);
+}
+/*---------------------------------------------------------------------------*/
+struct orchestra_rule unicast_traffic_adaptive = {
+  init,
+  new_time_source,
+  select_packet,
+  NULL,
+  NULL,
+  packet_sent,
+  packet_received,
+};
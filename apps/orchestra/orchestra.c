@@ -64,11 +64,24 @@ const struct orchestra_rule *all_rules[] = ORCHESTRA_RULES;
 static void
 orchestra_packet_received(void)
 {
+  /* Notify all Orchestra rules that a packet was received */
+  int i;
+  for(i = 0; i < NUM_RULES; i++) {
+    if(all_rules[i]->packet_received != NULL) {
+      all_rules[i]->packet_received();
+    }
+  }
 }
 /*---------------------------------------------------------------------------*/
 static void
 orchestra_packet_sent(int mac_status)
 {
+  int i;
+  for(i = 0; i < NUM_RULES; i++) {
+    if(all_rules[i]->packet_sent != NULL) {
+      all_rules[i]->packet_sent(mac_status);
+    }
+  }
   /* Check if our parent just ACKed a DAO */
   if(orchestra_parent_knows_us == 0
      && mac_status == MAC_TX_OK
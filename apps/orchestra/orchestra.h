@@ -50,12 +50,29 @@ struct orchestra_rule {
   int  (* select_packet)(uint16_t *slotframe, uint16_t *timeslot);
   void (* child_added)(const linkaddr_t *addr);
   void (* child_removed)(const linkaddr_t *addr);
+  void (* packet_sent)(int mac_status);
+  void (* packet_received)(void);
 };
 
-struct orchestra_rule eb_per_time_source;
-struct orchestra_rule unicast_per_neighbor_rpl_storing;
-struct orchestra_rule unicast_per_neighbor_rpl_ns;
-struct orchestra_rule default_common;
+extern struct orchestra_rule eb_per_time_source;
+extern struct orchestra_rule unicast_per_neighbor_rpl_storing;
+extern struct orchestra_rule unicast_per_neighbor_rpl_ns;
+extern struct orchestra_rule unicast_traffic_adaptive;
+extern struct orchestra_rule default_common;
+
+/* State of a link of the traffic-adaptive rule. Both ends of the link
+ * update it with the frames delivered over it, and so agree on its
+ * number of extra cells without any signaling but the frame pending bit. */
+struct orchestra_adaptive_link {
+  linkaddr_t addr; /* The neighbor at the other end */
+  uint32_t last_asn; /* ASN of the last delivered frame */
+  uint32_t last_queued_asn; /* Sender only: ASN of the last queued frame */
+  uint16_t gap; /* Sender only: average slots between queued frames, times 8 */
+  uint8_t level; /* Number of extra cells */
+  uint8_t up; /* Consecutive delivered frames asking for one more cell */
+  uint8_t down; /* Consecutive delivered frames asking for one less cell */
+  uint8_t pending; /* Sender only: frame pending bit of the last queued frame */
+};
 
 extern linkaddr_t orchestra_parent_linkaddr;
 extern int orchestra_parent_knows_us;
@@ -72,4 +89,13 @@ void orchestra_callback_child_added(const linkaddr_t *addr);
 /* Set with #define NETSTACK_CONF_ROUTING_NEIGHBOR_REMOVED_CALLBACK orchestra_callback_child_removed */
 void orchestra_callback_child_removed(const linkaddr_t *addr);
 
+/* Timeslot of the given extra cell of a sender in the traffic-adaptive slotframe */
+uint16_t orchestra_adaptive_timeslot(const linkaddr_t *sender, int cell);
+/* Sender: a frame is queued behind queue_len others, returns its frame pending bit */
+int orchestra_adaptive_queued(struct orchestra_adaptive_link *l, uint32_t asn, int queue_len);
+/* Both ends: a frame was delivered, returns 1 if the number of extra cells changed */
+int orchestra_adaptive_delivered(struct orchestra_adaptive_link *l, uint32_t asn, int pending, uint32_t timeout);
+/* Sender: the number of extra cells to transmit in */
+int orchestra_adaptive_tx_cells(const struct orchestra_adaptive_link *l);
+
 #endif /* __ORCHESTRA_H__ */
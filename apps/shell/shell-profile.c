@@ -32,7 +32,8 @@
 
 /**
  * \file
- *         A brief description of what this file is.
+ *         Shell command that shows the CPU time used by each process
+ *         and by each type of event
  * \author
  *         Adam Dunkels <adam@sics.se>
  */
@@ -41,8 +42,6 @@
 #include "contiki-conf.h"
 #include "shell-profile.h"
 
-#include "loader/symbols.h"
-
 #include <stdio.h>
 #include <string.h>
 
@@ -50,38 +49,58 @@
 PROCESS(shell_profile_process, "Shell 'profile' command");
 SHELL_COMMAND(profile_command,
 	      "profile",
-	      "profile: show aggregate profiling information",
+	      "profile [reset]: show or clear the CPU time used by processes",
 	      &shell_profile_process);
 /*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_PROFILE
+static void
+output_profile(const char *name, const struct process_profile *profile)
+{
+  char buf[80];
+
+  snprintf(buf, sizeof(buf), "%s: %lu calls, %lu total, %lu max",
+           name, profile->calls, profile->time, profile->max);
+  shell_output_str(&profile_command, buf, "");
+}
+#endif /* PROCESS_CONF_PROFILE */
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(shell_profile_process, ev, data)
 {
+#if PROCESS_CONF_PROFILE
+  const struct process_profile *profile;
+  struct process *p;
+  process_event_t event;
+  char buf[30];
   int i;
-  char buf[100];
+#endif /* PROCESS_CONF_PROFILE */
   PROCESS_BEGIN();
 
-#if DETAILED_AGGREGATES
-  for(i = 0; i < aggregates_list_ptr; ++i) {
-    sprintf(buf, "-- %s: %lu / %u = %lu", aggregates[i].ptr,
-	   aggregates[i].cycles,
-	   aggregates[i].episodes,
-	   aggregates[i].cycles / aggregates[i].episodes);
-    shell_output(buf, "");
+#if PROCESS_CONF_PROFILE
+  if(data != NULL && strcmp(data, "reset") == 0) {
+    process_profile_reset();
+    PROCESS_EXIT();
   }
-#else
-  for(i = 0; i < aggregates_list_ptr; ++i) {
-    sprintf(buf, "-- %c%c: %lu / %u = %lu",
-	   aggregates[i].ptr[0], aggregates[i].ptr[1],
-	   aggregates[i].cycles,
-	   aggregates[i].episodes,
-	   aggregates[i].cycles / aggregates[i].episodes);
-    shell_output(buf, "");
+
+  snprintf(buf, sizeof(buf), "%lu", (unsigned long)PROCESS_PROFILE_SECOND);
+  shell_output_str(&profile_command, "Time units per second: ", buf);
+
+  shell_output_str(&profile_command, "Processes:", "");
+  for(p = PROCESS_LIST(); p != NULL; p = p->next) {
+    strncpy(buf, PROCESS_NAME_STRING(p), sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    output_profile(buf, &p->profile);
+  }
+
+  shell_output_str(&profile_command, "Events:", "");
+  for(i = 0; (profile = process_profile_event(i, &event)) != NULL; i++) {
+    snprintf(buf, sizeof(buf), "0x%02x", event);
+    output_profile(buf, profile);
   }
-#endif
+#else /* PROCESS_CONF_PROFILE */
+  shell_output_str(&profile_command,
+                   "Profiling is disabled; set PROCESS_CONF_PROFILE", "");
+#endif /* PROCESS_CONF_PROFILE */
 
-  sprintf(buf, "Memory for aggregates: %d * %d = %d\n",
-	  (int)sizeof(struct aggregate), aggregates_list_ptr,
-	  (int)sizeof(struct aggregate) * aggregates_list_ptr);
-  shell_output(buf, "");
   PROCESS_END();
 }
 /*---------------------------------------------------------------------------*/
@@ -1,4 +1,5 @@
 #include "avr-handler.h"
+#include "lib/crc16.h"
 
 /**
  * Turn debuggin on.
@@ -92,27 +93,6 @@ static void (*serial_write)(uint8_t *buf, int len);
  */
 static void (*callback)(bool isSuccess);
 
-/**
- * Add a byte to a CRC.
- * @param crc The existing CRC. 0xFFFF should be used as a starting value.
- * @param a The byte to add
- * @return The new crc
- *
- * Note: This is the exact crc function used in the AVR & python
- * There is a contiki CRC function but not sure it'll
- * behave in the same way.
- */
-static uint16_t crc16(uint16_t crc, uint8_t a);
-
-/**
- * Add several bytes to a CRC.
- * @param crc The existing CRC. 0xFFFF should be used as a starting value.
- * @param buf The bytes to add
- * @param len The number of bytes to add
- * @return The new crc
- */
-static uint16_t crc16_all(uint16_t crc, uint8_t *buf, uint8_t len);
-
 /**
  * Chack a given message is a valid response message.
  * (ie the message is for us, is of type response, and has a valid crc).
@@ -260,32 +240,6 @@ PROCESS_THREAD(avr_process, ev, data_ptr) {
     PROCESS_END();
 }
 
-uint16_t crc16(uint16_t crc, uint8_t a) {
-    //DEBUG("Starting CRC with 0x%04x\n", crc);
-    uint8_t i;
-    //DEBUG("Processing CRC for 0x%04x\n", a);
-    crc ^= (uint16_t)a;
-    //DEBUG("After XOR = 0x%04x\n", crc);
-    for (i = 0; i < 8; ++i) {
-        if (crc & 1) {
-            crc = (crc >> 1) ^ 0xA001;
-        } else {
-            crc = (crc >> 1);
-        }
-    //DEBUG("CRC r%d = 0x%04x\n",i, crc);
-    }
-    //DEBUG("CRC RET = 0x%04x\n", crc);
-    return crc;
-}
-
-uint16_t crc16_all(uint16_t crc, uint8_t *buf, uint8_t len) {
-    uint8_t i;
-    for (i = 0; i < len; i++) {
-        crc = crc16(crc, buf[i]);
-    }
-    return crc;
-}
-
 bool send_message(uint8_t addr, uint8_t opcode, uint8_t *payload, uint8_t payload_length) {
     //DEBUG("Dest: %02x\n", addr);
     //DEBUG("Optcode: %02x\n", opcode);
@@ -297,11 +251,11 @@ bool send_message(uint8_t addr, uint8_t opcode, uint8_t *payload, uint8_t payloa
     }
 
     // Add the address and type to the crc
-    uint16_t crc = crc16(0xFFFF, addr);
-    crc = crc16(crc, opcode);
+    uint16_t crc = crc16_modbus_add(addr, 0xFFFF);
+    crc = crc16_modbus_add(opcode, crc);
 
     // Add the payload to the crc
-    crc = crc16_all(crc, payload, payload_length);
+    crc = crc16_modbus_data(payload, payload_length, crc);
 
     DEBUG("CRC is %u High: %x Low: %x High2: %x Low2: %x\n", crc, (crc >> 8) & 0xFF, crc & 0xFF, *(((uint8_t *) &crc) + 1), *((uint8_t *) &crc));
 
@@ -331,9 +285,9 @@ bool check_message(uint8_t addr, uint8_t opcode, uint8_t *payload, uint8_t paylo
     uint16_t rcv_crc = *((uint16_t *) crc);
     //DEBUG("Recieved CRC: %d\n", rcv_crc);
 
-    uint16_t cal_crc = crc16(0xFFFF, addr);
-    cal_crc = crc16(cal_crc, opcode);
-    cal_crc = crc16_all(cal_crc, payload, payload_length);
+    uint16_t cal_crc = crc16_modbus_add(addr, 0xFFFF);
+    cal_crc = crc16_modbus_add(opcode, cal_crc);
+    cal_crc = crc16_modbus_data(payload, payload_length, cal_crc);
 
     //DEBUG("Calculated CRC: %d\n", cal_crc);
 
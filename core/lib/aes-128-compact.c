@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Byte-wise AES-128 with small tables, for 8- and 16-bit
+ *         platforms (MSP430). Multiplications by 2 come from a table
+ *         instead of a multiplier, and SubBytes, ShiftRow, MixColumn
+ *         and AddRoundKey take two passes over the state per round.
+ *         Selected with AES_128_CONF=aes_128_compact_driver.
+ */
+
+#include "lib/aes-128.h"
+#include <string.h>
+
+#define ROUNDS 10
+
+/* Multiplication by 2 in GF(2^8) */
+static const uint8_t xtime[256] = {
+  0x00, 0x02, 0x04, 0x06, 0x08, 0x0a, 0x0c, 0x0e, 0x10, 0x12, 0x14, 0x16,
+  0x18, 0x1a, 0x1c, 0x1e, 0x20, 0x22, 0x24, 0x26, 0x28, 0x2a, 0x2c, 0x2e,
+  0x30, 0x32, 0x34, 0x36, 0x38, 0x3a, 0x3c, 0x3e, 0x40, 0x42, 0x44, 0x46,
+  0x48, 0x4a, 0x4c, 0x4e, 0x50, 0x52, 0x54, 0x56, 0x58, 0x5a, 0x5c, 0x5e,
+  0x60, 0x62, 0x64, 0x66, 0x68, 0x6a, 0x6c, 0x6e, 0x70, 0x72, 0x74, 0x76,
+  0x78, 0x7a, 0x7c, 0x7e, 0x80, 0x82, 0x84, 0x86, 0x88, 0x8a, 0x8c, 0x8e,
+  0x90, 0x92, 0x94, 0x96, 0x98, 0x9a, 0x9c, 0x9e, 0xa0, 0xa2, 0xa4, 0xa6,
+  0xa8, 0xaa, 0xac, 0xae, 0xb0, 0xb2, 0xb4, 0xb6, 0xb8, 0xba, 0xbc, 0xbe,
+  0xc0, 0xc2, 0xc4, 0xc6, 0xc8, 0xca, 0xcc, 0xce, 0xd0, 0xd2, 0xd4, 0xd6,
+  0xd8, 0xda, 0xdc, 0xde, 0xe0, 0xe2, 0xe4, 0xe6, 0xe8, 0xea, 0xec, 0xee,
+  0xf0, 0xf2, 0xf4, 0xf6, 0xf8, 0xfa, 0xfc, 0xfe, 0x1b, 0x19, 0x1f, 0x1d,
+  0x13, 0x11, 0x17, 0x15, 0x0b, 0x09, 0x0f, 0x0d, 0x03, 0x01, 0x07, 0x05,
+  0x3b, 0x39, 0x3f, 0x3d, 0x33, 0x31, 0x37, 0x35, 0x2b, 0x29, 0x2f, 0x2d,
+  0x23, 0x21, 0x27, 0x25, 0x5b, 0x59, 0x5f, 0x5d, 0x53, 0x51, 0x57, 0x55,
+  0x4b, 0x49, 0x4f, 0x4d, 0x43, 0x41, 0x47, 0x45, 0x7b, 0x79, 0x7f, 0x7d,
+  0x73, 0x71, 0x77, 0x75, 0x6b, 0x69, 0x6f, 0x6d, 0x63, 0x61, 0x67, 0x65,
+  0x9b, 0x99, 0x9f, 0x9d, 0x93, 0x91, 0x97, 0x95, 0x8b, 0x89, 0x8f, 0x8d,
+  0x83, 0x81, 0x87, 0x85, 0xbb, 0xb9, 0xbf, 0xbd, 0xb3, 0xb1, 0xb7, 0xb5,
+  0xab, 0xa9, 0xaf, 0xad, 0xa3, 0xa1, 0xa7, 0xa5, 0xdb, 0xd9, 0xdf, 0xdd,
+  0xd3, 0xd1, 0xd7, 0xd5, 0xcb, 0xc9, 0xcf, 0xcd, 0xc3, 0xc1, 0xc7, 0xc5,
+  0xfb, 0xf9, 0xff, 0xfd, 0xf3, 0xf1, 0xf7, 0xf5, 0xeb, 0xe9, 0xef, 0xed,
+  0xe3, 0xe1, 0xe7, 0xe5
+};
+
+/* ShiftRow: byte r of column c comes from column c + r */
+static const uint8_t shift_row[AES_128_BLOCK_SIZE] = {
+  0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12, 1, 6, 11
+};
+
+static uint8_t schedules[AES_128_KEY_SCHEDULES][ROUNDS + 1][AES_128_KEY_LENGTH];
+static uint8_t (*round_keys)[AES_128_KEY_LENGTH] = schedules[0];
+static struct aes_128_keys keys;
+
+/*---------------------------------------------------------------------------*/
+static void
+set_key(const uint8_t *key)
+{
+  const uint8_t *p;
+  uint8_t *k;
+  uint8_t rcon;
+  uint8_t i;
+  uint8_t j;
+  int expand;
+
+  expand = aes_128_keys_select(&keys, key);
+  round_keys = schedules[keys.current];
+  if(!expand) {
+    return;
+  }
+
+  rcon = 0x01;
+  memcpy(round_keys[0], key, AES_128_KEY_LENGTH);
+  for(i = 1; i <= ROUNDS; i++) {
+    p = round_keys[i - 1];
+    k = round_keys[i];
+    k[0] = aes_128_sbox[p[13]] ^ p[0] ^ rcon;
+    k[1] = aes_128_sbox[p[14]] ^ p[1];
+    k[2] = aes_128_sbox[p[15]] ^ p[2];
+    k[3] = aes_128_sbox[p[12]] ^ p[3];
+    for(j = 4; j < AES_128_KEY_LENGTH; j++) {
+      k[j] = p[j] ^ k[j - 4];
+    }
+    rcon = xtime[rcon];
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+encrypt(uint8_t *state)
+{
+  uint8_t t[AES_128_BLOCK_SIZE];
+  const uint8_t *k;
+  uint8_t all;
+  uint8_t round;
+  uint8_t i;
+
+  k = round_keys[0];
+  for(i = 0; i < AES_128_BLOCK_SIZE; i++) {
+    state[i] ^= k[i];
+  }
+
+  for(round = 1; round <= ROUNDS; round++) {
+    /* SubBytes and ShiftRow */
+    for(i = 0; i < AES_128_BLOCK_SIZE; i++) {
+      t[i] = aes_128_sbox[state[shift_row[i]]];
+    }
+
+    /* MixColumn and AddRoundKey; the last round skips MixColumn */
+    k = round_keys[round];
+    if(round < ROUNDS) {
+      for(i = 0; i < AES_128_BLOCK_SIZE; i += 4) {
+        all = t[i] ^ t[i + 1] ^ t[i + 2] ^ t[i + 3];
+        state[i] = t[i] ^ all ^ xtime[t[i] ^ t[i + 1]] ^ k[i];
+        state[i + 1] = t[i + 1] ^ all ^ xtime[t[i + 1] ^ t[i + 2]] ^ k[i + 1];
+        state[i + 2] = t[i + 2] ^ all ^ xtime[t[i + 2] ^ t[i + 3]] ^ k[i + 2];
+        state[i + 3] = t[i + 3] ^ all ^ xtime[t[i + 3] ^ t[i]] ^ k[i + 3];
+      }
+    } else {
+      for(i = 0; i < AES_128_BLOCK_SIZE; i++) {
+        state[i] = t[i] ^ k[i];
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+const struct aes_128_driver aes_128_compact_driver = {
+  set_key,
+  encrypt
+};
+/*---------------------------------------------------------------------------*/
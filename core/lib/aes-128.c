@@ -46,7 +46,7 @@
 #include "lib/aes-128.h"
 #include <string.h>
 
-static const uint8_t sbox[256] =   { 
+const uint8_t aes_128_sbox[256] =   { 
 0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
 0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
@@ -64,7 +64,9 @@ static const uint8_t sbox[256] =   {
 0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
 0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16 };
 
-static uint8_t round_keys[11][AES_128_KEY_LENGTH];
+static uint8_t schedules[AES_128_KEY_SCHEDULES][11][AES_128_KEY_LENGTH];
+static uint8_t (*round_keys)[AES_128_KEY_LENGTH] = schedules[0];
+static struct aes_128_keys keys;
 
 /*---------------------------------------------------------------------------*/
 /* multiplies by 2 in GF(2) */
@@ -81,14 +83,21 @@ set_key(const uint8_t *key)
   uint8_t i;
   uint8_t j;
   uint8_t rcon;
+  int expand;
+  
+  expand = aes_128_keys_select(&keys, key);
+  round_keys = schedules[keys.current];
+  if(!expand) {
+    return;
+  }
   
   rcon = 0x01;
   memcpy(round_keys[0], key, AES_128_KEY_LENGTH);
   for(i = 1; i <= 10; i++) {
-    round_keys[i][0] = sbox[round_keys[i - 1][13]] ^ round_keys[i - 1][0] ^ rcon;
-    round_keys[i][1] = sbox[round_keys[i - 1][14]] ^ round_keys[i - 1][1];
-    round_keys[i][2] = sbox[round_keys[i - 1][15]] ^ round_keys[i - 1][2];
-    round_keys[i][3] = sbox[round_keys[i - 1][12]] ^ round_keys[i - 1][3];
+    round_keys[i][0] = aes_128_sbox[round_keys[i - 1][13]] ^ round_keys[i - 1][0] ^ rcon;
+    round_keys[i][1] = aes_128_sbox[round_keys[i - 1][14]] ^ round_keys[i - 1][1];
+    round_keys[i][2] = aes_128_sbox[round_keys[i - 1][15]] ^ round_keys[i - 1][2];
+    round_keys[i][3] = aes_128_sbox[round_keys[i - 1][12]] ^ round_keys[i - 1][3];
     for(j = 4; j < AES_128_BLOCK_SIZE; j++) {
       round_keys[i][j] = round_keys[i - 1][j] ^ round_keys[i][j - 4];
     }
@@ -110,7 +119,7 @@ encrypt(uint8_t *state)
   for(round = 1; round <= 10; round++) {
     /* ByteSub */
     for(i = 0; i < AES_128_BLOCK_SIZE; i++) {
-      state[i] = sbox[state[i]];
+      state[i] = aes_128_sbox[state[i]];
     }
       
     /* ShiftRow */
@@ -176,6 +185,28 @@ aes_128_set_padded_key(uint8_t *key, uint8_t key_len)
   AES_128.set_key(block);
 }
 /*---------------------------------------------------------------------------*/
+int
+aes_128_keys_select(struct aes_128_keys *keys, const uint8_t *key)
+{
+  uint8_t i;
+  
+  for(i = 0; i < keys->used; i++) {
+    if(memcmp(keys->key[i], key, AES_128_KEY_LENGTH) == 0) {
+      keys->current = i;
+      return 0;
+    }
+  }
+  
+  /* the schedules are replaced in turn */
+  keys->current = keys->next;
+  keys->next = (keys->next + 1) % AES_128_KEY_SCHEDULES;
+  if(keys->used < AES_128_KEY_SCHEDULES) {
+    keys->used++;
+  }
+  memcpy(keys->key[keys->current], key, AES_128_KEY_LENGTH);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 const struct aes_128_driver aes_128_driver = {
   set_key,
   encrypt
@@ -45,6 +45,23 @@
 #define AES_128_BLOCK_SIZE 16
 #define AES_128_KEY_LENGTH 16
 
+/*
+ * The number of keys whose schedules the software drivers keep, so
+ * that switching back to one of them does not expand it again
+ */
+#ifdef AES_128_CONF_KEY_SCHEDULES
+#define AES_128_KEY_SCHEDULES AES_128_CONF_KEY_SCHEDULES
+#else /* AES_128_CONF_KEY_SCHEDULES */
+#define AES_128_KEY_SCHEDULES 1
+#endif /* AES_128_CONF_KEY_SCHEDULES */
+
+/*
+ * Besides the drivers of the platforms with AES hardware, there are
+ * three software drivers: aes_128_driver (the default, byte-wise),
+ * aes_128_compact_driver (byte-wise with small tables, for 8- and
+ * 16-bit platforms) and aes_128_ttable_driver (32-bit, with a 1 kB
+ * table, for native and ARM).
+ */
 #ifdef AES_128_CONF
 #define AES_128            AES_128_CONF
 #else /* AES_128_CONF */
@@ -67,11 +84,38 @@ struct aes_128_driver {
   void (* encrypt)(uint8_t *plaintext_and_result);
 };
 
+/**
+ * The keys of the schedules kept by a software driver.
+ */
+struct aes_128_keys {
+  uint8_t key[AES_128_KEY_SCHEDULES][AES_128_KEY_LENGTH];
+  uint8_t used;
+  uint8_t next;
+  uint8_t current;
+};
+
 /**
  * \brief Pads the key with zeroes before calling AES_128.set_key
  */
 void aes_128_set_padded_key(uint8_t *key, uint8_t key_len);
 
+/**
+ * \brief      Selects the schedule of a key in a software driver
+ * \param keys The keys of the schedules of the driver
+ * \param key  The key to set
+ * \retval 0   The schedule keys->current was computed before
+ * \retval 1   The schedule keys->current is to be computed
+ */
+int aes_128_keys_select(struct aes_128_keys *keys, const uint8_t *key);
+
+/**
+ * The S-box, shared by the byte-wise software drivers
+ */
+extern const uint8_t aes_128_sbox[256];
+
 extern const struct aes_128_driver AES_128;
+extern const struct aes_128_driver aes_128_driver;
+extern const struct aes_128_driver aes_128_compact_driver;
+extern const struct aes_128_driver aes_128_ttable_driver;
 
 #endif /* AES_128_H_ */
@@ -78,14 +78,14 @@ ctr_step(const uint8_t *nonce,
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Starts the CBC-MAC x with B_0 and the additional authenticated data */
 static void
-mic(const uint8_t *nonce,
-    const uint8_t *m, uint8_t m_len,
+mic_begin(uint8_t *x,
+    const uint8_t *nonce,
+    uint8_t m_len,
     const uint8_t *a, uint8_t a_len,
-    uint8_t *result,
     uint8_t mic_len)
 {
-  uint8_t x[AES_128_BLOCK_SIZE];
   uint8_t pos;
   uint8_t i;
   
@@ -109,35 +109,6 @@ mic(const uint8_t *nonce,
       AES_128.encrypt(x);
     }
   }
-  
-  if(m_len) {
-    pos = 0;
-    while(pos < m_len) {
-      for(i = 0; (pos + i < m_len) && (i < AES_128_BLOCK_SIZE); i++) {
-        x[i] ^= m[pos + i];
-      }
-      pos += AES_128_BLOCK_SIZE;
-      AES_128.encrypt(x);
-    }
-  }
-  
-  ctr_step(nonce, 0, x, AES_128_BLOCK_SIZE, 0);
-  
-  memcpy(result, x, mic_len);
-}
-/*---------------------------------------------------------------------------*/
-static void
-ctr(const uint8_t *nonce, uint8_t *m, uint8_t m_len)
-{
-  uint8_t pos;
-  uint8_t counter;
-  
-  pos = 0;
-  counter = 1;
-  while(pos < m_len) {
-    ctr_step(nonce, pos, m, m_len, counter++);
-    pos += AES_128_BLOCK_SIZE;
-  }
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -153,21 +124,45 @@ aead(const uint8_t* nonce,
     uint8_t *result, uint8_t mic_len,
     int forward)
 {
-  if(!forward) {
-    /* decrypt */
-    ctr(nonce, m, m_len);
-  }
+  uint8_t x[AES_128_BLOCK_SIZE];
+  uint8_t ctr_iv[AES_128_BLOCK_SIZE];
+  uint8_t k[AES_128_BLOCK_SIZE];
+  uint8_t pos;
+  uint8_t len;
+  uint8_t i;
   
-  mic(nonce,
-    m, m_len,
-    a, a_len,
-    result,
-    mic_len);
+  mic_begin(x, nonce, m_len, a, a_len, mic_len);
   
-  if(forward) {
-    /* encrypt */
-    ctr(nonce, m, m_len);
+  /*
+   * A single pass over m: each block is encrypted (or decrypted) with
+   * its key stream block and added to the CBC-MAC as plaintext
+   */
+  set_iv(ctr_iv, CCM_STAR_ENCRYPTION_FLAGS, nonce, 0);
+  pos = 0;
+  while(pos < m_len) {
+    memcpy(k, ctr_iv, AES_128_BLOCK_SIZE);
+    k[15] = (pos / AES_128_BLOCK_SIZE) + 1;
+    AES_128.encrypt(k);
+    
+    len = MIN(m_len - pos, AES_128_BLOCK_SIZE);
+    if(forward) {
+      for(i = 0; i < len; i++) {
+        x[i] ^= m[pos + i];
+        m[pos + i] ^= k[i];
+      }
+    } else {
+      for(i = 0; i < len; i++) {
+        m[pos + i] ^= k[i];
+        x[i] ^= m[pos + i];
+      }
+    }
+    AES_128.encrypt(x);
+    pos += AES_128_BLOCK_SIZE;
   }
+  
+  ctr_step(nonce, 0, x, AES_128_BLOCK_SIZE, 0);
+  
+  memcpy(result, x, mic_len);
 }
 /*---------------------------------------------------------------------------*/
 const struct ccm_star_driver ccm_star_driver = {
@@ -49,12 +49,38 @@
  * calculation module is an iterative CRC calculator that can be used
  * to cumulatively update a CRC checksum for every incoming byte.
  *
+ * Two CRC16s are provided: the CCITT one (as in IEEE 802.15.4, in its
+ * reflected form also known as CRC-16/KERMIT) with crc16_add() and
+ * crc16_data(), and the MODBUS one with crc16_modbus_add() and
+ * crc16_modbus_data().
+ *
+ * By default, the CRCs are computed without tables. CRC16_CONF_TABLE
+ * selects tables of 16 entries, with which each byte takes two table
+ * lookups, or of 256 entries, with which it takes one: flash for
+ * speed. The CCITT CRC16 only has the table of 256 entries, as its
+ * shifts are faster than the lookups in a table of 16. CRC_CONF_TABLE
+ * selects the tables of both CRC16 and CRC32.
+ *
  * @{
  */
 
 #ifndef CRC16_H_
 #define CRC16_H_
 
+#include "contiki-conf.h"
+
+#ifdef CRC16_CONF_TABLE
+#define CRC16_TABLE CRC16_CONF_TABLE
+#elif defined(CRC_CONF_TABLE)
+#define CRC16_TABLE CRC_CONF_TABLE
+#else
+#define CRC16_TABLE 0
+#endif
+
+#if CRC16_TABLE != 0 && CRC16_TABLE != 16 && CRC16_TABLE != 256
+#error CRC16_CONF_TABLE must be 0, 16 or 256
+#endif
+
 /**
  * \brief      Update an accumulated CRC16 checksum with one byte.
  * \param b    The byte to be added to the checksum
@@ -65,10 +91,10 @@
  *             with one byte. It can be used as a running checksum, or
  *             to checksum an entire data block.
  *
- *             \note The algorithm used in this implementation is
- *             tailored for a running checksum and does not perform as
- *             well as a table-driven algorithm when checksumming an
- *             entire data block.
+ *             \note Unless CRC16_CONF_TABLE is 256, the algorithm used
+ *             in this implementation is tailored for a running
+ *             checksum and does not perform as well as a table-driven
+ *             algorithm when checksumming an entire data block.
  *
  */
 unsigned short crc16_add(unsigned char b, unsigned short crc);
@@ -82,14 +108,32 @@ unsigned short crc16_add(unsigned char b, unsigned short crc);
  *
  *             This function calculates the CRC16 checksum of a data area.
  *
- *             \note The algorithm used in this implementation is
- *             tailored for a running checksum and does not perform as
- *             well as a table-driven algorithm when checksumming an
- *             entire data block.
+ *             \note Unless CRC16_CONF_TABLE is 256, the algorithm used
+ *             in this implementation is tailored for a running
+ *             checksum and does not perform as well as a table-driven
+ *             algorithm when checksumming an entire data block.
  */
 unsigned short crc16_data(const unsigned char *data, int datalen,
 			  unsigned short acc);
 
+/**
+ * \brief      Update an accumulated CRC16/MODBUS checksum with one byte.
+ * \param b    The byte to be added to the checksum
+ * \param crc  The accumulated CRC that is to be updated (or 0xffff).
+ * \return     The updated CRC checksum.
+ */
+unsigned short crc16_modbus_add(unsigned char b, unsigned short crc);
+
+/**
+ * \brief      Calculate the CRC16/MODBUS over a data area
+ * \param data Pointer to the data
+ * \param datalen The length of the data
+ * \param acc  The accumulated CRC that is to be updated (or 0xffff).
+ * \return     The CRC16/MODBUS checksum.
+ */
+unsigned short crc16_modbus_data(const unsigned char *data, int datalen,
+                                 unsigned short acc);
+
 #endif /* CRC16_H_ */
 
 /** @} */
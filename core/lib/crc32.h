@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Header file for the CRC32 calculation
+ */
+
+/** \addtogroup lib
+ * @{ */
+
+/**
+ * \defgroup crc32 Cyclic Redundancy Check 32 (CRC32) calculation
+ *
+ * The CRC32 of IEEE 802.3 and zlib (reflected polynomial 0xedb88320,
+ * initial value and final XOR 0xffffffff). The inversions are done
+ * inside crc32_add() and crc32_data(), so that a checksum starts
+ * with 0 and the result of one call is passed to the next when the
+ * data comes in pieces.
+ *
+ * Like for the CRC16, CRC32_CONF_TABLE (or CRC_CONF_TABLE) selects
+ * no table (0, the default), a table of 16 entries (64 bytes) or one
+ * of 256 entries (1 kB).
+ *
+ * @{
+ */
+
+#ifndef CRC32_H_
+#define CRC32_H_
+
+#include "contiki-conf.h"
+
+#ifdef CRC32_CONF_TABLE
+#define CRC32_TABLE CRC32_CONF_TABLE
+#elif defined(CRC_CONF_TABLE)
+#define CRC32_TABLE CRC_CONF_TABLE
+#else
+#define CRC32_TABLE 0
+#endif
+
+#if CRC32_TABLE != 0 && CRC32_TABLE != 16 && CRC32_TABLE != 256
+#error CRC32_CONF_TABLE must be 0, 16 or 256
+#endif
+
+/**
+ * \brief      Update a CRC32 checksum with one byte.
+ * \param b    The byte to be added to the checksum
+ * \param crc  The checksum so far (or 0).
+ * \return     The updated CRC32 checksum.
+ */
+uint32_t crc32_add(unsigned char b, uint32_t crc);
+
+/**
+ * \brief      Calculate the CRC32 over a data area
+ * \param data Pointer to the data
+ * \param datalen The length of the data
+ * \param crc  The checksum of the preceding data (or 0).
+ * \return     The CRC32 checksum.
+ */
+uint32_t crc32_data(const unsigned char *data, int datalen, uint32_t crc);
+
+#endif /* CRC32_H_ */
+
+/** @} */
+/** @} */
@@ -47,57 +47,162 @@
 #include "contiki.h"
 #include "lib/memb.h"
 
+#if MEMB_STATS
+static struct memb *pools;
+#endif /* MEMB_STATS */
+
+/* Blocks that can hold a pointer are kept on a free list; smaller
+   ones are found by walking through the blocks. */
+#if MEMB_FREELIST
+#define USE_FREELIST(m) ((m)->size >= sizeof(void *))
+#else /* MEMB_FREELIST */
+#define USE_FREELIST(m) 0
+#endif /* MEMB_FREELIST */
+
+/*---------------------------------------------------------------------------*/
+#if MEMB_STATS
+static void
+register_memb(struct memb *m)
+{
+  struct memb *p;
+
+  for(p = pools; p != NULL; p = p->next) {
+    if(p == m) {
+      return;
+    }
+  }
+  m->next = pools;
+  pools = m;
+}
+/*---------------------------------------------------------------------------*/
+struct memb *
+memb_pools(void)
+{
+  return pools;
+}
+#endif /* MEMB_STATS */
+/*---------------------------------------------------------------------------*/
+/* Get the index of the block that ptr points to, or -1 if it does not
+   point to a block. */
+static int
+block_index(struct memb *m, void *ptr)
+{
+  unsigned long offset;
+
+  if(!memb_inmemb(m, ptr)) {
+    return -1;
+  }
+  offset = (char *)ptr - (char *)m->mem;
+  if(offset % m->size != 0) {
+    return -1;
+  }
+  return offset / m->size;
+}
 /*---------------------------------------------------------------------------*/
 void
 memb_init(struct memb *m)
 {
   memset(m->count, 0, m->num);
   memset(m->mem, 0, m->size * m->num);
+#if MEMB_FREELIST
+  m->free = NULL;
+  m->fresh = 0;
+#endif /* MEMB_FREELIST */
+#if MEMB_FREELIST || MEMB_STATS
+  m->used = 0;
+#endif /* MEMB_FREELIST || MEMB_STATS */
+#if MEMB_STATS
+  m->max_used = 0;
+  m->failures = 0;
+  register_memb(m);
+#endif /* MEMB_STATS */
 }
 /*---------------------------------------------------------------------------*/
 void *
 memb_alloc(struct memb *m)
 {
+  char *ptr;
   int i;
 
-  for(i = 0; i < m->num; ++i) {
-    if(m->count[i] == 0) {
-      /* If this block was unused, we increase the reference count to
-	 indicate that it now is used and return a pointer to the
-	 memory block. */
-      ++(m->count[i]);
-      return (void *)((char *)m->mem + (i * m->size));
+  ptr = NULL;
+  i = 0;
+#if MEMB_FREELIST
+  if(USE_FREELIST(m)) {
+    if(m->free != NULL) {
+      ptr = m->free;
+      memcpy(&m->free, ptr, sizeof(void *));
+      i = (ptr - (char *)m->mem) / m->size;
+    } else if(m->fresh < m->num) {
+      /* Blocks that have never been allocated are not on the list. */
+      i = m->fresh++;
+      ptr = (char *)m->mem + i * m->size;
     }
+  } else
+#endif /* MEMB_FREELIST */
+  {
+    for(i = 0; i < m->num; ++i) {
+      if(m->count[i] == 0) {
+        ptr = (char *)m->mem + (i * m->size);
+        break;
+      }
+    }
+  }
+
+#if MEMB_STATS
+  if(m->max_used == 0) {
+    register_memb(m);
   }
+#endif /* MEMB_STATS */
 
-  /* No free block was found, so we return NULL to indicate failure to
-     allocate block. */
-  return NULL;
+  if(ptr == NULL) {
+    /* No free block was found, so we return NULL to indicate failure
+       to allocate block. */
+#if MEMB_STATS
+    m->failures++;
+#endif /* MEMB_STATS */
+    return NULL;
+  }
+
+  /* The block was unused, so we increase the reference count to
+     indicate that it now is used and return a pointer to it. */
+  ++(m->count[i]);
+#if MEMB_FREELIST || MEMB_STATS
+  m->used++;
+#endif /* MEMB_FREELIST || MEMB_STATS */
+#if MEMB_STATS
+  if(m->used > m->max_used) {
+    m->max_used = m->used;
+  }
+#endif /* MEMB_STATS */
+  return ptr;
 }
 /*---------------------------------------------------------------------------*/
 char
 memb_free(struct memb *m, void *ptr)
 {
   int i;
-  char *ptr2;
 
-  /* Walk through the list of blocks and try to find the block to
-     which the pointer "ptr" points to. */
-  ptr2 = (char *)m->mem;
-  for(i = 0; i < m->num; ++i) {
-    
-    if(ptr2 == (char *)ptr) {
-      /* We've found to block to which "ptr" points so we decrease the
-	 reference count and return the new value of it. */
-      if(m->count[i] > 0) {
-	/* Make sure that we don't deallocate free memory. */
-	--(m->count[i]);
+  i = block_index(m, ptr);
+  if(i < 0) {
+    return -1;
+  }
+
+  /* Make sure that we don't deallocate free memory. */
+  if(m->count[i] > 0) {
+    --(m->count[i]);
+    if(m->count[i] == 0) {
+#if MEMB_FREELIST
+      if(USE_FREELIST(m)) {
+        memcpy(ptr, &m->free, sizeof(void *));
+        m->free = ptr;
       }
-      return m->count[i];
+#endif /* MEMB_FREELIST */
+#if MEMB_FREELIST || MEMB_STATS
+      m->used--;
+#endif /* MEMB_FREELIST || MEMB_STATS */
     }
-    ptr2 += m->size;
   }
-  return -1;
+  return m->count[i];
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -110,6 +215,9 @@ memb_inmemb(struct memb *m, void *ptr)
 int
 memb_numfree(struct memb *m)
 {
+#if MEMB_FREELIST || MEMB_STATS
+  return m->num - m->used;
+#else /* MEMB_FREELIST || MEMB_STATS */
   int i;
   int num_free = 0;
 
@@ -120,5 +228,6 @@ memb_numfree(struct memb *m)
   }
 
   return num_free;
+#endif /* MEMB_FREELIST || MEMB_STATS */
 }
 /** @} */
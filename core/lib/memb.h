@@ -48,6 +48,19 @@
  * memory by the memb_alloc() function, and are deallocated with the
  * memb_free() function.
  *
+ * By default, memb_alloc() looks for a free block by walking through
+ * the blocks. With MEMB_CONF_FREELIST, free blocks are instead kept on
+ * a list that is threaded through the blocks themselves, so that
+ * memb_alloc() and memb_free() take constant time. A freed block is
+ * then overwritten with the list pointer, so its contents must not be
+ * used after memb_free(), which is an error in any case.
+ *
+ * With MEMB_CONF_STATS, each memory block keeps the number of blocks
+ * in use, the largest number that have been in use, and the number of
+ * allocations that failed. Memory blocks are registered when they are
+ * initialized or first used, and memb_pools() returns the first of
+ * them.
+ *
  * @{
  */
 
@@ -63,8 +76,21 @@
 #ifndef MEMB_H_
 #define MEMB_H_
 
+#include "contiki-conf.h"
 #include "sys/cc.h"
 
+#ifdef MEMB_CONF_FREELIST
+#define MEMB_FREELIST MEMB_CONF_FREELIST
+#else /* MEMB_CONF_FREELIST */
+#define MEMB_FREELIST 0
+#endif /* MEMB_CONF_FREELIST */
+
+#ifdef MEMB_CONF_STATS
+#define MEMB_STATS MEMB_CONF_STATS
+#else /* MEMB_CONF_STATS */
+#define MEMB_STATS 0
+#endif /* MEMB_CONF_STATS */
+
 /**
  * Declare a memory block.
  *
@@ -86,18 +112,44 @@ MEMB(connections, struct connection, 16);
  * \param num The total number of memory chunks in the block.
  *
  */
+#if MEMB_STATS
+#define MEMB(name, structure, num) \
+        static char CC_CONCAT(name,_memb_count)[num]; \
+        static structure CC_CONCAT(name,_memb_mem)[num]; \
+        static struct memb name = {sizeof(structure), num, \
+                                          CC_CONCAT(name,_memb_count), \
+                                          (void *)CC_CONCAT(name,_memb_mem), \
+                                          #name}
+#else /* MEMB_STATS */
 #define MEMB(name, structure, num) \
         static char CC_CONCAT(name,_memb_count)[num]; \
         static structure CC_CONCAT(name,_memb_mem)[num]; \
         static struct memb name = {sizeof(structure), num, \
                                           CC_CONCAT(name,_memb_count), \
                                           (void *)CC_CONCAT(name,_memb_mem)}
+#endif /* MEMB_STATS */
 
 struct memb {
   unsigned short size;
   unsigned short num;
   char *count;
   void *mem;
+#if MEMB_STATS
+  const char *name;
+  unsigned short used;
+  unsigned short max_used;
+  unsigned long failures;
+  struct memb *next;
+#endif /* MEMB_STATS */
+#if MEMB_FREELIST
+  /* The list of freed blocks, and the number of blocks at the start
+     of the memory that have been handed out at least once. */
+  void *free;
+  unsigned short fresh;
+#if !MEMB_STATS
+  unsigned short used;
+#endif /* !MEMB_STATS */
+#endif /* MEMB_FREELIST */
 };
 
 /**
@@ -132,6 +184,14 @@ int memb_inmemb(struct memb *m, void *ptr);
 
 int  memb_numfree(struct memb *m);
 
+#if MEMB_STATS
+/**
+ * Get the first registered memory block. The others follow through
+ * the next field.
+ */
+struct memb *memb_pools(void);
+#endif /* MEMB_STATS */
+
 /** @} */
 /** @} */
 
@@ -46,6 +46,7 @@
 
 #include "mmem.h"
 #include "list.h"
+#include "memb.h"
 #include "contiki-conf.h"
 #include <string.h>
 
@@ -55,10 +56,254 @@
 #define MMEM_SIZE 4096
 #endif
 
+/* The number of bytes that mmem_free() moves to compact the holes it
+   leaves, or 0 to compact the memory at once at every mmem_free(). */
+#ifdef MMEM_CONF_COMPACT_STEP
+#define MMEM_COMPACT_STEP MMEM_CONF_COMPACT_STEP
+#else
+#define MMEM_COMPACT_STEP 0
+#endif
+
+/* The number of holes that can be left by freed blocks. When they are
+   all used, mmem_free() joins the two that are closest. */
+#ifdef MMEM_CONF_HOLES
+#define MMEM_HOLES MMEM_CONF_HOLES
+#else
+#define MMEM_HOLES 8
+#endif
+
+/* Allocations of at most this many bytes are placed in holes. */
+#ifdef MMEM_CONF_SMALL_SIZE
+#define MMEM_SMALL_SIZE MMEM_CONF_SMALL_SIZE
+#else
+#define MMEM_SMALL_SIZE 32
+#endif
+
 LIST(mmemlist);
 unsigned int avail_memory;
 static char memory[MMEM_SIZE];
 
+#if MMEM_COMPACT_STEP
+/* The holes left by freed blocks stay in the list, in order of
+   address, until they are compacted away. */
+MEMB(holes, struct mmem, MMEM_HOLES);
+static unsigned int hole_memory;
+#define IS_HOLE(m) memb_inmemb(&holes, (m))
+#endif /* MMEM_COMPACT_STEP */
+
+#if MMEM_STATS
+static unsigned long moved_memory;
+static unsigned int max_moved;
+static unsigned long failures;
+#endif /* MMEM_STATS */
+
+/*---------------------------------------------------------------------------*/
+static void
+count_moved(unsigned int bytes)
+{
+#if MMEM_STATS
+  moved_memory += bytes;
+  if(bytes > max_moved) {
+    max_moved = bytes;
+  }
+#endif /* MMEM_STATS */
+}
+/*---------------------------------------------------------------------------*/
+#if MMEM_COMPACT_STEP
+static void
+link_after(struct mmem *prev, struct mmem *m)
+{
+  if(prev == NULL) {
+    *mmemlist = m;
+  } else {
+    prev->next = m;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Move blocks down over the first hole, until at least max bytes have
+   been moved or there are no holes left. When join is set, start at
+   the hole that is closest to the next one, and stop when they have
+   been joined. Returns the number of bytes moved. */
+static unsigned int
+compact(unsigned int max, int join)
+{
+  struct mmem *prev, *gap, *m, *p, *start, *start_prev;
+  unsigned int moved, between, fewest;
+
+  prev = gap = NULL;
+  if(join) {
+    p = start = start_prev = NULL;
+    between = 0;
+    fewest = MMEM_SIZE;
+    for(m = list_head(mmemlist); m != NULL; m = m->next) {
+      if(IS_HOLE(m)) {
+        if(start != NULL && between < fewest) {
+          fewest = between;
+          gap = start;
+          prev = start_prev;
+        }
+        start = m;
+        start_prev = p;
+        between = 0;
+      } else {
+        between += m->size;
+      }
+      p = m;
+    }
+    /* The last hole is joined with the free memory at the end. */
+    if(start != NULL && between < fewest) {
+      gap = start;
+      prev = start_prev;
+    }
+  } else {
+    for(gap = list_head(mmemlist); gap != NULL && !IS_HOLE(gap);
+        gap = gap->next) {
+      prev = gap;
+    }
+  }
+
+  moved = 0;
+  while(gap != NULL && moved < max) {
+    m = gap->next;
+    if(m == NULL) {
+      /* The hole has reached the end, so it is free memory again. */
+      link_after(prev, NULL);
+      avail_memory += gap->size;
+      hole_memory -= gap->size;
+      memb_free(&holes, gap);
+      break;
+    }
+
+    if(IS_HOLE(m)) {
+      gap->size += m->size;
+      gap->next = m->next;
+      memb_free(&holes, m);
+      if(join) {
+        break;
+      }
+      continue;
+    }
+
+    /* Move the block down to the start of the hole, and the hole up
+       past the block. */
+    memmove(gap->ptr, m->ptr, m->size);
+    m->ptr = gap->ptr;
+    gap->ptr = (char *)gap->ptr + m->size;
+    gap->next = m->next;
+    m->next = gap;
+    link_after(prev, m);
+    prev = m;
+    moved += m->size;
+  }
+
+  return moved;
+}
+/*---------------------------------------------------------------------------*/
+/* Put a small block in the smallest hole that it fits in. */
+static int
+reuse_hole(struct mmem *m, unsigned int size)
+{
+  struct mmem *prev, *n, *best, *best_prev;
+
+  best = best_prev = NULL;
+  prev = NULL;
+  for(n = list_head(mmemlist); n != NULL; n = n->next) {
+    if(IS_HOLE(n) && n->size >= size &&
+       (best == NULL || n->size < best->size)) {
+      best = n;
+      best_prev = prev;
+      if(n->size == size) {
+        break;
+      }
+    }
+    prev = n;
+  }
+
+  if(best == NULL) {
+    return 0;
+  }
+
+  m->ptr = best->ptr;
+  m->size = size;
+  hole_memory -= size;
+  if(best->size == size) {
+    m->next = best->next;
+    memb_free(&holes, best);
+  } else {
+    best->ptr = (char *)best->ptr + size;
+    best->size -= size;
+    m->next = best;
+  }
+  link_after(best_prev, m);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Replace a block with a hole, joined with the holes next to it.
+   Returns zero if there was no free hole. */
+static int
+free_hole(struct mmem *m, unsigned int *moved)
+{
+  struct mmem *prevprev, *prev, *n, *h;
+
+  /* Compaction joins holes, so it makes holes free. */
+  if(memb_numfree(&holes) == 0) {
+    *moved = compact(MMEM_SIZE, 1);
+  }
+
+  prevprev = prev = NULL;
+  for(n = list_head(mmemlist); n != NULL && n != m; n = n->next) {
+    prevprev = prev;
+    prev = n;
+  }
+  if(n == NULL) {
+    return 1;
+  }
+
+  n = m->next;
+  if(n == NULL) {
+    /* The last block, and a hole before it, go back to the free
+       memory at the end. */
+    link_after(prev, NULL);
+    avail_memory += m->size;
+    if(prev != NULL && IS_HOLE(prev)) {
+      link_after(prevprev, NULL);
+      avail_memory += prev->size;
+      hole_memory -= prev->size;
+      memb_free(&holes, prev);
+    }
+    return 1;
+  }
+
+  if(prev != NULL && IS_HOLE(prev)) {
+    h = prev;
+    h->size += m->size;
+    h->next = n;
+  } else if(IS_HOLE(n)) {
+    h = n;
+    h->ptr = m->ptr;
+    h->size += m->size;
+    link_after(prev, h);
+  } else {
+    h = memb_alloc(&holes);
+    if(h == NULL) {
+      return 0;
+    }
+    h->ptr = m->ptr;
+    h->size = m->size;
+    h->next = n;
+    link_after(prev, h);
+  }
+  hole_memory += m->size;
+
+  if(h != n && IS_HOLE(n)) {
+    h->size += n->size;
+    h->next = n->next;
+    memb_free(&holes, n);
+  }
+  return 1;
+}
+#endif /* MMEM_COMPACT_STEP */
+
 /*---------------------------------------------------------------------------*/
 /**
  * \brief      Allocate a managed memory block
@@ -82,8 +327,27 @@ static char memory[MMEM_SIZE];
 int
 mmem_alloc(struct mmem *m, unsigned int size)
 {
+#if MMEM_COMPACT_STEP
+  if(size <= MMEM_SMALL_SIZE && hole_memory >= size &&
+     reuse_hole(m, size)) {
+    return 1;
+  }
+
+  /* Without room at the end, use a hole, or compact the memory if
+     that makes enough room. */
+  if(avail_memory < size && hole_memory >= size && reuse_hole(m, size)) {
+    return 1;
+  }
+  if(avail_memory < size && avail_memory + hole_memory >= size) {
+    count_moved(compact(MMEM_SIZE, 0));
+  }
+#endif /* MMEM_COMPACT_STEP */
+
   /* Check if we have enough memory left for this allocation. */
   if(avail_memory < size) {
+#if MMEM_STATS
+    failures++;
+#endif /* MMEM_STATS */
     return 0;
   }
 
@@ -119,12 +383,24 @@ void
 mmem_free(struct mmem *m)
 {
   struct mmem *n;
+  unsigned int moved;
+
+  moved = 0;
+#if MMEM_COMPACT_STEP
+  /* Leave a hole, and compact a bit of the memory. Without a free
+     hole, compact the memory after the block as below. */
+  if(free_hole(m, &moved)) {
+    count_moved(moved + compact(MMEM_COMPACT_STEP, 0));
+    return;
+  }
+#endif /* MMEM_COMPACT_STEP */
 
   if(m->next != NULL) {
     /* Compact the memory after the allocation that is to be removed
        by moving it downwards. */
     memmove(m->ptr, m->next->ptr,
 	    &memory[MMEM_SIZE - avail_memory] - (char *)m->next->ptr);
+    moved += &memory[MMEM_SIZE - avail_memory] - (char *)m->next->ptr;
     
     /* Update all the memory pointers that points to memory that is
        after the allocation that is to be removed. */
@@ -134,6 +410,7 @@ mmem_free(struct mmem *m)
   }
 
   avail_memory += m->size;
+  count_moved(moved);
 
   /* Remove the memory block from the list. */
   list_remove(mmemlist, m);
@@ -157,8 +434,79 @@ mmem_init(void)
   }
   list_init(mmemlist);
   avail_memory = MMEM_SIZE;
+#if MMEM_COMPACT_STEP
+  memb_init(&holes);
+  hole_memory = 0;
+#endif /* MMEM_COMPACT_STEP */
   inited = 1;
 }
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief      Compact the managed memory
+ * \param max  The number of bytes to move
+ * \return     Non-zero if there are holes left to compact
+ *
+ *             This function moves allocated blocks down over the
+ *             holes left by mmem_free(), until at least max bytes
+ *             have been moved. It can be called when the system is
+ *             idle, so that mmem_alloc() seldom needs to compact the
+ *             memory. Blocks are moved whole, so a call can move the
+ *             size of a block more than max bytes.
+ *
+ */
+int
+mmem_compact(unsigned int max)
+{
+#if MMEM_COMPACT_STEP
+  count_moved(compact(max, 0));
+  return hole_memory > 0;
+#else /* MMEM_COMPACT_STEP */
+  return 0;
+#endif /* MMEM_COMPACT_STEP */
+}
+/*---------------------------------------------------------------------------*/
+#if MMEM_STATS
+/**
+ * \brief       Get statistics of the managed memory
+ * \param stats The statistics are written here
+ *
+ *              The fragmentation of the memory is hole_memory out of
+ *              hole_memory + free_memory bytes. Bytes moved are
+ *              counted by mmem_alloc(), mmem_free() and mmem_compact()
+ *              calls, and max_moved is the most moved by one call.
+ *
+ */
+void
+mmem_stats(struct mmem_stats *stats)
+{
+#if MMEM_COMPACT_STEP
+  struct mmem *m;
+#endif /* MMEM_COMPACT_STEP */
+
+  stats->free_memory = avail_memory;
+  stats->hole_memory = 0;
+  stats->holes = 0;
+#if MMEM_COMPACT_STEP
+  stats->hole_memory = hole_memory;
+  for(m = list_head(mmemlist); m != NULL; m = m->next) {
+    if(IS_HOLE(m)) {
+      stats->holes++;
+    }
+  }
+#endif /* MMEM_COMPACT_STEP */
+  stats->moved = moved_memory;
+  stats->max_moved = max_moved;
+  stats->failures = failures;
+}
+/*---------------------------------------------------------------------------*/
+void
+mmem_stats_reset(void)
+{
+  moved_memory = 0;
+  max_moved = 0;
+  failures = 0;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* MMEM_STATS */
 
 /** @} */
@@ -44,6 +44,15 @@
  * stays in place. Therefore, a level of indirection is used: access
  * to allocated memory must always be done using a special macro.
  *
+ * By default, every mmem_free() compacts the memory after the freed
+ * block, which takes time in proportion to the amount of memory
+ * allocated after it. With MMEM_CONF_COMPACT_STEP, mmem_free() instead
+ * leaves a hole, and moves at most about that many bytes to compact
+ * the holes away. mmem_compact() can be called to compact more, and
+ * mmem_alloc() compacts everything when it needs the room. Small
+ * allocations of at most MMEM_CONF_SMALL_SIZE bytes are placed in
+ * holes when they fit, without compaction.
+ *
  * \note This module has not been heavily tested.
  * @{
  */
@@ -59,6 +68,14 @@
 #ifndef MMEM_H_
 #define MMEM_H_
 
+#include "contiki-conf.h"
+
+#ifdef MMEM_CONF_STATS
+#define MMEM_STATS MMEM_CONF_STATS
+#else /* MMEM_CONF_STATS */
+#define MMEM_STATS 0
+#endif /* MMEM_CONF_STATS */
+
 /*---------------------------------------------------------------------------*/
 /**
  * \brief      Get a pointer to the managed memory
@@ -86,6 +103,21 @@ struct mmem {
 int  mmem_alloc(struct mmem *m, unsigned int size);
 void mmem_free(struct mmem *);
 void mmem_init(void);
+int  mmem_compact(unsigned int max);
+
+#if MMEM_STATS
+struct mmem_stats {
+  unsigned int free_memory;   /**< Bytes free after the last block */
+  unsigned int hole_memory;   /**< Bytes free in holes between blocks */
+  unsigned int holes;         /**< Number of holes */
+  unsigned long moved;        /**< Bytes moved to compact the memory */
+  unsigned int max_moved;     /**< Most bytes moved by one call */
+  unsigned long failures;     /**< Number of failed allocations */
+};
+
+void mmem_stats(struct mmem_stats *stats);
+void mmem_stats_reset(void);
+#endif /* MMEM_STATS */
 
 #endif /* MMEM_H_ */
 
@@ -66,12 +66,26 @@ get_extended_address(const linkaddr_t *addr)
 #endif /* LINKADDR_SIZE == 2 */
 /*---------------------------------------------------------------------------*/
 void
+ccm_star_packetbuf_nonce_prefix(uint8_t *prefix, const linkaddr_t *addr)
+{
+  memcpy(prefix, get_extended_address(addr),
+      CCM_STAR_PACKETBUF_NONCE_PREFIX_LENGTH);
+}
+/*---------------------------------------------------------------------------*/
+void
 ccm_star_packetbuf_set_nonce(uint8_t *nonce, int forward)
 {
   const linkaddr_t *source_addr;
   
   source_addr = forward ? &linkaddr_node_addr : packetbuf_addr(PACKETBUF_ADDR_SENDER);
-  memcpy(nonce, get_extended_address(source_addr), 8);
+  ccm_star_packetbuf_set_nonce_from_prefix(nonce,
+      get_extended_address(source_addr));
+}
+/*---------------------------------------------------------------------------*/
+void
+ccm_star_packetbuf_set_nonce_from_prefix(uint8_t *nonce, const uint8_t *prefix)
+{
+  memcpy(nonce, prefix, CCM_STAR_PACKETBUF_NONCE_PREFIX_LENGTH);
   nonce[8] = packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_2_3) >> 8;
   nonce[9] = packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_2_3) & 0xff;
   nonce[10] = packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_0_1) >> 8;
@@ -42,7 +42,26 @@
 #define CCM_STAR_PACKETBUF_H_
 
 #include "lib/ccm-star.h"
+#include "net/linkaddr.h"
+
+/* The part of the nonce that only depends on the source address */
+#define CCM_STAR_PACKETBUF_NONCE_PREFIX_LENGTH 8
 
 void ccm_star_packetbuf_set_nonce(uint8_t *nonce, int forward);
 
+/**
+ * \brief        Writes the part of the nonce of the frames from a source
+ *               that does not change from frame to frame
+ * \param prefix CCM_STAR_PACKETBUF_NONCE_PREFIX_LENGTH bytes
+ * \param addr   The source address
+ */
+void ccm_star_packetbuf_nonce_prefix(uint8_t *prefix, const linkaddr_t *addr);
+
+/**
+ * \brief        Sets the nonce of the frame in packetbuf from the prefix
+ *               of its source, as written by ccm_star_packetbuf_nonce_prefix()
+ */
+void ccm_star_packetbuf_set_nonce_from_prefix(uint8_t *nonce,
+                                              const uint8_t *prefix);
+
 #endif /* CCM_STAR_PACKETBUF_H_ */
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Table of the link-layer security sessions with the neighbors
+ */
+
+/**
+ * \addtogroup llsec802154
+ * @{
+ */
+
+#include "net/llsec/llsec-session.h"
+#include "net/llsec/llsec802154.h"
+#include <string.h>
+
+#if LLSEC802154_USES_AUX_HEADER && LLSEC802154_USES_FRAME_COUNTER
+
+/* Hash slots: a power of two, at least twice the number of sessions */
+#if LLSEC_SESSION_MAX <= 8
+#define SLOTS 16
+#elif LLSEC_SESSION_MAX <= 16
+#define SLOTS 32
+#elif LLSEC_SESSION_MAX <= 32
+#define SLOTS 64
+#elif LLSEC_SESSION_MAX <= 64
+#define SLOTS 128
+#elif LLSEC_SESSION_MAX <= 127
+#define SLOTS 256
+#else
+#error LLSEC_SESSION_CONF_MAX must be at most 127
+#endif
+
+static struct llsec_session sessions[LLSEC_SESSION_MAX];
+static uint8_t count;
+
+/* The index of the session in each slot, plus one; 0 for a free slot.
+   Collisions go to the next slots. */
+static uint8_t slots[SLOTS];
+
+#if LLSEC_SESSION_STATS
+static struct llsec_session_stats stats;
+#define STATS_ADD(field, n) (stats.field += (n))
+#else /* LLSEC_SESSION_STATS */
+#define STATS_ADD(field, n)
+#endif /* LLSEC_SESSION_STATS */
+
+/*---------------------------------------------------------------------------*/
+static uint8_t
+hash(const linkaddr_t *addr)
+{
+  uint16_t h;
+  uint8_t i;
+
+  h = 0;
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    h = h * 31 + addr->u8[i];
+  }
+  return (h ^ (h >> 8)) & (SLOTS - 1);
+}
+/*---------------------------------------------------------------------------*/
+void
+llsec_session_init(void)
+{
+  memset(slots, 0, sizeof(slots));
+  count = 0;
+}
+/*---------------------------------------------------------------------------*/
+struct llsec_session *
+llsec_session_get(const linkaddr_t *addr)
+{
+  struct llsec_session *s;
+  uint8_t i;
+
+  STATS_ADD(lookups, 1);
+  for(i = hash(addr); slots[i] != 0; i = (i + 1) & (SLOTS - 1)) {
+    STATS_ADD(probes, 1);
+    s = &sessions[slots[i] - 1];
+    if(linkaddr_cmp(&s->addr, addr)) {
+      return s;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+struct llsec_session *
+llsec_session_add(const linkaddr_t *addr)
+{
+  struct llsec_session *s;
+  uint8_t i;
+
+  if(count == LLSEC_SESSION_MAX) {
+    STATS_ADD(full, 1);
+    return NULL;
+  }
+
+  i = hash(addr);
+  while(slots[i] != 0) {
+    i = (i + 1) & (SLOTS - 1);
+  }
+  s = &sessions[count++];
+  slots[i] = count;
+
+  linkaddr_copy(&s->addr, addr);
+  ccm_star_packetbuf_nonce_prefix(s->nonce_prefix, addr);
+  return s;
+}
+/*---------------------------------------------------------------------------*/
+int
+llsec_session_count(void)
+{
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+#if LLSEC_SESSION_STATS
+const struct llsec_session_stats *
+llsec_session_stats(void)
+{
+  return &stats;
+}
+/*---------------------------------------------------------------------------*/
+void
+llsec_session_stats_reset(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+#endif /* LLSEC_SESSION_STATS */
+/*---------------------------------------------------------------------------*/
+#endif /* LLSEC802154_USES_AUX_HEADER && LLSEC802154_USES_FRAME_COUNTER */
+
+/** @} */
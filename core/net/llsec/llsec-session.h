@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Table of the link-layer security sessions with the neighbors
+ */
+
+/**
+ * \addtogroup llsec802154
+ * @{
+ */
+
+/*
+ * A session holds what the link-layer security keeps about a
+ * neighbor: its anti-replay information and the part of the CCM*
+ * nonces of its frames that does not change from frame to frame. The
+ * sessions are found through a hash of the link address, so that the
+ * lookup for a received frame stays short in dense neighborhoods,
+ * and they are kept apart from the neighbor table, so that they do
+ * not take its entries.
+ *
+ * Sessions are never removed: forgetting the frame counter of a
+ * neighbor would let its frames be replayed.
+ */
+
+#ifndef LLSEC_SESSION_H_
+#define LLSEC_SESSION_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+#include "net/nbr-table.h"
+#include "net/llsec/anti-replay.h"
+#include "net/llsec/ccm-star-packetbuf.h"
+
+/* The number of sessions, at most 127 */
+#ifdef LLSEC_SESSION_CONF_MAX
+#define LLSEC_SESSION_MAX LLSEC_SESSION_CONF_MAX
+#else /* LLSEC_SESSION_CONF_MAX */
+#define LLSEC_SESSION_MAX NBR_TABLE_MAX_NEIGHBORS
+#endif /* LLSEC_SESSION_CONF_MAX */
+
+#ifdef LLSEC_SESSION_CONF_STATS
+#define LLSEC_SESSION_STATS LLSEC_SESSION_CONF_STATS
+#else /* LLSEC_SESSION_CONF_STATS */
+#define LLSEC_SESSION_STATS 0
+#endif /* LLSEC_SESSION_CONF_STATS */
+
+struct llsec_session {
+  linkaddr_t addr;
+  uint8_t nonce_prefix[CCM_STAR_PACKETBUF_NONCE_PREFIX_LENGTH];
+  struct anti_replay_info info;
+};
+
+#if LLSEC_SESSION_STATS
+struct llsec_session_stats {
+  uint32_t lookups;   /**< Calls to llsec_session_get() */
+  uint32_t probes;    /**< Sessions compared in the lookups */
+  uint32_t full;      /**< Sessions not added, for lack of room */
+};
+
+/**
+ * \brief Returns the statistics of the session table
+ */
+const struct llsec_session_stats *llsec_session_stats(void);
+
+/**
+ * \brief Resets the statistics of the session table
+ */
+void llsec_session_stats_reset(void);
+#endif /* LLSEC_SESSION_STATS */
+
+/**
+ * \brief Removes all sessions
+ */
+void llsec_session_init(void);
+
+/**
+ * \brief      Looks up the session with a neighbor
+ * \param addr The link address of the neighbor
+ * \return     The session, or NULL if there is none
+ */
+struct llsec_session *llsec_session_get(const linkaddr_t *addr);
+
+/**
+ * \brief      Adds a session with a neighbor that has none yet
+ * \param addr The link address of the neighbor
+ * \return     The session, with its nonce prefix set, or NULL if the
+ *             table is full
+ *
+ *             The anti-replay information is for the caller to set.
+ */
+struct llsec_session *llsec_session_add(const linkaddr_t *addr);
+
+/**
+ * \brief Returns the number of sessions
+ */
+int llsec_session_count(void);
+
+#endif /* LLSEC_SESSION_H_ */
+
+/** @} */
@@ -44,12 +44,12 @@
 
 #include "net/llsec/noncoresec/noncoresec.h"
 #include "net/llsec/anti-replay.h"
+#include "net/llsec/llsec-session.h"
 #include "net/llsec/llsec802154.h"
 #include "net/llsec/ccm-star-packetbuf.h"
 #include "net/mac/frame802154.h"
 #include "net/netstack.h"
 #include "net/packetbuf.h"
-#include "net/nbr-table.h"
 #include "net/linkaddr.h"
 #include "lib/ccm-star.h"
 #include <string.h>
@@ -94,11 +94,11 @@ extern const struct framer DECORATED_FRAMER;
 
 /* network-wide CCM* key */
 static uint8_t key[16] = NONCORESEC_KEY;
-NBR_TABLE(struct anti_replay_info, anti_replay_table);
 
 /*---------------------------------------------------------------------------*/
+/* nonce_prefix is the one of the sender, for received frames only */
 static int
-aead(uint8_t hdrlen, int forward)
+aead(uint8_t hdrlen, int forward, const uint8_t *nonce_prefix)
 {
   uint8_t totlen;
   uint8_t nonce[CCM_STAR_NONCE_LENGTH];
@@ -110,7 +110,11 @@ aead(uint8_t hdrlen, int forward)
   uint8_t generated_mic[MIC_LEN];
   uint8_t *mic;
   
-  ccm_star_packetbuf_set_nonce(nonce, forward);
+  if(forward) {
+    ccm_star_packetbuf_set_nonce(nonce, 1);
+  } else {
+    ccm_star_packetbuf_set_nonce_from_prefix(nonce, nonce_prefix);
+  }
   totlen = packetbuf_totlen();
   a = packetbuf_hdrptr();
 #if WITH_ENCRYPTION
@@ -165,7 +169,7 @@ create(void)
     return result;
   }
 
-  aead(result, 1);
+  aead(result, 1, NULL);
   
   return result;
 }
@@ -175,7 +179,9 @@ parse(void)
 {
   int result;
   const linkaddr_t *sender;
-  struct anti_replay_info* info;
+  struct llsec_session *session;
+  const uint8_t *nonce_prefix;
+  uint8_t new_nonce_prefix[CCM_STAR_PACKETBUF_NONCE_PREFIX_LENGTH];
   
   result = DECORATED_FRAMER.parse();
   if(result == FRAMER_FAILED) {
@@ -194,40 +200,41 @@ parse(void)
   
   packetbuf_set_datalen(packetbuf_datalen() - MIC_LEN);
   
-  if(!aead(result, 0)) {
+  session = llsec_session_get(sender);
+  if(session) {
+    nonce_prefix = session->nonce_prefix;
+  } else {
+    ccm_star_packetbuf_nonce_prefix(new_nonce_prefix, sender);
+    nonce_prefix = new_nonce_prefix;
+  }
+  
+  if(!aead(result, 0, nonce_prefix)) {
     PRINTF("noncoresec: received unauthentic frame %"PRIu32"\n",
         anti_replay_get_counter());
     return FRAMER_FAILED;
   }
   
-  info = nbr_table_get_from_lladdr(anti_replay_table, sender);
-  if(!info) {
-    info = nbr_table_add_lladdr(anti_replay_table, sender, NBR_TABLE_REASON_LLSEC, NULL);
-    if(!info) {
-      PRINTF("noncoresec: could not get nbr_table_item\n");
-      return FRAMER_FAILED;
-    }
-    
+  if(!session) {
     /*
-     * Locking avoids replay attacks due to removed neighbor table items.
-     * Unfortunately, an attacker can mount a memory-based DoS attack
-     * on this by replaying broadcast frames from other network parts.
-     * However, this is not an issue as long as the network size does not
-     * exceed NBR_TABLE_MAX_NEIGHBORS.
-     *  
-     * To avoid locking, we could swap anti-replay information
-     * to external flash. Locking is also unnecessary when using
+     * Sessions are never removed, which avoids replay attacks due to
+     * forgotten frame counters. Unfortunately, an attacker can mount a
+     * memory-based DoS attack on this by replaying broadcast frames
+     * from other network parts. However, this is not an issue as long
+     * as the network size does not exceed LLSEC_SESSION_MAX.
+     *
+     * To avoid this, we could swap anti-replay information to
+     * external flash. Keeping sessions is also unnecessary when using
      * pairwise session keys, as done in coresec.
      */
-    if(!nbr_table_lock(anti_replay_table, info)) {
-      nbr_table_remove(anti_replay_table, info);
-      PRINTF("noncoresec: could not lock\n");
+    session = llsec_session_add(sender);
+    if(!session) {
+      PRINTF("noncoresec: could not add session\n");
       return FRAMER_FAILED;
     }
     
-    anti_replay_init_info(info);
+    anti_replay_init_info(&session->info);
   } else {
-    if(anti_replay_was_replayed(info)) {
+    if(anti_replay_was_replayed(&session->info)) {
        PRINTF("noncoresec: received replayed frame %"PRIu32"\n",
            anti_replay_get_counter());
        return FRAMER_FAILED;
@@ -254,7 +261,7 @@ static void
 init(void)
 {
   CCM_STAR.set_key(key);
-  nbr_table_register(anti_replay_table, NULL);
+  llsec_session_init();
 }
 /*---------------------------------------------------------------------------*/
 const struct llsec_driver noncoresec_driver = {
@@ -44,6 +44,14 @@
 
 #define CONTIKIMAC_ID 0x00
 
+/* With adaptive channel check rates, the low bits of the id carry the
+   sender's rate shift */
+#if CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE
+#define RATE_SHIFT_MASK 0x07
+#else /* CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE */
+#define RATE_SHIFT_MASK 0x00
+#endif /* CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE */
+
 /* SHORTEST_PACKET_SIZE is the shortest packet that ContikiMAC
    allows. Packets have to be a certain size to be able to be detected
    by two consecutive CCA checks, and here is where we define this
@@ -101,6 +109,9 @@ create(void)
   }
   chdr = packetbuf_hdrptr();
   chdr->id = CONTIKIMAC_ID;
+#if CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE
+  chdr->id |= packetbuf_attr(PACKETBUF_ATTR_CHECK_RATE_SHIFT) & RATE_SHIFT_MASK;
+#endif /* CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE */
   chdr->len = packetbuf_datalen();
   pad();
   
@@ -144,10 +155,13 @@ parse(void)
   }
   
   chdr = packetbuf_dataptr();
-  if(chdr->id != CONTIKIMAC_ID) {
+  if((chdr->id & ~RATE_SHIFT_MASK) != CONTIKIMAC_ID) {
     PRINTF("contikimac-framer: CONTIKIMAC_ID is missing\n");
     return FRAMER_FAILED;
   }
+#if CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE
+  packetbuf_set_attr(PACKETBUF_ATTR_CHECK_RATE_SHIFT, chdr->id & RATE_SHIFT_MASK);
+#endif /* CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE */
   
   if(!packetbuf_hdrreduce(sizeof(struct hdr))) {
     PRINTF("contikimac-framer: packetbuf_hdrreduce failed\n");
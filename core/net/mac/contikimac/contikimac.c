@@ -185,6 +185,55 @@ static int we_are_receiving_burst = 0;
 #define MAX_NONACTIVITY_PERIODS            10
 #endif
 
+/* With WITH_ADAPTIVE_RATE, a node that receives many unicast frames
+   checks the channel more often: 2^rate_shift times per cycle, evenly
+   spread. The cycle start stays a wake-up, so a neighbor that assumes
+   the base rate still reaches us. The rate shift is advertised in our
+   frames (see contikimac-framer.c) and kept in the phase table of the
+   neighbors, which then wait for our next wake-up rather than our
+   next cycle. */
+#ifdef CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE
+#define WITH_ADAPTIVE_RATE                 CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE
+#else
+#define WITH_ADAPTIVE_RATE                 0
+#endif
+
+/* ADAPTIVE_MAX_SHIFT is the highest rate shift. CYCLE_TIME shifted by
+   it must remain well above GUARD_TIME. */
+#ifdef CONTIKIMAC_CONF_ADAPTIVE_MAX_SHIFT
+#define ADAPTIVE_MAX_SHIFT                 CONTIKIMAC_CONF_ADAPTIVE_MAX_SHIFT
+#else
+#define ADAPTIVE_MAX_SHIFT                 2
+#endif
+
+/* ADAPTIVE_WINDOW is the number of cycles over which received unicast
+   frames are counted before the rate is reconsidered. */
+#ifdef CONTIKIMAC_CONF_ADAPTIVE_WINDOW
+#define ADAPTIVE_WINDOW                    CONTIKIMAC_CONF_ADAPTIVE_WINDOW
+#else
+#define ADAPTIVE_WINDOW                    (4 * NETSTACK_RDC_CHANNEL_CHECK_RATE)
+#endif
+
+/* ADAPTIVE_UP is the number of unicast frames per window that doubles
+   the base rate. Each further doubling takes twice as many, and a
+   rate is halved again under half the frames that raised it. */
+#ifdef CONTIKIMAC_CONF_ADAPTIVE_UP
+#define ADAPTIVE_UP                        CONTIKIMAC_CONF_ADAPTIVE_UP
+#else
+#define ADAPTIVE_UP                        4
+#endif
+
+/* With WITH_BURST_DETECTION, the frame pending bit of a queued frame
+   is also set when frames were queued behind it after it was created.
+   A frame created alone and deferred to the phase of the receiver then
+   carries the frames queued in the meantime in the same wake-up.
+   Secured frames are left as they are. */
+#ifdef CONTIKIMAC_CONF_WITH_BURST_DETECTION
+#define WITH_BURST_DETECTION               CONTIKIMAC_CONF_WITH_BURST_DETECTION
+#else
+#define WITH_BURST_DETECTION               1
+#endif
+
 
 
 
@@ -242,6 +291,16 @@ static volatile uint8_t contikimac_keep_radio_on = 0;
 static volatile unsigned char we_are_sending = 0;
 static volatile unsigned char radio_is_on = 0;
 
+#if WITH_ADAPTIVE_RATE
+/* We check the channel 2^rate_shift times per cycle */
+static volatile uint8_t rate_shift = 0;
+/* Unicast frames received for us in the current window */
+static uint16_t rate_frames;
+
+/* Time from the cycle start to its wake-up i */
+#define WAKEUP_TIME(i) ((rtimer_clock_t)(((uint32_t)CYCLE_TIME * (i)) >> rate_shift))
+#endif /* WITH_ADAPTIVE_RATE */
+
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -359,6 +418,31 @@ powercycle_turn_radio_on(void)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if WITH_ADAPTIVE_RATE
+/* Called at each cycle start: reconsiders the rate once per window */
+static void
+adapt_rate(void)
+{
+  static uint16_t window_cycles;
+
+  if(++window_cycles < ADAPTIVE_WINDOW) {
+    return;
+  }
+  window_cycles = 0;
+
+  if(rate_shift < ADAPTIVE_MAX_SHIFT &&
+     rate_frames >= (ADAPTIVE_UP << rate_shift)) {
+    rate_shift++;
+    PRINTF("contikimac: rate shift %u\n", rate_shift);
+  } else if(rate_shift > 0 &&
+            rate_frames < (ADAPTIVE_UP << (rate_shift - 1)) / 2) {
+    rate_shift--;
+    PRINTF("contikimac: rate shift %u\n", rate_shift);
+  }
+  rate_frames = 0;
+}
+#endif /* WITH_ADAPTIVE_RATE */
+/*---------------------------------------------------------------------------*/
 static void
 powercycle_wrapper(struct rtimer *t, void *ptr)
 {
@@ -384,6 +468,14 @@ powercycle(struct rtimer *t, void *ptr)
   while(1) {
     static uint8_t packet_seen;
     static uint8_t count;
+    static rtimer_clock_t next_wakeup;
+#if WITH_ADAPTIVE_RATE
+    static uint8_t wakeup;
+
+    /* The rate only changes at a cycle start, so that wake-ups stay
+       evenly spread over each cycle */
+    if(wakeup == 0) {
+#endif /* WITH_ADAPTIVE_RATE */
 
 #if SYNC_CYCLE_STARTS
     /* Compute cycle start when RTIMER_ARCH_SECOND is not a multiple
@@ -403,6 +495,11 @@ powercycle(struct rtimer *t, void *ptr)
     cycle_start += CYCLE_TIME;
 #endif
 
+#if WITH_ADAPTIVE_RATE
+      adapt_rate();
+    }
+#endif /* WITH_ADAPTIVE_RATE */
+
     packet_seen = 0;
 
     for(count = 0; count < CCA_COUNT_MAX; ++count) {
@@ -490,7 +587,15 @@ powercycle(struct rtimer *t, void *ptr)
       }
     }
 
-    if(RTIMER_CLOCK_LT(RTIMER_NOW() - cycle_start, CYCLE_TIME - CHECK_TIME * 4)) {
+#if WITH_ADAPTIVE_RATE
+    /* The next wake-up of this cycle, or the start of the next one */
+    next_wakeup = cycle_start + WAKEUP_TIME(wakeup + 1);
+    wakeup = (wakeup + 1) & ((1 << rate_shift) - 1);
+#else /* WITH_ADAPTIVE_RATE */
+    next_wakeup = cycle_start + CYCLE_TIME;
+#endif /* WITH_ADAPTIVE_RATE */
+
+    if(RTIMER_CLOCK_LT(RTIMER_NOW(), next_wakeup - CHECK_TIME * 4)) {
       /* Schedule the next powercycle interrupt, or sleep the mcu
 	 until then.  Sleeping will not exit from this interrupt, so
 	 ensure an occasional wake cycle or foreground processing will
@@ -498,14 +603,14 @@ powercycle(struct rtimer *t, void *ptr)
 #if RDC_CONF_MCU_SLEEP
       static uint8_t sleepcycle;
       if((sleepcycle++ < 16) && !we_are_sending && !radio_is_on) {
-        rtimer_arch_sleep(CYCLE_TIME - (RTIMER_NOW() - cycle_start));
+        rtimer_arch_sleep(next_wakeup - RTIMER_NOW());
       } else {
         sleepcycle = 0;
-        schedule_powercycle_fixed(t, CYCLE_TIME + cycle_start);
+        schedule_powercycle_fixed(t, next_wakeup);
         PT_YIELD(&pt);
       }
 #else
-      schedule_powercycle_fixed(t, CYCLE_TIME + cycle_start);
+      schedule_powercycle_fixed(t, next_wakeup);
       PT_YIELD(&pt);
 #endif
     }
@@ -548,6 +653,7 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
   uint8_t got_strobe_ack = 0;
   uint8_t is_broadcast = 0;
   uint8_t is_known_receiver = 0;
+  rtimer_clock_t phase_strobe_time = MAX_PHASE_STROBE_TIME;
   uint8_t collisions;
   int transmit_len;
   int ret;
@@ -599,6 +705,9 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
 
   if(!packetbuf_attr(PACKETBUF_ATTR_IS_CREATED_AND_SECURED)) {
     packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, 1);
+#if WITH_ADAPTIVE_RATE
+    packetbuf_set_attr(PACKETBUF_ATTR_CHECK_RATE_SHIFT, rate_shift);
+#endif /* WITH_ADAPTIVE_RATE */
     if(NETSTACK_FRAMER.create() < 0) {
       PRINTF("contikimac: framer failed\n");
       return MAC_TX_ERR_FATAL;
@@ -610,14 +719,27 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
   
   if(!is_broadcast && !is_receiver_awake) {
 #if WITH_PHASE_OPTIMIZATION
+#if WITH_ADAPTIVE_RATE
+    /* Wait for the next wake-up the receiver advertised */
+    ret = phase_wait(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
+                     CYCLE_TIME >> phase_rate_shift(packetbuf_addr(PACKETBUF_ADDR_RECEIVER)),
+                     GUARD_TIME,
+                     mac_callback, mac_callback_ptr, buf_list);
+#else /* WITH_ADAPTIVE_RATE */
     ret = phase_wait(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
                      CYCLE_TIME, GUARD_TIME,
                      mac_callback, mac_callback_ptr, buf_list);
+#endif /* WITH_ADAPTIVE_RATE */
     if(ret == PHASE_DEFERRED) {
       return MAC_TX_DEFERRED;
     }
     if(ret != PHASE_UNKNOWN) {
       is_known_receiver = 1;
+#if PHASE_DRIFT_CORRECT
+      /* We started early by the margin, and the wake-up may as well
+         come that much late */
+      phase_strobe_time += 2 * phase_margin(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+#endif /* PHASE_DRIFT_CORRECT */
     }
 #endif /* WITH_PHASE_OPTIMIZATION */ 
   }
@@ -708,7 +830,7 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
     watchdog_periodic();
 
     if(!is_broadcast && (is_receiver_awake || is_known_receiver) &&
-       !RTIMER_CLOCK_LT(RTIMER_NOW(), t0 + MAX_PHASE_STROBE_TIME)) {
+       !RTIMER_CLOCK_LT(RTIMER_NOW(), t0 + phase_strobe_time)) {
       PRINTF("miss to %d\n", packetbuf_addr(PACKETBUF_ADDR_RECEIVER)->u8[0]);
       break;
     }
@@ -819,6 +941,14 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
 
   if(!is_broadcast) {
     if(collisions == 0 && is_receiver_awake == 0) {
+#if WITH_ADAPTIVE_RATE
+      /* The phase we knew may be a wake-up that the receiver dropped
+         when it slowed down: learn it again with a full strobe rather
+         than missing it until MAX_NOACKS */
+      if(is_known_receiver && !got_strobe_ack) {
+        phase_remove(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+      }
+#endif /* WITH_ADAPTIVE_RATE */
       phase_update(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
 		   encounter_time, ret);
     }
@@ -837,6 +967,28 @@ qsend_packet(mac_callback_t sent, void *ptr)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if WITH_BURST_DETECTION
+/* Sets the frame pending bit of the frame in packetbuf, if it is an
+   unsecured data frame. Returns 1 if it was set. */
+static int
+set_frame_pending(void)
+{
+  frame802154_t info154;
+  uint8_t *hdr;
+
+  hdr = packetbuf_hdrptr();
+  if(frame802154_parse(hdr, packetbuf_totlen(), &info154) == 0 ||
+     info154.fcf.frame_type != FRAME802154_DATAFRAME ||
+     info154.fcf.security_enabled) {
+    return 0;
+  }
+  /* Frame pending is bit 4 of the frame control field */
+  hdr[0] |= 1 << 4;
+  packetbuf_set_attr(PACKETBUF_ATTR_PENDING, 1);
+  return 1;
+}
+#endif /* WITH_BURST_DETECTION */
+/*---------------------------------------------------------------------------*/
 static void
 qsend_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
 {
@@ -869,6 +1021,9 @@ qsend_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
         packetbuf_set_attr(PACKETBUF_ATTR_PENDING, 1);
       }
       packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, 1);
+#if WITH_ADAPTIVE_RATE
+      packetbuf_set_attr(PACKETBUF_ATTR_CHECK_RATE_SHIFT, rate_shift);
+#endif /* WITH_ADAPTIVE_RATE */
       if(NETSTACK_FRAMER.create() < 0) {
         PRINTF("contikimac: framer failed\n");
         mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 1);
@@ -877,6 +1032,15 @@ qsend_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
       
       packetbuf_set_attr(PACKETBUF_ATTR_IS_CREATED_AND_SECURED, 1);
       queuebuf_update_from_packetbuf(curr->buf);
+#if WITH_BURST_DETECTION
+    } else if(next != NULL && !packetbuf_attr(PACKETBUF_ATTR_PENDING)) {
+      /* Created while alone in the queue, typically before being
+         deferred to the phase of the receiver: carry on with the
+         frames queued since */
+      if(set_frame_pending()) {
+        queuebuf_update_from_packetbuf(curr->buf);
+      }
+#endif /* WITH_BURST_DETECTION */
     }
     curr = next;
   } while(next != NULL);
@@ -956,6 +1120,16 @@ input_packet(void)
       /* This is a regular packet that is destined to us or to the
          broadcast address. */
 
+#if WITH_ADAPTIVE_RATE
+      if(!packetbuf_holds_broadcast()) {
+        rate_frames++;
+      }
+#if WITH_PHASE_OPTIMIZATION
+      phase_set_rate_shift(packetbuf_addr(PACKETBUF_ADDR_SENDER),
+                           packetbuf_attr(PACKETBUF_ATTR_CHECK_RATE_SHIFT));
+#endif /* WITH_PHASE_OPTIMIZATION */
+#endif /* WITH_ADAPTIVE_RATE */
+
       /* If FRAME_PENDING is set, we are receiving a packets in a burst */
       we_are_receiving_burst = packetbuf_attr(PACKETBUF_ATTR_PENDING);
       if(we_are_receiving_burst) {
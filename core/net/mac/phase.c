@@ -44,18 +44,28 @@
 #include "net/queuebuf.h"
 #include "net/nbr-table.h"
 
-#if PHASE_CONF_DRIFT_CORRECT
-#define PHASE_DRIFT_CORRECT PHASE_CONF_DRIFT_CORRECT
-#else
-#define PHASE_DRIFT_CORRECT 0
-#endif
+#include <string.h>
 
 struct phase {
   rtimer_clock_t time;
 #if PHASE_DRIFT_CORRECT
-  rtimer_clock_t drift;
+  /* The clock at the last encounter, and the earlier encounter the
+     drift is measured from */
+  clock_time_t clock;
+  rtimer_clock_t anchor_time;
+  clock_time_t anchor_clock;
+  /* Drift of the phase, and how far off it may be, in rtimer ticks
+     per 2^24 rtimer ticks */
+  int16_t drift;
+  uint16_t spread;
+  /* The cycle time the phase was last predicted with */
+  rtimer_clock_t cycle_time;
+  uint8_t samples;
+  uint8_t predicted;
 #endif
   uint8_t noacks;
+  /* The neighbor checks the channel 2^rate_shift times per cycle */
+  uint8_t rate_shift;
   struct timer noacks_timer;
 };
 
@@ -74,9 +84,42 @@ struct phase_queueitem {
 
 #define MAX_NOACKS_TIME       CLOCK_SECOND * 30
 
+#if PHASE_DRIFT_CORRECT
+/* DRIFT_MIN_SPAN is the shortest time over which the drift is
+   measured. An encounter is only known to within a strobe, so the
+   drift over a shorter time is mostly noise. */
+#ifdef PHASE_CONF_DRIFT_MIN_SPAN
+#define DRIFT_MIN_SPAN        PHASE_CONF_DRIFT_MIN_SPAN
+#else
+#define DRIFT_MIN_SPAN        (CLOCK_SECOND * 60)
+#endif
+
+/* MAX_DRIFT_PPM is the relative drift of two clocks assumed as long
+   as that of a neighbor has not been measured. */
+#ifdef PHASE_CONF_MAX_DRIFT_PPM
+#define MAX_DRIFT_PPM         PHASE_CONF_MAX_DRIFT_PPM
+#else
+#define MAX_DRIFT_PPM         80
+#endif
+#define MAX_DRIFT             ((MAX_DRIFT_PPM * (1UL << 24)) / 1000000)
+/* The spread of a measured drift is kept above MIN_SPREAD, as
+   temperature changes it between measurements */
+#define MIN_SPREAD            (MAX_DRIFT / 32)
+
+/* Time past which the drift is not extrapolated, in rtimer ticks */
+#define MAX_ELAPSED           ((1UL << 28) - 1)
+#endif /* PHASE_DRIFT_CORRECT */
+
 MEMB(queued_packets_memb, struct phase_queueitem, PHASE_QUEUESIZE);
 NBR_TABLE(struct phase, nbr_phase);
 
+#if PHASE_STATS
+static struct phase_stats stats;
+#define STATS_ADD(field, n) stats.field += (n)
+#else /* PHASE_STATS */
+#define STATS_ADD(field, n)
+#endif /* PHASE_STATS */
+
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -87,19 +130,95 @@ NBR_TABLE(struct phase, nbr_phase);
 #define PRINTDEBUG(...)
 #endif
 /*---------------------------------------------------------------------------*/
+#if PHASE_DRIFT_CORRECT
+/* Rtimer ticks from then to now. rtimer_clock_t may have wrapped
+   around in between: the clock tells how many times. */
+static uint32_t
+ticks_since(rtimer_clock_t then, clock_time_t then_clock,
+            rtimer_clock_t now, clock_time_t now_clock)
+{
+  const uint32_t wrap = (rtimer_clock_t)~0;
+  clock_time_t elapsed;
+  rtimer_clock_t diff;
+  uint32_t ticks;
+
+  elapsed = now_clock - then_clock;
+  diff = now - then;
+  ticks = elapsed / CLOCK_SECOND * RTIMER_ARCH_SECOND +
+    elapsed % CLOCK_SECOND * RTIMER_ARCH_SECOND / CLOCK_SECOND;
+  ticks = ((ticks + wrap / 2 - diff) & ~wrap) + diff;
+  return ticks < MAX_ELAPSED ? ticks : MAX_ELAPSED;
+}
+/*---------------------------------------------------------------------------*/
+/* Phase drift over that many rtimer ticks */
+static int32_t
+drift_over(int32_t drift, uint32_t ticks)
+{
+  return drift * (int32_t)(ticks >> 12) / (1L << 12);
+}
+#endif /* PHASE_DRIFT_CORRECT */
+/*---------------------------------------------------------------------------*/
 void
-phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
-             int mac_status)
+phase_observe(const linkaddr_t *neighbor, rtimer_clock_t time,
+              clock_time_t clock, int mac_status)
 {
   struct phase *e;
 
   /* If we have an entry for this neighbor already, we renew it. */
   e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
   if(e != NULL) {
-    if(mac_status == MAC_TX_OK) {
 #if PHASE_DRIFT_CORRECT
-      e->drift = time-e->time;
-#endif
+    if(e->predicted) {
+      e->predicted = 0;
+      if(mac_status == MAC_TX_OK) {
+        STATS_ADD(hits, 1);
+      } else if(mac_status == MAC_TX_NOACK) {
+        STATS_ADD(misses, 1);
+      }
+    }
+    if(mac_status == MAC_TX_OK) {
+      uint32_t elapsed;
+      int32_t err, sample;
+
+      elapsed = ticks_since(e->anchor_time, e->anchor_clock, time, clock);
+      if(e->cycle_time > 0 &&
+         clock - e->anchor_clock >= DRIFT_MIN_SPAN &&
+         elapsed < MAX_ELAPSED) {
+        /* How far the phase moved from where the drift put it, within
+           half a cycle */
+        err = (elapsed - drift_over(e->drift, elapsed)) % e->cycle_time;
+        if(err >= e->cycle_time / 2) {
+          err -= e->cycle_time;
+        }
+        sample = err * 65536 / (int32_t)(elapsed >> 8);
+        if(sample > 2 * (int32_t)MAX_DRIFT || sample < -2 * (int32_t)MAX_DRIFT) {
+          /* Not a drift: the neighbor rebooted or changed its rate */
+          PRINTF("phase jump %ld to %d.%d\n", (long)err, neighbor->u8[0], neighbor->u8[1]);
+          e->drift = 0;
+          e->spread = MAX_DRIFT;
+          e->samples = 0;
+        } else {
+          /* The first samples are averaged, later ones weigh a quarter */
+          if(e->samples < 4) {
+            e->samples++;
+          }
+          e->drift += sample / e->samples;
+          if(sample < 0) {
+            sample = -sample;
+          }
+          e->spread = e->samples == 1 ? MAX_DRIFT / 2 :
+            e->spread + (sample - (int32_t)e->spread) / 4;
+          if(e->spread < MIN_SPREAD) {
+            e->spread = MIN_SPREAD;
+          }
+        }
+        e->anchor_time = time;
+        e->anchor_clock = clock;
+      }
+      e->clock = clock;
+    }
+#endif /* PHASE_DRIFT_CORRECT */
+    if(mac_status == MAC_TX_OK) {
       e->time = time;
     }
     /* If the neighbor didn't reply to us, it may have switched
@@ -126,14 +245,105 @@ phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
       if(e) {
         e->time = time;
 #if PHASE_DRIFT_CORRECT
-      e->drift = 0;
+        e->clock = clock;
+        e->anchor_time = time;
+        e->anchor_clock = clock;
+        e->drift = 0;
+        e->spread = MAX_DRIFT;
+        e->cycle_time = 0;
+        e->samples = 0;
+        e->predicted = 0;
 #endif
-      e->noacks = 0;
+        e->noacks = 0;
+        e->rate_shift = 0;
       }
     }
   }
 }
 /*---------------------------------------------------------------------------*/
+void
+phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
+             int mac_status)
+{
+  phase_observe(neighbor, time, clock_time(), mac_status);
+}
+/*---------------------------------------------------------------------------*/
+int
+phase_predict(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
+              rtimer_clock_t now, clock_time_t clock,
+              rtimer_clock_t *wait, rtimer_clock_t *margin)
+{
+  struct phase *e;
+  rtimer_clock_t since;
+
+  e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
+  if(e == NULL) {
+    return 0;
+  }
+
+  /* We expect phases to happen every CYCLE_TIME time
+     units. The next expected phase is at time e->time +
+     CYCLE_TIME. To compute a relative offset, we subtract
+     with clock_time(). Because we are only interested in turning
+     on the radio within the CYCLE_TIME period, we compute the
+     waiting time with modulo CYCLE_TIME. */
+#if PHASE_DRIFT_CORRECT
+  {
+    uint32_t elapsed;
+    int32_t correction, spread;
+
+    elapsed = ticks_since(e->time, e->clock, now, clock);
+    correction = drift_over(e->drift, elapsed);
+    spread = drift_over(e->spread, elapsed);
+    STATS_ADD(predictions, 1);
+    if(spread >= cycle_time / 2) {
+      /* The wake-up could be anywhere in the cycle */
+      STATS_ADD(uncertain, 1);
+      return 0;
+    }
+    if(correction != 0) {
+      STATS_ADD(corrected, 1);
+      STATS_ADD(correction, correction > 0 ? correction : -correction);
+    }
+    STATS_ADD(margin, spread);
+    *margin = spread;
+    since = (elapsed - correction) % cycle_time;
+    e->cycle_time = cycle_time;
+    e->predicted = 1;
+  }
+#else /* PHASE_DRIFT_CORRECT */
+  /* Check if cycle_time is a power of two */
+  if(!(cycle_time & (cycle_time - 1))) {
+    /* Faster if cycle_time is a power of two */
+    since = (rtimer_clock_t)((now - e->time) & (cycle_time - 1));
+  } else {
+    /* Works generally */
+    since = (rtimer_clock_t)((now - e->time) % cycle_time);
+  }
+  *margin = 0;
+#endif /* PHASE_DRIFT_CORRECT */
+  *wait = since == 0 ? 0 : cycle_time - since;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+rtimer_clock_t
+phase_margin(const linkaddr_t *neighbor)
+{
+#if PHASE_DRIFT_CORRECT
+  struct phase *e;
+  int32_t spread;
+
+  e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
+  if(e != NULL) {
+    spread = drift_over(e->spread, ticks_since(e->time, e->clock,
+                                               RTIMER_NOW(), clock_time()));
+    /* Past half the largest cycle, the phase is not used anyway */
+    return spread < (rtimer_clock_t)~0 / 2 ? spread : (rtimer_clock_t)~0 / 2;
+  }
+#endif /* PHASE_DRIFT_CORRECT */
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 static void
 send_packet(void *ptr)
 {
@@ -156,55 +366,18 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
            mac_callback_t mac_callback, void *mac_callback_ptr,
            struct rdc_buf_list *buf_list)
 {
-  struct phase *e;
-  //  const linkaddr_t *neighbor = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
+  rtimer_clock_t wait, margin, now, expected;
+  clock_time_t ctimewait;
+
   /* We go through the list of phases to find if we have recorded a
      phase for this particular neighbor. If so, we can compute the
      time for the next expected phase and setup a ctimer to switch on
      the radio just before the phase. */
-  e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
-  if(e != NULL) {
-    rtimer_clock_t wait, now, expected, sync;
-    clock_time_t ctimewait;
-    
-    /* We expect phases to happen every CYCLE_TIME time
-       units. The next expected phase is at time e->time +
-       CYCLE_TIME. To compute a relative offset, we subtract
-       with clock_time(). Because we are only interested in turning
-       on the radio within the CYCLE_TIME period, we compute the
-       waiting time with modulo CYCLE_TIME. */
-    
-    /*      printf("neighbor phase 0x%02x (cycle 0x%02x)\n", e->time & (cycle_time - 1),
-            cycle_time);*/
-
-    /*      if(e->noacks > 0) {
-            printf("additional wait %d\n", additional_wait);
-            }*/
-    
-    now = RTIMER_NOW();
-
-    sync = (e == NULL) ? now : e->time;
-
-#if PHASE_DRIFT_CORRECT
-    {
-      int32_t s;
-      if(e->drift > cycle_time) {
-        s = e->drift % cycle_time / (e->drift / cycle_time);  /* drift per cycle */
-        s = s * (now - sync) / cycle_time;                    /* estimated drift to now */
-        sync += s;                                            /* add it in */
-      }
-    }
-#endif
-
-    /* Check if cycle_time is a power of two */
-    if(!(cycle_time & (cycle_time - 1))) {
-      /* Faster if cycle_time is a power of two */
-      wait = (rtimer_clock_t)((sync - now) & (cycle_time - 1));
-    } else {
-      /* Works generally */
-      wait = cycle_time - (rtimer_clock_t)((now - sync) % cycle_time);
-    }
-
+  now = RTIMER_NOW();
+  if(phase_predict(neighbor, cycle_time, now, clock_time(), &wait, &margin)) {
+    /* Start early enough for the drift that may have moved the phase
+       since we last saw it */
+    guard_time += margin;
     if(wait < guard_time) {
       wait += cycle_time;
     }
@@ -244,6 +417,53 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
 }
 /*---------------------------------------------------------------------------*/
 void
+phase_remove(const linkaddr_t *neighbor)
+{
+  struct phase *e;
+
+  e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
+  if(e != NULL) {
+    nbr_table_remove(nbr_phase, e);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+phase_set_rate_shift(const linkaddr_t *neighbor, uint8_t rate_shift)
+{
+  struct phase *e;
+
+  /* Only kept along with a phase: without one, we strobe for a full
+     cycle anyway */
+  e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
+  if(e != NULL) {
+    e->rate_shift = rate_shift;
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+phase_rate_shift(const linkaddr_t *neighbor)
+{
+  struct phase *e;
+
+  e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
+  return e != NULL ? e->rate_shift : 0;
+}
+/*---------------------------------------------------------------------------*/
+#if PHASE_STATS
+void
+phase_stats(struct phase_stats *s)
+{
+  *s = stats;
+}
+/*---------------------------------------------------------------------------*/
+void
+phase_stats_reset(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+#endif /* PHASE_STATS */
+/*---------------------------------------------------------------------------*/
+void
 phase_init(void)
 {
   memb_init(&queued_packets_memb);
@@ -47,6 +47,18 @@
 #include "lib/memb.h"
 #include "net/netstack.h"
 
+#ifdef PHASE_CONF_DRIFT_CORRECT
+#define PHASE_DRIFT_CORRECT PHASE_CONF_DRIFT_CORRECT
+#else /* PHASE_CONF_DRIFT_CORRECT */
+#define PHASE_DRIFT_CORRECT 0
+#endif /* PHASE_CONF_DRIFT_CORRECT */
+
+#ifdef PHASE_CONF_STATS
+#define PHASE_STATS PHASE_CONF_STATS
+#else /* PHASE_CONF_STATS */
+#define PHASE_STATS 0
+#endif /* PHASE_CONF_STATS */
+
 typedef enum {
   PHASE_UNKNOWN,
   PHASE_SEND_NOW,
@@ -62,5 +74,46 @@ phase_status_t phase_wait(const linkaddr_t *neighbor,
 void phase_update(const linkaddr_t *neighbor,
                   rtimer_clock_t time, int mac_status);
 void phase_remove(const linkaddr_t *neighbor);
+void phase_set_rate_shift(const linkaddr_t *neighbor, uint8_t rate_shift);
+uint8_t phase_rate_shift(const linkaddr_t *neighbor);
+rtimer_clock_t phase_margin(const linkaddr_t *neighbor);
+
+/*
+ * With PHASE_DRIFT_CORRECT, the drift of the phase of each neighbor is
+ * measured between encounters at least PHASE_CONF_DRIFT_MIN_SPAN apart,
+ * and wake-ups are predicted with it. Transmissions then start earlier
+ * by a margin that grows with the time since the last encounter and the
+ * uncertainty of the drift, and a phase that is too uncertain is given
+ * up. phase_margin() tells how much earlier, for the caller to look for
+ * the wake-up that much longer too.
+ *
+ * phase_update() and phase_wait() use the current time. phase_observe()
+ * and phase_predict() take it as arguments, for replays of recorded
+ * encounters: phase_predict() returns 0 if the phase of the neighbor is
+ * unknown or too uncertain, and otherwise sets the time to the next
+ * wake-up and the margin.
+ */
+void phase_observe(const linkaddr_t *neighbor, rtimer_clock_t time,
+                   clock_time_t clock, int mac_status);
+int phase_predict(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
+                  rtimer_clock_t now, clock_time_t clock,
+                  rtimer_clock_t *wait, rtimer_clock_t *margin);
+
+#if PHASE_STATS
+struct phase_stats {
+  unsigned long predictions;  /**< Wake-ups predicted */
+  unsigned long uncertain;    /**< Phases given up as too uncertain */
+  unsigned long hits;         /**< Predicted wake-ups met */
+  unsigned long misses;       /**< Predicted wake-ups missed */
+  unsigned long corrected;    /**< Predictions moved by the drift */
+  unsigned long correction;   /**< Total drift correction, in rtimer ticks:
+                                   divided by the strobe period, the strobes
+                                   saved or misses avoided */
+  unsigned long margin;       /**< Total early start margin, in rtimer ticks */
+};
+
+void phase_stats(struct phase_stats *stats);
+void phase_stats_reset(void);
+#endif /* PHASE_STATS */
 
 #endif /* PHASE_H */
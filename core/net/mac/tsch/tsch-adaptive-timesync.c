@@ -39,85 +39,216 @@
  */
 
 #include "tsch-adaptive-timesync.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-queue.h"
 #include "tsch-log.h"
 #include <stdio.h>
+#include <string.h>
 
 #if TSCH_ADAPTIVE_TIMESYNC
 
-/* Estimated drift of the time-source neighbor. Can be negative.
+/* Drift estimate of a neighbor */
+struct timesync_neighbor {
+  linkaddr_t addr;
+  /* Start of the current measurement: its ASN, and the correction
+   * observed then plus the ticks applied to our clock until then */
+  struct asn_t anchor_asn;
+  uint32_t anchor;
+  /* Last drift learned */
+  struct asn_t sample_asn;
+  /* Estimated drift, and the measurement time behind it in seconds */
+  int32_t drift_ppm;
+  uint16_t span;
+  uint8_t in_use;
+  uint8_t is_anchored;
+};
+static struct timesync_neighbor neighbors[TSCH_ADAPTIVE_TIMESYNC_NEIGHBORS];
+
+/* Estimated drift, fused from the neighbors. Can be negative.
  * Units used: ppm multiplied by 256. */
 static int32_t drift_ppm;
-/* Ticks compensated locally since the last timesync time */
-static int32_t compensated_ticks;
-/* Number of already recorded timesync history entries */
-static uint8_t timesync_entry_count;
-/* Since last learning of the  drift; may be more than time since last timesync */
-static uint32_t asn_since_last_learning;
+/* Ticks applied to our clock: corrections from the time source and
+ * compensation of the drift. Only differences are meaningful. */
+static uint32_t adjusted_ticks;
 
 /* Units in which drift is stored: ppm * 256 */
 #define TSCH_DRIFT_UNIT (1000L * 1000 * 256)
 
+/* A drift beyond that is rather a measurement gone wrong */
+#define MAX_DRIFT_PPM (100L * 256)
+
 /*---------------------------------------------------------------------------*/
-/* Add a value to a moving average estimator */
-static int32_t
-timesync_entry_add(int32_t val, uint32_t time_delta)
+static int
+is_time_source(const struct timesync_neighbor *e)
 {
-#define NUM_TIMESYNC_ENTRIES 8
-  static int32_t buffer[NUM_TIMESYNC_ENTRIES];
-  static uint8_t pos;
-  int i;
-  if(timesync_entry_count == 0) {
-    pos = 0;
-  }
-  buffer[pos] = val;
-  if(timesync_entry_count < NUM_TIMESYNC_ENTRIES) {
-    timesync_entry_count++;
+  return last_timesource_neighbor != NULL
+    && linkaddr_cmp(&e->addr, &last_timesource_neighbor->addr);
+}
+/*---------------------------------------------------------------------------*/
+/* How much the estimate of a neighbor counts: the longer measured, the more,
+ * and the longer ago, the less */
+static uint32_t
+timesync_weight(const struct timesync_neighbor *e)
+{
+  uint32_t age = ASN_DIFF(current_asn, e->sample_asn) / TSCH_SLOTS_PER_SECOND;
+  uint32_t weight = (uint32_t)e->span * TSCH_ADAPTIVE_TIMESYNC_HALF_AGE
+    / (TSCH_ADAPTIVE_TIMESYNC_HALF_AGE + age);
+
+  /* Its clock is the one we follow */
+  if(is_time_source(e)) {
+    weight *= 2;
   }
-  pos = (pos + 1) % NUM_TIMESYNC_ENTRIES;
+  return weight;
+}
+/*---------------------------------------------------------------------------*/
+/* Get the entry of a neighbor, or make room for it */
+static struct timesync_neighbor *
+timesync_neighbor_get(const linkaddr_t *addr)
+{
+  struct timesync_neighbor *e, *replace = NULL;
+  uint32_t weight, replace_weight = 0;
 
-  val = 0;
-  for(i = 0; i < timesync_entry_count; ++i) {
-    val += buffer[i];
+  for(e = neighbors; e < neighbors + TSCH_ADAPTIVE_TIMESYNC_NEIGHBORS; e++) {
+    if(e->in_use && linkaddr_cmp(&e->addr, addr)) {
+      return e;
+    }
   }
-  return val / timesync_entry_count;
+  /* Replace a free entry, or else the one that counts the least, but
+   * never the time source */
+  for(e = neighbors; e < neighbors + TSCH_ADAPTIVE_TIMESYNC_NEIGHBORS; e++) {
+    if(!e->in_use) {
+      replace = e;
+      break;
+    }
+    if(!is_time_source(e)) {
+      weight = timesync_weight(e);
+      if(replace == NULL || weight < replace_weight) {
+        replace = e;
+        replace_weight = weight;
+      }
+    }
+  }
+  if(replace != NULL) {
+    memset(replace, 0, sizeof(*replace));
+    linkaddr_copy(&replace->addr, addr);
+    replace->in_use = 1;
+  }
+  return replace;
 }
 /*---------------------------------------------------------------------------*/
-/* Learn the neighbor drift rate at ppm */
+/* Fuse the estimates of the neighbors into the drift we compensate for */
 static void
-timesync_learn_drift_ticks(uint32_t time_delta_asn, int32_t drift_ticks)
+timesync_fuse(void)
+{
+  struct timesync_neighbor *e;
+  int64_t sum = 0;
+  uint32_t weight, total = 0;
+
+  for(e = neighbors; e < neighbors + TSCH_ADAPTIVE_TIMESYNC_NEIGHBORS; e++) {
+    if(e->in_use && e->span > 0) {
+      weight = timesync_weight(e);
+      sum += (int64_t)e->drift_ppm * weight;
+      total += weight;
+    }
+  }
+  if(total > 0) {
+    drift_ppm = (int32_t)(sum / total);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Learn the drift of a neighbor from the correction that would synchronize
+ * to it now. Returns 1 if the estimate changed. */
+static int
+timesync_learn(struct timesync_neighbor *e, int32_t drift_correction)
 {
-  /* should fit in 32-bit unsigned integer */
-  uint32_t time_delta_ticks = time_delta_asn * tsch_timing[tsch_ts_timeslot_length];
-  int32_t real_drift_ticks = drift_ticks + compensated_ticks;
-  int32_t last_drift_ppm = (int32_t)((int64_t)real_drift_ticks * TSCH_DRIFT_UNIT / time_delta_ticks);
+  uint32_t time_delta_asn;
+  uint32_t time_delta_ticks;
+  int32_t real_drift_ticks;
+  int32_t last_drift_ppm;
+  uint16_t span;
+  int learned = 0;
 
-  drift_ppm = timesync_entry_add(last_drift_ppm, time_delta_ticks);
+  if(e->is_anchored) {
+    time_delta_asn = ASN_DIFF(current_asn, e->anchor_asn);
+    if(time_delta_asn < 4 * TSCH_SLOTS_PER_SECOND) {
+      /* Too small timedelta, do not recalculate the drift to avoid
+       * introducing error. Keep measuring from the same anchor instead. */
+      return 0;
+    }
+    if(time_delta_asn <= 0xffffffff / tsch_timing[tsch_ts_timeslot_length]) {
+      time_delta_ticks = time_delta_asn * tsch_timing[tsch_ts_timeslot_length];
+      /* The neighbor drifted away by the correction it needs now, and by
+       * what we applied to our clock meanwhile */
+      real_drift_ticks = (int32_t)(drift_correction + adjusted_ticks - e->anchor);
+      last_drift_ppm = (int32_t)((int64_t)real_drift_ticks * TSCH_DRIFT_UNIT / time_delta_ticks);
+      if(ABS(last_drift_ppm) <= MAX_DRIFT_PPM) {
+        /* Average over the last TSCH_ADAPTIVE_TIMESYNC_MAX_SPAN seconds */
+        span = MIN(time_delta_asn / TSCH_SLOTS_PER_SECOND, TSCH_ADAPTIVE_TIMESYNC_MAX_SPAN);
+        e->drift_ppm = (int32_t)(((int64_t)e->drift_ppm * e->span + (int64_t)last_drift_ppm * span)
+            / (e->span + span));
+        e->span = MIN(e->span + span, TSCH_ADAPTIVE_TIMESYNC_MAX_SPAN);
+        e->sample_asn = current_asn;
+        learned = 1;
+      } else {
+        TSCH_LOG_ADD(tsch_log_message,
+            snprintf(log->message, sizeof(log->message),
+                "!drift %ld from %u", (long)last_drift_ppm / 256, TSCH_LOG_ID_FROM_LINKADDR(&e->addr)));
+      }
+    }
+  }
+  e->anchor_asn = current_asn;
+  e->anchor = drift_correction + adjusted_ticks;
+  e->is_anchored = 1;
+  return learned;
 }
 /*---------------------------------------------------------------------------*/
-/* Either reset or update the neighbor's drift */
+/* Learn the drift from the time source, whose correction we apply */
 void
 tsch_timesync_update(struct tsch_neighbor *n, uint16_t time_delta_asn, int32_t drift_correction)
 {
-  /* Account the drift if either this is a new timesource,
-   * or the timedelta is not too small, as smaller timedelta
-   * means proportionally larger measurement error. */
-  if(last_timesource_neighbor != n) {
-    last_timesource_neighbor = n;
-    drift_ppm = 0;
-    timesync_entry_count = 0;
-    compensated_ticks = 0;
-    asn_since_last_learning = 0;
-  } else {
-    asn_since_last_learning += time_delta_asn;
-    if(asn_since_last_learning >= 4 * TSCH_SLOTS_PER_SECOND) {
-      timesync_learn_drift_ticks(asn_since_last_learning, drift_correction);
-      compensated_ticks = 0;
-      asn_since_last_learning = 0;
-    } else {
-      /* Too small timedelta, do not recalculate the drift to avoid introducing error. instead account for the corrected ticks */
-      compensated_ticks += drift_correction;
+  struct timesync_neighbor *e;
+
+  if(last_timesource_neighbor == NULL) {
+    /* We (re)joined, and our clock and ASN were set anew: the measurements
+     * start over, but the drift estimates of our clock stay valid */
+    for(e = neighbors; e < neighbors + TSCH_ADAPTIVE_TIMESYNC_NEIGHBORS; e++) {
+      e->is_anchored = 0;
+      e->sample_asn = current_asn;
     }
   }
+  /* A new time source takes over the drift learned so far, from it and
+   * from the other neighbors */
+  last_timesource_neighbor = n;
+
+  e = timesync_neighbor_get(&n->addr);
+  if(e != NULL && timesync_learn(e, drift_correction)) {
+    timesync_fuse();
+  }
+  adjusted_ticks += drift_correction;
+}
+/*---------------------------------------------------------------------------*/
+/* Learn the drift from a neighbor that is not the time source */
+void
+tsch_timesync_observe(const linkaddr_t *addr, int32_t drift_correction)
+{
+  struct timesync_neighbor *e;
+
+  /* Not synchronized, or the time source, learned from in tsch_timesync_update */
+  if(last_timesource_neighbor == NULL
+     || linkaddr_cmp(addr, &last_timesource_neighbor->addr)) {
+    return;
+  }
+
+  e = timesync_neighbor_get(addr);
+  if(e != NULL && timesync_learn(e, drift_correction)) {
+    timesync_fuse();
+  }
+}
+/*---------------------------------------------------------------------------*/
+int32_t
+tsch_timesync_drift(void)
+{
+  return drift_ppm;
 }
 /*---------------------------------------------------------------------------*/
 /* Error-accumulation free compensation algorithm */
@@ -157,7 +288,7 @@ tsch_timesync_adaptive_compensate(rtimer_clock_t time_delta_ticks)
     static int16_t tick_conversion_error;
     result = compensate_internal(time_delta_usec, drift_ppm,
         &remainder, &tick_conversion_error);
-    compensated_ticks += result;
+    adjusted_ticks += result;
   }
 
   if(TSCH_BASE_DRIFT_PPM) {
@@ -177,6 +308,17 @@ tsch_timesync_update(struct tsch_neighbor *n, uint16_t time_delta_asn, int32_t d
 {
 }
 /*---------------------------------------------------------------------------*/
+void
+tsch_timesync_observe(const linkaddr_t *addr, int32_t drift_correction)
+{
+}
+/*---------------------------------------------------------------------------*/
+int32_t
+tsch_timesync_drift(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 int32_t
 tsch_timesync_adaptive_compensate(rtimer_clock_t delta_ticks)
 {
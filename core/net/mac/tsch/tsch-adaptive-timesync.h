@@ -72,6 +72,30 @@
 #define TSCH_BASE_DRIFT_PPM 0
 #endif
 
+/* Number of neighbors whose drift is estimated at once. Besides the time
+ * source, the estimates of other neighbors heard from are fused into the
+ * drift we compensate for, and they keep it when the time source changes. */
+#ifdef TSCH_CONF_ADAPTIVE_TIMESYNC_NEIGHBORS
+#define TSCH_ADAPTIVE_TIMESYNC_NEIGHBORS TSCH_CONF_ADAPTIVE_TIMESYNC_NEIGHBORS
+#else
+#define TSCH_ADAPTIVE_TIMESYNC_NEIGHBORS 4
+#endif
+
+/* Measurement time, in seconds, over which the drift of a neighbor is averaged */
+#ifdef TSCH_CONF_ADAPTIVE_TIMESYNC_MAX_SPAN
+#define TSCH_ADAPTIVE_TIMESYNC_MAX_SPAN TSCH_CONF_ADAPTIVE_TIMESYNC_MAX_SPAN
+#else
+#define TSCH_ADAPTIVE_TIMESYNC_MAX_SPAN 128
+#endif
+
+/* Time, in seconds, after which the estimate of a neighbor not heard from
+ * weighs half as much in the fusion */
+#ifdef TSCH_CONF_ADAPTIVE_TIMESYNC_HALF_AGE
+#define TSCH_ADAPTIVE_TIMESYNC_HALF_AGE TSCH_CONF_ADAPTIVE_TIMESYNC_HALF_AGE
+#else
+#define TSCH_ADAPTIVE_TIMESYNC_HALF_AGE 600
+#endif
+
 /* The approximate number of slots per second */
 #define TSCH_SLOTS_PER_SECOND (1000000 / TSCH_DEFAULT_TS_TIMESLOT_LENGTH)
 
@@ -82,7 +106,13 @@ extern struct tsch_neighbor *last_timesource_neighbor;
 
 /********** Functions *********/
 
+/* Synchronize to the time source n: drift_correction is applied to our clock */
 void tsch_timesync_update(struct tsch_neighbor *n, uint16_t time_delta_asn, int32_t drift_correction);
+/* Learn from another neighbor: drift_correction would synchronize to it,
+ * but is not applied */
+void tsch_timesync_observe(const linkaddr_t *addr, int32_t drift_correction);
+/* The drift we compensate for, in ppm multiplied by 256 */
+int32_t tsch_timesync_drift(void);
 
 int32_t tsch_timesync_adaptive_compensate(rtimer_clock_t delta_ticks);
 
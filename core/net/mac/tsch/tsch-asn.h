@@ -81,6 +81,10 @@ struct asn_divisor_t {
 #define ASN_DIFF(asn1, asn2) \
   ((asn1).ls4b - (asn2).ls4b)
 
+/* Are asn1 and asn2 equal? */
+#define ASN_EQ(asn1, asn2) \
+  ((asn1).ls4b == (asn2).ls4b && (asn1).ms1b == (asn2).ms1b)
+
 /* Initialize a struct asn_divisor_t */
 #define ASN_DIVISOR_INIT(div, val_) do { \
     (div).val = (val_); \
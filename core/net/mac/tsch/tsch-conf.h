@@ -175,6 +175,23 @@
 #define TSCH_ADAPTIVE_TIMESYNC 0
 #endif
 
+/* Build the frame of the next slot (Sync-IE update, security) at the end
+ * of the current one, instead of at the start of the next slot */
+#ifdef TSCH_CONF_PREPARE_AHEAD
+#define TSCH_PREPARE_AHEAD TSCH_CONF_PREPARE_AHEAD
+#else /* TSCH_CONF_PREPARE_AHEAD */
+#define TSCH_PREPARE_AHEAD 0
+#endif /* TSCH_CONF_PREPARE_AHEAD */
+
+/* With TSCH_PREPARE_AHEAD, also copy the frame to the radio buffer ahead of
+ * its slot. Only for radio drivers that keep the prepared frame while
+ * receiving and while off. */
+#ifdef TSCH_CONF_PRELOAD_RADIO
+#define TSCH_PRELOAD_RADIO TSCH_CONF_PRELOAD_RADIO
+#else /* TSCH_CONF_PRELOAD_RADIO */
+#define TSCH_PRELOAD_RADIO 0
+#endif /* TSCH_CONF_PRELOAD_RADIO */
+
 /* HW frame filtering enabled */
 #ifdef TSCH_CONF_HW_FRAME_FILTERING
 #define TSCH_HW_FRAME_FILTERING TSCH_CONF_HW_FRAME_FILTERING
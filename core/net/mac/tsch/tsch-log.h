@@ -89,6 +89,7 @@ struct tsch_log_t {
       int mac_tx_status;
       int dest;
       int drift;
+      uint16_t selection_time; /* rtimer ticks taken to select the packet */
       uint8_t num_tx;
       uint8_t datalen;
       uint8_t is_data;
@@ -77,6 +77,80 @@ LIST(neighbor_list);
 struct tsch_neighbor *n_broadcast;
 struct tsch_neighbor *n_eb;
 
+/* Neighbors without Tx links, with a packet and an expired backoff, that
+ * is, that may send over a shared link. Kept in the order they became
+ * ready, and only changed from the slot operation or under the lock.
+ * Neighbors that are no longer ready are taken out at lookup. */
+static struct tsch_neighbor *ready_head;
+static struct tsch_neighbor *ready_tail;
+/* Neighbors that got a packet outside of the slot operation, for the slot
+ * operation to add to the ready list. Same lockfree implementation as the
+ * neighbor queues. Neighbors that do not fit are added at the next backoff
+ * update. Its size must be a power of two. */
+#define PENDING_READY_NUM 8
+static struct tsch_neighbor *pending_ready_array[PENDING_READY_NUM];
+static struct ringbufindex pending_ready_ringbuf;
+
+/*---------------------------------------------------------------------------*/
+/* May packets to the neighbor go out on links to the broadcast address?
+ * Only if we have no Tx link to it, not counting extra links, which add to
+ * the shared links instead of replacing them. */
+static int
+nbr_uses_broadcast_links(const struct tsch_neighbor *n)
+{
+  return !n->is_broadcast && n->tx_links_count == n->extra_tx_links_count;
+}
+/*---------------------------------------------------------------------------*/
+/* May the neighbor send over a shared link to any neighbor? */
+static int
+nbr_is_ready(const struct tsch_neighbor *n)
+{
+  return nbr_uses_broadcast_links(n)
+    && n->backoff_window == 0 && !ringbufindex_empty(&n->tx_ringbuf);
+}
+/*---------------------------------------------------------------------------*/
+/* Add a neighbor to the ready list if it is ready and not there yet */
+static void
+ready_add(struct tsch_neighbor *n)
+{
+  if(!n->is_ready && nbr_is_ready(n)) {
+    n->is_ready = 1;
+    n->next_ready = NULL;
+    if(ready_tail == NULL) {
+      ready_head = n;
+    } else {
+      ready_tail->next_ready = n;
+    }
+    ready_tail = n;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Remove a neighbor from the ready list, given the one before it */
+static void
+ready_remove(struct tsch_neighbor *prev, struct tsch_neighbor *n)
+{
+  if(prev == NULL) {
+    ready_head = n->next_ready;
+  } else {
+    prev->next_ready = n->next_ready;
+  }
+  if(ready_tail == n) {
+    ready_tail = prev;
+  }
+  n->is_ready = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Add the neighbors that got a packet to the ready list */
+static void
+ready_add_pending(void)
+{
+  int16_t get_index;
+  while((get_index = ringbufindex_peek_get(&pending_ready_ringbuf)) != -1) {
+    ready_add(pending_ready_array[get_index]);
+    ringbufindex_get(&pending_ready_ringbuf);
+  }
+}
+
 /*---------------------------------------------------------------------------*/
 /* Add a TSCH neighbor */
 struct tsch_neighbor *
@@ -208,6 +282,19 @@ tsch_queue_remove_nbr(struct tsch_neighbor *n)
       /* Remove neighbor from list */
       list_remove(neighbor_list, n);
 
+      /* Remove neighbor from the ready list, after the pending ones were
+       * added, so that no reference to it is left */
+      ready_add_pending();
+      if(n->is_ready) {
+        struct tsch_neighbor *prev = NULL;
+        struct tsch_neighbor *curr = ready_head;
+        while(curr != n) {
+          prev = curr;
+          curr = curr->next_ready;
+        }
+        ready_remove(prev, n);
+      }
+
       tsch_release_lock();
 
       /* Flush queue */
@@ -246,6 +333,14 @@ tsch_queue_add_packet(const linkaddr_t *addr, mac_callback_t sent, void *ptr)
             /* Add to ringbuf (actual add committed through atomic operation) */
             n->tx_array[put_index] = p;
             ringbufindex_put(&n->tx_ringbuf);
+            /* Let the slot operation add the neighbor to the ready list */
+            if(!n->is_broadcast && !n->is_ready) {
+              put_index = ringbufindex_peek_put(&pending_ready_ringbuf);
+              if(put_index != -1) {
+                pending_ready_array[put_index] = n;
+                ringbufindex_put(&pending_ready_ringbuf);
+              }
+            }
             return p;
           } else {
             memb_free(&packet_memb, p);
@@ -278,9 +373,11 @@ tsch_queue_remove_packet_from_queue(struct tsch_neighbor *n)
 {
   if(!tsch_is_locked()) {
     if(n != NULL) {
-      /* Get and remove packet from ringbuf (remove committed through an atomic operation */
-      int16_t get_index = ringbufindex_get(&n->tx_ringbuf);
+      /* Get and remove packet from ringbuf (remove committed through an atomic operation.
+       * ringbufindex_get() returns the index before the packet, so peek first. */
+      int16_t get_index = ringbufindex_peek_get(&n->tx_ringbuf);
       if(get_index != -1) {
+        ringbufindex_get(&n->tx_ringbuf);
         return n->tx_array[get_index];
       } else {
         return NULL;
@@ -359,10 +456,13 @@ tsch_queue_get_packet_for_nbr(const struct tsch_neighbor *n, struct tsch_link *l
 #if TSCH_WITH_LINK_SELECTOR
         int packet_attr_slotframe = queuebuf_attr(n->tx_array[get_index]->qb, PACKETBUF_ATTR_TSCH_SLOTFRAME);
         int packet_attr_timeslot = queuebuf_attr(n->tx_array[get_index]->qb, PACKETBUF_ATTR_TSCH_TIMESLOT);
-        if(packet_attr_slotframe != 0xffff && packet_attr_slotframe != link->slotframe_handle) {
+        /* An extra link to this very neighbor may carry any of its packets */
+        int is_extra_link = link != NULL && (link->link_options & LINK_OPTION_EXTRA_TX)
+          && !n->is_broadcast && linkaddr_cmp(&link->addr, &n->addr);
+        if(!is_extra_link && packet_attr_slotframe != 0xffff && packet_attr_slotframe != link->slotframe_handle) {
           return NULL;
         }
-        if(packet_attr_timeslot != 0xffff && packet_attr_timeslot != link->timeslot) {
+        if(!is_extra_link && packet_attr_timeslot != 0xffff && packet_attr_timeslot != link->timeslot) {
           return NULL;
         }
 #endif
@@ -389,11 +489,35 @@ struct tsch_packet *
 tsch_queue_get_unicast_packet_for_any(struct tsch_neighbor **n, struct tsch_link *link)
 {
   if(!tsch_is_locked()) {
-    struct tsch_neighbor *curr_nbr = list_head(neighbor_list);
+    struct tsch_neighbor *curr_nbr;
     struct tsch_packet *p = NULL;
+    if(link != NULL && link->link_options & LINK_OPTION_SHARED) {
+      /* On shared links, only neighbors of the ready list may send */
+      struct tsch_neighbor *prev_nbr = NULL;
+      ready_add_pending();
+      curr_nbr = ready_head;
+      while(curr_nbr != NULL) {
+        struct tsch_neighbor *next_nbr = curr_nbr->next_ready;
+        if(!nbr_is_ready(curr_nbr)) {
+          ready_remove(prev_nbr, curr_nbr);
+        } else {
+          p = tsch_queue_get_packet_for_nbr(curr_nbr, link);
+          if(p != NULL) {
+            if(n != NULL) {
+              *n = curr_nbr;
+            }
+            return p;
+          }
+          prev_nbr = curr_nbr;
+        }
+        curr_nbr = next_nbr;
+      }
+      return NULL;
+    }
+    /* On other links, backoff does not apply: look at all neighbors */
+    curr_nbr = list_head(neighbor_list);
     while(curr_nbr != NULL) {
-      if(!curr_nbr->is_broadcast && curr_nbr->tx_links_count == 0) {
-        /* Only look up for non-broadcast neighbors we do not have a tx link to */
+      if(nbr_uses_broadcast_links(curr_nbr)) {
         p = tsch_queue_get_packet_for_nbr(curr_nbr, link);
         if(p != NULL) {
           if(n != NULL) {
@@ -447,10 +571,13 @@ tsch_queue_update_all_backoff_windows(const linkaddr_t *dest_addr)
     struct tsch_neighbor *n = list_head(neighbor_list);
     while(n != NULL) {
       if(n->backoff_window != 0 /* Is the queue in backoff state? */
-         && ((n->tx_links_count == 0 && is_broadcast)
+         && ((is_broadcast && nbr_uses_broadcast_links(n))
              || (n->tx_links_count > 0 && linkaddr_cmp(dest_addr, &n->addr)))) {
         n->backoff_window--;
       }
+      /* Add the neighbor to the ready list if its backoff expired, or if
+       * it became ready in any other way */
+      ready_add(n);
       n = list_item_next(n);
     }
   }
@@ -463,6 +590,8 @@ tsch_queue_init(void)
   list_init(neighbor_list);
   memb_init(&neighbor_memb);
   memb_init(&packet_memb);
+  ready_head = ready_tail = NULL;
+  ringbufindex_init(&pending_ready_ringbuf, PENDING_READY_NUM);
   /* Add virtual EB and the broadcast neighbors */
   n_eb = tsch_queue_add_nbr(&tsch_eb_address);
   n_broadcast = tsch_queue_add_nbr(&tsch_broadcast_address);
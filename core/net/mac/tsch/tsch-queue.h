@@ -134,6 +134,9 @@ struct tsch_neighbor {
   uint8_t last_backoff_window; /* Last CSMA backoff window */
   uint8_t tx_links_count; /* How many links do we have to this neighbor? */
   uint8_t dedicated_tx_links_count; /* How many dedicated links do we have to this neighbor? */
+  uint8_t extra_tx_links_count; /* How many of the tx links are extra links (LINK_OPTION_EXTRA_TX)? */
+  uint8_t is_ready; /* is this neighbor in the list of neighbors ready to send over shared links? */
+  struct tsch_neighbor *next_ready; /* Next neighbor in the list of ready neighbors */
   /* Array for the ringbuf. Contains pointers to packets.
    * Its size must be a power of two to allow for atomic put */
   struct tsch_packet *tx_array[TSCH_QUEUE_NUM_PER_NEIGHBOR];
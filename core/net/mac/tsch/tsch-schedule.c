@@ -68,6 +68,55 @@ MEMB(link_memb, struct tsch_link, TSCH_SCHEDULE_MAX_LINKS);
 MEMB(slotframe_memb, struct tsch_slotframe, TSCH_SCHEDULE_MAX_SLOTFRAMES);
 /* List of slotframes (each slotframe holds its own list of links) */
 LIST(slotframe_list);
+/* Links of all slotframes, in the order of slotframe_list and then of
+ * timeslot, for a binary search of the next link of each slotframe.
+ * Updated under the lock whenever links or slotframes change. */
+static struct tsch_link *link_index[TSCH_SCHEDULE_MAX_LINKS];
+
+/*---------------------------------------------------------------------------*/
+/* Rebuilds the link index from the slotframe and link lists */
+static void
+update_link_index(void)
+{
+  struct tsch_slotframe *sf;
+  struct tsch_link *l;
+  uint16_t i = 0;
+
+  for(sf = list_head(slotframe_list); sf != NULL; sf = list_item_next(sf)) {
+    sf->first_link = i;
+    for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+      link_index[i++] = l;
+    }
+    sf->links_count = i - sf->first_link;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Looks within a slotframe for the first link after a given timeslot,
+ * wrapping around to the first link of the slotframe */
+static struct tsch_link *
+get_next_link_in_slotframe(struct tsch_slotframe *sf, uint16_t timeslot)
+{
+  uint16_t low, high, mid;
+
+  if(sf->links_count == 0) {
+    return NULL;
+  }
+  low = sf->first_link;
+  high = sf->first_link + sf->links_count;
+  while(low < high) {
+    mid = low + (high - low) / 2;
+    if(link_index[mid]->timeslot > timeslot) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+  if(low == sf->first_link + sf->links_count) {
+    low = sf->first_link;
+  }
+  return link_index[low];
+}
+/*---------------------------------------------------------------------------*/
 
 /* Adds and returns a slotframe (NULL if failure) */
 struct tsch_slotframe *
@@ -91,6 +140,7 @@ tsch_schedule_add_slotframe(uint16_t handle, uint16_t size)
       LIST_STRUCT_INIT(sf, links_list);
       /* Add the slotframe to the global list */
       list_add(slotframe_list, sf);
+      update_link_index();
     }
     PRINTF("TSCH-schedule: add_slotframe %u %u\n",
            handle, size);
@@ -129,6 +179,7 @@ tsch_schedule_remove_slotframe(struct tsch_slotframe *slotframe)
       PRINTF("TSCH-schedule: remove slotframe %u %u\n", slotframe->handle, slotframe->size.val);
       memb_free(&slotframe_memb, slotframe);
       list_remove(slotframe_list, slotframe);
+      update_link_index();
       tsch_release_lock();
       return 1;
     }
@@ -195,8 +246,14 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
       } else {
         static int current_link_handle = 0;
         struct tsch_neighbor *n;
-        /* Add the link to the slotframe */
-        list_add(slotframe->links_list, l);
+        struct tsch_link *prev = NULL;
+        struct tsch_link *next = list_head(slotframe->links_list);
+        /* Add the link to the slotframe, keeping the list sorted by timeslot */
+        while(next != NULL && next->timeslot < timeslot) {
+          prev = next;
+          next = list_item_next(next);
+        }
+        list_insert(slotframe->links_list, prev, l);
         /* Initialize link */
         l->handle = current_link_handle++;
         l->link_options = link_options;
@@ -209,6 +266,7 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
           address = &linkaddr_null;
         }
         linkaddr_copy(&l->addr, address);
+        update_link_index();
 
         PRINTF("TSCH-schedule: add_link %u %u %u %u %u %u\n",
                slotframe->handle, link_options, link_type, timeslot, channel_offset, TSCH_LOG_ID_FROM_LINKADDR(address));
@@ -224,6 +282,9 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
             if(!(l->link_options & LINK_OPTION_SHARED)) {
               n->dedicated_tx_links_count++;
             }
+            if(l->link_options & LINK_OPTION_EXTRA_TX) {
+              n->extra_tx_links_count++;
+            }
           }
         }
       }
@@ -257,6 +318,7 @@ tsch_schedule_remove_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
 
       list_remove(slotframe->links_list, l);
       memb_free(&link_memb, l);
+      update_link_index();
 
       /* Release the lock before we update the neighbor (will take the lock) */
       tsch_release_lock();
@@ -269,6 +331,9 @@ tsch_schedule_remove_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
           if(!(link_options & LINK_OPTION_SHARED)) {
             n->dedicated_tx_links_count--;
           }
+          if(link_options & LINK_OPTION_EXTRA_TX) {
+            n->extra_tx_links_count--;
+          }
         }
       }
 
@@ -321,12 +386,14 @@ tsch_schedule_get_next_active_link(struct asn_t *asn, uint16_t *time_offset,
   must have Rx flag set. */
   if(!tsch_is_locked()) {
     struct tsch_slotframe *sf = list_head(slotframe_list);
-    /* For each slotframe, look for the earliest occurring link */
+    /* For each slotframe, look for the earliest occurring link. Links of
+     * a slotframe have distinct timeslots, so only the earliest one can
+     * tie with the links of other slotframes. */
     while(sf != NULL) {
       /* Get timeslot from ASN, given the slotframe length */
       uint16_t timeslot = ASN_MOD(*asn, sf->size);
-      struct tsch_link *l = list_head(sf->links_list);
-      while(l != NULL) {
+      struct tsch_link *l = get_next_link_in_slotframe(sf, timeslot);
+      if(l != NULL) {
         uint16_t time_to_timeslot =
           l->timeslot > timeslot ?
           l->timeslot - timeslot :
@@ -368,8 +435,6 @@ tsch_schedule_get_next_active_link(struct asn_t *asn, uint16_t *time_offset,
             curr_best = new_best;
           }
         }
-
-        l = list_item_next(l);
       }
       sf = list_item_next(sf);
     }
@@ -79,6 +79,11 @@
 #define LINK_OPTION_RX              2
 #define LINK_OPTION_SHARED          4
 #define LINK_OPTION_TIME_KEEPING    8
+/* Not an IEEE 802.15.4 link option, only used locally: a Tx link to a
+ * neighbor that adds to the links its packets were selected for. It
+ * carries any packet to the neighbor, and does not keep the neighbor
+ * from using links to the broadcast address. */
+#define LINK_OPTION_EXTRA_TX        0x80
 
 /************ Types ***********/
 
@@ -120,8 +125,12 @@ struct tsch_slotframe {
   /* Number of timeslots in the slotframe.
    * Stored as struct asn_divisor_t because we often need ASN%size */
   struct asn_divisor_t size;
-  /* List of links belonging to this slotframe */
+  /* List of links belonging to this slotframe, sorted by timeslot */
   LIST_STRUCT(links_list);
+  /* Position and number of the links of this slotframe in the link
+   * index, which holds the links of all slotframes sorted by timeslot */
+  uint16_t first_link;
+  uint16_t links_count;
 };
 
 /********** Functions *********/
@@ -150,6 +150,24 @@ struct tsch_link *current_link = NULL;
 static struct tsch_link *backup_link = NULL;
 static struct tsch_packet *current_packet = NULL;
 static struct tsch_neighbor *current_neighbor = NULL;
+/* Time taken to select the packet of the current slot, in rtimer ticks */
+static rtimer_clock_t packet_selection_time;
+
+/* The frame built for the current (or next) slot. With TSCH_PREPARE_AHEAD,
+ * it is built at the end of the previous slot, for the ASN of the next slot. */
+static struct {
+  struct tsch_packet *packet; /* The packet the frame was built from, NULL if none */
+  struct asn_t asn; /* The ASN the frame was built for */
+  void *frame; /* The frame to transmit */
+  uint8_t len; /* Its length */
+  uint8_t loaded; /* Was it already copied to the radio buffer? */
+} prepared;
+#if LLSEC802154_ENABLED
+/* Encrypted payload */
+static uint8_t encrypted_packet[TSCH_PACKET_MAX_LEN];
+#endif /* LLSEC802154_ENABLED */
+/* Longest time taken to prepare a frame so far, in rtimer ticks */
+static rtimer_clock_t prepare_duration;
 
 /* Protothread for association */
 PT_THREAD(tsch_scan(struct pt *pt));
@@ -191,6 +209,8 @@ tsch_get_lock(void)
       /* Take the lock if it is free */
       tsch_locked = 1;
       tsch_lock_requested = 0;
+      /* The queues may change while locked: drop any frame prepared ahead */
+      prepared.packet = NULL;
       if(busy_wait) {
         /* Issue a log whenever we had to busy wait until getting the lock */
         TSCH_LOG_ADD(tsch_log_message,
@@ -327,6 +347,84 @@ get_packet_and_neighbor_for_link(struct tsch_link *link, struct tsch_neighbor **
   return p;
 }
 /*---------------------------------------------------------------------------*/
+/* Build the frame to be sent from packet p to neighbor n in the slot of the
+ * given ASN: update the Sync-IE of EBs and secure the frame. If load is set,
+ * also copy the frame to the radio buffer. Returns 1 if the frame is ready. */
+static int
+prepare_frame(struct tsch_packet *p, struct tsch_neighbor *n, struct asn_t *asn, int load)
+{
+  rtimer_clock_t start = RTIMER_NOW();
+  int ready;
+
+  prepared.packet = NULL;
+  prepared.loaded = 0;
+  /* get payload */
+  prepared.frame = queuebuf_dataptr(p->qb);
+  prepared.len = queuebuf_datalen(p->qb);
+  /* if this is an EB, then update its Sync-IE */
+  if(n == n_eb) {
+    ready = tsch_packet_update_eb(prepared.frame, prepared.len, p->tsch_sync_ie_offset);
+  } else {
+    ready = 1;
+  }
+
+#if LLSEC802154_ENABLED
+  if(tsch_is_pan_secured) {
+    /* If we are going to encrypt, we need to generate the output in a separate buffer and keep
+     * the original untouched. This is to allow for future retransmissions. */
+    int with_encryption = queuebuf_attr(p->qb, PACKETBUF_ATTR_SECURITY_LEVEL) & 0x4;
+    prepared.len += tsch_security_secure_frame(prepared.frame, with_encryption ? encrypted_packet : prepared.frame,
+        p->header_len, prepared.len - p->header_len, asn);
+    if(with_encryption) {
+      prepared.frame = encrypted_packet;
+    }
+  }
+#endif /* LLSEC802154_ENABLED */
+
+  if(ready && load) {
+    /* copy to radio buffer, 0 means success */
+    ready = NETSTACK_RADIO.prepare(prepared.frame, prepared.len) == 0;
+    prepared.loaded = ready;
+  }
+  if(ready) {
+    prepared.packet = p;
+    prepared.asn = *asn;
+  }
+
+  start = RTIMER_NOW() - start;
+  if(start > prepare_duration) {
+    prepare_duration = start;
+  }
+  return ready;
+}
+/*---------------------------------------------------------------------------*/
+#if TSCH_PREPARE_AHEAD
+/* Use the idle time left before the next slot to build its frame, so that
+ * the slot itself only has to transmit it. Skipped when the slot is too
+ * close to fit the longest preparation seen so far. */
+static void
+prepare_next_slot(void)
+{
+  struct tsch_packet *p;
+  struct tsch_neighbor *n;
+  rtimer_clock_t needed = packet_selection_time + prepare_duration + RTIMER_GUARD;
+
+  prepared.packet = NULL;
+  if(current_link == NULL || tsch_lock_requested
+      || !RTIMER_CLOCK_LT(RTIMER_NOW() + needed, current_slot_start)) {
+    return;
+  }
+  /* Same selection as at the start of the slot, including the backup link */
+  p = get_packet_and_neighbor_for_link(current_link, &n);
+  if(p == NULL && !(current_link->link_options & LINK_OPTION_RX) && backup_link != NULL) {
+    p = get_packet_and_neighbor_for_link(backup_link, &n);
+  }
+  if(p != NULL && p->qb != NULL) {
+    prepare_frame(p, n, &current_asn, TSCH_PRELOAD_RADIO);
+  }
+}
+#endif /* TSCH_PREPARE_AHEAD */
+/*---------------------------------------------------------------------------*/
 /* Post TX: Update neighbor state after a transmission */
 static int
 update_neighbor_state(struct tsch_neighbor *n, struct tsch_packet *p,
@@ -404,10 +502,6 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
     } else {
       /* packet payload */
       static void *packet;
-#if LLSEC802154_ENABLED
-      /* encrypted payload */
-      static uint8_t encrypted_packet[TSCH_PACKET_MAX_LEN];
-#endif /* LLSEC802154_ENABLED */
       /* packet payload length */
       static uint8_t packet_len;
       /* packet seqno */
@@ -420,35 +514,23 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
       static uint8_t cca_status;
 #endif
 
-      /* get payload */
-      packet = queuebuf_dataptr(current_packet->qb);
-      packet_len = queuebuf_datalen(current_packet->qb);
       /* is this a broadcast packet? (wait for ack?) */
       is_broadcast = current_neighbor->is_broadcast;
       /* read seqno from payload */
-      seqno = ((uint8_t *)(packet))[2];
-      /* if this is an EB, then update its Sync-IE */
-      if(current_neighbor == n_eb) {
-        packet_ready = tsch_packet_update_eb(packet, packet_len, current_packet->tsch_sync_ie_offset);
-      } else {
+      seqno = ((uint8_t *)(queuebuf_dataptr(current_packet->qb)))[2];
+      /* build the frame, unless it was done at the end of the previous slot */
+      if(prepared.packet == current_packet && ASN_EQ(current_asn, prepared.asn)) {
         packet_ready = 1;
+      } else {
+        packet_ready = prepare_frame(current_packet, current_neighbor, &current_asn, 0);
       }
-
-#if LLSEC802154_ENABLED
-      if(tsch_is_pan_secured) {
-        /* If we are going to encrypt, we need to generate the output in a separate buffer and keep
-         * the original untouched. This is to allow for future retransmissions. */
-        int with_encryption = queuebuf_attr(current_packet->qb, PACKETBUF_ATTR_SECURITY_LEVEL) & 0x4;
-        packet_len += tsch_security_secure_frame(packet, with_encryption ? encrypted_packet : packet, current_packet->header_len,
-            packet_len - current_packet->header_len, &current_asn);
-        if(with_encryption) {
-          packet = encrypted_packet;
-        }
-      }
-#endif /* LLSEC802154_ENABLED */
+      prepared.packet = NULL;
+      packet = prepared.frame;
+      packet_len = prepared.len;
 
       /* prepare packet to send: copy to radio buffer */
-      if(packet_ready && NETSTACK_RADIO.prepare(packet, packet_len) == 0) { /* 0 means success */
+      if(packet_ready
+          && (prepared.loaded || NETSTACK_RADIO.prepare(packet, packet_len) == 0)) { /* 0 means success */
         static rtimer_clock_t tx_duration;
 
 #if CCA_ENABLED
@@ -573,6 +655,12 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
                   /* Keep track of sync time */
                   last_sync_asn = current_asn;
                   tsch_schedule_keepalive();
+                } else if(current_neighbor != NULL) {
+                  /* Not synchronizing to this neighbor, but learning our drift from it */
+                  int32_t eack_time_correction = US_TO_RTIMERTICKS(ack_ies.ie_time_correction);
+                  if(ABS(eack_time_correction) <= SYNC_IE_BOUND) {
+                    tsch_timesync_observe(&current_neighbor->addr, eack_time_correction);
+                  }
                 }
                 mac_tx_status = MAC_TX_OK;
               } else {
@@ -607,6 +695,7 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
     log->tx.datalen = queuebuf_datalen(current_packet->qb);
     log->tx.drift = drift_correction;
     log->tx.drift_used = is_drift_correction_used;
+    log->tx.selection_time = packet_selection_time;
     log->tx.is_data = ((((uint8_t *)(queuebuf_dataptr(current_packet->qb)))[0]) & 7) == FRAME802154_DATAFRAME;
 #if LLSEC802154_ENABLED
     log->tx.sec_level = queuebuf_attr(current_packet->qb, PACKETBUF_ATTR_SECURITY_LEVEL);
@@ -798,6 +887,9 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
               is_drift_correction_used = 1;
               tsch_timesync_update(n, since_last_timesync, -estimated_drift);
               tsch_schedule_keepalive();
+            } else {
+              /* Not synchronizing to this neighbor, but learning our drift from it */
+              tsch_timesync_observe(&source_address, -estimated_drift);
             }
 
             /* Add current input to ringbuf */
@@ -863,6 +955,7 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
       TSCH_DEBUG_SLOT_START();
       tsch_in_slot_operation = 1;
       /* Get a packet ready to be sent */
+      packet_selection_time = RTIMER_NOW();
       current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
       /* There is no packet to send, and this link does not have Rx flag. Instead of doing
        * nothing, switch to the backup link (has Rx flag) if any. */
@@ -870,6 +963,7 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
         current_link = backup_link;
         current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
       }
+      packet_selection_time = RTIMER_NOW() - packet_selection_time;
       /* Hop channel */
       current_channel = tsch_calculate_channel(&current_asn, current_link->channel_offset);
       NETSTACK_RADIO.set_value(RADIO_PARAM_CHANNEL, current_channel);
@@ -941,6 +1035,9 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
         current_slot_start += time_to_next_active_slot;
         current_slot_start += tsch_timesync_adaptive_compensate(time_to_next_active_slot);
       } while(!tsch_schedule_slot_operation(t, prev_slot_start, time_to_next_active_slot, "main"));
+#if TSCH_PREPARE_AHEAD
+      prepare_next_slot();
+#endif /* TSCH_PREPARE_AHEAD */
     }
 
     tsch_in_slot_operation = 0;
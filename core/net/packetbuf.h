@@ -255,6 +255,9 @@ enum {
 #endif /* NETSTACK_CONF_WITH_RIME */
   PACKETBUF_ATTR_PENDING,
   PACKETBUF_ATTR_FRAME_TYPE,
+#if CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE
+  PACKETBUF_ATTR_CHECK_RATE_SHIFT,
+#endif /* CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE */
 #if LLSEC802154_USES_AUX_HEADER
   PACKETBUF_ATTR_SECURITY_LEVEL,
 #endif /* LLSEC802154_USES_AUX_HEADER */
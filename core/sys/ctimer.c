@@ -46,8 +46,22 @@
 #include "contiki.h"
 #include "lib/list.h"
 
+/*
+ * The pending callback timers are kept in a list ordered by the time
+ * left until they expire. The callback timer process has a single
+ * event timer for the first timer on the list. When it expires, the
+ * process calls the callbacks of all timers that are due in one pass.
+ *
+ * The etimer structure in each callback timer holds its time and
+ * tells if it is pending, but it is not on the list of event timers.
+ */
 LIST(ctimer_list);
 
+/* The last timer on the list, as new timers often expire last. */
+static struct ctimer *last;
+
+static struct etimer next_timer;
+
 static char initialized;
 
 #define DEBUG 0
@@ -58,31 +72,125 @@ static char initialized;
 #define PRINTF(...)
 #endif
 
-/*---------------------------------------------------------------------------*/
 PROCESS(ctimer_process, "Ctimer process");
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+time_left(struct ctimer *c, clock_time_t now)
+{
+  clock_time_t elapsed;
+
+  elapsed = now - c->etimer.timer.start;
+  return elapsed >= c->etimer.timer.interval ?
+    0 : c->etimer.timer.interval - elapsed;
+}
+/*---------------------------------------------------------------------------*/
+/* Set the event timer of the process to the first callback timer. */
+static void
+schedule(void)
+{
+  struct ctimer *c;
+
+  c = list_head(ctimer_list);
+  if(initialized && c != NULL) {
+    PROCESS_CONTEXT_BEGIN(&ctimer_process);
+    etimer_set(&next_timer, time_left(c, clock_time()));
+    PROCESS_CONTEXT_END(&ctimer_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_ctimer(struct ctimer *c)
+{
+  struct ctimer *t;
+
+  list_remove(ctimer_list, c);
+  if(c == last) {
+    last = NULL;
+    for(t = list_head(ctimer_list); t != NULL; t = t->next) {
+      last = t;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_ctimer(struct ctimer *c)
+{
+  struct ctimer *t, *previous;
+  clock_time_t now, left;
+
+  /* A timer that is not pending is not on the list. */
+  if(!ctimer_expired(c)) {
+    remove_ctimer(c);
+  }
+
+  c->etimer.p = &ctimer_process;
+  c->etimer.next = c->etimer.child = c->etimer.prev = NULL;
+
+  /* Insert the timer after the timers that expire before it, or at
+     the same time. */
+  now = clock_time();
+  left = time_left(c, now);
+  if(last != NULL && time_left(last, now) <= left) {
+    previous = last;
+  } else {
+    previous = NULL;
+    for(t = list_head(ctimer_list);
+        t != NULL && time_left(t, now) <= left;
+        t = t->next) {
+      previous = t;
+    }
+  }
+
+  if(previous == NULL) {
+    list_push(ctimer_list, c);
+    schedule();
+  } else {
+    list_insert(ctimer_list, previous, c);
+  }
+  if(previous == last) {
+    last = c;
+  }
+}
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(ctimer_process, ev, data)
 {
   struct ctimer *c;
+  clock_time_t now;
+  int due;
   PROCESS_BEGIN();
 
-  for(c = list_head(ctimer_list); c != NULL; c = c->next) {
-    etimer_set(&c->etimer, c->etimer.timer.interval);
-  }
   initialized = 1;
+  schedule();
 
   while(1) {
     PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_TIMER);
-    for(c = list_head(ctimer_list); c != NULL; c = c->next) {
-      if(&c->etimer == data) {
-	list_remove(ctimer_list, c);
-	PROCESS_CONTEXT_BEGIN(c->p);
-	if(c->f != NULL) {
-	  c->f(c->ptr);
-	}
-	PROCESS_CONTEXT_END(c->p);
-	break;
+
+    /* Call the callbacks of the timers that are due. A timer that is
+       set again by its callback is put back on the list, and waits
+       for the next pass if it is due at once. */
+    now = clock_time();
+    due = 0;
+    for(c = list_head(ctimer_list);
+        c != NULL && time_left(c, now) == 0;
+        c = c->next) {
+      due++;
+    }
+
+    while(due-- > 0 && (c = list_head(ctimer_list)) != NULL &&
+          time_left(c, clock_time()) == 0) {
+      list_pop(ctimer_list);
+      if(c == last) {
+        last = NULL;
+      }
+      c->etimer.p = PROCESS_NONE;
+      PROCESS_CONTEXT_BEGIN(c->p);
+      if(c->f != NULL) {
+	c->f(c->ptr);
       }
+      PROCESS_CONTEXT_END(c->p);
     }
+
+    schedule();
   }
   PROCESS_END();
 }
@@ -92,6 +200,7 @@ ctimer_init(void)
 {
   initialized = 0;
   list_init(ctimer_list);
+  last = NULL;
   process_start(&ctimer_process, NULL);
 }
 /*---------------------------------------------------------------------------*/
@@ -110,66 +219,42 @@ ctimer_set_with_process(struct ctimer *c, clock_time_t t,
   c->p = p;
   c->f = f;
   c->ptr = ptr;
-  if(initialized) {
-    PROCESS_CONTEXT_BEGIN(&ctimer_process);
-    etimer_set(&c->etimer, t);
-    PROCESS_CONTEXT_END(&ctimer_process);
-  } else {
-    c->etimer.timer.interval = t;
-  }
-
-  list_add(ctimer_list, c);
+  timer_set(&c->etimer.timer, t);
+  add_ctimer(c);
 }
 /*---------------------------------------------------------------------------*/
 void
 ctimer_reset(struct ctimer *c)
 {
-  if(initialized) {
-    PROCESS_CONTEXT_BEGIN(&ctimer_process);
-    etimer_reset(&c->etimer);
-    PROCESS_CONTEXT_END(&ctimer_process);
-  }
-
-  list_add(ctimer_list, c);
+  timer_reset(&c->etimer.timer);
+  add_ctimer(c);
 }
 /*---------------------------------------------------------------------------*/
 void
 ctimer_restart(struct ctimer *c)
 {
-  if(initialized) {
-    PROCESS_CONTEXT_BEGIN(&ctimer_process);
-    etimer_restart(&c->etimer);
-    PROCESS_CONTEXT_END(&ctimer_process);
-  }
-
-  list_add(ctimer_list, c);
+  timer_restart(&c->etimer.timer);
+  add_ctimer(c);
 }
 /*---------------------------------------------------------------------------*/
 void
 ctimer_stop(struct ctimer *c)
 {
-  if(initialized) {
-    etimer_stop(&c->etimer);
-  } else {
-    c->etimer.next = NULL;
-    c->etimer.p = PROCESS_NONE;
+  /* The event timer of the process may expire before the next
+     timer; the process then finds nothing to do. It is stopped with
+     the last timer, so that an idle system does not wake up for it. */
+  remove_ctimer(c);
+  c->etimer.next = NULL;
+  c->etimer.p = PROCESS_NONE;
+  if(list_head(ctimer_list) == NULL) {
+    etimer_stop(&next_timer);
   }
-  list_remove(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
 int
 ctimer_expired(struct ctimer *c)
 {
-  struct ctimer *t;
-  if(initialized) {
-    return etimer_expired(&c->etimer);
-  }
-  for(t = list_head(ctimer_list); t != NULL; t = t->next) {
-    if(t == c) {
-      return 0;
-    }
-  }
-  return 1;
+  return c->etimer.p == PROCESS_NONE;
 }
 /*---------------------------------------------------------------------------*/
 /** @} */
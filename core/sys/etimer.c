@@ -44,43 +44,192 @@
  * Adam Dunkels <adam@sics.se>
  */
 
+/*
+ * The pending event timers are kept in a pairing heap, ordered by the
+ * time that remains until they expire. The root of the heap is always
+ * the next timer to expire, so finding the next expiration time is
+ * O(1), adding a timer is O(1), and removing a timer takes amortized
+ * O(log n) time.
+ *
+ * The heap is stored in the timers themselves: child points to the
+ * leftmost child of a timer, next to its right sibling, and prev to
+ * its left sibling or, for the leftmost child, to its parent.
+ *
+ * Timers are compared by the time left until they expire, measured
+ * from a common point in time. This is safe when the clock wraps
+ * around: the remaining times of two pending timers decrease at the
+ * same rate, and a timer that has expired has no time left, so the
+ * order between two timers never changes while they are in the heap.
+ *
+ * A timer is in the heap exactly when its self field points to the
+ * timer itself. The field is set when the timer is inserted and
+ * cleared when it is removed, expires, or is stopped. The links of a
+ * timer are never followed to find out whether it is in the heap:
+ * a timer that has never been set may hold any value, and a copy of a
+ * pending timer has links into the heap without being part of it. A
+ * copy has its self field pointing to the original, not to itself.
+ */
+
 #include "contiki-conf.h"
 
 #include "sys/etimer.h"
 #include "sys/process.h"
 
+/* The root of the timer heap. */
 static struct etimer *timerlist;
-static clock_time_t next_expiration;
 
 PROCESS(etimer_process, "Event timer");
 /*---------------------------------------------------------------------------*/
-static void
-update_time(void)
+static clock_time_t
+time_left(struct etimer *t, clock_time_t now)
+{
+  clock_time_t elapsed;
+
+  elapsed = now - t->timer.start;
+  return elapsed >= t->timer.interval ? 0 : t->timer.interval - elapsed;
+}
+/*---------------------------------------------------------------------------*/
+/* Join two heaps whose roots have no siblings. */
+static struct etimer *
+meld(struct etimer *a, struct etimer *b, clock_time_t now)
 {
-  clock_time_t tdist;
-  clock_time_t now;
   struct etimer *t;
 
-  if (timerlist == NULL) {
-    next_expiration = 0;
+  if(a == NULL) {
+    return b;
+  } else if(b == NULL) {
+    return a;
+  }
+
+  if(time_left(b, now) < time_left(a, now)) {
+    t = a;
+    a = b;
+    b = t;
+  }
+
+  /* The root that expires later becomes the leftmost child of the
+     other one. */
+  b->prev = a;
+  b->next = a->child;
+  if(a->child != NULL) {
+    a->child->prev = b;
+  }
+  a->child = b;
+
+  return a;
+}
+/*---------------------------------------------------------------------------*/
+/* Combine a list of sibling heaps into one heap with the standard
+   two-pass method: meld the heaps in pairs from left to right, and
+   then meld the pairs into one heap from right to left. */
+static struct etimer *
+merge_pairs(struct etimer *first, clock_time_t now)
+{
+  struct etimer *a, *b;
+  struct etimer *pairs;
+
+  pairs = NULL;
+  while(first != NULL) {
+    a = first;
+    b = a->next;
+    first = b == NULL ? NULL : b->next;
+
+    a->next = a->prev = NULL;
+    if(b != NULL) {
+      b->next = b->prev = NULL;
+    }
+    a = meld(a, b, now);
+
+    /* Keep the pairs in reverse order for the second pass. */
+    a->next = pairs;
+    pairs = a;
+  }
+
+  first = NULL;
+  while(pairs != NULL) {
+    a = pairs;
+    pairs = a->next;
+    a->next = NULL;
+    first = meld(first, a, now);
+  }
+
+  return first;
+}
+/*---------------------------------------------------------------------------*/
+static int
+in_heap(struct etimer *t)
+{
+  return t->self == t;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_timer(struct etimer *t, clock_time_t now)
+{
+  struct etimer *children;
+
+  children = merge_pairs(t->child, now);
+
+  if(t == timerlist) {
+    timerlist = children;
   } else {
-    now = clock_time();
-    t = timerlist;
-    /* Must calculate distance to next time into account due to wraps */
-    tdist = t->timer.start + t->timer.interval - now;
-    for(t = t->next; t != NULL; t = t->next) {
-      if(t->timer.start + t->timer.interval - now < tdist) {
-	tdist = t->timer.start + t->timer.interval - now;
-      }
+    if(t->prev->child == t) {
+      t->prev->child = t->next;
+    } else {
+      t->prev->next = t->next;
+    }
+    if(t->next != NULL) {
+      t->next->prev = t->prev;
+    }
+    timerlist = meld(timerlist, children, now);
+  }
+
+  t->next = t->child = t->prev = t->self = NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+insert_timer(struct etimer *t, clock_time_t now)
+{
+  t->next = t->child = t->prev = NULL;
+  t->self = t;
+  timerlist = meld(timerlist, t, now);
+}
+/*---------------------------------------------------------------------------*/
+/* Rebuild the heap without the timers of a process that has exited. */
+static void
+remove_process_timers(struct process *p)
+{
+  struct etimer *work, *t, *last;
+  clock_time_t now;
+
+  now = clock_time();
+  work = timerlist;
+  timerlist = NULL;
+
+  /* Visit every timer, using the next fields as a work list. */
+  while(work != NULL) {
+    t = work;
+    work = t->next;
+
+    if(t->child != NULL) {
+      for(last = t->child; last->next != NULL; last = last->next);
+      last->next = work;
+      work = t->child;
+    }
+
+    if(t->p == p) {
+      t->next = t->child = t->prev = t->self = NULL;
+      t->p = PROCESS_NONE;
+    } else {
+      insert_timer(t, now);
     }
-    next_expiration = now + tdist;
   }
 }
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(etimer_process, ev, data)
 {
-  struct etimer *t, *u;
-	
+  struct etimer *t;
+  clock_time_t now;
+
   PROCESS_BEGIN();
 
   timerlist = NULL;
@@ -89,53 +238,28 @@ PROCESS_THREAD(etimer_process, ev, data)
     PROCESS_YIELD();
 
     if(ev == PROCESS_EVENT_EXITED) {
-      struct process *p = data;
-
-      while(timerlist != NULL && timerlist->p == p) {
-	timerlist = timerlist->next;
-      }
-
-      if(timerlist != NULL) {
-	t = timerlist;
-	while(t->next != NULL) {
-	  if(t->next->p == p) {
-	    t->next = t->next->next;
-	  } else
-	    t = t->next;
-	}
-      }
+      remove_process_timers(data);
       continue;
     } else if(ev != PROCESS_EVENT_POLL) {
       continue;
     }
 
-  again:
-    
-    u = NULL;
-    
-    for(t = timerlist; t != NULL; t = t->next) {
-      if(timer_expired(&t->timer)) {
-	if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
-	  
-	  /* Reset the process ID of the event timer, to signal that the
-	     etimer has expired. This is later checked in the
-	     etimer_expired() function. */
-	  t->p = PROCESS_NONE;
-	  if(u != NULL) {
-	    u->next = t->next;
-	  } else {
-	    timerlist = t->next;
-	  }
-	  t->next = NULL;
-	  update_time();
-	  goto again;
-	} else {
-	  etimer_request_poll();
-	}
+    now = clock_time();
+    while(timerlist != NULL && time_left(timerlist, now) == 0) {
+      t = timerlist;
+      if(process_post_high(t->p, PROCESS_EVENT_TIMER, t) != PROCESS_ERR_OK) {
+        /* The event queue is full; try again later. */
+        etimer_request_poll();
+        break;
       }
-      u = t;
+
+      remove_timer(t, now);
+
+      /* Reset the process ID of the event timer, to signal that the
+         etimer has expired. This is later checked in the
+         etimer_expired() function. */
+      t->p = PROCESS_NONE;
     }
-    
   }
   
   PROCESS_END();
@@ -150,27 +274,20 @@ etimer_request_poll(void)
 static void
 add_timer(struct etimer *timer)
 {
-  struct etimer *t;
+  clock_time_t now;
 
   etimer_request_poll();
 
-  if(timer->p != PROCESS_NONE) {
-    for(t = timerlist; t != NULL; t = t->next) {
-      if(t == timer) {
-	/* Timer already on list, bail out. */
-        timer->p = PROCESS_CURRENT();
-	update_time();
-	return;
-      }
-    }
+  now = clock_time();
+
+  /* A timer that is already pending has a new expiration time, so it
+     is moved to its new place in the heap. */
+  if(in_heap(timer)) {
+    remove_timer(timer, now);
   }
 
-  /* Timer not on list. */
   timer->p = PROCESS_CURRENT();
-  timer->next = timerlist;
-  timerlist = timer;
-
-  update_time();
+  insert_timer(timer, now);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -205,8 +322,15 @@ etimer_restart(struct etimer *et)
 void
 etimer_adjust(struct etimer *et, int timediff)
 {
+  clock_time_t now;
+
   et->timer.start += timediff;
-  update_time();
+
+  if(in_heap(et)) {
+    now = clock_time();
+    remove_timer(et, now);
+    insert_timer(et, now);
+  }
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -236,35 +360,26 @@ etimer_pending(void)
 clock_time_t
 etimer_next_expiration_time(void)
 {
-  return etimer_pending() ? next_expiration : 0;
+  clock_time_t now;
+
+  if(!etimer_pending()) {
+    return 0;
+  }
+
+  /* The timer at the root may already have expired. */
+  now = clock_time();
+  return now + time_left(timerlist, now);
 }
 /*---------------------------------------------------------------------------*/
 void
 etimer_stop(struct etimer *et)
 {
-  struct etimer *t;
-
-  /* First check if et is the first event timer on the list. */
-  if(et == timerlist) {
-    timerlist = timerlist->next;
-    update_time();
-  } else {
-    /* Else walk through the list and try to find the item before the
-       et timer. */
-    for(t = timerlist; t != NULL && t->next != et; t = t->next);
-
-    if(t != NULL) {
-      /* We've found the item before the event timer that we are about
-	 to remove. We point the items next pointer to the event after
-	 the removed item. */
-      t->next = et->next;
-
-      update_time();
-    }
+  if(in_heap(et)) {
+    remove_timer(et, clock_time());
   }
 
-  /* Remove the next pointer from the item to be removed. */
-  et->next = NULL;
+  /* Remove the heap links from the timer. */
+  et->next = et->child = et->prev = et->self = NULL;
   /* Set the timer as expired */
   et->p = PROCESS_NONE;
 }
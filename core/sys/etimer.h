@@ -71,12 +71,20 @@
  * This structure is used for declaring a timer. The timer must be set
  * with etimer_set() before it can be used.
  *
+ * Pending timers are kept in a pairing heap ordered by expiration
+ * time. The next, child, and prev fields link the timer into the heap,
+ * and self points to the timer itself while it is in the heap. They
+ * must not be used by applications.
+ *
  * \hideinitializer
  */
 struct etimer {
   struct timer timer;
   struct etimer *next;
   struct process *p;
+  struct etimer *child;
+  struct etimer *prev;
+  struct etimer *self;
 };
 
 /**
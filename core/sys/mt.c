@@ -111,3 +111,23 @@ mt_stop(struct mt_thread *thread)
   mtarch_stop(&thread->thread);
 }
 /*--------------------------------------------------------------------------*/
+int
+mt_stack_usage(struct mt_thread *thread)
+{
+#if MTARCH_STACK_USAGE
+  return mtarch_stack_usage(thread);
+#else /* MTARCH_STACK_USAGE */
+  return -1;
+#endif /* MTARCH_STACK_USAGE */
+}
+/*--------------------------------------------------------------------------*/
+int
+mt_stack_overflowed(struct mt_thread *thread)
+{
+#if MTARCH_STACK_CHECK
+  return mtarch_stack_overflowed(&thread->thread);
+#else /* MTARCH_STACK_CHECK */
+  return 0;
+#endif /* MTARCH_STACK_CHECK */
+}
+/*--------------------------------------------------------------------------*/
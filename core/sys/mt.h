@@ -268,6 +268,34 @@ void mt_exit(void);
  */
 void mt_stop(struct mt_thread *thread);
 
+/**
+ * Get the stack usage of a thread.
+ *
+ * The stack of a thread is filled with a known pattern when the
+ * thread is started, so that the deepest use of the stack so far can
+ * be found. It is counted in bytes, or in 16-bit words on MSP430. The
+ * size of the stack is MTARCH_CONF_STACKSIZE, and is the same for all
+ * threads.
+ *
+ * \param thread A pointer to the struct mt_thread block of the thread.
+ *
+ * eturn The largest part of the stack that the thread has used, or
+ * -1 if the architecture cannot measure it (MTARCH_STACK_USAGE is not
+ * set).
+ */
+int mt_stack_usage(struct mt_thread *thread);
+
+/**
+ * Check if a thread has used more than its stack.
+ *
+ * \param thread A pointer to the struct mt_thread block of the thread.
+ *
+ * eturn Non-zero if the thread has overwritten the memory at the
+ * bottom of its stack. Always zero if the architecture cannot tell
+ * (MTARCH_STACK_CHECK is not set).
+ */
+int mt_stack_overflowed(struct mt_thread *thread);
+
 /** @} */
 /** @} */
 #endif /* MT_H_ */
@@ -44,9 +44,13 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "sys/process.h"
 #include "sys/arg.h"
+#if PROCESS_CONF_PROFILE
+#include "sys/rtimer.h"
+#endif /* PROCESS_CONF_PROFILE */
 
 /*
  * Pointer to the currently running process structure.
@@ -68,12 +72,60 @@ struct event_data {
 static process_num_events_t nevents, fevent;
 static struct event_data events[PROCESS_CONF_NUMEVENTS];
 
+/*
+ * Events posted with process_post_high() are kept in a separate,
+ * smaller queue that is emptied before the queue of other events.
+ */
+#if PROCESS_CONF_NUMEVENTS_HIGH > 0
+static process_num_events_t nevents_high, fevent_high;
+static struct event_data events_high[PROCESS_CONF_NUMEVENTS_HIGH];
+#else
+#define nevents_high 0
+#endif /* PROCESS_CONF_NUMEVENTS_HIGH > 0 */
+
 #if PROCESS_CONF_STATS
 process_num_events_t process_maxevents;
+process_num_events_t process_maxevents_high;
+unsigned long process_dropped_events;
+unsigned long process_coalesced_events;
 #endif
 
 static volatile unsigned char poll_requested;
 
+/*
+ * The processes that have been polled are put on a list, so that the
+ * poll handlers can be called without looking at every process. The
+ * list may be changed from interrupts. An interrupt that preempts a
+ * change of the list does not touch it, but asks for a scan of the
+ * whole process list instead.
+ */
+static struct process *volatile poll_list;
+static volatile unsigned char poll_busy;
+static volatile unsigned char poll_rescan;
+
+#if PROCESS_CONF_SUBSCRIPTIONS
+static struct process_subscription *subscriptions;
+#endif /* PROCESS_CONF_SUBSCRIPTIONS */
+
+#if PROCESS_CONF_PROFILE
+#ifdef PROCESS_CONF_PROFILE_NOW
+typedef unsigned long profile_clock_t;
+#else /* PROCESS_CONF_PROFILE_NOW */
+typedef rtimer_clock_t profile_clock_t;
+#endif /* PROCESS_CONF_PROFILE_NOW */
+
+/*
+ * The profiles of the event types, in the order they were first
+ * seen. The last entry accounts for the events that did not fit.
+ */
+static struct process_profile event_profiles[PROCESS_CONF_PROFILE_EVENTS];
+static process_event_t profiled_events[PROCESS_CONF_PROFILE_EVENTS];
+static unsigned char nprofiled_events;
+
+/* The time spent in processes that were called by the current one. */
+static unsigned long profile_nested;
+#endif /* PROCESS_CONF_PROFILE */
+
 #define PROCESS_STATE_NONE        0
 #define PROCESS_STATE_RUNNING     1
 #define PROCESS_STATE_CALLED      2
@@ -157,6 +209,20 @@ exit_process(struct process *p, struct process *fromprocess)
     }
   }
 
+#if PROCESS_CONF_SUBSCRIPTIONS
+  {
+    struct process_subscription **sp;
+
+    for(sp = &subscriptions; *sp != NULL;) {
+      if((*sp)->p == p) {
+        *sp = (*sp)->next;
+      } else {
+        sp = &(*sp)->next;
+      }
+    }
+  }
+#endif /* PROCESS_CONF_SUBSCRIPTIONS */
+
   if(p == process_list) {
     process_list = process_list->next;
   } else {
@@ -171,10 +237,69 @@ exit_process(struct process *p, struct process *fromprocess)
   process_current = old_current;
 }
 /*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_PROFILE
+static void
+profile_add(struct process_profile *profile, unsigned long time)
+{
+  profile->time += time;
+  profile->calls++;
+  if(time > profile->max) {
+    profile->max = time;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct process_profile *
+event_profile(process_event_t ev)
+{
+  int i;
+
+  for(i = 0; i < nprofiled_events; i++) {
+    if(profiled_events[i] == ev) {
+      return &event_profiles[i];
+    }
+  }
+  if(nprofiled_events < PROCESS_CONF_PROFILE_EVENTS - 1) {
+    profiled_events[nprofiled_events] = ev;
+    return &event_profiles[nprofiled_events++];
+  }
+  profiled_events[PROCESS_CONF_PROFILE_EVENTS - 1] = PROCESS_EVENT_NONE;
+  return &event_profiles[PROCESS_CONF_PROFILE_EVENTS - 1];
+}
+/*---------------------------------------------------------------------------*/
+const struct process_profile *
+process_profile_event(int i, process_event_t *ev)
+{
+  if(i >= nprofiled_events) {
+    if(i != PROCESS_CONF_PROFILE_EVENTS - 1 ||
+       event_profiles[i].calls == 0) {
+      return NULL;
+    }
+  }
+  *ev = profiled_events[i];
+  return &event_profiles[i];
+}
+/*---------------------------------------------------------------------------*/
+void
+process_profile_reset(void)
+{
+  struct process *p;
+
+  for(p = process_list; p != NULL; p = p->next) {
+    memset(&p->profile, 0, sizeof(p->profile));
+  }
+  memset(event_profiles, 0, sizeof(event_profiles));
+  nprofiled_events = 0;
+}
+#endif /* PROCESS_CONF_PROFILE */
+/*---------------------------------------------------------------------------*/
 static void
 call_process(struct process *p, process_event_t ev, process_data_t data)
 {
   int ret;
+#if PROCESS_CONF_PROFILE
+  profile_clock_t start;
+  unsigned long elapsed, nested;
+#endif /* PROCESS_CONF_PROFILE */
 
 #if DEBUG
   if(p->state == PROCESS_STATE_CALLED) {
@@ -187,7 +312,19 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
     PRINTF("process: calling process '%s' with event %d\n", PROCESS_NAME_STRING(p), ev);
     process_current = p;
     p->state = PROCESS_STATE_CALLED;
+#if PROCESS_CONF_PROFILE
+    nested = profile_nested;
+    profile_nested = 0;
+    start = PROCESS_PROFILE_NOW();
+#endif /* PROCESS_CONF_PROFILE */
     ret = p->thread(&p->pt, ev, data);
+#if PROCESS_CONF_PROFILE
+    elapsed = (profile_clock_t)(PROCESS_PROFILE_NOW() - start);
+    /* Time spent in processes called from this one is theirs. */
+    profile_add(&p->profile, elapsed - profile_nested);
+    profile_add(event_profile(ev), elapsed - profile_nested);
+    profile_nested = nested + elapsed;
+#endif /* PROCESS_CONF_PROFILE */
     if(ret == PT_EXITED ||
        ret == PT_ENDED ||
        ev == PROCESS_EVENT_EXIT) {
@@ -210,8 +347,19 @@ process_init(void)
   lastevent = PROCESS_EVENT_MAX;
 
   nevents = fevent = 0;
+#if PROCESS_CONF_NUMEVENTS_HIGH > 0
+  nevents_high = fevent_high = 0;
+#endif /* PROCESS_CONF_NUMEVENTS_HIGH > 0 */
+  poll_list = NULL;
+  poll_busy = poll_rescan = 0;
+#if PROCESS_CONF_SUBSCRIPTIONS
+  subscriptions = NULL;
+#endif /* PROCESS_CONF_SUBSCRIPTIONS */
 #if PROCESS_CONF_STATS
   process_maxevents = 0;
+  process_maxevents_high = 0;
+  process_dropped_events = 0;
+  process_coalesced_events = 0;
 #endif /* PROCESS_CONF_STATS */
 
   process_current = process_list = NULL;
@@ -222,17 +370,43 @@ process_init(void)
  */
 /*---------------------------------------------------------------------------*/
 static void
+poll_process(struct process *p)
+{
+  if(p->needspoll) {
+    p->needspoll = 0;
+    if(process_is_running(p)) {
+      p->state = PROCESS_STATE_RUNNING;
+      call_process(p, PROCESS_EVENT_POLL, NULL);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
 do_poll(void)
 {
-  struct process *p;
+  struct process *p, *next;
 
   poll_requested = 0;
+
+  /* Take the list of polled processes. */
+  poll_busy = 1;
+  p = poll_list;
+  poll_list = NULL;
+  poll_busy = 0;
+
   /* Call the processes that needs to be polled. */
-  for(p = process_list; p != NULL; p = p->next) {
-    if(p->needspoll) {
-      p->state = PROCESS_STATE_RUNNING;
-      p->needspoll = 0;
-      call_process(p, PROCESS_EVENT_POLL, NULL);
+  for(; p != NULL; p = next) {
+    next = p->nextpoll;
+    p->pollqueued = 0;
+    poll_process(p);
+  }
+
+  /* A process that was polled while the list was being changed is
+     not on the list, so look at every process. */
+  if(poll_rescan) {
+    poll_rescan = 0;
+    for(p = process_list; p != NULL; p = p->next) {
+      poll_process(p);
     }
   }
 }
@@ -258,18 +432,55 @@ do_event(void)
    * call the poll handlers inbetween.
    */
 
-  if(nevents > 0) {
-    
-    /* There are events that we should deliver. */
-    ev = events[fevent].ev;
-    
-    data = events[fevent].data;
-    receiver = events[fevent].p;
+  if(nevents_high > 0 || nevents > 0) {
+
+#if PROCESS_CONF_NUMEVENTS_HIGH > 0
+    if(nevents_high > 0) {
+      /* Events in the high priority queue are delivered first. */
+      ev = events_high[fevent_high].ev;
+      data = events_high[fevent_high].data;
+      receiver = events_high[fevent_high].p;
+
+      fevent_high = (fevent_high + 1) % PROCESS_CONF_NUMEVENTS_HIGH;
+      --nevents_high;
+    } else
+#endif /* PROCESS_CONF_NUMEVENTS_HIGH > 0 */
+    {
+      /* There are events that we should deliver. */
+      ev = events[fevent].ev;
+
+      data = events[fevent].data;
+      receiver = events[fevent].p;
+
+      /* Since we have seen the new event, we move pointer upwards
+         and decrease the number of events. */
+      fevent = (fevent + 1) % PROCESS_CONF_NUMEVENTS;
+      --nevents;
+    }
 
-    /* Since we have seen the new event, we move pointer upwards
-       and decrease the number of events. */
-    fevent = (fevent + 1) % PROCESS_CONF_NUMEVENTS;
-    --nevents;
+#if PROCESS_CONF_SUBSCRIPTIONS
+    /* A broadcast event that processes have subscribed to is only
+       delivered to the subscribers. */
+    if(receiver == PROCESS_BROADCAST) {
+      struct process_subscription *s, *next;
+      int subscribed;
+
+      subscribed = 0;
+      for(s = subscriptions; s != NULL; s = next) {
+        next = s->next;
+        if(s->ev == ev) {
+          subscribed = 1;
+          if(poll_requested) {
+            do_poll();
+          }
+          call_process(s->p, ev, data);
+        }
+      }
+      if(subscribed) {
+        return;
+      }
+    }
+#endif /* PROCESS_CONF_SUBSCRIPTIONS */
 
     /* If this is a broadcast event, we deliver it to all events, in
        order of their priority. */
@@ -309,13 +520,38 @@ process_run(void)
   /* Process one event from the queue */
   do_event();
 
-  return nevents + poll_requested;
+  return nevents + nevents_high + poll_requested;
 }
 /*---------------------------------------------------------------------------*/
 int
 process_nevents(void)
 {
-  return nevents + poll_requested;
+  return nevents + nevents_high + poll_requested;
+}
+/*---------------------------------------------------------------------------*/
+/* Check if an event is already waiting in one of the queues. */
+static int
+is_pending(struct process *p, process_event_t ev, process_data_t data)
+{
+  process_num_events_t i, snum;
+
+  for(i = 0; i < nevents; i++) {
+    snum = (process_num_events_t)(fevent + i) % PROCESS_CONF_NUMEVENTS;
+    if(events[snum].p == p && events[snum].ev == ev &&
+       events[snum].data == data) {
+      return 1;
+    }
+  }
+#if PROCESS_CONF_NUMEVENTS_HIGH > 0
+  for(i = 0; i < nevents_high; i++) {
+    snum = (process_num_events_t)(fevent_high + i) % PROCESS_CONF_NUMEVENTS_HIGH;
+    if(events_high[snum].p == p && events_high[snum].ev == ev &&
+       events_high[snum].data == data) {
+      return 1;
+    }
+  }
+#endif /* PROCESS_CONF_NUMEVENTS_HIGH > 0 */
+  return 0;
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -333,6 +569,20 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
   }
   
   if(nevents == PROCESS_CONF_NUMEVENTS) {
+    /* The event is not posted. If an equal event is already waiting
+       for the same process, with the same data, the process still gets
+       it, so it is counted as merged rather than dropped. The caller
+       is told that the queue is full either way, so that it can back
+       off. */
+    if(is_pending(p, ev, data)) {
+#if PROCESS_CONF_STATS
+      process_coalesced_events++;
+#endif /* PROCESS_CONF_STATS */
+      return PROCESS_ERR_FULL;
+    }
+#if PROCESS_CONF_STATS
+    process_dropped_events++;
+#endif /* PROCESS_CONF_STATS */
 #if DEBUG
     if(p == PROCESS_BROADCAST) {
       printf("soft panic: event queue is full when broadcast event %d was posted from %s\n", ev, PROCESS_NAME_STRING(process_current));
@@ -358,6 +608,48 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
   return PROCESS_ERR_OK;
 }
 /*---------------------------------------------------------------------------*/
+int
+process_post_high(struct process *p, process_event_t ev, process_data_t data)
+{
+#if PROCESS_CONF_NUMEVENTS_HIGH > 0
+  process_num_events_t snum;
+
+  PRINTF("process_post_high: event %d to process '%s', nevents_high %d\n",
+         ev, p == PROCESS_BROADCAST ? "<broadcast>" : PROCESS_NAME_STRING(p),
+         nevents_high);
+
+  /* High priority events are polls and timer expirations, so an event
+     that is equal to one already waiting carries no news: it is merged
+     with it whether or not the queues are full. */
+  if(is_pending(p, ev, data)) {
+#if PROCESS_CONF_STATS
+    process_coalesced_events++;
+#endif /* PROCESS_CONF_STATS */
+    return PROCESS_ERR_OK;
+  }
+
+  if(nevents_high < PROCESS_CONF_NUMEVENTS_HIGH) {
+    snum = (process_num_events_t)(fevent_high + nevents_high) %
+      PROCESS_CONF_NUMEVENTS_HIGH;
+    events_high[snum].ev = ev;
+    events_high[snum].data = data;
+    events_high[snum].p = p;
+    ++nevents_high;
+
+#if PROCESS_CONF_STATS
+    if(nevents_high > process_maxevents_high) {
+      process_maxevents_high = nevents_high;
+    }
+#endif /* PROCESS_CONF_STATS */
+
+    return PROCESS_ERR_OK;
+  }
+#endif /* PROCESS_CONF_NUMEVENTS_HIGH > 0 */
+
+  /* The high priority queue is full; use the normal queue. */
+  return process_post(p, ev, data);
+}
+/*---------------------------------------------------------------------------*/
 void
 process_post_synch(struct process *p, process_event_t ev, process_data_t data)
 {
@@ -375,9 +667,48 @@ process_poll(struct process *p)
        p->state == PROCESS_STATE_CALLED) {
       p->needspoll = 1;
       poll_requested = 1;
+
+      if(poll_busy) {
+        /* We have preempted a change of the poll list. */
+        poll_rescan = 1;
+      } else {
+        poll_busy = 1;
+        if(!p->pollqueued) {
+          p->pollqueued = 1;
+          p->nextpoll = poll_list;
+          poll_list = p;
+        }
+        poll_busy = 0;
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_SUBSCRIPTIONS
+void
+process_subscribe(struct process_subscription *s, process_event_t ev,
+                  struct process *p)
+{
+  process_unsubscribe(s);
+  s->ev = ev;
+  s->p = p;
+  s->next = subscriptions;
+  subscriptions = s;
+}
+/*---------------------------------------------------------------------------*/
+void
+process_unsubscribe(struct process_subscription *s)
+{
+  struct process_subscription **sp;
+
+  for(sp = &subscriptions; *sp != NULL; sp = &(*sp)->next) {
+    if(*sp == s) {
+      *sp = s->next;
+      return;
     }
   }
 }
+#endif /* PROCESS_CONF_SUBSCRIPTIONS */
 /*---------------------------------------------------------------------------*/
 int
 process_is_running(struct process *p)
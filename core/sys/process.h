@@ -88,6 +88,49 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+/* The number of events in the queue for process_post_high(). */
+#ifndef PROCESS_CONF_NUMEVENTS_HIGH
+#define PROCESS_CONF_NUMEVENTS_HIGH 8
+#endif /* PROCESS_CONF_NUMEVENTS_HIGH */
+
+#if PROCESS_CONF_STATS
+/* The largest number of events that have been waiting in each queue,
+   the number of events that were dropped because the queue was full,
+   and the number of events that were merged with an equal waiting
+   event, by process_post_high() or when the queue was full. */
+extern process_num_events_t process_maxevents;
+extern process_num_events_t process_maxevents_high;
+extern unsigned long process_dropped_events;
+extern unsigned long process_coalesced_events;
+#endif /* PROCESS_CONF_STATS */
+
+/* Enable delivery of broadcast events to subscribed processes only. */
+#ifndef PROCESS_CONF_SUBSCRIPTIONS
+#define PROCESS_CONF_SUBSCRIPTIONS 0
+#endif /* PROCESS_CONF_SUBSCRIPTIONS */
+
+/* Enable the CPU profiler, which measures the time spent in each
+   process and in the handling of each type of event. */
+#ifndef PROCESS_CONF_PROFILE
+#define PROCESS_CONF_PROFILE 0
+#endif /* PROCESS_CONF_PROFILE */
+
+/* The number of event types that the profiler keeps apart. */
+#ifndef PROCESS_CONF_PROFILE_EVENTS
+#define PROCESS_CONF_PROFILE_EVENTS 16
+#endif /* PROCESS_CONF_PROFILE_EVENTS */
+
+/* The clock used by the profiler. A platform may provide a finer one
+   than the real-time clock, as an unsigned long count of
+   PROCESS_CONF_PROFILE_SECOND units. */
+#ifdef PROCESS_CONF_PROFILE_NOW
+#define PROCESS_PROFILE_NOW()  PROCESS_CONF_PROFILE_NOW()
+#define PROCESS_PROFILE_SECOND PROCESS_CONF_PROFILE_SECOND
+#else /* PROCESS_CONF_PROFILE_NOW */
+#define PROCESS_PROFILE_NOW()  RTIMER_NOW()
+#define PROCESS_PROFILE_SECOND RTIMER_SECOND
+#endif /* PROCESS_CONF_PROFILE_NOW */
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -312,6 +355,20 @@ static PT_THREAD(process_thread_##name(struct pt *process_pt,	\
 
 /** @} */
 
+#if PROCESS_CONF_PROFILE
+/**
+ * The CPU time used by a process, or by the handling of one type of
+ * event, in PROCESS_PROFILE_SECOND units. The time that a process
+ * spends in other processes that it calls synchronously is accounted
+ * to those processes.
+ */
+struct process_profile {
+  unsigned long time;
+  unsigned long calls;
+  unsigned long max;
+};
+#endif /* PROCESS_CONF_PROFILE */
+
 struct process {
   struct process *next;
 #if PROCESS_CONF_NO_PROCESS_NAMES
@@ -323,6 +380,11 @@ struct process {
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
   unsigned char state, needspoll;
+  unsigned char pollqueued;
+  struct process *nextpoll;
+#if PROCESS_CONF_PROFILE
+  struct process_profile profile;
+#endif /* PROCESS_CONF_PROFILE */
 };
 
 /**
@@ -361,9 +423,46 @@ CCIF void process_start(struct process *p, process_data_t data);
  *
  * \retval PROCESS_ERR_FULL The event queue was full and the event could
  * not be posted.
+ *
+ * If the event queue is full, but the same event with the same data
+ * is already waiting for the process, the process gets that event,
+ * and the post is counted in process_coalesced_events instead of
+ * process_dropped_events. The function still returns
+ * PROCESS_ERR_FULL.
  */
 CCIF int process_post(struct process *p, process_event_t ev, process_data_t data);
 
+/**
+ * Post an asynchronous event with high priority.
+ *
+ * This function works as process_post(), but the event is put in a
+ * small queue of events that are delivered before all events posted
+ * with process_post(). It is meant for events from the network stack
+ * and from device drivers, which should not wait behind application
+ * events. If the high priority queue is full, the event is posted as
+ * with process_post().
+ *
+ * The events are expected to be polls or timer expirations, where a
+ * second equal event adds nothing. If the same event with the same
+ * data is already waiting for the process in either queue, the two
+ * events are always delivered as one, even when the queues are not
+ * full.
+ *
+ * \param p The process to which the event should be posted, or
+ * PROCESS_BROADCAST if the event should be posted to all processes.
+ *
+ * \param ev The event to be posted.
+ *
+ * \param data The auxiliary data to be sent with the event
+ *
+ * \retval PROCESS_ERR_OK The event could be posted.
+ *
+ * \retval PROCESS_ERR_FULL The event queues were full and the event
+ * could not be posted.
+ */
+CCIF int process_post_high(struct process *p, process_event_t ev,
+                           process_data_t data);
+
 /**
  * Post a synchronous event to a process.
  *
@@ -439,6 +538,62 @@ process_current = p
  */
 #define PROCESS_CONTEXT_END(p) process_current = tmp_current; }
 
+#if PROCESS_CONF_SUBSCRIPTIONS
+/**
+ * A subscription of a process to a broadcast event.
+ *
+ * The structure is allocated by the subscriber, typically as a
+ * static variable, and must not be changed while it is in use.
+ */
+struct process_subscription {
+  struct process_subscription *next;
+  struct process *p;
+  process_event_t ev;
+};
+
+/**
+ * \brief      Subscribe a process to a broadcast event.
+ * \param s    The subscription structure.
+ * \param ev   The event.
+ * \param p    The process that subscribes to the event.
+ *
+ *             Once a process has subscribed to an event, broadcasts
+ *             of the event are only delivered to the processes that
+ *             have subscribed to it, instead of to every process.
+ *             Events that nobody has subscribed to are delivered to
+ *             every process, as before. The subscriptions of a
+ *             process are removed when the process exits.
+ */
+void process_subscribe(struct process_subscription *s, process_event_t ev,
+                       struct process *p);
+
+/**
+ * \brief      Remove a subscription to a broadcast event.
+ * \param s    The subscription structure.
+ */
+void process_unsubscribe(struct process_subscription *s);
+#endif /* PROCESS_CONF_SUBSCRIPTIONS */
+
+#if PROCESS_CONF_PROFILE
+/**
+ * \brief      Get the profile of a type of event.
+ * \param i    The index of the event type, starting at zero.
+ * \param ev   Set to the event.
+ * \return     The profile, or NULL if there are no more event types.
+ *
+ *             Events that arrive when PROCESS_CONF_PROFILE_EVENTS
+ *             types have been seen are accounted together, as
+ *             PROCESS_EVENT_NONE.
+ */
+const struct process_profile *process_profile_event(int i,
+                                                    process_event_t *ev);
+
+/**
+ * \brief      Clear the profiles of all processes and events.
+ */
+void process_profile_reset(void);
+#endif /* PROCESS_CONF_PROFILE */
+
 /**
  * \brief      Allocate a global event number.
  * \return     The allocated event number
@@ -463,7 +618,11 @@ CCIF process_event_t process_alloc_event(void);
  * Request a process to be polled.
  *
  * This function typically is called from an interrupt handler to
- * cause a process to be polled.
+ * cause a process to be polled. The process is put on a queue of
+ * processes to be polled, so that the scheduler does not have to look
+ * at every process. The function may be called from interrupts that
+ * preempt each other, as long as each interrupt handler runs to
+ * completion before the code that it preempted resumes.
  *
  * \param p A pointer to the process' process structure.
  */
@@ -54,8 +54,51 @@
 #define PRINTF(...)
 #endif
 
-static struct rtimer *next_rtimer;
+/* rtimer_run_next() pops tasks off the queue from the rtimer interrupt on
+   most platforms, so the queue is only changed, and the hardware timer
+   only reprogrammed, with that interrupt masked. An rtimer-arch.h that
+   runs rtimer_run_next() from an interrupt defines these: DISABLE masks
+   the interrupt and returns the previous state, of type STATE, which
+   RESTORE restores, so that they nest and may be used from a task. */
+#ifndef RTIMER_ARCH_INTERRUPTS_DISABLE
+#define RTIMER_ARCH_INTERRUPTS_STATE       int
+#define RTIMER_ARCH_INTERRUPTS_DISABLE()   0
+#define RTIMER_ARCH_INTERRUPTS_RESTORE(s)  (void)(s)
+#endif /* RTIMER_ARCH_INTERRUPTS_DISABLE */
 
+/* The pending real-time tasks, in the order they are due. Tasks that
+   are due at the same time are ordered by priority, highest first. */
+static struct rtimer *rtimer_list;
+
+/* Set while rtimer_run_next() executes tasks, so that tasks that are
+   set from a callback do not reprogram the hardware timer. */
+static unsigned char dispatching;
+
+/*---------------------------------------------------------------------------*/
+/* Remove a task from the queue, and return non-zero if it was there.
+   Called with the rtimer interrupt masked. */
+static int
+unlink_rtimer(struct rtimer *rtimer)
+{
+  struct rtimer **tp;
+
+  for(tp = &rtimer_list; *tp != NULL; tp = &(*tp)->next) {
+    if(*tp == rtimer) {
+      *tp = rtimer->next;
+      rtimer->next = NULL;
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule_first(void)
+{
+  if(rtimer_list != NULL && !dispatching) {
+    rtimer_arch_schedule(rtimer_list->time);
+  }
+}
 /*---------------------------------------------------------------------------*/
 void
 rtimer_init(void)
@@ -64,44 +107,123 @@ rtimer_init(void)
 }
 /*---------------------------------------------------------------------------*/
 int
-rtimer_set(struct rtimer *rtimer, rtimer_clock_t time,
-	   rtimer_clock_t duration,
-	   rtimer_callback_t func, void *ptr)
+rtimer_set_with_priority(struct rtimer *rtimer, rtimer_clock_t time,
+                         rtimer_clock_t duration,
+                         rtimer_callback_t func, void *ptr,
+                         unsigned char priority)
 {
-  int first = 0;
+  RTIMER_ARCH_INTERRUPTS_STATE state;
+  struct rtimer **tp;
+  struct rtimer *first;
 
-  PRINTF("rtimer_set time %d\n", time);
+  PRINTF("rtimer_set time %d priority %d\n", time, priority);
 
-  if(next_rtimer == NULL) {
-    first = 1;
-  }
+  state = RTIMER_ARCH_INTERRUPTS_DISABLE();
+  first = rtimer_list;
+
+  /* A task that is set again is moved to its new time. */
+  unlink_rtimer(rtimer);
 
   rtimer->func = func;
   rtimer->ptr = ptr;
-
   rtimer->time = time;
-  next_rtimer = rtimer;
+  rtimer->priority = priority;
+
+  /* Insert the task after all tasks that are due before it, or at the
+     same time with at least the same priority. */
+  for(tp = &rtimer_list; *tp != NULL; tp = &(*tp)->next) {
+    if(RTIMER_CLOCK_LT(time, (*tp)->time) ||
+       (time == (*tp)->time && priority > (*tp)->priority)) {
+      break;
+    }
+  }
+  rtimer->next = *tp;
+  *tp = rtimer;
 
-  if(first == 1) {
-    rtimer_arch_schedule(time);
+  if(rtimer_list == rtimer || rtimer_list != first) {
+    schedule_first();
   }
+  RTIMER_ARCH_INTERRUPTS_RESTORE(state);
   return RTIMER_OK;
 }
 /*---------------------------------------------------------------------------*/
+int
+rtimer_set(struct rtimer *rtimer, rtimer_clock_t time,
+	   rtimer_clock_t duration,
+	   rtimer_callback_t func, void *ptr)
+{
+  return rtimer_set_with_priority(rtimer, time, duration, func, ptr,
+                                  RTIMER_PRIORITY_NORMAL);
+}
+/*---------------------------------------------------------------------------*/
+int
+rtimer_cancel(struct rtimer *rtimer)
+{
+  RTIMER_ARCH_INTERRUPTS_STATE state;
+  struct rtimer *first;
+  int found;
+
+  state = RTIMER_ARCH_INTERRUPTS_DISABLE();
+  first = rtimer_list;
+  found = unlink_rtimer(rtimer);
+
+  /* The hardware timer may still fire for the cancelled task, but
+     rtimer_run_next() only executes tasks that are due. */
+  if(found && rtimer_list != first) {
+    schedule_first();
+  }
+  RTIMER_ARCH_INTERRUPTS_RESTORE(state);
+  return found;
+}
+/*---------------------------------------------------------------------------*/
+int
+rtimer_pending(struct rtimer *rtimer)
+{
+  RTIMER_ARCH_INTERRUPTS_STATE state;
+  struct rtimer *t;
+
+  state = RTIMER_ARCH_INTERRUPTS_DISABLE();
+  for(t = rtimer_list; t != NULL && t != rtimer; t = t->next);
+  RTIMER_ARCH_INTERRUPTS_RESTORE(state);
+  return t != NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+rtimer_next_expiration_time(rtimer_clock_t *time)
+{
+  RTIMER_ARCH_INTERRUPTS_STATE state;
+  struct rtimer *first;
+
+  state = RTIMER_ARCH_INTERRUPTS_DISABLE();
+  first = rtimer_list;
+  if(first != NULL) {
+    *time = first->time;
+  }
+  RTIMER_ARCH_INTERRUPTS_RESTORE(state);
+  return first != NULL;
+}
+/*---------------------------------------------------------------------------*/
 void
 rtimer_run_next(void)
 {
   struct rtimer *t;
-  if(next_rtimer == NULL) {
-    return;
-  }
-  t = next_rtimer;
-  next_rtimer = NULL;
-  t->func(t, t->ptr);
-  if(next_rtimer != NULL) {
-    rtimer_arch_schedule(next_rtimer->time);
+
+  dispatching = 1;
+
+  /* Execute every task that is due. A task that is due within the
+     guard time cannot be scheduled safely, so it is executed now. */
+  while(rtimer_list != NULL &&
+        !RTIMER_CLOCK_LT((rtimer_clock_t)(RTIMER_NOW() + RTIMER_GUARD_TIME),
+                         rtimer_list->time)) {
+    t = rtimer_list;
+    rtimer_list = t->next;
+    t->next = NULL;
+    t->func(t, t->ptr);
   }
-  return;
+
+  dispatching = 0;
+
+  schedule_first();
 }
 /*---------------------------------------------------------------------------*/
 
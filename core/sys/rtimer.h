@@ -84,9 +84,21 @@ typedef void (* rtimer_callback_t)(struct rtimer *t, void *ptr);
  *             support module for the real-time module.
  */
 struct rtimer {
+  struct rtimer *next;
   rtimer_clock_t time;
   rtimer_callback_t func;
   void *ptr;
+  unsigned char priority;
+};
+
+/**
+ * Priorities of real-time tasks. When several tasks are due at the
+ * same time, the task with the highest priority is executed first.
+ */
+enum {
+  RTIMER_PRIORITY_LOW = 0,
+  RTIMER_PRIORITY_NORMAL = 64,
+  RTIMER_PRIORITY_HIGH = 128,
 };
 
 enum {
@@ -114,10 +126,52 @@ int rtimer_set(struct rtimer *task, rtimer_clock_t time,
 	       rtimer_clock_t duration, rtimer_callback_t func, void *ptr);
 
 /**
- * \brief      Execute the next real-time task and schedule the next task, if any
+ * \brief      Post a real-time task with a priority.
+ * \param task A pointer to the task variable previously declared with RTIMER_TASK().
+ * \param time The time when the task is to be executed.
+ * \param duration Unused argument.
+ * \param func A function to be called when the task is executed.
+ * \param ptr An opaque pointer that will be supplied as an argument to the callback function.
+ * \param priority The priority of the task, e.g. RTIMER_PRIORITY_HIGH.
+ * \return     RTIMER_OK if the task could be scheduled.
+ *
+ *             This function works as rtimer_set(), but the task is
+ *             executed before tasks with a lower priority that are
+ *             due at the same time. A task that is already pending
+ *             is moved to the new time.
+ */
+int rtimer_set_with_priority(struct rtimer *task, rtimer_clock_t time,
+                             rtimer_clock_t duration, rtimer_callback_t func,
+                             void *ptr, unsigned char priority);
+
+/**
+ * \brief      Cancel a pending real-time task.
+ * \param task The task
+ * \return     Non-zero if the task was pending, zero otherwise.
+ */
+int rtimer_cancel(struct rtimer *task);
+
+/**
+ * \brief      Check if a real-time task is pending.
+ * \param task The task
+ * \return     Non-zero if the task is waiting to be executed.
+ */
+int rtimer_pending(struct rtimer *task);
+
+/**
+ * \brief      Get the time of the next pending real-time task.
+ * \param time Set to the time of the next task, if there is one
+ * \return     Non-zero if a task is pending, zero otherwise.
+ */
+int rtimer_next_expiration_time(rtimer_clock_t *time);
+
+/**
+ * \brief      Execute the real-time tasks that are due and schedule the next task, if any
  *
  *             This function is called by the architecture dependent
  *             code to execute and schedule the next real-time task.
+ *             All tasks that are due are executed in one call, and
+ *             the hardware timer is programmed once afterwards.
  *
  */
 void rtimer_run_next(void);
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \addtogroup tickless
+ * @{
+ */
+
+/**
+ * \file
+ *         Tickless idle support
+ */
+
+#include "sys/tickless.h"
+
+static unsigned long wakeups;
+static unsigned long idle_ticks;
+static clock_time_t idle_start;
+
+/*---------------------------------------------------------------------------*/
+clock_time_t
+tickless_next_wakeup(void)
+{
+  clock_time_t now, ticks, left;
+  rtimer_clock_t rnow, rtime;
+
+  if(process_nevents() > 0) {
+    return 0;
+  }
+
+  ticks = TICKLESS_MAX_SLEEP;
+
+  if(etimer_pending()) {
+    now = clock_time();
+    left = etimer_next_expiration_time() - now;
+    if(left < ticks) {
+      ticks = left;
+    }
+  }
+
+  if(rtimer_next_expiration_time(&rtime)) {
+    rnow = RTIMER_NOW();
+    if(RTIMER_CLOCK_LT(rtime, rnow)) {
+      return 0;
+    }
+    /* Round down, as waking up early is harmless. */
+    left = (unsigned long)(rtimer_clock_t)(rtime - rnow) * CLOCK_SECOND /
+      RTIMER_SECOND;
+    if(left < ticks) {
+      ticks = left;
+    }
+  }
+
+  return ticks;
+}
+/*---------------------------------------------------------------------------*/
+clock_time_t
+tickless_idle_begin(void)
+{
+  idle_start = clock_time();
+  return tickless_next_wakeup();
+}
+/*---------------------------------------------------------------------------*/
+void
+tickless_idle_end(void)
+{
+  wakeups++;
+  idle_ticks += clock_time() - idle_start;
+}
+/*---------------------------------------------------------------------------*/
+unsigned long
+tickless_wakeups(void)
+{
+  return wakeups;
+}
+/*---------------------------------------------------------------------------*/
+unsigned long
+tickless_wakeups_per_hour(void)
+{
+  unsigned long seconds;
+
+  seconds = idle_ticks / CLOCK_SECOND;
+  if(seconds == 0) {
+    return 0;
+  }
+  return wakeups * 60 / seconds * 60;
+}
+/*---------------------------------------------------------------------------*/
+void
+tickless_reset_stats(void)
+{
+  wakeups = 0;
+  idle_ticks = 0;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Tickless idle support
+ */
+
+/** \addtogroup sys
+ * @{ */
+
+/**
+ * \defgroup tickless Tickless idle
+ *
+ * A platform that sleeps between calls to process_run() normally
+ * wakes up on every clock tick, whether or not anything is due. In
+ * tickless mode, the platform main loop asks for the time until the
+ * next deadline before it sleeps, programs a single wakeup for it,
+ * and brings clock_time() up to date when it wakes up.
+ *
+ * The next deadline is the earliest of the next event timer and the
+ * next real-time task. Callback timers are covered by the event timer
+ * of the ctimer process.
+ *
+ * The main loop calls tickless_idle_begin() with interrupts disabled
+ * before it goes to sleep, and tickless_idle_end() when it wakes up.
+ * The number of wakeups and the time spent idle are recorded, so that
+ * tickless_wakeups_per_hour() can show the effect on a running node.
+ *
+ * @{
+ */
+
+#ifndef TICKLESS_H_
+#define TICKLESS_H_
+
+#include "contiki.h"
+
+#ifdef TICKLESS_CONF_ENABLED
+#define TICKLESS_ENABLED TICKLESS_CONF_ENABLED
+#else /* TICKLESS_CONF_ENABLED */
+#define TICKLESS_ENABLED 0
+#endif /* TICKLESS_CONF_ENABLED */
+
+/** The longest time, in clock ticks, that tickless_idle_begin()
+    asks the platform to sleep. Platforms may sleep for less. */
+#ifdef TICKLESS_CONF_MAX_SLEEP
+#define TICKLESS_MAX_SLEEP TICKLESS_CONF_MAX_SLEEP
+#else /* TICKLESS_CONF_MAX_SLEEP */
+#define TICKLESS_MAX_SLEEP (60 * CLOCK_SECOND)
+#endif /* TICKLESS_CONF_MAX_SLEEP */
+
+/**
+ * \brief      Get the time until the next deadline
+ * \return     The number of clock ticks until the next timer is due,
+ *             zero if there is work to do now, or TICKLESS_MAX_SLEEP
+ *             if nothing is due before then.
+ */
+clock_time_t tickless_next_wakeup(void);
+
+/**
+ * \brief      Start an idle period
+ * \return     The number of clock ticks the platform may sleep
+ *
+ *             This function is called by the platform main loop,
+ *             with interrupts disabled, just before it goes to sleep.
+ */
+clock_time_t tickless_idle_begin(void);
+
+/**
+ * \brief      End an idle period
+ *
+ *             This function is called by the platform main loop when
+ *             it wakes up, after clock_time() has been brought up to
+ *             date.
+ */
+void tickless_idle_end(void);
+
+/**
+ * \brief      Get the number of times the platform has woken up
+ */
+unsigned long tickless_wakeups(void);
+
+/**
+ * \brief      Get the wakeup rate
+ * \return     The number of wakeups per hour of idle time, or zero if
+ *             the platform has been idle for less than a second.
+ */
+unsigned long tickless_wakeups_per_hour(void);
+
+/**
+ * \brief      Reset the wakeup statistics
+ */
+void tickless_reset_stats(void);
+
+/**
+ * \name Platform functions
+ *
+ * A platform that implements tickless idle in hardware provides these
+ * functions from its clock module.
+ * @{
+ */
+
+/**
+ * \brief      Stop the periodic tick until the next deadline
+ * \param ticks The number of clock ticks until the next deadline
+ *
+ *             Called with interrupts disabled. The platform wakes up
+ *             after at most \c ticks clock ticks.
+ */
+void clock_set_wakeup(clock_time_t ticks);
+
+/**
+ * \brief      Bring clock_time() up to date after sleeping, and
+ *             restart the periodic tick
+ */
+void clock_update(void);
+
+/** @} */
+
+#endif /* TICKLESS_H_ */
+
+/** @} */
+/** @} */
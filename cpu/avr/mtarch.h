@@ -55,5 +55,12 @@ struct mtarch_thread {
   unsigned char *sp;
 };
 
+struct mt_thread;
+
+/* The stack usage of mt.h is supported. */
+#define MTARCH_STACK_USAGE 1
+
+int mtarch_stack_usage(struct mt_thread *t);
+
 #endif /* MTARCH_H_ */
 	
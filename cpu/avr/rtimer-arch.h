@@ -68,4 +68,17 @@
 #endif
 
 void rtimer_arch_sleep(rtimer_clock_t howlong);
+
+/* rtimer_run_next() runs from the timer compare interrupt */
+#define RTIMER_ARCH_INTERRUPTS_STATE       uint8_t
+#define RTIMER_ARCH_INTERRUPTS_DISABLE()   rtimer_arch_interrupts_disable()
+#define RTIMER_ARCH_INTERRUPTS_RESTORE(s)  (SREG = (s))
+
+static inline uint8_t
+rtimer_arch_interrupts_disable(void)
+{
+  uint8_t sreg = SREG;
+  cli();
+  return sreg;
+}
 #endif /* RTIMER_ARCH_H_ */
@@ -62,6 +62,7 @@
 
 #include "contiki.h"
 #include "dev/gptimer.h"
+#include "cpu.h"
 
 #define RTIMER_ARCH_SECOND 32768
 
@@ -88,6 +89,12 @@ rtimer_clock_t rtimer_arch_now(void);
  */
 rtimer_clock_t rtimer_arch_next_trigger(void);
 
+/* rtimer_run_next() runs from the sleep timer interrupt. The state is
+ * PRIMASK: zero if interrupts were enabled. */
+#define RTIMER_ARCH_INTERRUPTS_STATE       unsigned long
+#define RTIMER_ARCH_INTERRUPTS_DISABLE()   INTERRUPTS_DISABLE()
+#define RTIMER_ARCH_INTERRUPTS_RESTORE(s)  do { if(!(s)) { INTERRUPTS_ENABLE(); } } while(0)
+
 #endif /* RTIMER_ARCH_H_ */
 
 /**
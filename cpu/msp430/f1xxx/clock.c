@@ -33,6 +33,7 @@
 #include "sys/energest.h"
 #include "sys/clock.h"
 #include "sys/etimer.h"
+#include "sys/tickless.h"
 #include "rtimer-arch.h"
 #include "dev/watchdog.h"
 #include "isr_compat.h"
@@ -48,6 +49,9 @@ static volatile unsigned long seconds;
 static volatile clock_time_t count = 0;
 /* last_tar is used for calculating clock_fine */
 static volatile uint16_t last_tar = 0;
+/* The timer value of the next clock tick. TACCR1 is set further
+   ahead than this while the tick is stopped by clock_set_wakeup(). */
+static volatile uint16_t next_tick = INTERVAL;
 /*---------------------------------------------------------------------------*/
 static inline uint16_t
 read_tar(void)
@@ -61,6 +65,33 @@ read_tar(void)
   return t1;
 }
 /*---------------------------------------------------------------------------*/
+/* Count the ticks that have passed, and set the timer for the next one. */
+static void
+update_count(void)
+{
+  last_tar = read_tar();
+  /* Make sure interrupt time is future */
+  while(!CLOCK_LT(last_tar, next_tick)) {
+    next_tick += INTERVAL;
+    ++count;
+
+    /* Make sure the CLOCK_CONF_SECOND is a power of two, to ensure
+       that the modulo operation below becomes a logical and and not
+       an expensive divide. Algorithm from Wikipedia:
+       http://en.wikipedia.org/wiki/Power_of_two */
+#if (CLOCK_CONF_SECOND & (CLOCK_CONF_SECOND - 1)) != 0
+#error CLOCK_CONF_SECOND must be a power of two (i.e., 1, 2, 4, 8, 16, 32, 64, ...).
+#error Change CLOCK_CONF_SECOND in contiki-conf.h.
+#endif
+    if(count % CLOCK_CONF_SECOND == 0) {
+      ++seconds;
+      energest_flush();
+    }
+    last_tar = read_tar();
+  }
+  TACCR1 = next_tick;
+}
+/*---------------------------------------------------------------------------*/
 ISR(TIMERA1, timera1)
 {
   ENERGEST_ON(ENERGEST_TYPE_IRQ);
@@ -73,27 +104,14 @@ ISR(TIMERA1, timera1)
      * Occurs when timer state is toggled between STOP and CONT. */
     while(TACTL & MC1 && TACCR1 - read_tar() == 1);
 
-    last_tar = read_tar();
-    /* Make sure interrupt time is future */
-    while(!CLOCK_LT(last_tar, TACCR1)) {
-      TACCR1 += INTERVAL;
-      ++count;
-
-      /* Make sure the CLOCK_CONF_SECOND is a power of two, to ensure
-         that the modulo operation below becomes a logical and and not
-         an expensive divide. Algorithm from Wikipedia:
-         http://en.wikipedia.org/wiki/Power_of_two */
-#if (CLOCK_CONF_SECOND & (CLOCK_CONF_SECOND - 1)) != 0
-#error CLOCK_CONF_SECOND must be a power of two (i.e., 1, 2, 4, 8, 16, 32, 64, ...).
-#error Change CLOCK_CONF_SECOND in contiki-conf.h.
-#endif
-      if(count % CLOCK_CONF_SECOND == 0) {
-        ++seconds;
-        energest_flush();
-      }
-      last_tar = read_tar();
+    /* A wakeup set by clock_set_wakeup() returns to the main loop, so
+       that it can set the next one. */
+    if(TACCR1 != next_tick) {
+      LPM4_EXIT;
     }
 
+    update_count();
+
     if(etimer_pending() &&
        (etimer_next_expiration_time() - count - 1) > MAX_TICKS) {
       etimer_request_poll();
@@ -125,7 +143,8 @@ void
 clock_set(clock_time_t clock, clock_time_t fclock)
 {
   TAR = fclock;
-  TACCR1 = fclock + INTERVAL;
+  next_tick = fclock + INTERVAL;
+  TACCR1 = next_tick;
   count = clock;
 }
 /*---------------------------------------------------------------------------*/
@@ -172,7 +191,8 @@ clock_init(void)
   TACCTL1 = CCIE;
 
   /* Interrupt after X ms. */
-  TACCR1 = INTERVAL;
+  next_tick = INTERVAL;
+  TACCR1 = next_tick;
 
   /* Start Timer_A in continuous mode. */
   TACTL |= MC1;
@@ -239,3 +259,26 @@ clock_counter(void)
   return t1;
 }
 /*---------------------------------------------------------------------------*/
+void
+clock_set_wakeup(clock_time_t ticks)
+{
+  /* The wakeup must stay within half a timer period, or it is taken
+     for a time in the past. */
+  if(ticks > 0x7fff / INTERVAL) {
+    ticks = 0x7fff / INTERVAL;
+  }
+  if(ticks > 1) {
+    TACCR1 = next_tick + (uint16_t)(ticks - 1) * INTERVAL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+clock_update(void)
+{
+  int s;
+
+  s = splhigh();
+  update_count();
+  splx(s);
+}
+/*---------------------------------------------------------------------------*/
@@ -34,7 +34,11 @@
 #include "contiki.h"
 
 #ifndef MTARCH_STACKSIZE
+#ifdef MTARCH_CONF_STACKSIZE
+#define MTARCH_STACKSIZE MTARCH_CONF_STACKSIZE
+#else /* MTARCH_CONF_STACKSIZE */
 #define MTARCH_STACKSIZE 128
+#endif /* MTARCH_CONF_STACKSIZE */
 #endif /* MTARCH_STACKSIZE */
 
 struct mtarch_thread {
@@ -46,6 +50,9 @@ struct mtarch_thread {
 
 struct mt_thread;
 
+/* The stack usage of mt.h is supported, in words. */
+#define MTARCH_STACK_USAGE 1
+
 int mtarch_stack_usage(struct mt_thread *t);
 
 #endif /* MTARCH_H_ */
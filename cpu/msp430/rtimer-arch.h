@@ -41,6 +41,7 @@
 #define RTIMER_ARCH_H_
 
 #include "sys/rtimer.h"
+#include "msp430def.h"
 
 #ifdef RTIMER_CONF_SECOND
 #define RTIMER_ARCH_SECOND RTIMER_CONF_SECOND
@@ -64,4 +65,9 @@
 
 rtimer_clock_t rtimer_arch_now(void);
 
+/* rtimer_run_next() runs from the timer interrupt */
+#define RTIMER_ARCH_INTERRUPTS_STATE       spl_t
+#define RTIMER_ARCH_INTERRUPTS_DISABLE()   splhigh()
+#define RTIMER_ARCH_INTERRUPTS_RESTORE(s)  splx(s)
+
 #endif /* RTIMER_ARCH_H_ */
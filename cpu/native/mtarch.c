@@ -33,11 +33,35 @@
  */
 
 #include "sys/mt.h"
+#include "lib/memb.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #ifndef MTARCH_STACKSIZE
+#ifdef MTARCH_CONF_STACKSIZE
+#define MTARCH_STACKSIZE MTARCH_CONF_STACKSIZE
+#else /* MTARCH_CONF_STACKSIZE */
 #define MTARCH_STACKSIZE 4096
+#endif /* MTARCH_CONF_STACKSIZE */
 #endif /* MTARCH_STACKSIZE */
 
+/* The number of thread stacks that are kept in a pool. Threads that
+   are started when the pool is empty get their stack from malloc(). */
+#ifdef MTARCH_CONF_STACKS
+#define MTARCH_STACKS MTARCH_CONF_STACKS
+#else /* MTARCH_CONF_STACKS */
+#define MTARCH_STACKS 8
+#endif /* MTARCH_CONF_STACKS */
+
+/* Unused stack is filled with this value, so that the deepest use of
+   the stack can be found later. The lowest bytes of the stack serve
+   as a canary: if they change, the stack has overflowed. */
+#define STACK_FILL   0xa5
+#define CANARY_SIZE  16
+
 #if defined(_WIN32) || defined(__CYGWIN__)
 
 #define WIN32_LEAN_AND_MEAN
@@ -45,6 +69,57 @@
 
 static void *main_fiber;
 
+#elif defined(__linux) && defined(__x86_64__)
+
+/* Threads are switched by saving the callee-saved registers on the
+   stack and exchanging the stack pointers, which is much cheaper
+   than swapcontext(), as that also saves the signal mask with a
+   system call on every switch. */
+#define FAST_SWITCH 1
+
+struct mtarch_t {
+  void *sp;
+  unsigned char stack[MTARCH_STACKSIZE] __attribute__((aligned(16)));
+};
+
+static void *main_sp;
+static struct mtarch_t *running;
+
+void mtarch_switch(void **save_sp, void *sp);
+void mtarch_entry(void);
+
+/* mtarch_switch(save_sp, sp) pushes the callee-saved registers, saves
+   the stack pointer in *save_sp, and pops the registers of the stack
+   at sp. A new thread starts in mtarch_entry(), with the function in
+   r13 and its argument in r12. */
+__asm__(".text\n"
+        ".globl mtarch_switch\n"
+        ".type mtarch_switch, @function\n"
+        "mtarch_switch:\n"
+        "  pushq %rbp\n"
+        "  pushq %rbx\n"
+        "  pushq %r12\n"
+        "  pushq %r13\n"
+        "  pushq %r14\n"
+        "  pushq %r15\n"
+        "  movq %rsp, (%rdi)\n"
+        "  movq %rsi, %rsp\n"
+        "  popq %r15\n"
+        "  popq %r14\n"
+        "  popq %r13\n"
+        "  popq %r12\n"
+        "  popq %rbx\n"
+        "  popq %rbp\n"
+        "  ret\n"
+        ".size mtarch_switch, .-mtarch_switch\n"
+        ".globl mtarch_entry\n"
+        ".type mtarch_entry, @function\n"
+        "mtarch_entry:\n"
+        "  movq %r12, %rdi\n"
+        "  callq *%r13\n"
+        "  callq mt_exit\n"
+        ".size mtarch_entry, .-mtarch_entry\n");
+
 #elif defined(__linux) || defined(__APPLE__)
 
 #ifdef __APPLE__
@@ -52,7 +127,6 @@ static void *main_fiber;
 #define _XOPEN_SOURCE
 #endif
 
-#include <stdlib.h>
 #include <signal.h>
 #include <ucontext.h>
 
@@ -66,6 +140,11 @@ static ucontext_t *running_context;
 
 #endif /* _WIN32 || __CYGWIN__ || __linux */
 
+#if defined(__linux)
+MEMB(stacks, struct mtarch_t, MTARCH_STACKS);
+static unsigned long stack_memory = sizeof(stacks_memb_mem);
+#endif /* __linux */
+
 /*--------------------------------------------------------------------------*/
 void
 mtarch_init(void)
@@ -74,7 +153,11 @@ mtarch_init(void)
 
   main_fiber = ConvertThreadToFiber(NULL);
 
-#endif /* _WIN32 || __CYGWIN__ */
+#elif defined(__linux)
+
+  memb_init(&stacks);
+
+#endif /* _WIN32 || __CYGWIN__ || __linux */
 }
 /*--------------------------------------------------------------------------*/
 void
@@ -98,15 +181,41 @@ mtarch_start(struct mtarch_thread *thread,
 
 #elif defined(__linux)
 
-  thread->mt_thread = malloc(sizeof(struct mtarch_t));
-
-  getcontext(&((struct mtarch_t *)thread->mt_thread)->context);
-
-  ((struct mtarch_t *)thread->mt_thread)->context.uc_link = NULL;
-  ((struct mtarch_t *)thread->mt_thread)->context.uc_stack.ss_sp = 
-			((struct mtarch_t *)thread->mt_thread)->stack;
-  ((struct mtarch_t *)thread->mt_thread)->context.uc_stack.ss_size = 
-			sizeof(((struct mtarch_t *)thread->mt_thread)->stack);
+  struct mtarch_t *t;
+
+  t = memb_alloc(&stacks);
+  if(t == NULL) {
+    t = malloc(sizeof(struct mtarch_t));
+    stack_memory += sizeof(struct mtarch_t);
+  }
+  thread->mt_thread = t;
+
+  memset(t->stack, STACK_FILL, sizeof(t->stack));
+
+#if FAST_SWITCH
+  {
+    void **sp;
+
+    /* The frame that mtarch_switch() pops: six registers and the
+       return address, placed so that the stack is aligned as the ABI
+       requires when mtarch_entry() calls the function. */
+    sp = (void **)((uintptr_t)(t->stack + sizeof(t->stack)) & ~(uintptr_t)15);
+    sp -= 2;
+    *--sp = (void *)mtarch_entry;
+    *--sp = NULL;                   /* rbp */
+    *--sp = NULL;                   /* rbx */
+    *--sp = data;                   /* r12 */
+    *--sp = (void *)function;       /* r13 */
+    *--sp = NULL;                   /* r14 */
+    *--sp = NULL;                   /* r15 */
+    t->sp = sp;
+  }
+#else /* FAST_SWITCH */
+  getcontext(&t->context);
+
+  t->context.uc_link = NULL;
+  t->context.uc_stack.ss_sp = t->stack;
+  t->context.uc_stack.ss_size = sizeof(t->stack);
 
   /* Some notes:
      - If a CPU needs stronger alignment for the stack than malloc()
@@ -123,8 +232,8 @@ mtarch_start(struct mtarch_thread *thread,
        the only way to stay independent from the CPU architecture. But
        Solaris prior to release 10 interprets ss_sp as highest stack
        address thus requiring special handling. */
-  makecontext(&((struct mtarch_t *)thread->mt_thread)->context,
-	      (void (*)(void))function, 1, data);
+  makecontext(&t->context, (void (*)(void))function, 1, data);
+#endif /* FAST_SWITCH */
 
 #endif /* _WIN32 || __CYGWIN__ || __linux */
 }
@@ -136,6 +245,10 @@ mtarch_yield(void)
 
   SwitchToFiber(main_fiber);
 
+#elif defined(__linux) && FAST_SWITCH
+
+  mtarch_switch(&running->sp, main_sp);
+
 #elif defined(__linux)
 
   swapcontext(running_context, &main_context);
@@ -152,9 +265,23 @@ mtarch_exec(struct mtarch_thread *thread)
 
 #elif defined(__linux)
 
+#if FAST_SWITCH
+  running = thread->mt_thread;
+  mtarch_switch(&main_sp, running->sp);
+  running = NULL;
+#else /* FAST_SWITCH */
   running_context = &((struct mtarch_t *)thread->mt_thread)->context;
   swapcontext(&main_context, running_context);
   running_context = NULL;
+#endif /* FAST_SWITCH */
+
+  /* The memory below the stack has been overwritten; carrying on
+     would only hide where. */
+  if(mtarch_stack_overflowed(thread)) {
+    fprintf(stderr, "mtarch: thread stack overflow, increase "
+            "MTARCH_CONF_STACKSIZE (%d)\n", MTARCH_STACKSIZE);
+    abort();
+  }
 
 #endif /* _WIN32 || __CYGWIN__ || __linux */
 }
@@ -168,7 +295,13 @@ mtarch_stop(struct mtarch_thread *thread)
 
 #elif defined(linux) || defined(__linux)
 
-  free(thread->mt_thread);
+  if(memb_inmemb(&stacks, thread->mt_thread)) {
+    memb_free(&stacks, thread->mt_thread);
+  } else {
+    free(thread->mt_thread);
+    stack_memory -= sizeof(struct mtarch_t);
+  }
+  thread->mt_thread = NULL;
 
 #endif /* _WIN32 || __CYGWIN__ || __linux */
 }
@@ -183,3 +316,42 @@ mtarch_pstop(void)
 {
 }
 /*--------------------------------------------------------------------------*/
+#if defined(__linux)
+int
+mtarch_stack_usage(struct mt_thread *t)
+{
+  const unsigned char *stack;
+  int i;
+
+  stack = ((struct mtarch_t *)t->thread.mt_thread)->stack;
+  for(i = 0; i < MTARCH_STACKSIZE; ++i) {
+    if(stack[i] != STACK_FILL) {
+      return MTARCH_STACKSIZE - i;
+    }
+  }
+
+  return 0;
+}
+/*--------------------------------------------------------------------------*/
+int
+mtarch_stack_overflowed(struct mtarch_thread *thread)
+{
+  const unsigned char *stack;
+  int i;
+
+  stack = ((struct mtarch_t *)thread->mt_thread)->stack;
+  for(i = 0; i < CANARY_SIZE; ++i) {
+    if(stack[i] != STACK_FILL) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*--------------------------------------------------------------------------*/
+unsigned long
+mtarch_stack_memory(void)
+{
+  return stack_memory;
+}
+/*--------------------------------------------------------------------------*/
+#endif /* __linux */
@@ -39,4 +39,22 @@ struct mtarch_thread {
   void *mt_thread;
 };
 
+struct mt_thread;
+
+/* The stack usage and overflow check of mt.h are supported. */
+#define MTARCH_STACK_USAGE 1
+#define MTARCH_STACK_CHECK 1
+
+/* The largest number of bytes of the stack of a thread that have
+   been in use since the thread was started. */
+int mtarch_stack_usage(struct mt_thread *t);
+
+/* Non-zero if a thread has used more than its stack. This is also
+   checked every time the thread yields. */
+int mtarch_stack_overflowed(struct mtarch_thread *thread);
+
+/* The number of bytes of memory taken by thread stacks, including
+   the stacks in the pool that are not in use. */
+unsigned long mtarch_stack_memory(void);
+
 #endif /* MTARCH_H_ */
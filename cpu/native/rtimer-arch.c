@@ -70,6 +70,25 @@ rtimer_arch_init(void)
 #endif /* !_WIN32 */
 }
 /*---------------------------------------------------------------------------*/
+#ifndef _WIN32
+sigset_t
+rtimer_arch_interrupts_disable(void)
+{
+  sigset_t mask, state;
+
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGALRM);
+  sigprocmask(SIG_BLOCK, &mask, &state);
+  return state;
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_interrupts_restore(const sigset_t *state)
+{
+  sigprocmask(SIG_SETMASK, state, NULL);
+}
+#endif /* !_WIN32 */
+/*---------------------------------------------------------------------------*/
 void
 rtimer_arch_schedule(rtimer_clock_t t)
 {
@@ -78,9 +97,15 @@ rtimer_arch_schedule(rtimer_clock_t t)
   rtimer_clock_t c;
 
   c = t - (unsigned short)clock_time();
-  
-  val.it_value.tv_sec = c / 1000;
-  val.it_value.tv_usec = (c % 1000) * 1000;
+
+  if(RTIMER_CLOCK_DIFF(t, (rtimer_clock_t)clock_time()) <= 0) {
+    /* The task is already due. A zero value would disarm the timer. */
+    val.it_value.tv_sec = 0;
+    val.it_value.tv_usec = 1;
+  } else {
+    val.it_value.tv_sec = c / 1000;
+    val.it_value.tv_usec = (c % 1000) * 1000;
+  }
 
   PRINTF("rtimer_arch_schedule time %u %u in %d.%d seconds\n", t, c, c / 1000,
 	 (c % 1000) * 1000);
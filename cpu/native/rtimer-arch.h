@@ -46,4 +46,16 @@
 
 #define rtimer_arch_now() clock_time()
 
+#ifndef _WIN32
+#include <signal.h>
+
+/* rtimer_run_next() runs from the SIGALRM handler */
+#define RTIMER_ARCH_INTERRUPTS_STATE       sigset_t
+#define RTIMER_ARCH_INTERRUPTS_DISABLE()   rtimer_arch_interrupts_disable()
+#define RTIMER_ARCH_INTERRUPTS_RESTORE(s)  rtimer_arch_interrupts_restore(&(s))
+
+sigset_t rtimer_arch_interrupts_disable(void);
+void rtimer_arch_interrupts_restore(const sigset_t *state);
+#endif /* !_WIN32 */
+
 #endif /* RTIMER_ARCH_H_ */
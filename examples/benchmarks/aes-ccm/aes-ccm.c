@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Known-answer tests of the software AES-128 drivers and of
+ *         CCM*, and their speed per byte. Build with AES=<driver> for
+ *         the driver under CCM*.
+ */
+
+#include "contiki.h"
+#include "lib/aes-128.h"
+#include "lib/ccm-star.h"
+#include "lib/random.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BLOCKS      2000000UL
+#define FRAMES      200000UL
+#define FRAME_HDR   21
+#define FRAME_DATA  100
+#define MIC_LEN     8
+
+static const struct {
+  const char *name;
+  const struct aes_128_driver *driver;
+} drivers[] = {
+  { "byte-wise", &aes_128_driver },
+  { "compact", &aes_128_compact_driver },
+  { "t-table", &aes_128_ttable_driver },
+};
+#define DRIVERS (sizeof(drivers) / sizeof(drivers[0]))
+
+/* FIPS-197, appendices B and C.1 */
+static const uint8_t fips_key[2][AES_128_KEY_LENGTH] = {
+  { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c },
+  { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f },
+};
+static const uint8_t fips_plaintext[2][AES_128_BLOCK_SIZE] = {
+  { 0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d,
+    0x31, 0x31, 0x98, 0xa2, 0xe0, 0x37, 0x07, 0x34 },
+  { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff },
+};
+static const uint8_t fips_ciphertext[2][AES_128_BLOCK_SIZE] = {
+  { 0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb,
+    0xdc, 0x11, 0x85, 0x97, 0x19, 0x6a, 0x0b, 0x32 },
+  { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+    0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a },
+};
+
+/* RFC 3610, packet vector #1 */
+static const uint8_t ccm_key[AES_128_KEY_LENGTH] = {
+  0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+  0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf
+};
+static const uint8_t ccm_nonce[CCM_STAR_NONCE_LENGTH] = {
+  0x00, 0x00, 0x00, 0x03, 0x02, 0x01, 0x00, 0xa0,
+  0xa1, 0xa2, 0xa3, 0xa4, 0xa5
+};
+static const uint8_t ccm_a[8] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07
+};
+static const uint8_t ccm_ciphertext[23] = {
+  0x58, 0x8c, 0x97, 0x9a, 0x61, 0xc6, 0x63, 0xd2,
+  0xf0, 0x66, 0xd0, 0xc2, 0xc0, 0xf9, 0x89, 0x80,
+  0x6d, 0x5f, 0x6b, 0x61, 0xda, 0xc3, 0x84
+};
+static const uint8_t ccm_mic[MIC_LEN] = {
+  0x17, 0xe8, 0xd1, 0x2c, 0xfd, 0xf9, 0x26, 0xe0
+};
+
+static uint8_t frame[FRAME_HDR + FRAME_DATA + MIC_LEN];
+
+PROCESS(aes_ccm_process, "AES-128 and CCM* benchmark");
+AUTOSTART_PROCESSES(&aes_ccm_process);
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(fips, "The drivers give the FIPS-197 ciphertexts");
+UNIT_TEST_REGISTER(agree, "The drivers agree on random keys and data");
+UNIT_TEST_REGISTER(ccm, "CCM* gives the RFC 3610 ciphertext and MIC");
+UNIT_TEST_REGISTER(round_trip, "CCM* decrypts and verifies what it encrypts");
+
+UNIT_TEST(fips)
+{
+  uint8_t block[AES_128_BLOCK_SIZE];
+  int d, v;
+
+  UNIT_TEST_BEGIN();
+
+  for(d = 0; d < DRIVERS; d++) {
+    for(v = 0; v < 2; v++) {
+      drivers[d].driver->set_key(fips_key[v]);
+      memcpy(block, fips_plaintext[v], AES_128_BLOCK_SIZE);
+      drivers[d].driver->encrypt(block);
+      UNIT_TEST_ASSERT(!memcmp(block, fips_ciphertext[v], AES_128_BLOCK_SIZE));
+    }
+  }
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(agree)
+{
+  uint8_t key[AES_128_KEY_LENGTH];
+  uint8_t block[DRIVERS][AES_128_BLOCK_SIZE];
+  int d, i, n;
+
+  UNIT_TEST_BEGIN();
+
+  for(n = 0; n < 100; n++) {
+    for(i = 0; i < AES_128_KEY_LENGTH; i++) {
+      key[i] = random_rand();
+      block[0][i] = random_rand();
+    }
+    for(d = 0; d < DRIVERS; d++) {
+      memcpy(block[d], block[0], AES_128_BLOCK_SIZE);
+    }
+    for(d = 0; d < DRIVERS; d++) {
+      drivers[d].driver->set_key(key);
+      /* Twice, so that the output is the input of the next block */
+      drivers[d].driver->encrypt(block[d]);
+      drivers[d].driver->encrypt(block[d]);
+    }
+    for(d = 1; d < DRIVERS; d++) {
+      UNIT_TEST_ASSERT(!memcmp(block[d], block[0], AES_128_BLOCK_SIZE));
+    }
+  }
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(ccm)
+{
+  uint8_t m[sizeof(ccm_ciphertext)];
+  uint8_t mic[MIC_LEN];
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  for(i = 0; i < sizeof(m); i++) {
+    m[i] = 0x08 + i;
+  }
+  CCM_STAR.set_key(ccm_key);
+  CCM_STAR.aead(ccm_nonce, m, sizeof(m), ccm_a, sizeof(ccm_a),
+                mic, MIC_LEN, 1);
+  UNIT_TEST_ASSERT(!memcmp(m, ccm_ciphertext, sizeof(m)));
+  UNIT_TEST_ASSERT(!memcmp(mic, ccm_mic, MIC_LEN));
+
+  CCM_STAR.aead(ccm_nonce, m, sizeof(m), ccm_a, sizeof(ccm_a),
+                mic, MIC_LEN, 0);
+  UNIT_TEST_ASSERT(m[0] == 0x08 && m[sizeof(m) - 1] == 0x08 + sizeof(m) - 1);
+  UNIT_TEST_ASSERT(!memcmp(mic, ccm_mic, MIC_LEN));
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(round_trip)
+{
+  static const uint8_t lengths[] = { 0, 1, 15, 16, 17, 32, 100 };
+  uint8_t plaintext[FRAME_DATA];
+  uint8_t mic[MIC_LEN];
+  uint8_t check[MIC_LEN];
+  int i, l;
+
+  UNIT_TEST_BEGIN();
+
+  CCM_STAR.set_key(ccm_key);
+  for(l = 0; l < sizeof(lengths); l++) {
+    for(i = 0; i < FRAME_DATA; i++) {
+      plaintext[i] = frame[FRAME_HDR + i] = random_rand();
+    }
+    CCM_STAR.aead(ccm_nonce, frame + FRAME_HDR, lengths[l],
+                  frame, FRAME_HDR, mic, MIC_LEN, 1);
+    CCM_STAR.aead(ccm_nonce, frame + FRAME_HDR, lengths[l],
+                  frame, FRAME_HDR, check, MIC_LEN, 0);
+    UNIT_TEST_ASSERT(!memcmp(frame + FRAME_HDR, plaintext, FRAME_DATA));
+    UNIT_TEST_ASSERT(!memcmp(mic, check, MIC_LEN));
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+/* Native has no cycle counter: the cost is in nanoseconds per byte */
+static unsigned long
+ns_per_byte(clock_time_t time, unsigned long bytes)
+{
+  return (unsigned long)((1000000ULL * time) / bytes);
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(void)
+{
+  uint8_t block[AES_128_BLOCK_SIZE];
+  clock_time_t start, time;
+  unsigned long n;
+  int d;
+
+  memset(block, 0, sizeof(block));
+  for(d = 0; d < DRIVERS; d++) {
+    drivers[d].driver->set_key(ccm_key);
+    start = clock_time();
+    for(n = 0; n < BLOCKS; n++) {
+      drivers[d].driver->encrypt(block);
+    }
+    time = clock_time() - start;
+    printf("%-10s %lu blocks in %4lu ms: %3lu ns/byte\n", drivers[d].name,
+           BLOCKS, (unsigned long)time,
+           ns_per_byte(time, BLOCKS * AES_128_BLOCK_SIZE));
+  }
+
+  CCM_STAR.set_key(ccm_key);
+  start = clock_time();
+  for(n = 0; n < FRAMES; n++) {
+    CCM_STAR.aead(ccm_nonce, frame + FRAME_HDR, FRAME_DATA,
+                  frame, FRAME_HDR, frame + FRAME_HDR + FRAME_DATA, MIC_LEN,
+                  n & 1);
+  }
+  time = clock_time() - start;
+  printf("CCM* %lu frames of %u bytes in %4lu ms: %3lu ns/byte, %lu frames/s\n",
+         FRAMES, FRAME_HDR + FRAME_DATA, (unsigned long)time,
+         ns_per_byte(time, FRAMES * (FRAME_HDR + FRAME_DATA)),
+         time ? (unsigned long)(FRAMES * 1000 / time) : 0);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(aes_ccm_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  UNIT_TEST_RUN(fips);
+  UNIT_TEST_RUN(agree);
+  UNIT_TEST_RUN(ccm);
+  UNIT_TEST_RUN(round_trip);
+
+  printf("\n");
+  benchmark();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,389 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Join method checks and timing for Antelope.
+ */
+
+#include "contiki.h"
+#include "antelope.h"
+#include "cfs/cfs.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#define NODES     20
+#define SAMPLES   300
+#define SORTED    200
+#define LARGE     400
+#define ROUNDS    5
+#define REPEAT    50
+
+#define SKEWED_KEY(i) ((i) % 4 == 0 ? (i) : 7)
+
+struct join_result {
+  unsigned long rows;
+  unsigned long sum;
+};
+
+static db_handle_t handle;
+/*---------------------------------------------------------------------------*/
+static int
+file_exists(const char *name)
+{
+  int fd;
+
+  fd = cfs_open(name, CFS_READ);
+  if(fd < 0) {
+    return 0;
+  }
+  cfs_close(fd);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Run a join query to completion and sum up all values in the result. */
+static db_result_t
+run_join(const char *query, struct join_result *join, const char *spill)
+{
+  attribute_value_t value;
+  db_result_t result;
+  unsigned col;
+
+  join->rows = join->sum = 0;
+
+  result = db_query(&handle, query);
+  if(DB_ERROR(result)) {
+    db_free(&handle);
+    return result;
+  }
+
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_GOT_ROW) {
+      if(join->rows++ == 0 && spill != NULL && !file_exists(spill)) {
+        result = DB_STORAGE_ERROR;
+        break;
+      }
+      for(col = 0; col < handle.ncolumns; col++) {
+        db_get_value(&value, &handle, col);
+        join->sum += db_value_to_long(&value);
+      }
+    } else if(result != DB_OK) {
+      break;
+    }
+  }
+
+  db_free(&handle);
+
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_relations(void)
+{
+  unsigned i;
+
+  db_query(NULL, "REMOVE RELATION nodes;");
+  db_query(NULL, "CREATE RELATION nodes;");
+  db_query(NULL, "CREATE ATTRIBUTE node DOMAIN INT IN nodes;");
+  db_query(NULL, "CREATE ATTRIBUTE x DOMAIN INT IN nodes;");
+  for(i = 0; i < NODES; i++) {
+    db_query(NULL, "INSERT (%u, %u) INTO nodes;", i, i * 10);
+  }
+
+  db_query(NULL, "REMOVE RELATION tiny;");
+  db_query(NULL, "CREATE RELATION tiny;");
+  db_query(NULL, "CREATE ATTRIBUTE id DOMAIN INT IN tiny;");
+  db_query(NULL, "CREATE ATTRIBUTE y DOMAIN INT IN tiny;");
+  db_query(NULL, "INSERT (13, 1) INTO tiny;");
+  db_query(NULL, "INSERT (17, 2) INTO tiny;");
+
+  db_query(NULL, "REMOVE RELATION samples;");
+  db_query(NULL, "CREATE RELATION samples;");
+  db_query(NULL, "CREATE ATTRIBUTE node DOMAIN INT IN samples;");
+  db_query(NULL, "CREATE ATTRIBUTE value DOMAIN INT IN samples;");
+  for(i = 0; i < SAMPLES; i++) {
+    db_query(NULL, "INSERT (%u, %u) INTO samples;", i % NODES, i);
+  }
+
+  /* Two relations sorted on the id attribute. The inline index
+     supports exact lookups only for unique ids, as in sa. */
+  db_query(NULL, "REMOVE RELATION sa;");
+  db_query(NULL, "CREATE RELATION sa;");
+  db_query(NULL, "CREATE ATTRIBUTE id DOMAIN INT IN sa;");
+  db_query(NULL, "CREATE ATTRIBUTE a DOMAIN INT IN sa;");
+  db_query(NULL, "CREATE INDEX sa.id TYPE INLINE;");
+  db_query(NULL, "REMOVE RELATION sb;");
+  db_query(NULL, "CREATE RELATION sb;");
+  db_query(NULL, "CREATE ATTRIBUTE id DOMAIN INT IN sb;");
+  db_query(NULL, "CREATE ATTRIBUTE b DOMAIN INT IN sb;");
+  db_query(NULL, "CREATE INDEX sb.id TYPE INLINE;");
+  for(i = 0; i < SORTED; i++) {
+    db_query(NULL, "INSERT (%u, %u) INTO sa;", 10 + i, i);
+  }
+  for(i = 0; i < SORTED + SORTED / 2; i++) {
+    db_query(NULL, "INSERT (%u, %u) INTO sb;", i / 3, i);
+  }
+
+  /* Two unindexed relations that are too large for the hash join memory. */
+  db_query(NULL, "REMOVE RELATION la;");
+  db_query(NULL, "CREATE RELATION la;");
+  db_query(NULL, "CREATE ATTRIBUTE k DOMAIN INT IN la;");
+  db_query(NULL, "CREATE ATTRIBUTE v DOMAIN INT IN la;");
+  db_query(NULL, "REMOVE RELATION lb;");
+  db_query(NULL, "CREATE RELATION lb;");
+  db_query(NULL, "CREATE ATTRIBUTE k DOMAIN INT IN lb;");
+  db_query(NULL, "CREATE ATTRIBUTE w DOMAIN INT IN lb;");
+  for(i = 0; i < LARGE; i++) {
+    db_query(NULL, "INSERT (%u, %u) INTO la;", (i * 7) % 200, i);
+    db_query(NULL, "INSERT (%u, %u) INTO lb;", i % 250, i);
+  }
+
+  /* As la, with three quarters of the rows on a single key. */
+  db_query(NULL, "REMOVE RELATION ka;");
+  db_query(NULL, "CREATE RELATION ka;");
+  db_query(NULL, "CREATE ATTRIBUTE k DOMAIN INT IN ka;");
+  db_query(NULL, "CREATE ATTRIBUTE v DOMAIN INT IN ka;");
+  for(i = 0; i < LARGE; i++) {
+    db_query(NULL, "INSERT (%u, %u) INTO ka;", SKEWED_KEY(i), i);
+  }
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(hash_join, "Hash join on an unindexed attribute");
+UNIT_TEST_REGISTER(index_join, "Index join for a small outer relation");
+UNIT_TEST_REGISTER(merge_join, "Merge join on sorted relations");
+UNIT_TEST_REGISTER(spill_join, "Hash join spilled to partitions");
+UNIT_TEST_REGISTER(skew_join, "Hash join with skewed keys");
+
+UNIT_TEST(hash_join)
+{
+  struct join_result join;
+  unsigned long sum;
+  unsigned i;
+
+  UNIT_TEST_BEGIN();
+
+  for(sum = 0, i = 0; i < SAMPLES; i++) {
+    sum += i + (i % NODES) * 10;
+  }
+
+  UNIT_TEST_ASSERT(run_join("JOIN nodes, samples ON node PROJECT value, x;",
+                            &join, NULL) == DB_FINISHED);
+  UNIT_TEST_ASSERT(join.rows == SAMPLES && join.sum == sum);
+
+  /* the join attribute of the left relation is not indexed */
+  UNIT_TEST_ASSERT(run_join("JOIN samples, nodes ON node PROJECT value, x;",
+                            &join, NULL) == DB_FINISHED);
+  UNIT_TEST_ASSERT(join.rows == SAMPLES && join.sum == sum);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(index_join)
+{
+  struct join_result join;
+  unsigned long sum;
+
+  UNIT_TEST_BEGIN();
+
+  /* sa.id is 13 in row 3 and 17 in row 7 */
+  sum = 3 + 1 + 7 + 2;
+
+  UNIT_TEST_ASSERT(run_join("JOIN tiny, sa ON id PROJECT a, y;",
+                            &join, NULL) == DB_FINISHED);
+  UNIT_TEST_ASSERT(join.rows == 2 && join.sum == sum);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(merge_join)
+{
+  struct join_result join;
+  unsigned long rows;
+  unsigned long sum;
+  unsigned i;
+  unsigned j;
+
+  UNIT_TEST_BEGIN();
+
+  for(rows = sum = 0, i = 0; i < SORTED; i++) {
+    for(j = 0; j < SORTED + SORTED / 2; j++) {
+      if(10 + i == j / 3) {
+        rows++;
+        sum += i + j;
+      }
+    }
+  }
+
+  UNIT_TEST_ASSERT(run_join("JOIN sa, sb ON id PROJECT a, b;",
+                            &join, NULL) == DB_FINISHED);
+  UNIT_TEST_ASSERT(join.rows == rows && join.sum == sum);
+
+  UNIT_TEST_ASSERT(run_join("JOIN sb, sa ON id PROJECT a, b;",
+                            &join, NULL) == DB_FINISHED);
+  UNIT_TEST_ASSERT(join.rows == rows && join.sum == sum);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(spill_join)
+{
+  struct join_result join;
+  char spill[16];
+  unsigned long rows;
+  unsigned long sum;
+  unsigned i;
+  unsigned j;
+
+  UNIT_TEST_BEGIN();
+
+  for(rows = sum = 0, i = 0; i < LARGE; i++) {
+    for(j = 0; j < LARGE; j++) {
+      if((i * 7) % 200 == j % 250) {
+        rows++;
+        sum += i + j;
+      }
+    }
+  }
+
+  /* the partitions exist while the join runs, and are removed after it */
+  snprintf(spill, sizeof(spill), "db-join.p%u", DB_JOIN_MAX_PARTITIONS - 1);
+  UNIT_TEST_ASSERT(run_join("JOIN la, lb ON k PROJECT v, w;",
+                            &join, spill) == DB_FINISHED);
+  UNIT_TEST_ASSERT(join.rows == rows && join.sum == sum);
+  UNIT_TEST_ASSERT(!file_exists(spill));
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(skew_join)
+{
+  struct join_result join;
+  char spill[16];
+  unsigned long rows;
+  unsigned long sum;
+  unsigned i;
+  unsigned j;
+
+  UNIT_TEST_BEGIN();
+
+  for(rows = sum = 0, i = 0; i < LARGE; i++) {
+    for(j = 0; j < LARGE; j++) {
+      if(SKEWED_KEY(i) == j % 250) {
+        rows++;
+        sum += i + j;
+      }
+    }
+  }
+
+  /* one partition gets most rows, and is joined in several chunks */
+  snprintf(spill, sizeof(spill), "db-join.p%u", DB_JOIN_MAX_PARTITIONS - 1);
+  UNIT_TEST_ASSERT(run_join("JOIN ka, lb ON k PROJECT v, w;",
+                            &join, spill) == DB_FINISHED);
+  UNIT_TEST_ASSERT(join.rows == rows && join.sum == sum);
+
+  /* a partition that cannot be written, as when a skewed partition
+     runs out of storage, makes the join run without partitions */
+  mkdir("db-join.b1", 0700);
+  cfs_close(cfs_open("db-join.b1/x", CFS_WRITE));
+  UNIT_TEST_ASSERT(run_join("JOIN ka, lb ON k PROJECT v, w;",
+                            &join, NULL) == DB_FINISHED);
+  cfs_remove("db-join.b1/x");
+  cfs_remove("db-join.b1");
+  UNIT_TEST_ASSERT(join.rows == rows && join.sum == sum);
+  UNIT_TEST_ASSERT(!file_exists("db-join.b0") && !file_exists(spill));
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(const char *name, const char *query)
+{
+  struct join_result join;
+  clock_time_t start, duration, best;
+  db_result_t result;
+  int round;
+  int i;
+
+  /* report the best of several rounds to keep scheduling noise out */
+  best = 0;
+  for(round = 0; round < ROUNDS; round++) {
+    start = clock_time();
+    for(i = 0; i < REPEAT; i++) {
+      result = run_join(query, &join, NULL);
+      if(DB_ERROR(result)) {
+        printf("%s: %s\n", name, db_get_result_message(result));
+        return;
+      }
+    }
+    duration = clock_time() - start;
+    if(round == 0 || duration < best) {
+      best = duration;
+    }
+  }
+
+  printf("%s: %d joins of %lu rows in %lu ticks\n", name, REPEAT, join.rows,
+         (unsigned long)best);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(antelope_join_process, "Antelope join benchmark");
+AUTOSTART_PROCESSES(&antelope_join_process);
+
+PROCESS_THREAD(antelope_join_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  db_init();
+  create_relations();
+
+  UNIT_TEST_RUN(hash_join);
+  UNIT_TEST_RUN(index_join);
+  UNIT_TEST_RUN(merge_join);
+  UNIT_TEST_RUN(spill_join);
+  UNIT_TEST_RUN(skew_join);
+
+  printf("\n");
+  benchmark("nodes x samples", "JOIN nodes, samples ON node PROJECT value, x;");
+  benchmark("tiny x sorted", "JOIN tiny, sa ON id PROJECT a, y;");
+  benchmark("sorted x sorted", "JOIN sb, sa ON id PROJECT a, b;");
+  benchmark("large x large", "JOIN la, lb ON k PROJECT v, w;");
+  benchmark("skewed x large", "JOIN ka, lb ON k PROJECT v, w;");
+
+  db_query(NULL, "REMOVE RELATION nodes;");
+  db_query(NULL, "REMOVE RELATION tiny;");
+  db_query(NULL, "REMOVE RELATION samples;");
+  db_query(NULL, "REMOVE RELATION sa;");
+  db_query(NULL, "REMOVE RELATION sb;");
+  db_query(NULL, "REMOVE RELATION la;");
+  db_query(NULL, "REMOVE RELATION lb;");
+  db_query(NULL, "REMOVE RELATION ka;");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Range query checks and timing for the B+-tree index of Antelope.
+ */
+
+#include "contiki.h"
+#include "antelope.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+
+#define SAMPLES   5000
+#define INTERVAL  3
+#define ROUNDS    5
+#define REPEAT    200
+
+struct range_result {
+  unsigned long rows;
+  unsigned long sum;
+  int ordered;
+  int indexed;
+};
+
+static db_handle_t handle;
+/*---------------------------------------------------------------------------*/
+/* Run a query to completion and sum up all values in the result. The
+   first column is checked to be in ascending order. */
+static db_result_t
+run_query(struct range_result *range, const char *query)
+{
+  attribute_value_t value;
+  db_result_t result;
+  long previous;
+  unsigned col;
+
+  range->rows = range->sum = 0;
+  range->ordered = 1;
+  previous = 0;
+
+  result = db_query(&handle, query);
+  if(DB_ERROR(result)) {
+    db_free(&handle);
+    return result;
+  }
+  range->indexed = (handle.flags & DB_HANDLE_FLAG_SEARCH_INDEX) != 0;
+
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_GOT_ROW) {
+      for(col = 0; col < handle.ncolumns; col++) {
+        db_get_value(&value, &handle, col);
+        range->sum += db_value_to_long(&value);
+        if(col == 0) {
+          if(range->rows > 0 && db_value_to_long(&value) < previous) {
+            range->ordered = 0;
+          }
+          previous = db_value_to_long(&value);
+        }
+      }
+      range->rows++;
+    } else if(result != DB_OK) {
+      break;
+    }
+  }
+
+  db_free(&handle);
+
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned
+sample_value(unsigned i)
+{
+  return (i * 37) % 1000;
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_relation(const char *name, const char *index_type, int index_value)
+{
+  unsigned i;
+
+  db_query(NULL, "REMOVE RELATION %s;", name);
+  db_query(NULL, "CREATE RELATION %s;", name);
+  db_query(NULL, "CREATE ATTRIBUTE time DOMAIN LONG IN %s;", name);
+  db_query(NULL, "CREATE ATTRIBUTE node DOMAIN INT IN %s;", name);
+  db_query(NULL, "CREATE ATTRIBUTE value DOMAIN INT IN %s;", name);
+  if(index_type != NULL) {
+    db_query(NULL, "CREATE INDEX %s.time TYPE %s;", name, index_type);
+  }
+  if(index_value) {
+    db_query(NULL, "CREATE INDEX %s.value TYPE BTREE;", name);
+  }
+  for(i = 0; i < SAMPLES; i++) {
+    db_query(NULL, "INSERT (%u, %u, %u) INTO %s;",
+             i * INTERVAL, i % 20, sample_value(i), name);
+  }
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(time_range, "Closed timestamp range");
+UNIT_TEST_REGISTER(open_range, "Open timestamp range");
+UNIT_TEST_REGISTER(value_range, "Range over unsorted keys");
+UNIT_TEST_REGISTER(duplicates, "Equal keys");
+
+UNIT_TEST(time_range)
+{
+  struct range_result range;
+  unsigned long sum;
+  unsigned i;
+
+  UNIT_TEST_BEGIN();
+
+  for(sum = 0, i = 1000; i <= 2000; i++) {
+    sum += i * INTERVAL + sample_value(i);
+  }
+
+  UNIT_TEST_ASSERT(run_query(&range, "SELECT time, value FROM samples "
+                             "WHERE time >= 3000 AND time <= 6000;") == DB_FINISHED);
+  UNIT_TEST_ASSERT(range.indexed && range.ordered);
+  UNIT_TEST_ASSERT(range.rows == 1001 && range.sum == sum);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(open_range)
+{
+  struct range_result range;
+  unsigned long rows, sum;
+  unsigned i;
+
+  UNIT_TEST_BEGIN();
+
+  for(rows = sum = 0, i = 0; i < SAMPLES; i++) {
+    if(i * INTERVAL > 14000) {
+      rows++;
+      sum += i * INTERVAL;
+    }
+  }
+
+  UNIT_TEST_ASSERT(run_query(&range, "SELECT time FROM samples "
+                             "WHERE time > 14000;") == DB_FINISHED);
+  UNIT_TEST_ASSERT(range.indexed && range.ordered);
+  UNIT_TEST_ASSERT(range.rows == rows && range.sum == sum);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(value_range)
+{
+  struct range_result range;
+  unsigned long rows, sum;
+  unsigned i;
+
+  UNIT_TEST_BEGIN();
+
+  for(rows = sum = 0, i = 0; i < SAMPLES; i++) {
+    if(sample_value(i) >= 100 && sample_value(i) < 200) {
+      rows++;
+      sum += sample_value(i) + i * INTERVAL;
+    }
+  }
+
+  /* the values were inserted out of order, so leaves were split */
+  UNIT_TEST_ASSERT(run_query(&range, "SELECT value, time FROM samples "
+                             "WHERE value >= 100 AND value < 200;") == DB_FINISHED);
+  UNIT_TEST_ASSERT(range.indexed && range.ordered);
+  UNIT_TEST_ASSERT(range.rows == rows && range.sum == sum);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(duplicates)
+{
+  struct range_result range;
+  unsigned long rows, sum;
+  unsigned i;
+
+  UNIT_TEST_BEGIN();
+
+  for(rows = sum = 0, i = 0; i < SAMPLES; i++) {
+    if(sample_value(i) == 370) {
+      rows++;
+      sum += i * INTERVAL;
+    }
+  }
+
+  UNIT_TEST_ASSERT(run_query(&range, "SELECT time FROM samples "
+                             "WHERE value = 370;") == DB_FINISHED);
+  UNIT_TEST_ASSERT(range.indexed);
+  UNIT_TEST_ASSERT(range.rows == rows && range.sum == sum);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(const char *relation, unsigned long width)
+{
+  struct range_result range;
+  char query[AQL_MAX_QUERY_LENGTH];
+  clock_time_t start, duration, best;
+  unsigned long low;
+  unsigned long rows;
+  db_result_t result;
+  int round;
+  int i;
+
+  /* report the best of several rounds to keep scheduling noise out */
+  best = 0;
+  for(round = 0; round < ROUNDS; round++) {
+    rows = 0;
+    start = clock_time();
+    for(i = 0; i < REPEAT; i++) {
+      /* spread the ranges over the relation */
+      low = (unsigned long)i * (SAMPLES - width) / REPEAT * INTERVAL;
+      snprintf(query, sizeof(query), "SELECT time, value FROM %s "
+               "WHERE time >= %lu AND time < %lu;",
+               relation, low, low + width * INTERVAL);
+      result = run_query(&range, query);
+      if(DB_ERROR(result)) {
+        printf("%s: %s\n", relation, db_get_result_message(result));
+        return;
+      }
+      rows += range.rows;
+    }
+    duration = clock_time() - start;
+    if(round == 0 || duration < best) {
+      best = duration;
+    }
+  }
+
+  printf("%-8s %d range queries of %4lu rows in %4lu ticks%s\n", relation,
+         REPEAT, rows / REPEAT, (unsigned long)best,
+         range.indexed ? "" : " (full scan)");
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(antelope_range_process, "Antelope range query benchmark");
+AUTOSTART_PROCESSES(&antelope_range_process);
+
+PROCESS_THREAD(antelope_range_process, ev, data)
+{
+  static const unsigned long widths[] = {10, 100, 1000};
+  int i;
+
+  PROCESS_BEGIN();
+
+  db_init();
+  create_relation("samples", "BTREE", 1);
+
+  UNIT_TEST_RUN(time_range);
+  UNIT_TEST_RUN(open_range);
+  UNIT_TEST_RUN(value_range);
+  UNIT_TEST_RUN(duplicates);
+
+  /* the same samples, stored in time order with an inline index or
+     without an index */
+  create_relation("sorted", "INLINE", 0);
+  create_relation("plain", NULL, 0);
+
+  printf("\n");
+  for(i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+    benchmark("samples", widths[i]);
+    benchmark("sorted", widths[i]);
+    benchmark("plain", widths[i]);
+  }
+
+  db_query(NULL, "REMOVE RELATION samples;");
+  db_query(NULL, "REMOVE RELATION sorted;");
+  db_query(NULL, "REMOVE RELATION plain;");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Full-table scan checks and timing for Antelope.
+ */
+
+#include "contiki.h"
+#include "antelope.h"
+#include "cfs/cfs.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+
+#define SAMPLES   10000
+#define ROUNDS    5
+#define REPEAT    10
+
+#ifndef COUNT_CFS_CALLS
+#define COUNT_CFS_CALLS 0
+#endif
+
+struct scan_result {
+  unsigned long rows;
+  unsigned long sum;
+};
+
+static db_handle_t handle;
+static unsigned long cfs_calls;
+/*---------------------------------------------------------------------------*/
+#if COUNT_CFS_CALLS
+int __real_cfs_read(int fd, void *buf, unsigned int len);
+cfs_offset_t __real_cfs_seek(int fd, cfs_offset_t offset, int whence);
+
+int
+__wrap_cfs_read(int fd, void *buf, unsigned int len)
+{
+  cfs_calls++;
+  return __real_cfs_read(fd, buf, len);
+}
+
+cfs_offset_t
+__wrap_cfs_seek(int fd, cfs_offset_t offset, int whence)
+{
+  cfs_calls++;
+  return __real_cfs_seek(fd, offset, whence);
+}
+#endif /* COUNT_CFS_CALLS */
+/*---------------------------------------------------------------------------*/
+/* Run a query to completion and sum up all values in the result. */
+static db_result_t
+run_query(const char *query, struct scan_result *scan)
+{
+  attribute_value_t value;
+  db_result_t result;
+  unsigned col;
+
+  scan->rows = scan->sum = 0;
+
+  result = db_query(&handle, query);
+  if(DB_ERROR(result)) {
+    db_free(&handle);
+    return result;
+  }
+
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_GOT_ROW) {
+      scan->rows++;
+      for(col = 0; col < handle.ncolumns; col++) {
+        db_get_value(&value, &handle, col);
+        scan->sum += db_value_to_long(&value);
+      }
+    } else if(result != DB_OK) {
+      break;
+    }
+  }
+
+  db_free(&handle);
+
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned
+sample_value(unsigned i)
+{
+  return (i * 37) % 1000;
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_relation(void)
+{
+  unsigned i;
+
+  db_query(NULL, "REMOVE RELATION samples;");
+  db_query(NULL, "CREATE RELATION samples;");
+  db_query(NULL, "CREATE ATTRIBUTE time DOMAIN INT IN samples;");
+  db_query(NULL, "CREATE ATTRIBUTE node DOMAIN INT IN samples;");
+  db_query(NULL, "CREATE ATTRIBUTE value DOMAIN INT IN samples;");
+  for(i = 0; i < SAMPLES; i++) {
+    db_query(NULL, "INSERT (%u, %u, %u) INTO samples;",
+             i, i % 20, sample_value(i));
+  }
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(full_scan, "Select all rows");
+UNIT_TEST_REGISTER(aggregate, "Aggregate over all rows");
+UNIT_TEST_REGISTER(append, "Scan after appending a row");
+
+UNIT_TEST(full_scan)
+{
+  struct scan_result scan;
+  unsigned long sum;
+  unsigned i;
+
+  UNIT_TEST_BEGIN();
+
+  for(sum = 0, i = 0; i < SAMPLES; i++) {
+    sum += i + sample_value(i);
+  }
+
+  UNIT_TEST_ASSERT(run_query("SELECT time, value FROM samples;",
+                             &scan) == DB_FINISHED);
+  UNIT_TEST_ASSERT(scan.rows == SAMPLES && scan.sum == sum);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(aggregate)
+{
+  struct scan_result scan;
+
+  UNIT_TEST_BEGIN();
+
+  UNIT_TEST_ASSERT(run_query("SELECT MAX(value) FROM samples;",
+                             &scan) == DB_FINISHED);
+  UNIT_TEST_ASSERT(scan.rows == 1 && scan.sum == 999);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(append)
+{
+  struct scan_result scan;
+
+  UNIT_TEST_BEGIN();
+
+  /* the last page of the relation is cached by the previous scans */
+  UNIT_TEST_ASSERT(db_query(NULL, "INSERT (%u, 1, 1000) INTO samples;",
+                            SAMPLES) == DB_OK);
+  UNIT_TEST_ASSERT(run_query("SELECT MAX(value) FROM samples;",
+                             &scan) == DB_FINISHED);
+  UNIT_TEST_ASSERT(scan.rows == 1 && scan.sum == 1000);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(const char *name, const char *query)
+{
+  struct scan_result scan;
+  clock_time_t start, duration, best;
+  unsigned long calls;
+  db_result_t result;
+  int round;
+  int i;
+
+  /* report the best of several rounds to keep scheduling noise out */
+  best = 0;
+  for(round = 0; round < ROUNDS; round++) {
+    calls = cfs_calls;
+    start = clock_time();
+    for(i = 0; i < REPEAT; i++) {
+      result = run_query(query, &scan);
+      if(DB_ERROR(result)) {
+        printf("%s: %s\n", name, db_get_result_message(result));
+        return;
+      }
+    }
+    duration = clock_time() - start;
+    calls = (cfs_calls - calls) / REPEAT;
+    if(round == 0 || duration < best) {
+      best = duration;
+    }
+  }
+
+  printf("%s: %d scans of %lu rows in %lu ticks, %lu file system calls each\n",
+         name, REPEAT, scan.rows, (unsigned long)best, calls);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(antelope_scan_process, "Antelope scan benchmark");
+AUTOSTART_PROCESSES(&antelope_scan_process);
+
+PROCESS_THREAD(antelope_scan_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  db_init();
+  create_relation();
+
+  UNIT_TEST_RUN(full_scan);
+  UNIT_TEST_RUN(aggregate);
+  UNIT_TEST_RUN(append);
+
+  printf("\n");
+  benchmark("select", "SELECT time, value FROM samples;");
+  benchmark("aggregate", "SELECT MAX(value), MEAN(value) FROM samples;");
+
+  db_query(NULL, "REMOVE RELATION samples;");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks and timing of compiled selection predicates in Antelope.
+ */
+
+#include "contiki.h"
+#include "antelope.h"
+#include "aql.h"
+#include "lvm.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SAMPLES   5000
+#define ROWS      1000
+#define ROW_SIZE  8
+#define ROUNDS    5
+#define REPEAT    2000
+#define QUERIES   20
+
+struct select_result {
+  unsigned long rows;
+  unsigned long sum;
+};
+
+static db_handle_t handle;
+static aql_adt_t adt;
+static lvm_program_t program;
+static unsigned char rows[ROWS][ROW_SIZE];
+
+static char *predicates[] = {
+  "value > 900",
+  "node = 3 AND value < 500",
+  "node = 1 OR value >= 990",
+  "500 > value",
+  "value - node > 900",
+  "time * 2 < value"
+};
+#define PREDICATES (sizeof(predicates) / sizeof(predicates[0]))
+/*---------------------------------------------------------------------------*/
+static unsigned
+sample_value(unsigned i)
+{
+  return (i * 37) % 1000;
+}
+/*---------------------------------------------------------------------------*/
+/* Run a query to completion and sum up all values in the result. */
+static db_result_t
+run_query(struct select_result *select, const char *query)
+{
+  attribute_value_t value;
+  db_result_t result;
+  unsigned col;
+
+  select->rows = select->sum = 0;
+
+  result = db_query(&handle, query);
+  if(DB_ERROR(result)) {
+    db_free(&handle);
+    return result;
+  }
+
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_GOT_ROW) {
+      select->rows++;
+      for(col = 0; col < handle.ncolumns; col++) {
+        db_get_value(&value, &handle, col);
+        select->sum += db_value_to_long(&value);
+      }
+    } else if(result != DB_OK) {
+      break;
+    }
+  }
+
+  db_free(&handle);
+
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_relation(void)
+{
+  unsigned i;
+
+  db_query(NULL, "REMOVE RELATION samples;");
+  db_query(NULL, "CREATE RELATION samples;");
+  db_query(NULL, "CREATE ATTRIBUTE time DOMAIN LONG IN samples;");
+  db_query(NULL, "CREATE ATTRIBUTE node DOMAIN INT IN samples;");
+  db_query(NULL, "CREATE ATTRIBUTE value DOMAIN INT IN samples;");
+  for(i = 0; i < SAMPLES; i++) {
+    db_query(NULL, "INSERT (%u, %u, %u) INTO samples;",
+             i, i % 20, sample_value(i));
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Fill rows laid out as in the samples relation: a LONG followed by
+   two INT attributes, all stored in big-endian byte order. */
+static void
+create_rows(void)
+{
+  unsigned i;
+  unsigned value;
+
+  for(i = 0; i < ROWS; i++) {
+    value = sample_value(i);
+    rows[i][0] = 0;
+    rows[i][1] = 0;
+    rows[i][2] = i >> 8;
+    rows[i][3] = i & 0xff;
+    rows[i][4] = 0;
+    rows[i][5] = i % 20;
+    rows[i][6] = value >> 8;
+    rows[i][7] = value & 0xff;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Parse a predicate and compile it for the rows created above. */
+static lvm_instance_t *
+parse_predicate(char *predicate)
+{
+  char query[AQL_MAX_QUERY_LENGTH];
+
+  snprintf(query, sizeof(query),
+           "SELECT time, node, value FROM samples WHERE %s;", predicate);
+  if(AQL_ERROR(aql_parse(&adt, query)) || adt.lvm_instance == NULL) {
+    return NULL;
+  }
+
+  if(LVM_ERROR(lvm_compile(adt.lvm_instance, &program))) {
+    return NULL;
+  }
+  lvm_bind_variable(&program, "time", 0, 4);
+  lvm_bind_variable(&program, "node", 4, 2);
+  lvm_bind_variable(&program, "value", 6, 2);
+
+  return program.unbound == 0 ? adt.lvm_instance : NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Evaluate a predicate like relation_process_select() does without a
+   compiled program: set each variable by name, then interpret. */
+static lvm_status_t
+interpret(lvm_instance_t *lvm_instance, const unsigned char *row)
+{
+  operand_value_t value;
+
+  value.l = (uint32_t)row[0] << 24 | (uint32_t)row[1] << 16 |
+            (uint32_t)row[2] << 8 | row[3];
+  lvm_set_variable_value("time", value);
+  value.l = row[4] << 8 | row[5];
+  lvm_set_variable_value("node", value);
+  value.l = row[6] << 8 | row[7];
+  lvm_set_variable_value("value", value);
+
+  return lvm_execute(lvm_instance);
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(hidden_attribute, "Predicate on an unprojected attribute");
+UNIT_TEST_REGISTER(connectives, "Predicates with connectives");
+UNIT_TEST_REGISTER(aggregate, "Aggregate over selected rows");
+UNIT_TEST_REGISTER(equivalence, "Compiled and interpreted results agree");
+
+UNIT_TEST(hidden_attribute)
+{
+  struct select_result select;
+  unsigned long rows, sum;
+  unsigned i;
+
+  UNIT_TEST_BEGIN();
+
+  for(rows = sum = 0, i = 0; i < SAMPLES; i++) {
+    if(sample_value(i) > 900) {
+      rows++;
+      sum += i;
+    }
+  }
+
+  UNIT_TEST_ASSERT(run_query(&select,
+                   "SELECT time FROM samples WHERE value > 900;") == DB_FINISHED);
+  UNIT_TEST_ASSERT(select.rows == rows && select.sum == sum);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(connectives)
+{
+  struct select_result select;
+  unsigned long rows, sum;
+  unsigned i;
+
+  UNIT_TEST_BEGIN();
+
+  for(rows = sum = 0, i = 0; i < SAMPLES; i++) {
+    if(i % 20 == 3 && sample_value(i) < 500) {
+      rows++;
+      sum += i + sample_value(i);
+    }
+  }
+
+  UNIT_TEST_ASSERT(run_query(&select,
+                   "SELECT time, value FROM samples "
+                   "WHERE node = 3 AND value < 500;") == DB_FINISHED);
+  UNIT_TEST_ASSERT(select.rows == rows && select.sum == sum);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(aggregate)
+{
+  struct select_result select;
+  unsigned long rows;
+  unsigned i;
+
+  UNIT_TEST_BEGIN();
+
+  for(rows = 0, i = 0; i < SAMPLES; i++) {
+    if(sample_value(i) >= 500) {
+      rows++;
+    }
+  }
+
+  UNIT_TEST_ASSERT(run_query(&select,
+                   "SELECT COUNT(time) FROM samples WHERE value >= 500;") == DB_FINISHED);
+  UNIT_TEST_ASSERT(select.rows == 1 && select.sum == rows);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(equivalence)
+{
+  lvm_instance_t *lvm_instance;
+  unsigned i, j;
+  unsigned mismatches;
+
+  UNIT_TEST_BEGIN();
+
+  mismatches = 0;
+  for(i = 0; i < PREDICATES; i++) {
+    lvm_instance = parse_predicate(predicates[i]);
+    UNIT_TEST_ASSERT(lvm_instance != NULL);
+    for(j = 0; j < ROWS; j++) {
+      if(lvm_run(&program, rows[j]) != interpret(lvm_instance, rows[j])) {
+        mismatches++;
+      }
+    }
+  }
+  UNIT_TEST_ASSERT(mismatches == 0);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+rows_per_second(unsigned long rows, clock_time_t duration)
+{
+  if(duration == 0) {
+    duration = 1;
+  }
+  return rows * CLOCK_SECOND / duration;
+}
+/*---------------------------------------------------------------------------*/
+/* Compare the predicate throughput of the interpreter with that of the
+   compiled program. */
+static void
+benchmark_predicate(char *predicate)
+{
+  lvm_instance_t *lvm_instance;
+  clock_time_t start, duration, interpreted, compiled;
+  volatile unsigned long matches;
+  int round;
+  int i, j;
+
+  lvm_instance = parse_predicate(predicate);
+  if(lvm_instance == NULL) {
+    printf("%s: not compiled\n", predicate);
+    return;
+  }
+
+  /* report the best of several rounds to keep scheduling noise out */
+  interpreted = compiled = 0;
+  for(round = 0; round < ROUNDS; round++) {
+    start = clock_time();
+    for(matches = 0, i = 0; i < REPEAT; i++) {
+      for(j = 0; j < ROWS; j++) {
+        matches += interpret(lvm_instance, rows[j]) == TRUE;
+      }
+    }
+    duration = clock_time() - start;
+    if(round == 0 || duration < interpreted) {
+      interpreted = duration;
+    }
+
+    start = clock_time();
+    for(matches = 0, i = 0; i < REPEAT; i++) {
+      for(j = 0; j < ROWS; j++) {
+        matches += lvm_run(&program, rows[j]) == TRUE;
+      }
+    }
+    duration = clock_time() - start;
+    if(round == 0 || duration < compiled) {
+      compiled = duration;
+    }
+  }
+
+  printf("%-40s interpreted %8lu rows/s, compiled %9lu rows/s\n", predicate,
+         rows_per_second((unsigned long)REPEAT * ROWS, interpreted),
+         rows_per_second((unsigned long)REPEAT * ROWS, compiled));
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark_query(const char *query)
+{
+  struct select_result select;
+  clock_time_t start, duration, best;
+  db_result_t result;
+  int round;
+  int i;
+
+  best = 0;
+  for(round = 0; round < ROUNDS; round++) {
+    start = clock_time();
+    for(i = 0; i < QUERIES; i++) {
+      result = run_query(&select, query);
+      if(DB_ERROR(result)) {
+        printf("%s: %s\n", query, db_get_result_message(result));
+        return;
+      }
+    }
+    duration = clock_time() - start;
+    if(round == 0 || duration < best) {
+      best = duration;
+    }
+  }
+
+  printf("%s: %lu rows scanned per second, %lu selected\n", query,
+         rows_per_second((unsigned long)QUERIES * SAMPLES, best), select.rows);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(antelope_select_process, "Antelope selection benchmark");
+AUTOSTART_PROCESSES(&antelope_select_process);
+
+PROCESS_THREAD(antelope_select_process, ev, data)
+{
+  unsigned i;
+
+  PROCESS_BEGIN();
+
+  db_init();
+  create_relation();
+  create_rows();
+
+  UNIT_TEST_RUN(hidden_attribute);
+  UNIT_TEST_RUN(connectives);
+  UNIT_TEST_RUN(aggregate);
+  UNIT_TEST_RUN(equivalence);
+
+  printf("\n");
+  for(i = 0; i < PREDICATES; i++) {
+    benchmark_predicate(predicates[i]);
+  }
+  benchmark_query("SELECT time, node, value FROM samples WHERE value > 900;");
+  benchmark_query("SELECT time, node, value FROM samples WHERE node = 3 AND value < 500;");
+
+  db_query(NULL, "REMOVE RELATION samples;");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks that the channel check rate of a neighbor travels in the
+ *         ContikiMAC header into the phase table, and simulates a sink
+ *         tree under ContikiMAC with static rates, with burst detection
+ *         and with adaptive rates, for end-to-end latency and radio duty
+ *         cycle.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/packetbuf.h"
+#include "net/mac/mac.h"
+#include "net/mac/phase.h"
+#include "net/mac/contikimac/contikimac-framer.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+PROCESS(contikimac_adaptive_process, "ContikiMAC adaptive rate benchmark");
+AUTOSTART_PROCESSES(&contikimac_adaptive_process);
+
+static const linkaddr_t sender_addr = { { 0, 1 } };
+static const linkaddr_t receiver_addr = { { 0, 2 } };
+
+/* The simulated tree: node 0 is the sink, 1 and 2 relays, the others leaves */
+#define NODES      9
+static const uint8_t parent_of[NODES] = { 0, 0, 0, 1, 1, 1, 2, 2, 2 };
+#define FIRST_LEAF 3
+
+/* Timing, in ticks of 1/8192 s, of ContikiMAC at 8 Hz with its default
+ * constants and 80-byte frames at 250 kbit/s */
+#define SECOND            8192
+#define SECONDS           600
+#define CYCLE             (SECOND / 8)
+#define CHECK_TIME        (2 * (1 + SECOND / 2000))
+#define CHECK_TIME_TX     (6 * (1 + SECOND / 2000))
+#define GUARD_TIME        (10 * CHECK_TIME + CHECK_TIME_TX)
+#define STROBE_TIME       (CYCLE + 2 * CHECK_TIME)
+#define MAX_PHASE_STROBE  (SECOND / 60)
+/* A frame and the wait for its ACK; a receiver hears on average half
+ * of one before the one it receives */
+#define FRAME_TIME        26
+#define RX_TIME           (FRAME_TIME * 3 / 2)
+/* Radio on time of a channel check, and of the CCAs before sending */
+#define CHECK_ON          4
+#define CCA_TX_ON         6
+
+#define QUEUE_LEN         8
+#define MAX_TRANSMISSIONS 3
+/* How often a node broadcasts, and thereby advertises its rate */
+#define BROADCAST_PERIOD  (8 * SECOND)
+
+/* The defaults of contikimac.c */
+#define ADAPTIVE_MAX_SHIFT 2
+#define ADAPTIVE_WINDOW    (4 * 8)
+#define ADAPTIVE_UP        4
+
+enum { STATIC, BURSTS, ADAPTIVE };
+static const char *variant_name[] = { "static  ", "bursts  ", "adaptive" };
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(advertise, "Rates travel to the phase table");
+
+UNIT_TEST(advertise)
+{
+  uint8_t frame[PACKETBUF_SIZE];
+  int len, shift;
+
+  UNIT_TEST_BEGIN();
+
+  /* We are the neighbor, as framer-802154 sends from our own address */
+  linkaddr_set_node_addr((linkaddr_t *)&receiver_addr);
+  phase_init();
+
+  /* A rate is only kept along with a phase */
+  phase_set_rate_shift(&receiver_addr, 2);
+  UNIT_TEST_ASSERT(phase_rate_shift(&receiver_addr) == 0);
+  phase_update(&receiver_addr, 100, MAC_TX_OK);
+  UNIT_TEST_ASSERT(phase_rate_shift(&receiver_addr) == 0);
+
+  /* Each rate shift makes it through the header, that of the base rate
+   * as the ContikiMAC id of nodes without adaptive rates */
+  for(shift = 0; shift <= ADAPTIVE_MAX_SHIFT; shift++) {
+    packetbuf_clear();
+    packetbuf_copyfrom("data", 4);
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &sender_addr);
+    packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_DATAFRAME);
+    packetbuf_set_attr(PACKETBUF_ATTR_CHECK_RATE_SHIFT, shift);
+    UNIT_TEST_ASSERT(contikimac_framer.create() > 0);
+    len = packetbuf_totlen();
+    memcpy(frame, packetbuf_hdrptr(), len);
+
+    packetbuf_clear();
+    memcpy(packetbuf_dataptr(), frame, len);
+    packetbuf_set_datalen(len);
+    UNIT_TEST_ASSERT(contikimac_framer.parse() > 0);
+    UNIT_TEST_ASSERT(packetbuf_datalen() == 4);
+    UNIT_TEST_ASSERT(packetbuf_attr(PACKETBUF_ATTR_CHECK_RATE_SHIFT) == shift);
+
+    phase_set_rate_shift(packetbuf_addr(PACKETBUF_ADDR_SENDER),
+                         packetbuf_attr(PACKETBUF_ATTR_CHECK_RATE_SHIFT));
+    UNIT_TEST_ASSERT(phase_rate_shift(&receiver_addr) == shift);
+  }
+
+  /* Forgetting the phase forgets the rate */
+  phase_remove(&receiver_addr);
+  UNIT_TEST_ASSERT(phase_rate_shift(&receiver_addr) == 0);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+enum { IDLE, DEFERRED, STROBING };
+
+struct node {
+  /* Queue to the parent: tick each packet was created at */
+  uint32_t created[QUEUE_LEN];
+  uint8_t head, len;
+  uint8_t state, transmissions, burst;
+  uint32_t until;
+  /* Sending or receiving a burst until then */
+  uint32_t busy_until;
+  /* Our channel checks */
+  uint32_t cycle_start, next_check;
+  uint8_t rate_shift, check, checking;
+  uint16_t window, frames;
+  /* Phase of the parent, and the rate shift it advertised */
+  uint8_t has_phase, parent_shift;
+  uint32_t phase;
+  unsigned long long radio_on;
+};
+static struct node nodes[NODES];
+
+struct stats {
+  unsigned long created, delivered;
+  unsigned long long latency;
+  unsigned long max_latency;
+};
+/*---------------------------------------------------------------------------*/
+static void
+enqueue(struct node *n, uint32_t created)
+{
+  if(n->len < QUEUE_LEN) {
+    n->created[(n->head + n->len) % QUEUE_LEN] = created;
+    n->len++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The channel checks of a node: 2^rate_shift per cycle, the rate only
+ * changing at a cycle start, as in contikimac.c */
+static void
+next_check(struct node *n, int variant)
+{
+  n->check = (n->check + 1) & ((1 << n->rate_shift) - 1);
+  if(n->check == 0) {
+    n->cycle_start += CYCLE;
+    if(variant == ADAPTIVE && ++n->window >= ADAPTIVE_WINDOW) {
+      n->window = 0;
+      if(n->rate_shift < ADAPTIVE_MAX_SHIFT &&
+         n->frames >= (ADAPTIVE_UP << n->rate_shift)) {
+        n->rate_shift++;
+      } else if(n->rate_shift > 0 &&
+                n->frames < (ADAPTIVE_UP << (n->rate_shift - 1)) / 2) {
+        n->rate_shift--;
+      }
+      n->frames = 0;
+    }
+  }
+  n->next_check = n->cycle_start + ((CYCLE * n->check) >> n->rate_shift);
+}
+/*---------------------------------------------------------------------------*/
+/* Start sending the head of the queue, as send_packet() and phase_wait() */
+static void
+start_sending(struct node *n, uint32_t t, int variant)
+{
+  uint32_t period, expected;
+
+  /* Without burst detection, the frames queued from now on are not
+   * announced by the pending bit of the last one */
+  n->burst = n->len;
+  n->radio_on += CCA_TX_ON;
+  if(n->has_phase) {
+    period = CYCLE >> (variant == ADAPTIVE ? n->parent_shift : 0);
+    expected = n->phase + (t + GUARD_TIME - n->phase + period - 1) / period * period;
+    n->state = DEFERRED;
+    n->until = expected - GUARD_TIME;
+  } else {
+    n->state = STROBING;
+    n->until = t + STROBE_TIME;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+simulate(int per_minute, int variant)
+{
+  struct stats s;
+  struct node *n, *p;
+  unsigned long long leaves, relays;
+  uint32_t t, created;
+  int i, k, frames;
+
+  memset(nodes, 0, sizeof(nodes));
+  memset(&s, 0, sizeof(s));
+  random_init(1);
+  for(i = 0; i < NODES; i++) {
+    nodes[i].cycle_start = random_rand() % CYCLE;
+    nodes[i].next_check = nodes[i].cycle_start;
+  }
+
+  for(t = 0; t < SECONDS * SECOND; t++) {
+    /* Leaves create packets */
+    for(i = FIRST_LEAF; i < NODES; i++) {
+      if(((uint32_t)random_rand() << 16 | random_rand()) % (60 * SECOND) < per_minute) {
+        s.created++;
+        enqueue(&nodes[i], t);
+      }
+    }
+
+    /* Channel checks, unless sending or receiving */
+    for(i = 0; i < NODES; i++) {
+      n = &nodes[i];
+      n->checking = 0;
+      if(t == n->next_check) {
+        if(n->state != STROBING && t >= n->busy_until) {
+          n->checking = 1;
+          n->radio_on += CHECK_ON;
+        }
+        next_check(n, variant);
+      }
+    }
+
+    /* Broadcasts advertise the rate to the children that know our phase */
+    for(i = 1; i < NODES; i++) {
+      n = &nodes[i];
+      if(t % BROADCAST_PERIOD == 0 && n->has_phase) {
+        n->parent_shift = nodes[parent_of[i]].rate_shift;
+      }
+    }
+
+    for(i = 1; i < NODES; i++) {
+      n = &nodes[i];
+      p = &nodes[parent_of[i]];
+      if(t < n->busy_until) {
+        continue;
+      }
+      if(n->state == IDLE && n->len > 0) {
+        start_sending(n, t, variant);
+      }
+      if(n->state == DEFERRED && t >= n->until) {
+        n->state = STROBING;
+        n->until = t + MAX_PHASE_STROBE;
+      }
+      if(n->state != STROBING) {
+        continue;
+      }
+      n->radio_on++;
+
+      if(p->checking) {
+        /* Caught the parent awake: send the burst. The first frame is
+         * always sent, the others if announced in time */
+        frames = variant == STATIC ? MIN(n->burst, n->len) : n->len;
+        frames = MAX(frames, 1);
+        p->checking = 0;
+        p->frames += frames;
+        p->radio_on += RX_TIME + (frames - 1) * FRAME_TIME;
+        n->radio_on += frames * FRAME_TIME;
+        n->has_phase = 1;
+        n->phase = t;
+        n->state = IDLE;
+        n->busy_until = t + RX_TIME + (frames - 1) * FRAME_TIME;
+        p->busy_until = n->busy_until;
+        n->transmissions = 0;
+        for(k = 0; k < frames; k++) {
+          created = n->created[n->head];
+          n->head = (n->head + 1) % QUEUE_LEN;
+          n->len--;
+          if(parent_of[i] == 0) {
+            s.delivered++;
+            s.latency += n->busy_until - created;
+            s.max_latency = MAX(s.max_latency, n->busy_until - created);
+          } else {
+            enqueue(p, created);
+          }
+        }
+      } else if(t >= n->until) {
+        /* Missed: with adaptive rates, the phase may be a check the
+         * parent dropped, so it is learned again */
+        if(variant == ADAPTIVE) {
+          n->has_phase = 0;
+          n->parent_shift = 0;
+        }
+        n->state = IDLE;
+        if(++n->transmissions >= MAX_TRANSMISSIONS) {
+          n->head = (n->head + 1) % QUEUE_LEN;
+          n->len--;
+          n->transmissions = 0;
+        }
+      }
+    }
+  }
+
+  leaves = 0;
+  for(i = FIRST_LEAF; i < NODES; i++) {
+    leaves += nodes[i].radio_on;
+  }
+  relays = nodes[1].radio_on + nodes[2].radio_on;
+  printf("%3d packets/min per leaf, %s: %5.1f%% delivered, latency %4lu ms (max %5lu), "
+         "duty cycle leaves %.2f%%, relays %.2f%%, sink %.2f%%\n",
+         per_minute, variant_name[variant],
+         s.created ? 100.0 * s.delivered / s.created : 0.0,
+         s.delivered ? (unsigned long)(s.latency * 1000 / SECOND / s.delivered) : 0,
+         s.max_latency * 1000 / SECOND,
+         100.0 * leaves / (NODES - FIRST_LEAF) / (SECONDS * SECOND),
+         100.0 * relays / 2 / (SECONDS * SECOND),
+         100.0 * nodes[0].radio_on / (SECONDS * SECOND));
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(contikimac_adaptive_process, ev, data)
+{
+  static const int per_minute[] = { 1, 6, 30, 60 };
+  int i;
+
+  PROCESS_BEGIN();
+
+  UNIT_TEST_RUN(advertise);
+
+  printf("\n");
+  for(i = 0; i < sizeof(per_minute) / sizeof(per_minute[0]); i++) {
+    simulate(per_minute[i], STATIC);
+    simulate(per_minute[i], BURSTS);
+    simulate(per_minute[i], ADAPTIVE);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Check values and streaming of the CRC16 (CCITT and MODBUS)
+ *         and CRC32 calculations, and their throughput. Build with
+ *         TABLE=0 or TABLE=16 for the smaller variants.
+ */
+
+#include "contiki.h"
+#include "lib/crc16.h"
+#include "lib/crc32.h"
+#include "lib/random.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+
+#define DATA_SIZE   1024
+#define BENCH_BYTES (16UL * 1024 * 1024)
+
+static unsigned char buf[DATA_SIZE];
+static const unsigned char check[] = "123456789";
+
+PROCESS(crc_table_process, "CRC benchmark");
+AUTOSTART_PROCESSES(&crc_table_process);
+/*---------------------------------------------------------------------------*/
+/* Bit by bit, as in the specifications, to check the other variants */
+static uint32_t
+reference(uint32_t poly, int bits, const unsigned char *p, int len,
+          uint32_t crc)
+{
+  uint32_t mask;
+  int i, j;
+
+  mask = bits == 32 ? 0xffffffffUL : (1UL << bits) - 1;
+  for(i = 0; i < len; i++) {
+    crc ^= p[i];
+    for(j = 0; j < 8; j++) {
+      crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+    }
+  }
+  return crc & mask;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(check_values, "The catalogued check values");
+UNIT_TEST_REGISTER(reference_data, "Random data gives the bitwise CRCs");
+UNIT_TEST_REGISTER(streaming, "Data in pieces gives the same CRCs");
+
+UNIT_TEST(check_values)
+{
+  int len = sizeof(check) - 1;
+
+  UNIT_TEST_BEGIN();
+
+  UNIT_TEST_ASSERT(crc16_data(check, len, 0) == 0x2189);
+  UNIT_TEST_ASSERT(crc16_modbus_data(check, len, 0xffff) == 0x4b37);
+  UNIT_TEST_ASSERT(crc32_data(check, len, 0) == 0xcbf43926UL);
+  UNIT_TEST_ASSERT(crc16_data(check, 0, 0x1234) == 0x1234);
+  UNIT_TEST_ASSERT(crc32_data(check, 0, 0) == 0);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(reference_data)
+{
+  unsigned short init;
+  int len;
+
+  UNIT_TEST_BEGIN();
+
+  for(len = 0; len < DATA_SIZE; len += 37) {
+    init = random_rand();
+    UNIT_TEST_ASSERT(crc16_data(buf, len, init) ==
+                     reference(0x8408, 16, buf, len, init));
+    UNIT_TEST_ASSERT(crc16_modbus_data(buf, len, init) ==
+                     reference(0xa001, 16, buf, len, init));
+    UNIT_TEST_ASSERT(crc32_data(buf, len, 0) ==
+                     (reference(0xedb88320UL, 32, buf, len,
+                                0xffffffffUL) ^ 0xffffffffUL));
+  }
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(streaming)
+{
+  unsigned short ccitt, modbus;
+  uint32_t crc32;
+  int i, split;
+
+  UNIT_TEST_BEGIN();
+
+  for(split = 0; split <= 64; split++) {
+    ccitt = crc16_data(buf, split, 0);
+    ccitt = crc16_data(buf + split, 64 - split, ccitt);
+    UNIT_TEST_ASSERT(ccitt == crc16_data(buf, 64, 0));
+
+    modbus = crc16_modbus_data(buf, split, 0xffff);
+    modbus = crc16_modbus_data(buf + split, 64 - split, modbus);
+    UNIT_TEST_ASSERT(modbus == crc16_modbus_data(buf, 64, 0xffff));
+
+    crc32 = crc32_data(buf, split, 0);
+    crc32 = crc32_data(buf + split, 64 - split, crc32);
+    UNIT_TEST_ASSERT(crc32 == crc32_data(buf, 64, 0));
+  }
+
+  /* One byte at a time */
+  ccitt = 0;
+  modbus = 0xffff;
+  crc32 = 0;
+  for(i = 0; i < 64; i++) {
+    ccitt = crc16_add(buf[i], ccitt);
+    modbus = crc16_modbus_add(buf[i], modbus);
+    crc32 = crc32_add(buf[i], crc32);
+  }
+  UNIT_TEST_ASSERT(ccitt == crc16_data(buf, 64, 0));
+  UNIT_TEST_ASSERT(modbus == crc16_modbus_data(buf, 64, 0xffff));
+  UNIT_TEST_ASSERT(crc32 == crc32_data(buf, 64, 0));
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static volatile uint32_t sink;
+
+/* Native has no cycle counter: the throughput is in bytes per us */
+static void
+report(const char *name, clock_time_t time)
+{
+  unsigned long rate;
+
+  if(time == 0) {
+    time = 1;
+  }
+  rate = BENCH_BYTES / 100 / time;
+  printf("%-12s %lu bytes in %4lu ms: %3lu.%lu bytes/us\n", name,
+         BENCH_BYTES, (unsigned long)time, rate / 10, rate % 10);
+}
+
+static void
+benchmark(void)
+{
+  clock_time_t start;
+  unsigned long n;
+  uint32_t crc32;
+  unsigned short crc;
+
+  printf("CRC table of %d (CRC16) and %d (CRC32) entries\n",
+         CRC16_TABLE, CRC32_TABLE);
+
+  start = clock_time();
+  crc = 0;
+  for(n = 0; n < BENCH_BYTES; n += DATA_SIZE) {
+    crc = crc16_data(buf, DATA_SIZE, crc);
+  }
+  sink = crc;
+  report("crc16", clock_time() - start);
+
+  start = clock_time();
+  crc = 0xffff;
+  for(n = 0; n < BENCH_BYTES; n += DATA_SIZE) {
+    crc = crc16_modbus_data(buf, DATA_SIZE, crc);
+  }
+  sink = crc;
+  report("crc16 modbus", clock_time() - start);
+
+  start = clock_time();
+  crc32 = 0;
+  for(n = 0; n < BENCH_BYTES; n += DATA_SIZE) {
+    crc32 = crc32_data(buf, DATA_SIZE, crc32);
+  }
+  sink = crc32;
+  report("crc32", clock_time() - start);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(crc_table_process, ev, data)
+{
+  int i;
+
+  PROCESS_BEGIN();
+
+  for(i = 0; i < DATA_SIZE; i++) {
+    buf[i] = random_rand();
+  }
+
+  UNIT_TEST_RUN(check_values);
+  UNIT_TEST_RUN(reference_data);
+  UNIT_TEST_RUN(streaming);
+
+  printf("\n");
+  benchmark();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
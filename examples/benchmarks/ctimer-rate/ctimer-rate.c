@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Callback timer checks, and a benchmark of the number of
+ *         callbacks per second.
+ */
+
+#include "contiki.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+
+#define MAX_TIMERS 64
+
+static struct ctimer timers[MAX_TIMERS];
+static int order[MAX_TIMERS];
+static int norder;
+static int wrong_context;
+static unsigned long callbacks;
+static int running;
+
+PROCESS(other_process, "Callback context");
+PROCESS(ctimer_rate_process, "Callback timer benchmark");
+AUTOSTART_PROCESSES(&ctimer_rate_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(other_process, ev, data)
+{
+  PROCESS_BEGIN();
+  PROCESS_WAIT_EVENT_UNTIL(0);
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+record(void *ptr)
+{
+  struct ctimer *c = ptr;
+
+  if(PROCESS_CURRENT() != c->p) {
+    wrong_context = 1;
+  }
+  order[norder++] = c - timers;
+}
+/*---------------------------------------------------------------------------*/
+static void
+again(void *ptr)
+{
+  record(ptr);
+  if(norder < 4) {
+    /* A timer that is due at once runs in the next pass. */
+    ctimer_set(ptr, 0, again, ptr);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+count(void *ptr)
+{
+  callbacks++;
+  if(running) {
+    ctimer_reset(ptr);
+  }
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(ordered, "Callbacks run in the order the timers expire");
+UNIT_TEST_REGISTER(stopped, "Stopped timers do not run");
+
+UNIT_TEST(ordered)
+{
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  /* The timers were set by the process before this test. */
+  UNIT_TEST_ASSERT(!wrong_context);
+  UNIT_TEST_ASSERT(norder == 9);
+  UNIT_TEST_ASSERT(order[0] == 5 && order[1] == 6);
+  UNIT_TEST_ASSERT(order[2] == 5 && order[3] == 5);
+  for(i = 4; i < norder; i++) {
+    UNIT_TEST_ASSERT(order[i] == i - 4);
+  }
+  for(i = 0; i < 8; i++) {
+    UNIT_TEST_ASSERT(ctimer_expired(&timers[i]));
+  }
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(stopped)
+{
+  UNIT_TEST_BEGIN();
+
+  UNIT_TEST_ASSERT(norder == 0);
+  UNIT_TEST_ASSERT(ctimer_expired(&timers[0]));
+  UNIT_TEST_ASSERT(!ctimer_expired(&timers[1]));
+  ctimer_stop(&timers[1]);
+  UNIT_TEST_ASSERT(ctimer_expired(&timers[1]));
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ctimer_rate_process, ev, data)
+{
+  static struct etimer et;
+  static int n;
+  int i;
+
+  PROCESS_BEGIN();
+
+  process_start(&other_process, NULL);
+
+  /* Timers 0 to 4 expire 10 ms apart, in the opposite order from
+     the order they were set in. Timer 6 runs in another process. */
+  for(i = 4; i >= 0; i--) {
+    ctimer_set(&timers[i], CLOCK_SECOND / 50 + i * CLOCK_SECOND / 100,
+               record, &timers[i]);
+  }
+  ctimer_set(&timers[5], 0, again, &timers[5]);
+  ctimer_set_with_process(&timers[6], 0, record, &timers[6],
+                          &other_process);
+  ctimer_set(&timers[7], CLOCK_SECOND, record, &timers[7]);
+  ctimer_stop(&timers[7]);
+
+  etimer_set(&et, CLOCK_SECOND / 5);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  UNIT_TEST_RUN(ordered);
+
+  norder = 0;
+  ctimer_set(&timers[0], CLOCK_SECOND / 100, record, &timers[0]);
+  ctimer_set(&timers[1], CLOCK_SECOND, record, &timers[1]);
+  ctimer_stop(&timers[0]);
+  etimer_set(&et, CLOCK_SECOND / 20);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  UNIT_TEST_RUN(stopped);
+
+  /* Timers that are set again at once by their callbacks. */
+  printf("\n");
+  for(n = 1; n <= MAX_TIMERS; n *= 4) {
+    callbacks = 0;
+    running = 1;
+    for(i = 0; i < n; i++) {
+      ctimer_set(&timers[i], 0, count, &timers[i]);
+    }
+    etimer_set(&et, CLOCK_SECOND);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    running = 0;
+    for(i = 0; i < n; i++) {
+      ctimer_stop(&timers[i]);
+    }
+    printf("%2d timers: %lu callbacks per second\n", n, callbacks);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
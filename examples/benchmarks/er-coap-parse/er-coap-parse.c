@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Parse throughput benchmark and option decoding checks for
+ *         Erbium CoAP.
+ */
+
+#include "contiki.h"
+#include "er-coap.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define ITERATIONS 1000000UL
+#define ROUNDS     5
+
+static uint8_t templates[4][COAP_MAX_PACKET_SIZE];
+static size_t template_len[4];
+static uint8_t work[COAP_MAX_PACKET_SIZE + 1];
+static coap_packet_t packet[1];
+
+static const uint8_t token[] = { 0xCA, 0xFE, 0x01, 0x02 };
+static const uint8_t etag[] = { 0x12, 0x34, 0x56 };
+/*---------------------------------------------------------------------------*/
+static void
+build_templates(void)
+{
+  static coap_packet_t request[1];
+  static const char payload[] = "interval=600&avr=1";
+
+  /* GET with multi-segment Uri-Path, Uri-Query, Accept and Block2 */
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0x1234);
+  coap_set_token(request, token, sizeof(token));
+  coap_set_header_uri_path(request, "sensors/temp/raw");
+  coap_set_header_uri_query(request, "unit=c&avg=10");
+  coap_set_header_accept(request, APPLICATION_JSON);
+  coap_set_header_block2(request, 2, 0, 64);
+  template_len[0] = coap_serialize_message(request, templates[0]);
+
+  /* Observe registration with an ETag */
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0x1235);
+  coap_set_token(request, token, 2);
+  coap_set_header_etag(request, etag, sizeof(etag));
+  coap_set_header_observe(request, 0);
+  coap_set_header_uri_path(request, "sample");
+  template_len[1] = coap_serialize_message(request, templates[1]);
+
+  /* POST with Content-Format, Block1 and a payload */
+  coap_init_message(request, COAP_TYPE_NON, COAP_POST, 0x1236);
+  coap_set_header_uri_path(request, "config");
+  coap_set_header_content_format(request, APPLICATION_OCTET_STREAM);
+  coap_set_header_block1(request, 1, 1, 32);
+  coap_set_payload(request, payload, sizeof(payload) - 1);
+  template_len[2] = coap_serialize_message(request, templates[2]);
+
+  /* the next block of the same transfer, with a different block size */
+  coap_init_message(request, COAP_TYPE_NON, COAP_POST, 0x1237);
+  coap_set_header_uri_path(request, "config");
+  coap_set_header_content_format(request, APPLICATION_OCTET_STREAM);
+  coap_set_header_block1(request, 5, 0, 16);
+  coap_set_payload(request, payload, 8);
+  template_len[3] = coap_serialize_message(request, templates[3]);
+}
+/*---------------------------------------------------------------------------*/
+static coap_status_t
+parse(int i)
+{
+  memcpy(work, templates[i], template_len[i]);
+  return coap_parse_message(packet, work, template_len[i]);
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(decode_get, "Decode GET options");
+UNIT_TEST_REGISTER(decode_observe, "Decode Observe/ETag options");
+UNIT_TEST_REGISTER(decode_post, "Decode POST options");
+UNIT_TEST_REGISTER(decode_consecutive, "Decode Block1 of consecutive messages");
+UNIT_TEST_REGISTER(reserialize, "Re-serialize parsed packet");
+
+UNIT_TEST(decode_get)
+{
+  const char *str;
+  unsigned int accept;
+  uint32_t num, offset;
+  uint8_t more;
+  uint16_t size;
+  int len;
+
+  UNIT_TEST_BEGIN();
+
+  UNIT_TEST_ASSERT(parse(0) == NO_ERROR);
+  UNIT_TEST_ASSERT(packet->token_len == sizeof(token));
+  UNIT_TEST_ASSERT(memcmp(packet->token, token, sizeof(token)) == 0);
+
+  /* decode an option located after the multi-options first */
+  UNIT_TEST_ASSERT(coap_get_header_block2(packet, &num, &more, &size, &offset));
+  UNIT_TEST_ASSERT(num == 2 && more == 0 && size == 64 && offset == 128);
+
+  len = coap_get_header_uri_path(packet, &str);
+  UNIT_TEST_ASSERT(len == 16 && strncmp(str, "sensors/temp/raw", len) == 0);
+  len = coap_get_header_uri_query(packet, &str);
+  UNIT_TEST_ASSERT(len == 13 && strncmp(str, "unit=c&avg=10", len) == 0);
+  len = coap_get_query_variable(packet, "avg", &str);
+  UNIT_TEST_ASSERT(len == 2 && strncmp(str, "10", len) == 0);
+
+  UNIT_TEST_ASSERT(coap_get_header_accept(packet, &accept));
+  UNIT_TEST_ASSERT(accept == APPLICATION_JSON);
+  UNIT_TEST_ASSERT(!coap_get_header_content_format(packet, &accept));
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(decode_observe)
+{
+  const uint8_t *bytes;
+  const char *str;
+  uint32_t observe = 1;
+
+  UNIT_TEST_BEGIN();
+
+  UNIT_TEST_ASSERT(parse(1) == NO_ERROR);
+  UNIT_TEST_ASSERT(coap_get_header_uri_path(packet, &str) == 6);
+  UNIT_TEST_ASSERT(coap_get_header_observe(packet, &observe));
+  UNIT_TEST_ASSERT(observe == 0);
+  UNIT_TEST_ASSERT(coap_get_header_etag(packet, &bytes) == sizeof(etag));
+  UNIT_TEST_ASSERT(memcmp(bytes, etag, sizeof(etag)) == 0);
+  UNIT_TEST_ASSERT(!coap_get_header_if_match(packet, &bytes));
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(decode_post)
+{
+  const uint8_t *payload;
+  unsigned int format;
+  uint32_t num, offset;
+  uint8_t more;
+  uint16_t size;
+
+  UNIT_TEST_BEGIN();
+
+  UNIT_TEST_ASSERT(parse(2) == NO_ERROR);
+  UNIT_TEST_ASSERT(coap_get_payload(packet, &payload) == 18);
+  UNIT_TEST_ASSERT(coap_get_header_content_format(packet, &format));
+  UNIT_TEST_ASSERT(format == APPLICATION_OCTET_STREAM);
+  UNIT_TEST_ASSERT(coap_get_header_block1(packet, &num, &more, &size, &offset));
+  UNIT_TEST_ASSERT(num == 1 && more == 1 && size == 32 && offset == 32);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(decode_consecutive)
+{
+  uint32_t num, offset;
+  uint8_t more;
+  uint16_t size;
+
+  UNIT_TEST_BEGIN();
+
+  /* the packet is reused: nothing may leak from the previous message */
+  UNIT_TEST_ASSERT(parse(2) == NO_ERROR);
+  UNIT_TEST_ASSERT(coap_get_header_block1(packet, &num, &more, &size, &offset));
+  UNIT_TEST_ASSERT(num == 1 && more == 1 && size == 32 && offset == 32);
+
+  UNIT_TEST_ASSERT(parse(3) == NO_ERROR);
+  UNIT_TEST_ASSERT(coap_get_header_block1(packet, &num, &more, &size, &offset));
+  UNIT_TEST_ASSERT(num == 5 && more == 0 && size == 16 && offset == 80);
+
+  /* also when the first message was never looked at */
+  UNIT_TEST_ASSERT(parse(2) == NO_ERROR);
+  UNIT_TEST_ASSERT(parse(3) == NO_ERROR);
+  UNIT_TEST_ASSERT(coap_get_header_block1(packet, &num, &more, &size, &offset));
+  UNIT_TEST_ASSERT(num == 5 && more == 0 && size == 16 && offset == 80);
+
+  /* and a message without Block1 must not report the old one */
+  UNIT_TEST_ASSERT(parse(1) == NO_ERROR);
+  UNIT_TEST_ASSERT(!coap_get_header_block1(packet, NULL, NULL, NULL, NULL));
+  UNIT_TEST_ASSERT(!coap_get_header_block2(packet, NULL, NULL, NULL, NULL));
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(reserialize)
+{
+  static uint8_t out[COAP_MAX_PACKET_SIZE];
+  const char *str;
+
+  UNIT_TEST_BEGIN();
+
+  /* a parsed packet must serialize back to the bytes it came from */
+  UNIT_TEST_ASSERT(parse(0) == NO_ERROR);
+  UNIT_TEST_ASSERT(coap_serialize_message(packet, out) == template_len[0]);
+  UNIT_TEST_ASSERT(memcmp(out, templates[0], template_len[0]) == 0);
+
+  /* also after a multi-option has been merged in place */
+  UNIT_TEST_ASSERT(parse(0) == NO_ERROR);
+  UNIT_TEST_ASSERT(coap_get_header_uri_path(packet, &str) == 16);
+  UNIT_TEST_ASSERT(coap_serialize_message(packet, out) == template_len[0]);
+  UNIT_TEST_ASSERT(memcmp(out, templates[0], template_len[0]) == 0);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(const char *name, int template, int get_path)
+{
+  rtimer_clock_t start, duration, best;
+  const char *str;
+  unsigned int accept;
+  uint32_t num;
+  unsigned long i;
+  int round;
+
+  /* report the best of several rounds to keep scheduling noise out */
+  best = 0;
+  for(round = 0; round < ROUNDS; round++) {
+    start = RTIMER_NOW();
+    for(i = 0; i < ITERATIONS; i++) {
+      parse(template);
+      if(get_path) {
+        /* what the REST engine and a typical GET handler look at */
+        coap_get_header_uri_path(packet, &str);
+        coap_get_header_block2(packet, &num, NULL, NULL, NULL);
+        coap_get_header_accept(packet, &accept);
+      }
+    }
+    duration = RTIMER_NOW() - start;
+    if(round == 0 || duration < best) {
+      best = duration;
+    }
+  }
+  if(best == 0) {
+    best = 1;
+  }
+
+  printf("%s: %lu messages in %lu ticks, %lu messages/s\n", name,
+         ITERATIONS, (unsigned long)best,
+         (unsigned long)((unsigned long long)ITERATIONS * RTIMER_SECOND / best));
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(coap_parse_process, "CoAP parse benchmark");
+AUTOSTART_PROCESSES(&coap_parse_process);
+
+PROCESS_THREAD(coap_parse_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  build_templates();
+
+  UNIT_TEST_RUN(decode_get);
+  UNIT_TEST_RUN(decode_observe);
+  UNIT_TEST_RUN(decode_post);
+  UNIT_TEST_RUN(decode_consecutive);
+  UNIT_TEST_RUN(reserialize);
+
+  printf("\nsizeof(coap_packet_t): %u bytes\n", (unsigned)sizeof(coap_packet_t));
+  benchmark("GET parse only", 0, 0);
+  benchmark("GET parse + handler getters", 0, 1);
+  benchmark("Observe parse + handler getters", 1, 1);
+  benchmark("POST parse only", 2, 0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
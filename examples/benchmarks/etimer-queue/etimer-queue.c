@@ -0,0 +1,412 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Event timer queue checks, and a benchmark of the cost of
+ *         setting and expiring event timers as the number of pending
+ *         timers grows.
+ */
+
+#include "contiki.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_TIMERS    4096
+#define EXPIRING      16
+#define OPERATIONS    200000UL
+#define FAR_AWAY      (3600UL * CLOCK_SECOND)
+
+static struct etimer timers[MAX_TIMERS];
+static struct etimer expiring[EXPIRING];
+static unsigned long fired;
+static struct etimer *last_fired;
+
+PROCESS(sink_process, "Timer sink");
+PROCESS(other_process, "Other timer owner");
+PROCESS(etimer_queue_process, "Event timer benchmark");
+AUTOSTART_PROCESSES(&etimer_queue_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(sink_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    if(ev == PROCESS_EVENT_TIMER) {
+      fired++;
+      last_fired = data;
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(other_process, ev, data)
+{
+  PROCESS_BEGIN();
+  PROCESS_WAIT_EVENT_UNTIL(0);
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+/* A simple linear congruential generator, so that every run of the
+   benchmark uses the same intervals. */
+static unsigned long
+next_random(void)
+{
+  static unsigned long state = 1;
+
+  state = state * 1103515245UL + 12345;
+  return (state >> 8) & 0xffff;
+}
+/*---------------------------------------------------------------------------*/
+/* Deliver the events that are posted by the event timer process. */
+static void
+run_events(void)
+{
+  int i;
+
+  PROCESS_CONTEXT_BEGIN(&sink_process);
+  for(i = 0; i < 10000 && process_run() > 0; i++);
+  PROCESS_CONTEXT_END(&sink_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_timer(struct etimer *et, clock_time_t interval)
+{
+  PROCESS_CONTEXT_BEGIN(&sink_process);
+  etimer_set(et, interval);
+  PROCESS_CONTEXT_END(&sink_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+stop_all(void)
+{
+  int i;
+
+  for(i = 0; i < MAX_TIMERS; i++) {
+    etimer_stop(&timers[i]);
+  }
+  for(i = 0; i < EXPIRING; i++) {
+    etimer_stop(&expiring[i]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Check the next expiration time against every pending timer. */
+static int
+next_expiration_is_earliest(int count)
+{
+  clock_time_t next;
+  clock_time_t now;
+  int pending;
+  int i;
+
+  now = clock_time();
+  next = etimer_next_expiration_time();
+  pending = 0;
+  for(i = 0; i < count; i++) {
+    if(!etimer_expired(&timers[i])) {
+      pending++;
+      if(etimer_expiration_time(&timers[i]) - now < next - now) {
+        return 0;
+      }
+    }
+  }
+
+  return pending == 0 ? !etimer_pending() : etimer_pending();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(earliest, "Next expiration after set, stop, and adjust");
+UNIT_TEST_REGISTER(expiry, "Expired timers are posted once");
+UNIT_TEST_REGISTER(exited, "Timers of an exited process are removed");
+UNIT_TEST_REGISTER(copied, "Copies of pending timers are not in the heap");
+UNIT_TEST_REGISTER(uninitialized, "Timers that were never set are not in the heap");
+
+UNIT_TEST(earliest)
+{
+  int i, j;
+
+  UNIT_TEST_BEGIN();
+
+  for(i = 0; i < 256; i++) {
+    set_timer(&timers[i], FAR_AWAY + next_random());
+    UNIT_TEST_ASSERT(next_expiration_is_earliest(256));
+  }
+
+  for(i = 0; i < 2000; i++) {
+    j = next_random() % 256;
+    switch(i % 4) {
+    case 0:
+      etimer_stop(&timers[j]);
+      break;
+    case 1:
+      set_timer(&timers[j], FAR_AWAY + next_random());
+      break;
+    case 2:
+      /* A timer that is moved into the future counts as expired, as
+         with timer_expired(), so only move timers back. */
+      etimer_adjust(&timers[j], -(int)(next_random() % 1000));
+      break;
+    default:
+      PROCESS_CONTEXT_BEGIN(&sink_process);
+      etimer_restart(&timers[j]);
+      PROCESS_CONTEXT_END(&sink_process);
+      break;
+    }
+    UNIT_TEST_ASSERT(next_expiration_is_earliest(256));
+  }
+
+  /* Remove the timers in the order they would expire. */
+  while(etimer_pending()) {
+    for(i = 0; i < 256; i++) {
+      if(!etimer_expired(&timers[i]) &&
+         etimer_expiration_time(&timers[i]) == etimer_next_expiration_time()) {
+        break;
+      }
+    }
+    UNIT_TEST_ASSERT(i < 256);
+    etimer_stop(&timers[i]);
+    UNIT_TEST_ASSERT(next_expiration_is_earliest(256));
+  }
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(expiry)
+{
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  for(i = 0; i < 100; i++) {
+    set_timer(&timers[i], i % 2 ? FAR_AWAY : 0);
+  }
+
+  fired = 0;
+  run_events();
+  UNIT_TEST_ASSERT(fired == 50);
+  for(i = 0; i < 100; i++) {
+    UNIT_TEST_ASSERT(etimer_expired(&timers[i]) == !(i % 2));
+  }
+
+  /* Nothing more expires. */
+  run_events();
+  UNIT_TEST_ASSERT(fired == 50);
+
+  /* A timer that is set again while pending is only posted once. */
+  set_timer(&timers[1], 0);
+  set_timer(&timers[1], 0);
+  run_events();
+  UNIT_TEST_ASSERT(fired == 51 && last_fired == &timers[1]);
+  UNIT_TEST_ASSERT(next_expiration_is_earliest(100));
+
+  stop_all();
+  UNIT_TEST_ASSERT(!etimer_pending());
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(exited)
+{
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  process_start(&other_process, NULL);
+  for(i = 0; i < 64; i++) {
+    if(i % 3 == 0) {
+      PROCESS_CONTEXT_BEGIN(&other_process);
+      etimer_set(&timers[i], FAR_AWAY + i);
+      PROCESS_CONTEXT_END(&other_process);
+    } else {
+      set_timer(&timers[i], FAR_AWAY + i);
+    }
+  }
+
+  process_exit(&other_process);
+  for(i = 0; i < 64; i++) {
+    UNIT_TEST_ASSERT(etimer_expired(&timers[i]) == (i % 3 == 0));
+  }
+  UNIT_TEST_ASSERT(next_expiration_is_earliest(64));
+  UNIT_TEST_ASSERT(etimer_next_expiration_time() ==
+                   etimer_expiration_time(&timers[1]));
+
+  stop_all();
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(int count)
+{
+  clock_time_t start, set_time, restart_time, expire_time;
+  unsigned long i, rounds;
+  int j;
+
+  stop_all();
+
+  /* Set the timers over and over again. */
+  rounds = OPERATIONS / count;
+  start = clock_time();
+  for(i = 0; i < rounds; i++) {
+    for(j = 0; j < count; j++) {
+      etimer_stop(&timers[j]);
+    }
+    for(j = 0; j < count; j++) {
+      set_timer(&timers[j], FAR_AWAY + next_random());
+    }
+  }
+  set_time = clock_time() - start;
+
+  /* Restart pending timers at random. */
+  start = clock_time();
+  PROCESS_CONTEXT_BEGIN(&sink_process);
+  for(i = 0; i < OPERATIONS; i++) {
+    etimer_restart(&timers[next_random() % count]);
+  }
+  PROCESS_CONTEXT_END(&sink_process);
+  restart_time = clock_time() - start;
+
+  /* Let a few timers expire while the others are pending. */
+  rounds = OPERATIONS / EXPIRING / 4;
+  fired = 0;
+  start = clock_time();
+  for(i = 0; i < rounds; i++) {
+    for(j = 0; j < EXPIRING; j++) {
+      set_timer(&expiring[j], 0);
+    }
+    run_events();
+  }
+  expire_time = clock_time() - start;
+
+  printf("%4d timers: %lu set+stop in %lu ticks, %lu restarts in %lu ticks, "
+         "%lu expiries in %lu ticks\n", count,
+         OPERATIONS / count * count, (unsigned long)set_time,
+         OPERATIONS, (unsigned long)restart_time,
+         fired, (unsigned long)expire_time);
+
+  stop_all();
+}
+UNIT_TEST(copied)
+{
+  static struct etimer copy;
+  int i, pending;
+
+  UNIT_TEST_BEGIN();
+
+  for(i = 0; i < 64; i++) {
+    set_timer(&timers[i], FAR_AWAY + next_random());
+  }
+
+  /* A copy of a pending timer has its links, but setting or stopping
+     it must leave the heap and the original alone. */
+  for(i = 0; i < 64; i++) {
+    copy = timers[i];
+    set_timer(&copy, FAR_AWAY + next_random());
+    etimer_stop(&copy);
+    copy = timers[i];
+    etimer_stop(&copy);
+    UNIT_TEST_ASSERT(!etimer_expired(&timers[i]));
+    UNIT_TEST_ASSERT(next_expiration_is_earliest(64));
+  }
+
+  /* Nor may a copy of a timer that has been stopped since. */
+  copy = timers[10];
+  etimer_stop(&timers[10]);
+  set_timer(&copy, FAR_AWAY + 1);
+  UNIT_TEST_ASSERT(next_expiration_is_earliest(64));
+  etimer_stop(&copy);
+
+  /* Every timer is still reachable: stopping them all empties the
+     heap. */
+  pending = 0;
+  for(i = 0; i < 64; i++) {
+    pending += !etimer_expired(&timers[i]);
+  }
+  UNIT_TEST_ASSERT(pending == 63);
+  stop_all();
+  UNIT_TEST_ASSERT(!etimer_pending());
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(uninitialized)
+{
+  static struct etimer garbage;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  for(i = 0; i < 64; i++) {
+    set_timer(&timers[i], FAR_AWAY + next_random());
+  }
+
+  /* A timer in memory that was never cleared, as on the stack or from
+     malloc(), has links that lead nowhere. Stopping, adjusting, and
+     setting it must not follow them. */
+  memset(&garbage, 0xa5, sizeof(garbage));
+  etimer_stop(&garbage);
+  memset(&garbage, 0xa5, sizeof(garbage));
+  etimer_adjust(&garbage, 1);
+  memset(&garbage, 0xa5, sizeof(garbage));
+  set_timer(&garbage, FAR_AWAY + 1);
+  UNIT_TEST_ASSERT(!etimer_expired(&garbage));
+  UNIT_TEST_ASSERT(next_expiration_is_earliest(64));
+  etimer_stop(&garbage);
+
+  stop_all();
+  UNIT_TEST_ASSERT(!etimer_pending());
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(etimer_queue_process, ev, data)
+{
+  int count;
+
+  PROCESS_BEGIN();
+
+  process_start(&sink_process, NULL);
+
+  UNIT_TEST_RUN(earliest);
+  UNIT_TEST_RUN(expiry);
+  UNIT_TEST_RUN(exited);
+  UNIT_TEST_RUN(copied);
+  UNIT_TEST_RUN(uninitialized);
+
+  printf("\nsizeof(struct etimer): %u bytes\n",
+         (unsigned)sizeof(struct etimer));
+  for(count = 16; count <= MAX_TIMERS; count *= 4) {
+    benchmark(count);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
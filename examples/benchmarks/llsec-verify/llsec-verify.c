@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks of the llsec session table and of noncoresec, and a
+ *         benchmark of the frames it verifies per second when many
+ *         neighbors send in turn.
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/netstack.h"
+#include "net/llsec/anti-replay.h"
+#include "net/llsec/llsec-session.h"
+#include "net/llsec/noncoresec/noncoresec.h"
+#include "net/mac/frame802154.h"
+#include "lib/aes-128.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define NEIGHBORS   LLSEC_SESSION_MAX
+#define PER_NEIGHBOR 20
+#define FRAMES      (NEIGHBORS * PER_NEIGHBOR)
+#define PAYLOAD     60
+#define ROUNDS      50
+#define SET_KEYS    1000000UL
+
+struct frame {
+  uint8_t len;
+  uint8_t data[PACKETBUF_SIZE];
+};
+
+/* Sent in turn by the neighbors, each with a greater frame counter */
+static struct frame frames[FRAMES];
+static linkaddr_t receiver;
+
+PROCESS(llsec_verify_process, "llsec verification benchmark");
+AUTOSTART_PROCESSES(&llsec_verify_process);
+/*---------------------------------------------------------------------------*/
+static void
+neighbor_addr(linkaddr_t *addr, int n)
+{
+  memset(addr, 0, sizeof(*addr));
+#if LINKADDR_SIZE == 8
+  /* Addresses from the same vendor, as in a real deployment */
+  addr->u8[1] = 0x12;
+  addr->u8[2] = 0x4b;
+#endif /* LINKADDR_SIZE == 8 */
+  addr->u8[LINKADDR_SIZE - 2] = n >> 8;
+  addr->u8[LINKADDR_SIZE - 1] = n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_frames(void)
+{
+  linkaddr_t sender;
+  int i, j;
+
+  linkaddr_copy(&receiver, &linkaddr_node_addr);
+  for(i = 0; i < FRAMES; i++) {
+    neighbor_addr(&sender, i % NEIGHBORS);
+    linkaddr_copy(&linkaddr_node_addr, &sender);
+
+    packetbuf_clear();
+    for(j = 0; j < PAYLOAD; j++) {
+      ((uint8_t *)packetbuf_dataptr())[j] = i + j;
+    }
+    packetbuf_set_datalen(PAYLOAD);
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &linkaddr_null);
+    packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_DATAFRAME);
+    packetbuf_set_attr(PACKETBUF_ATTR_SECURITY_LEVEL, NONCORESEC_CONF_SEC_LVL);
+    anti_replay_set_counter();
+    NETSTACK_FRAMER.create();
+
+    frames[i].len = packetbuf_totlen();
+    memcpy(frames[i].data, packetbuf_hdrptr(), frames[i].len);
+  }
+  linkaddr_copy(&linkaddr_node_addr, &receiver);
+}
+/*---------------------------------------------------------------------------*/
+static int
+receive(const struct frame *f)
+{
+  packetbuf_clear();
+  memcpy(packetbuf_dataptr(), f->data, f->len);
+  packetbuf_set_datalen(f->len);
+  return NETSTACK_FRAMER.parse() != FRAMER_FAILED;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(table, "Sessions are found by address");
+UNIT_TEST_REGISTER(verify, "Frames are verified once");
+UNIT_TEST_REGISTER(keys, "Kept key schedules give the right ciphertexts");
+
+UNIT_TEST(table)
+{
+  struct llsec_session *s[NEIGHBORS];
+  linkaddr_t addr;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  llsec_session_init();
+  for(i = 0; i < NEIGHBORS; i++) {
+    neighbor_addr(&addr, i);
+    UNIT_TEST_ASSERT(llsec_session_get(&addr) == NULL);
+    s[i] = llsec_session_add(&addr);
+    UNIT_TEST_ASSERT(s[i] != NULL);
+  }
+  UNIT_TEST_ASSERT(llsec_session_count() == NEIGHBORS);
+
+  neighbor_addr(&addr, NEIGHBORS);
+  UNIT_TEST_ASSERT(llsec_session_add(&addr) == NULL);
+  UNIT_TEST_ASSERT(llsec_session_get(&addr) == NULL);
+
+  for(i = 0; i < NEIGHBORS; i++) {
+    neighbor_addr(&addr, i);
+    UNIT_TEST_ASSERT(llsec_session_get(&addr) == s[i]);
+    UNIT_TEST_ASSERT(linkaddr_cmp(&s[i]->addr, &addr));
+  }
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(verify)
+{
+  struct frame f;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  llsec_session_init();
+  for(i = 0; i < FRAMES; i++) {
+    UNIT_TEST_ASSERT(receive(&frames[i]));
+  }
+  UNIT_TEST_ASSERT(llsec_session_count() == NEIGHBORS);
+
+  /* Replayed frames */
+  for(i = 0; i < FRAMES; i += 7) {
+    UNIT_TEST_ASSERT(!receive(&frames[i]));
+  }
+
+  /* A forged frame, which does not move the frame counter */
+  llsec_session_init();
+  f = frames[NEIGHBORS];
+  f.data[f.len - 1] ^= 1;
+  UNIT_TEST_ASSERT(!receive(&f));
+  UNIT_TEST_ASSERT(receive(&frames[0]));
+  UNIT_TEST_ASSERT(receive(&frames[NEIGHBORS]));
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(keys)
+{
+  /* FIPS-197, appendices B and C.1 */
+  static const uint8_t key[2][AES_128_KEY_LENGTH] = {
+    { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+      0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c },
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+      0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f },
+  };
+  static const uint8_t plaintext[2][AES_128_BLOCK_SIZE] = {
+    { 0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d,
+      0x31, 0x31, 0x98, 0xa2, 0xe0, 0x37, 0x07, 0x34 },
+    { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+      0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff },
+  };
+  static const uint8_t ciphertext[2][AES_128_BLOCK_SIZE] = {
+    { 0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb,
+      0xdc, 0x11, 0x85, 0x97, 0x19, 0x6a, 0x0b, 0x32 },
+    { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+      0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a },
+  };
+  uint8_t block[AES_128_BLOCK_SIZE];
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  /* Switch between the two keys, and to a third one and back */
+  for(i = 0; i < 6; i++) {
+    if(i == 4) {
+      AES_128.set_key(plaintext[0]);
+    }
+    AES_128.set_key(key[i & 1]);
+    memcpy(block, plaintext[i & 1], AES_128_BLOCK_SIZE);
+    AES_128.encrypt(block);
+    UNIT_TEST_ASSERT(!memcmp(block, ciphertext[i & 1], AES_128_BLOCK_SIZE));
+  }
+
+  NETSTACK_LLSEC.init();
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(void)
+{
+  const struct llsec_session_stats *stats;
+  clock_time_t start, time;
+  unsigned long verified;
+  uint8_t key[2][AES_128_KEY_LENGTH];
+  unsigned long n;
+  int r, i;
+
+  llsec_session_stats_reset();
+  verified = 0;
+  start = clock_time();
+  for(r = 0; r < ROUNDS; r++) {
+    llsec_session_init();
+    for(i = 0; i < FRAMES; i++) {
+      verified += receive(&frames[i]);
+    }
+  }
+  time = clock_time() - start;
+  stats = llsec_session_stats();
+  printf("%lu of %lu frames from %d neighbors verified in %lu ms: "
+         "%lu frames/s\n", verified, (unsigned long)FRAMES * ROUNDS,
+         NEIGHBORS, (unsigned long)time,
+         time ? verified * 1000 / time : 0);
+  printf("%lu lookups, %lu.%02lu sessions compared per lookup\n",
+         (unsigned long)stats->lookups,
+         (unsigned long)(stats->probes / stats->lookups),
+         (unsigned long)(stats->probes * 100 / stats->lookups % 100));
+
+  /* The cost of switching between two keys, kept or expanded again */
+  memset(key, 0, sizeof(key));
+  key[1][0] = 1;
+  start = clock_time();
+  for(n = 0; n < SET_KEYS; n++) {
+    AES_128.set_key(key[n & 1]);
+  }
+  time = clock_time() - start;
+  printf("set_key of a kept schedule:   %lu ns\n",
+         (unsigned long)(time * 1000000ULL / SET_KEYS));
+  start = clock_time();
+  for(n = 0; n < SET_KEYS; n++) {
+    key[0][1] = n;
+    AES_128.set_key(key[0]);
+  }
+  time = clock_time() - start;
+  printf("set_key of a new key:         %lu ns\n",
+         (unsigned long)(time * 1000000ULL / SET_KEYS));
+
+  NETSTACK_LLSEC.init();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(llsec_verify_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  create_frames();
+
+  UNIT_TEST_RUN(table);
+  UNIT_TEST_RUN(verify);
+  UNIT_TEST_RUN(keys);
+
+  printf("\n");
+  benchmark();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks of the memb free list, statistics and registry, and a
+ *         benchmark of allocation and deallocation with pools of
+ *         different sizes. Build with FREELIST=0 for the cost without
+ *         the free list.
+ */
+
+#include "contiki.h"
+#include "lib/memb.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+
+#define MAX_BLOCKS  256
+#define OPERATIONS  1000000UL
+
+struct block {
+  uint32_t data[4];
+};
+
+MEMB(small, char, 4);
+MEMB(blocks, struct block, MAX_BLOCKS);
+
+static void *allocated[MAX_BLOCKS];
+
+PROCESS(memb_alloc_process, "Memory block benchmark");
+AUTOSTART_PROCESSES(&memb_alloc_process);
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(alloc, "Every block is handed out once");
+UNIT_TEST_REGISTER(double_free, "A block can only be freed once");
+UNIT_TEST_REGISTER(stats, "Usage statistics are kept");
+UNIT_TEST_REGISTER(registry, "Memory blocks are registered");
+
+UNIT_TEST(alloc)
+{
+  void *p;
+  int i, j;
+
+  UNIT_TEST_BEGIN();
+
+  memb_init(&blocks);
+  for(i = 0; i < MAX_BLOCKS; i++) {
+    allocated[i] = memb_alloc(&blocks);
+    UNIT_TEST_ASSERT(allocated[i] != NULL);
+    UNIT_TEST_ASSERT(memb_inmemb(&blocks, allocated[i]));
+    for(j = 0; j < i; j++) {
+      UNIT_TEST_ASSERT(allocated[j] != allocated[i]);
+    }
+  }
+  UNIT_TEST_ASSERT(memb_alloc(&blocks) == NULL);
+  UNIT_TEST_ASSERT(memb_numfree(&blocks) == 0);
+
+  /* Freed blocks are handed out again. */
+  UNIT_TEST_ASSERT(memb_free(&blocks, allocated[7]) == 0);
+  UNIT_TEST_ASSERT(memb_free(&blocks, allocated[3]) == 0);
+  UNIT_TEST_ASSERT(memb_numfree(&blocks) == 2);
+  p = memb_alloc(&blocks);
+  UNIT_TEST_ASSERT(p == allocated[3] || p == allocated[7]);
+  p = memb_alloc(&blocks);
+  UNIT_TEST_ASSERT(p == allocated[3] || p == allocated[7]);
+  UNIT_TEST_ASSERT(memb_alloc(&blocks) == NULL);
+
+  /* Blocks too small to hold a pointer are also handed out once. */
+  memb_init(&small);
+  for(i = 0; i < 4; i++) {
+    allocated[i] = memb_alloc(&small);
+    UNIT_TEST_ASSERT(allocated[i] != NULL);
+  }
+  UNIT_TEST_ASSERT(memb_alloc(&small) == NULL);
+  UNIT_TEST_ASSERT(memb_free(&small, allocated[2]) == 0);
+  UNIT_TEST_ASSERT(memb_alloc(&small) == allocated[2]);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(double_free)
+{
+  void *p;
+
+  UNIT_TEST_BEGIN();
+
+  memb_init(&blocks);
+  p = memb_alloc(&blocks);
+  UNIT_TEST_ASSERT(memb_free(&blocks, p) == 0);
+  UNIT_TEST_ASSERT(memb_free(&blocks, p) == 0);
+  UNIT_TEST_ASSERT(memb_numfree(&blocks) == MAX_BLOCKS);
+
+  /* Pointers that are not to a block are refused. */
+  p = memb_alloc(&blocks);
+  UNIT_TEST_ASSERT(memb_free(&blocks, (char *)p + 1) == -1);
+  UNIT_TEST_ASSERT(memb_free(&blocks, allocated) == -1);
+
+  /* The block that was freed twice is only handed out once. */
+  UNIT_TEST_ASSERT(memb_alloc(&blocks) != p);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(stats)
+{
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  memb_init(&blocks);
+  UNIT_TEST_ASSERT(blocks.used == 0 && blocks.max_used == 0);
+  for(i = 0; i < 10; i++) {
+    allocated[i] = memb_alloc(&blocks);
+  }
+  for(i = 0; i < 5; i++) {
+    memb_free(&blocks, allocated[i]);
+  }
+  UNIT_TEST_ASSERT(blocks.used == 5);
+  UNIT_TEST_ASSERT(blocks.max_used == 10);
+  UNIT_TEST_ASSERT(blocks.failures == 0);
+
+  for(i = 5; i < MAX_BLOCKS + 3; i++) {
+    memb_alloc(&blocks);
+  }
+  UNIT_TEST_ASSERT(blocks.max_used == MAX_BLOCKS);
+  UNIT_TEST_ASSERT(blocks.failures == 3);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(registry)
+{
+  struct memb *m;
+  int found, count;
+
+  UNIT_TEST_BEGIN();
+
+  /* Both memory blocks were initialized, and only appear once. */
+  found = count = 0;
+  for(m = memb_pools(); m != NULL; m = m->next) {
+    if(m == &blocks || m == &small) {
+      found++;
+    }
+    count++;
+  }
+  UNIT_TEST_ASSERT(found == 2);
+
+  printf("%d registered memory blocks:\n", count);
+  for(m = memb_pools(); m != NULL; m = m->next) {
+    printf("  %-20s %3u of %3u used, at most %3u, %lu failures\n",
+           m->name, m->used, m->num, m->max_used, m->failures);
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+/* Keep all but one block of a pool of n blocks allocated, and free and
+   allocate blocks in turn, so that the free block moves around. */
+static void
+benchmark(int n)
+{
+  clock_time_t start, time;
+  unsigned long r;
+  int i;
+
+  blocks.num = n;
+  memb_init(&blocks);
+  for(i = 0; i < n; i++) {
+    allocated[i] = memb_alloc(&blocks);
+  }
+
+  start = clock_time();
+  for(r = 0; r < OPERATIONS; r++) {
+    i = (r * 7) % n;
+    memb_free(&blocks, allocated[i]);
+    allocated[i] = memb_alloc(&blocks);
+  }
+  time = clock_time() - start;
+
+  printf("%3d blocks: %lu free/alloc pairs in %lu ticks\n",
+         n, OPERATIONS, (unsigned long)time);
+
+  blocks.num = MAX_BLOCKS;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(memb_alloc_process, ev, data)
+{
+  int n;
+
+  PROCESS_BEGIN();
+
+  UNIT_TEST_RUN(alloc);
+  UNIT_TEST_RUN(double_free);
+  UNIT_TEST_RUN(stats);
+  UNIT_TEST_RUN(registry);
+
+  printf("\n");
+  for(n = 8; n <= MAX_BLOCKS; n *= 4) {
+    benchmark(n);
+  }
+  benchmark(MAX_BLOCKS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks of the managed memory allocator with random traces of
+ *         allocations and frees, and a benchmark of the time, the
+ *         number of bytes moved and the fragmentation. Build with
+ *         STEP=0 for compaction at every free.
+ */
+
+#include "contiki.h"
+#include "lib/mmem.h"
+#include "lib/random.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+
+#define BLOCKS      128
+#define OPERATIONS  1000000UL
+
+struct block {
+  struct mmem mmem;
+  unsigned char tag;
+  char allocated;
+};
+
+static struct block blocks[BLOCKS];
+static unsigned long allocations, failed_allocations;
+static unsigned long fragmentation_sum, fragmentation_samples;
+
+PROCESS(mmem_compact_process, "Managed memory benchmark");
+AUTOSTART_PROCESSES(&mmem_compact_process);
+/*---------------------------------------------------------------------------*/
+/* Mostly small blocks, with an occasional large one. */
+static unsigned int
+random_size(void)
+{
+  if((random_rand() & 7) == 0) {
+    return 64 + random_rand() % 256;
+  }
+  return 4 + random_rand() % 60;
+}
+/*---------------------------------------------------------------------------*/
+static void
+fill(struct block *b)
+{
+  unsigned char *p;
+  unsigned int i;
+
+  p = (unsigned char *)MMEM_PTR(&b->mmem);
+  for(i = 0; i < b->mmem.size; i++) {
+    p[i] = b->tag + i;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+intact(void)
+{
+  unsigned char *p;
+  unsigned int i;
+  int j;
+
+  for(j = 0; j < BLOCKS; j++) {
+    if(blocks[j].allocated) {
+      p = (unsigned char *)MMEM_PTR(&blocks[j].mmem);
+      for(i = 0; i < blocks[j].mmem.size; i++) {
+        if(p[i] != (unsigned char)(blocks[j].tag + i)) {
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Free or allocate a random block. */
+static void
+step(unsigned long n)
+{
+  struct mmem_stats stats;
+  struct block *b;
+
+  b = &blocks[random_rand() % BLOCKS];
+  if(b->allocated) {
+    mmem_free(&b->mmem);
+    b->allocated = 0;
+  } else {
+    allocations++;
+    if(mmem_alloc(&b->mmem, random_size())) {
+      b->allocated = 1;
+      b->tag = n;
+      fill(b);
+    } else {
+      failed_allocations++;
+    }
+  }
+
+  if((n & 63) == 0) {
+    mmem_stats(&stats);
+    fragmentation_sum += 100UL * stats.hole_memory /
+      (stats.hole_memory + stats.free_memory);
+    fragmentation_samples++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+free_all(void)
+{
+  int j;
+
+  for(j = 0; j < BLOCKS; j++) {
+    if(blocks[j].allocated) {
+      mmem_free(&blocks[j].mmem);
+      blocks[j].allocated = 0;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(trace, "Blocks keep their contents through a trace");
+UNIT_TEST_REGISTER(compact, "Compaction removes all holes");
+
+UNIT_TEST(trace)
+{
+  unsigned long n;
+  int ok;
+
+  UNIT_TEST_BEGIN();
+
+  random_init(1);
+  ok = 1;
+  for(n = 0; n < 20000 && ok; n++) {
+    step(n);
+    ok = intact();
+  }
+  UNIT_TEST_ASSERT(ok);
+
+  free_all();
+  mmem_compact(16384);
+  UNIT_TEST_ASSERT(mmem_alloc(&blocks[0].mmem, 16384));
+  mmem_free(&blocks[0].mmem);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(compact)
+{
+  struct mmem_stats stats;
+  unsigned int used;
+  unsigned long n;
+  int j;
+
+  UNIT_TEST_BEGIN();
+
+  random_init(2);
+  for(n = 0; n < 5000; n++) {
+    step(n);
+  }
+  while(mmem_compact(64));
+  mmem_stats(&stats);
+  UNIT_TEST_ASSERT(stats.holes == 0 && stats.hole_memory == 0);
+  UNIT_TEST_ASSERT(intact());
+
+  used = 0;
+  for(j = 0; j < BLOCKS; j++) {
+    if(blocks[j].allocated) {
+      used += blocks[j].mmem.size;
+    }
+  }
+  UNIT_TEST_ASSERT(used + stats.free_memory == 16384);
+
+  free_all();
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(void)
+{
+  struct mmem_stats stats;
+  clock_time_t start, time;
+  unsigned long n;
+
+  random_init(3);
+  mmem_stats_reset();
+  allocations = failed_allocations = 0;
+  fragmentation_sum = fragmentation_samples = 0;
+
+  start = clock_time();
+  for(n = 0; n < OPERATIONS; n++) {
+    step(n);
+  }
+  time = clock_time() - start;
+
+  mmem_stats(&stats);
+  printf("%lu operations in %lu ticks\n", OPERATIONS, (unsigned long)time);
+  printf("  %lu bytes moved, at most %u by one call\n",
+         stats.moved, stats.max_moved);
+  printf("  %lu%% of the free memory in holes on average, %u holes now\n",
+         fragmentation_sum / fragmentation_samples, stats.holes);
+  printf("  %lu of %lu allocations failed\n",
+         failed_allocations, allocations);
+
+  free_all();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(mmem_compact_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  mmem_init();
+
+  UNIT_TEST_RUN(trace);
+  UNIT_TEST_RUN(compact);
+
+  printf("\n");
+  benchmark();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
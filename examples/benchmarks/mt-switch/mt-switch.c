@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks of the thread stack pool and stack usage measurement,
+ *         and a benchmark of the cost of switching between threads.
+ */
+
+#include "contiki.h"
+#include "sys/mt.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+
+#define MAX_THREADS  64
+#define SWITCHES     1000000UL
+#define DEPTH        1024
+
+static struct mt_thread threads[MAX_THREADS];
+static unsigned long switches;
+static volatile char stack_sink;
+
+PROCESS(mt_switch_process, "Thread switch benchmark");
+AUTOSTART_PROCESSES(&mt_switch_process);
+/*---------------------------------------------------------------------------*/
+/* Use the top depth bytes of a buffer on the stack, and return the
+   last one. Not inlined, so that the yield in the caller uses less
+   stack than this. */
+static char __attribute__((noinline))
+use_stack(int depth)
+{
+  volatile char buf[DEPTH];
+  int i;
+
+  /* The stack grows down, so only the top of the buffer is used. */
+  for(i = DEPTH - depth; i < DEPTH; i++) {
+    buf[i] = i;
+  }
+  return buf[DEPTH - 1];
+}
+/*---------------------------------------------------------------------------*/
+static void
+deep_thread(void *data)
+{
+  stack_sink = use_stack((int)(uintptr_t)data);
+  mt_yield();
+  mt_exit();
+}
+/*---------------------------------------------------------------------------*/
+static void
+yield_thread(void *data)
+{
+  while(1) {
+    switches++;
+    mt_yield();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_to_end(struct mt_thread *t)
+{
+  while(t->state != MT_STATE_EXITED) {
+    mt_exec(t);
+  }
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(usage, "Stack usage is measured");
+UNIT_TEST_REGISTER(pool, "Stacks come from the pool, then from the heap");
+
+UNIT_TEST(usage)
+{
+  int small, large;
+
+  UNIT_TEST_BEGIN();
+
+  mt_start(&threads[0], deep_thread, (void *)16);
+  mt_start(&threads[1], deep_thread, (void *)DEPTH);
+  UNIT_TEST_ASSERT(mt_stack_usage(&threads[0]) < 128);
+
+  run_to_end(&threads[0]);
+  run_to_end(&threads[1]);
+  small = mt_stack_usage(&threads[0]);
+  large = mt_stack_usage(&threads[1]);
+  UNIT_TEST_ASSERT(small > 16 && small < DEPTH / 4);
+  UNIT_TEST_ASSERT(large >= DEPTH && large < 2 * DEPTH);
+  UNIT_TEST_ASSERT(!mt_stack_overflowed(&threads[1]));
+
+  mt_stop(&threads[0]);
+  mt_stop(&threads[1]);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(pool)
+{
+  unsigned long pooled;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  pooled = mtarch_stack_memory();
+  for(i = 0; i < MAX_THREADS; i++) {
+    mt_start(&threads[i], yield_thread, NULL);
+  }
+  UNIT_TEST_ASSERT(mtarch_stack_memory() > pooled);
+  for(i = 0; i < MAX_THREADS; i++) {
+    mt_stop(&threads[i]);
+  }
+  UNIT_TEST_ASSERT(mtarch_stack_memory() == pooled);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(int n)
+{
+  clock_time_t start, time;
+  unsigned long rounds, r;
+  int i, usage;
+
+  for(i = 0; i < n; i++) {
+    mt_start(&threads[i], yield_thread, NULL);
+  }
+
+  switches = 0;
+  rounds = SWITCHES / n;
+  start = clock_time();
+  for(r = 0; r < rounds; r++) {
+    for(i = 0; i < n; i++) {
+      mt_exec(&threads[i]);
+    }
+  }
+  time = clock_time() - start;
+
+  usage = 0;
+  for(i = 0; i < n; i++) {
+    if(mt_stack_usage(&threads[i]) > usage) {
+      usage = mt_stack_usage(&threads[i]);
+    }
+  }
+
+  printf("%2d threads: %lu exec/yield pairs in %lu ticks, "
+         "stack memory %lu bytes, largest stack usage %d bytes\n",
+         n, switches, (unsigned long)time, mtarch_stack_memory(), usage);
+
+  for(i = 0; i < n; i++) {
+    mt_stop(&threads[i]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(mt_switch_process, ev, data)
+{
+  int n;
+
+  PROCESS_BEGIN();
+
+  mt_init();
+
+  UNIT_TEST_RUN(usage);
+  UNIT_TEST_RUN(pool);
+
+  printf("\n");
+  for(n = 1; n <= MAX_THREADS; n *= 4) {
+    benchmark(n);
+  }
+
+  mt_remove();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,517 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks the cells of the traffic-adaptive Orchestra rule as the
+ *         traffic to the parent and from a child varies, and simulates a
+ *         small RPL tree with and without the rule, for end-to-end latency
+ *         and radio duty cycle.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/packetbuf.h"
+#include "net/mac/mac.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "orchestra.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SLOTFRAME  1
+/* The slotframe of the unicast rule, in the model */
+#define UNICAST_SLOTFRAME 2
+
+/* The simulated tree: node 0 is the root, 1 and 2 relays, the others leaves */
+#define NODES      9
+static const uint8_t parent_of[NODES] = { 0, 0, 0, 1, 1, 1, 2, 2, 2 };
+#define FIRST_LEAF 3
+
+#define SLOTS      100000UL
+#define SLOT_LEN   10 /* ms */
+#define QUEUE_LEN  8
+#define FRAME_LEN  80
+/* Radio on time, in us: transmitting and waiting for the ACK, listening
+ * for nothing, and receiving and ACKing */
+#define ACK_DURATION   (32 * (17 + 3))
+#define FRAME_DURATION (32 * (FRAME_LEN + 3))
+#define TX_ON          (FRAME_DURATION + 400 + ACK_DURATION)
+#define RX_IDLE        2200
+#define RX_ON          (RX_IDLE / 2 + FRAME_DURATION + ACK_DURATION)
+
+/* The rest of TSCH */
+struct asn_t current_asn;
+struct tsch_link *current_link;
+const linkaddr_t tsch_broadcast_address = { { 0xff, 0xff } };
+const linkaddr_t tsch_eb_address = { { 0xfe, 0xfe } };
+int tsch_is_coordinator;
+int
+tsch_is_locked(void)
+{
+  return 0;
+}
+int
+tsch_get_lock(void)
+{
+  return 1;
+}
+void
+tsch_release_lock(void)
+{
+}
+
+PROCESS(orchestra_adaptive_process, "Orchestra traffic-adaptive rule benchmark");
+AUTOSTART_PROCESSES(&orchestra_adaptive_process);
+
+static const linkaddr_t parent_addr = { { 0, 1 } };
+static const linkaddr_t node_addr = { { 0, 2 } };
+static const linkaddr_t child_addr = { { 0, 3 } };
+/*---------------------------------------------------------------------------*/
+/* A data frame, as built by framer-802154, carrying a 6LoWPAN packet */
+static void
+create_frame(const linkaddr_t *receiver, const linkaddr_t *sender, int pending)
+{
+  uint8_t *hdr;
+
+  packetbuf_clear();
+  packetbuf_copyfrom("\x60" "data", 5);
+  packetbuf_hdralloc(3);
+  hdr = packetbuf_hdrptr();
+  hdr[0] = FRAME802154_DATAFRAME;
+  hdr[1] = 0;
+  hdr[2] = 0;
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, receiver);
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, sender);
+  packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_DATAFRAME);
+  packetbuf_set_attr(PACKETBUF_ATTR_PENDING, pending);
+}
+/*---------------------------------------------------------------------------*/
+/* Number of extra cells of a sender with the given link option */
+static int
+cells(const linkaddr_t *sender, uint8_t link_option)
+{
+  struct tsch_slotframe *sf = tsch_schedule_get_slotframe_by_handle(SLOTFRAME);
+  struct tsch_link *l;
+  int k;
+
+  for(k = 0; k < ORCHESTRA_ADAPTIVE_MAX_CELLS; k++) {
+    l = tsch_schedule_get_link_by_timeslot(sf, orchestra_adaptive_timeslot(sender, k));
+    if(l == NULL || !(l->link_options & link_option)) {
+      break;
+    }
+  }
+  return k;
+}
+/*---------------------------------------------------------------------------*/
+/* Send a frame to the parent, delivered, with that many frames queued
+ * behind it. Returns its frame pending bit. */
+static int
+send_to_parent(int queued, int slots)
+{
+  uint8_t fcf;
+
+  tsch_queue_reset();
+  while(tsch_queue_packet_count(&parent_addr) < queued) {
+    create_frame(&parent_addr, &node_addr, 0);
+    tsch_queue_add_packet(&parent_addr, NULL, NULL);
+  }
+  ASN_INC(current_asn, slots);
+  create_frame(&parent_addr, &node_addr, 0);
+  unicast_traffic_adaptive.select_packet(NULL, NULL);
+  fcf = ((uint8_t *)packetbuf_hdrptr())[0];
+  unicast_traffic_adaptive.packet_sent(MAC_TX_OK);
+  return (fcf & 0x10) != 0;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(cells, "Extra cells follow the traffic");
+
+UNIT_TEST(cells)
+{
+  struct tsch_neighbor parent;
+  struct tsch_link other_link;
+  struct orchestra_adaptive_link l;
+  struct tsch_slotframe *sf;
+  int i, ok;
+
+  UNIT_TEST_BEGIN();
+
+  memset(&parent, 0, sizeof(parent));
+  linkaddr_copy(&parent.addr, &parent_addr);
+  unicast_traffic_adaptive.new_time_source(NULL, &parent);
+  sf = tsch_schedule_get_slotframe_by_handle(SLOTFRAME);
+  UNIT_TEST_ASSERT(sf != NULL && cells(&node_addr, LINK_OPTION_TX) == 0);
+
+  /* A queue building up asks for cells, two delivered frames for each */
+  ok = 1;
+  for(i = 0; i < ORCHESTRA_ADAPTIVE_UP * ORCHESTRA_ADAPTIVE_MAX_CELLS; i++) {
+    ok &= send_to_parent(ORCHESTRA_ADAPTIVE_QUEUE_HIGH, 5);
+    ok &= cells(&node_addr, LINK_OPTION_TX) == (i + 1) / ORCHESTRA_ADAPTIVE_UP;
+  }
+  UNIT_TEST_ASSERT(ok);
+  UNIT_TEST_ASSERT(tsch_queue_packet_count(&parent_addr) == ORCHESTRA_ADAPTIVE_QUEUE_HIGH);
+
+  /* The cells are extra links to the parent, and carry any packet to it */
+  other_link = *tsch_schedule_get_link_by_timeslot(sf, orchestra_adaptive_timeslot(&node_addr, 0));
+  UNIT_TEST_ASSERT(linkaddr_cmp(&other_link.addr, &parent_addr));
+  UNIT_TEST_ASSERT(other_link.link_options & LINK_OPTION_EXTRA_TX);
+  tsch_queue_reset();
+  create_frame(&parent_addr, &node_addr, 0);
+  packetbuf_set_attr(PACKETBUF_ATTR_TSCH_SLOTFRAME, SLOTFRAME + 1);
+  packetbuf_set_attr(PACKETBUF_ATTR_TSCH_TIMESLOT, 0);
+  tsch_queue_add_packet(&parent_addr, NULL, NULL);
+  UNIT_TEST_ASSERT(tsch_queue_get_packet_for_nbr(tsch_queue_get_nbr(&parent_addr), &other_link) != NULL);
+  /* Other links to it keep to the link selector */
+  other_link.link_options &= ~LINK_OPTION_EXTRA_TX;
+  UNIT_TEST_ASSERT(tsch_queue_get_packet_for_nbr(tsch_queue_get_nbr(&parent_addr), &other_link) == NULL);
+  other_link.link_options |= LINK_OPTION_EXTRA_TX;
+  linkaddr_copy(&other_link.addr, &tsch_broadcast_address);
+  UNIT_TEST_ASSERT(tsch_queue_get_packet_for_nbr(tsch_queue_get_nbr(&parent_addr), &other_link) == NULL);
+
+  /* and add to the shared cell the packet was selected for */
+  other_link.slotframe_handle = SLOTFRAME + 1;
+  other_link.timeslot = 0;
+  UNIT_TEST_ASSERT(tsch_queue_get_nbr(&parent_addr)->tx_links_count > 0);
+  UNIT_TEST_ASSERT(tsch_queue_get_unicast_packet_for_any(NULL, &other_link) != NULL);
+  /* while any other Tx link to the parent keeps it off the shared cells */
+  tsch_queue_get_nbr(&parent_addr)->tx_links_count++;
+  UNIT_TEST_ASSERT(tsch_queue_get_unicast_packet_for_any(NULL, &other_link) == NULL);
+  tsch_queue_get_nbr(&parent_addr)->tx_links_count--;
+
+  /* A steady rate keeps them, once its average is known: no two frames
+   * in a row ask for the same */
+  for(i = 0; i < 100; i++) {
+    send_to_parent(0, 3);
+  }
+  ok = 1;
+  for(i = 0; i < 100; i++) {
+    send_to_parent(0, 3);
+    ok &= cells(&node_addr, LINK_OPTION_TX) == ORCHESTRA_ADAPTIVE_MAX_CELLS;
+  }
+  UNIT_TEST_ASSERT(ok);
+
+  /* A slower one removes them */
+  for(i = 0; i < 100 && cells(&node_addr, LINK_OPTION_TX) > 0; i++) {
+    send_to_parent(0, 100);
+  }
+  UNIT_TEST_ASSERT(cells(&node_addr, LINK_OPTION_TX) == 0);
+
+  /* Frames from a child asking for a cell add one to listen to, until
+   * the child is silent for too long */
+  for(i = 0; i < ORCHESTRA_ADAPTIVE_UP; i++) {
+    ASN_INC(current_asn, 1);
+    create_frame(&node_addr, &child_addr, 1);
+    unicast_traffic_adaptive.packet_received();
+  }
+  UNIT_TEST_ASSERT(cells(&child_addr, LINK_OPTION_RX) == 1);
+  ASN_INC(current_asn, ORCHESTRA_ADAPTIVE_TIMEOUT + 1);
+  create_frame(&linkaddr_null, &parent_addr, 0);
+  unicast_traffic_adaptive.packet_received();
+  UNIT_TEST_ASSERT(cells(&child_addr, LINK_OPTION_RX) == 0);
+
+  /* Both ends of a link agree on its cells, and a frame the sender
+   * missed the ACK of never makes the receiver listen to fewer cells */
+  memset(&l, 0, sizeof(l));
+  ok = 1;
+  for(i = 0; i < 1000; i++) {
+    struct orchestra_adaptive_link receiver = l;
+    int pending = random_rand() % 3 != 0;
+    orchestra_adaptive_delivered(&l, i, pending, ORCHESTRA_ADAPTIVE_TIMEOUT);
+    orchestra_adaptive_delivered(&receiver, i, pending, ORCHESTRA_ADAPTIVE_TIMEOUT);
+    ok &= receiver.level == l.level;
+    orchestra_adaptive_delivered(&receiver, i, 0, ORCHESTRA_ADAPTIVE_TIMEOUT);
+    ok &= receiver.level >= orchestra_adaptive_tx_cells(&l);
+  }
+  UNIT_TEST_ASSERT(ok);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+struct node {
+  linkaddr_t addr;
+  /* Queue to the parent: ASN the packets were created at, frame pending bits */
+  uint32_t created[QUEUE_LEN];
+  uint8_t pending[QUEUE_LEN];
+  uint8_t head, len;
+  uint8_t transmissions, be, window;
+  /* Traffic-adaptive links to the parent, and from each child */
+  struct orchestra_adaptive_link up;
+  struct orchestra_adaptive_link down[NODES];
+  unsigned long long radio_on;
+};
+static struct node nodes[NODES];
+
+struct stats {
+  unsigned long created, delivered;
+  unsigned long long latency;
+  unsigned long max_latency;
+};
+/*---------------------------------------------------------------------------*/
+static void
+enqueue(int i, uint32_t asn, uint32_t created, int adaptive, struct stats *s)
+{
+  struct node *n = &nodes[i];
+  int pending;
+
+  if(n->len == QUEUE_LEN) {
+    return;
+  }
+  pending = adaptive ? orchestra_adaptive_queued(&n->up, asn, n->len) : 0;
+  n->created[(n->head + n->len) % QUEUE_LEN] = created;
+  n->pending[(n->head + n->len) % QUEUE_LEN] = pending;
+  n->len++;
+}
+/*---------------------------------------------------------------------------*/
+/* The real TSCH queue, set up as the queue of a node to its parent: a
+ * neighbor with a packet selected for the receiver-based unicast cell */
+static const linkaddr_t probe_addr = { { 0xaa, 0xaa } };
+static struct tsch_neighbor *probe;
+
+static void
+probe_init(void)
+{
+  tsch_queue_reset();
+  probe = tsch_queue_add_nbr(&probe_addr);
+  create_frame(&probe_addr, &node_addr, 0);
+  packetbuf_set_attr(PACKETBUF_ATTR_TSCH_SLOTFRAME, UNICAST_SLOTFRAME);
+  packetbuf_set_attr(PACKETBUF_ATTR_TSCH_TIMESLOT, 0);
+  tsch_queue_add_packet(&probe_addr, NULL, NULL);
+}
+/*---------------------------------------------------------------------------*/
+/* Would TSCH send the head packet of the node on one of its extra cells
+ * (extra Tx links to the parent) or on its unicast cell (a shared Tx link to
+ * the broadcast address)? Backoff is left to the model. */
+static int
+tsch_selects(struct node *n, int adaptive, int extra_cell)
+{
+  struct tsch_neighbor *nbr;
+  struct tsch_link link;
+  struct tsch_packet *p;
+
+  /* The rule adds an extra Tx link to the parent for each extra cell */
+  probe->tx_links_count = adaptive ? orchestra_adaptive_tx_cells(&n->up) : 0;
+  probe->extra_tx_links_count = probe->tx_links_count;
+  /* Update the ready list, without decrementing any backoff window */
+  tsch_queue_update_all_backoff_windows(&tsch_eb_address);
+
+  memset(&link, 0, sizeof(link));
+  link.link_options = LINK_OPTION_TX | LINK_OPTION_SHARED | (extra_cell ? LINK_OPTION_EXTRA_TX : 0);
+  link.link_type = LINK_TYPE_NORMAL;
+  link.slotframe_handle = extra_cell ? SLOTFRAME : UNICAST_SLOTFRAME;
+  linkaddr_copy(&link.addr, extra_cell ? &probe_addr : &tsch_broadcast_address);
+
+  /* As get_packet_and_neighbor_for_link() */
+  nbr = tsch_queue_get_nbr(&link.addr);
+  p = tsch_queue_get_packet_for_nbr(nbr, &link);
+  if(p == NULL && nbr == n_broadcast) {
+    p = tsch_queue_get_unicast_packet_for_any(&nbr, &link);
+  }
+  return p != NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* What a node does in a slot, as TSCH with the traffic-adaptive rule (if
+ * enabled), receiver-based unicast and common shared slotframes, by
+ * order of priority. Tx links are all shared, and whether they carry the
+ * head packet is up to the TSCH queue. */
+enum { IDLE, TX, RX };
+static int
+slot_action(int i, uint32_t asn, int adaptive)
+{
+  struct node *n = &nodes[i];
+  int c, k, link_options;
+  uint16_t timeslot;
+
+  if(adaptive) {
+    link_options = 0;
+    timeslot = asn % ORCHESTRA_ADAPTIVE_PERIOD;
+    for(k = 0; i != 0 && k < orchestra_adaptive_tx_cells(&n->up); k++) {
+      if(orchestra_adaptive_timeslot(&n->addr, k) == timeslot) {
+        link_options |= LINK_OPTION_TX;
+      }
+    }
+    for(c = FIRST_LEAF - 2; c < NODES; c++) {
+      for(k = 0; parent_of[c] == i && k < n->down[c].level; k++) {
+        if(orchestra_adaptive_timeslot(&nodes[c].addr, k) == timeslot) {
+          link_options |= LINK_OPTION_RX;
+        }
+      }
+    }
+    if((link_options & LINK_OPTION_TX) && n->len > 0 && tsch_selects(n, adaptive, 1)) {
+      if(n->window == 0) {
+        return TX;
+      }
+      n->window--;
+    }
+    if(link_options & LINK_OPTION_RX) {
+      return RX;
+    }
+  }
+
+  link_options = 0;
+  timeslot = asn % ORCHESTRA_UNICAST_PERIOD;
+  if(i != 0 && ORCHESTRA_LINKADDR_HASH(&nodes[parent_of[i]].addr) % ORCHESTRA_UNICAST_PERIOD == timeslot) {
+    link_options |= LINK_OPTION_TX;
+  }
+  if(ORCHESTRA_LINKADDR_HASH(&n->addr) % ORCHESTRA_UNICAST_PERIOD == timeslot) {
+    link_options |= LINK_OPTION_RX;
+  }
+  if((link_options & LINK_OPTION_TX) && n->len > 0 && tsch_selects(n, adaptive, 0)) {
+    if(n->window == 0) {
+      return TX;
+    }
+    n->window--;
+  }
+  if(link_options & LINK_OPTION_RX) {
+    return RX;
+  }
+
+  return asn % ORCHESTRA_COMMON_SHARED_PERIOD == 0 ? RX : IDLE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+simulate(int per_minute, int adaptive)
+{
+  static uint8_t action[NODES];
+  static uint8_t senders[NODES];
+  struct stats s;
+  unsigned long long radio_on;
+  uint32_t asn;
+  int i, r;
+
+  memset(nodes, 0, sizeof(nodes));
+  memset(&s, 0, sizeof(s));
+  for(i = 0; i < NODES; i++) {
+    nodes[i].addr.u8[LINKADDR_SIZE - 1] = i + 1;
+    nodes[i].up.gap = 0xffff;
+  }
+  random_init(1);
+
+  for(asn = 1; asn <= SLOTS; asn++) {
+    /* Leaves create packets */
+    for(i = FIRST_LEAF; i < NODES; i++) {
+      if(random_rand() % (60000 / SLOT_LEN) < per_minute) {
+        s.created++;
+        enqueue(i, asn, asn, adaptive, &s);
+      }
+    }
+
+    memset(senders, 0, sizeof(senders));
+    for(i = 0; i < NODES; i++) {
+      action[i] = slot_action(i, asn, adaptive);
+      if(action[i] == TX) {
+        senders[parent_of[i]]++;
+      }
+    }
+
+    for(i = 0; i < NODES; i++) {
+      struct node *n = &nodes[i];
+      if(action[i] == RX) {
+        n->radio_on += RX_IDLE;
+      } else if(action[i] == TX) {
+        r = parent_of[i];
+        n->radio_on += TX_ON;
+        if(action[r] == RX && senders[r] == 1) {
+          uint32_t created = n->created[n->head];
+          int pending = n->pending[n->head];
+          n->head = (n->head + 1) % QUEUE_LEN;
+          n->len--;
+          n->transmissions = 0;
+          n->be = TSCH_MAC_MIN_BE;
+          nodes[r].radio_on += RX_ON - RX_IDLE;
+          if(adaptive) {
+            orchestra_adaptive_delivered(&n->up, asn, pending, ORCHESTRA_ADAPTIVE_TIMEOUT * 3 / 4);
+            orchestra_adaptive_delivered(&nodes[r].down[i], asn, pending, ORCHESTRA_ADAPTIVE_TIMEOUT);
+          }
+          if(r == 0) {
+            s.delivered++;
+            s.latency += asn - created;
+            s.max_latency = MAX(s.max_latency, asn - created);
+          } else {
+            enqueue(r, asn, created, adaptive, &s);
+          }
+        } else {
+          /* Collision or nobody listening: back off */
+          if(++n->transmissions > TSCH_MAC_MAX_FRAME_RETRIES) {
+            n->head = (n->head + 1) % QUEUE_LEN;
+            n->len--;
+            n->transmissions = 0;
+            n->be = TSCH_MAC_MIN_BE;
+          } else {
+            n->be = MIN(n->be + 1, TSCH_MAC_MAX_BE);
+            n->window = random_rand() % (1 << n->be);
+          }
+        }
+      }
+    }
+  }
+
+  radio_on = 0;
+  for(i = 0; i < NODES; i++) {
+    radio_on += nodes[i].radio_on;
+  }
+  printf("%3d packets/min per leaf, %s: %5.1f%% delivered, latency %5lu ms (max %5lu), "
+         "duty cycle %.2f%% (relays %.2f%%)\n",
+         per_minute, adaptive ? "adaptive" : "static  ",
+         s.created ? 100.0 * s.delivered / s.created : 0.0,
+         s.delivered ? (unsigned long)(s.latency * SLOT_LEN / s.delivered) : 0,
+         s.max_latency * SLOT_LEN,
+         100.0 * radio_on / NODES / (SLOTS * SLOT_LEN * 1000),
+         100.0 * (nodes[1].radio_on + nodes[2].radio_on) / 2 / (SLOTS * SLOT_LEN * 1000));
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(orchestra_adaptive_process, ev, data)
+{
+  static const int per_minute[] = { 6, 30, 60, 120 };
+  int i;
+
+  PROCESS_BEGIN();
+
+  tsch_schedule_init();
+  tsch_queue_init();
+  linkaddr_set_node_addr((linkaddr_t *)&node_addr);
+  unicast_traffic_adaptive.init(SLOTFRAME);
+
+  UNIT_TEST_RUN(cells);
+  probe_init();
+
+  printf("\n");
+  for(i = 0; i < sizeof(per_minute) / sizeof(per_minute[0]); i++) {
+    simulate(per_minute[i], 0);
+    simulate(per_minute[i], 1);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+
+/**
+ * \file
+ *         Checks the drift estimation of the phase table, and replays
+ *         sparse transmissions to neighbors whose clocks drift, with the
+ *         plain phase prediction and with the drift-compensated one, for
+ *         the strobes sent and the wake-ups missed.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/mac/mac.h"
+#include "net/mac/phase.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+PROCESS(phase_drift_process, "Phase drift benchmark");
+AUTOSTART_PROCESSES(&phase_drift_process);
+
+/* The replay runs in microseconds; the phase table sees rtimer ticks,
+ * and on native the clock ticks too */
+#define SECOND            1000000ULL
+#define TICK              (SECOND / RTIMER_ARCH_SECOND)
+
+/* ContikiMAC at 8 Hz with its default constants, and 80-byte frames at
+ * 250 kbit/s sent every 4 ms with the wait for their ACK */
+#define CYCLE_TIME        (RTIMER_ARCH_SECOND / 8)
+#define GUARD_TIME        (RTIMER_ARCH_SECOND / 100)
+#define MAX_PHASE_STROBE  (RTIMER_ARCH_SECOND / 60)
+#define STROBE_PERIOD     (4 * SECOND / 1000)
+
+#define HOURS             24
+#define NEIGHBORS         6
+/* Drift of the clocks of the neighbors relative to ours */
+static const int drift_ppm[NEIGHBORS] = { -60, -35, -10, 15, 40, 60 };
+
+enum { PLAIN, DRIFT };
+static const char *variant_name[] = { "plain", "drift" };
+/*---------------------------------------------------------------------------*/
+/* The first wake-up at or after t of a neighbor that checks the channel
+ * from offset on, every cycle of its own clock */
+static uint64_t
+next_wakeup(uint64_t offset, int ppm, uint64_t t)
+{
+  double period;
+  uint64_t k;
+
+  period = (double)CYCLE_TIME * TICK * (1.0 + ppm / 1e6);
+  if(t <= offset) {
+    return offset;
+  }
+  k = (uint64_t)((t - offset) / period);
+  while(offset + (uint64_t)(k * period) < t) {
+    k++;
+  }
+  return offset + (uint64_t)(k * period);
+}
+/*---------------------------------------------------------------------------*/
+/* Encounters of the test neighbor with an exact drift, observed as
+ * ContikiMAC does: predicted, then updated with the strobe that got
+ * through, every span ticks */
+static void
+encounters(const linkaddr_t *neighbor, int ppm, uint32_t *now,
+           int count, uint32_t span)
+{
+  rtimer_clock_t wait, margin;
+  uint64_t t;
+
+  while(count-- > 0) {
+    *now += span;
+    phase_predict(neighbor, CYCLE_TIME, *now, *now, &wait, &margin);
+    t = next_wakeup(0, ppm, (uint64_t)*now * TICK);
+    phase_observe(neighbor, t / TICK, t / TICK, MAC_TX_OK);
+  }
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(unknown, "Unknown phases are not predicted");
+
+UNIT_TEST(unknown)
+{
+  static const linkaddr_t neighbor = { { 0, 1 } };
+  rtimer_clock_t wait, margin;
+
+  UNIT_TEST_BEGIN();
+
+  UNIT_TEST_ASSERT(!phase_predict(&neighbor, CYCLE_TIME, 0, 0, &wait, &margin));
+
+  /* Right after an encounter, the next wake-up is a cycle later */
+  phase_observe(&neighbor, 1000, 1000, MAC_TX_OK);
+  UNIT_TEST_ASSERT(phase_predict(&neighbor, CYCLE_TIME, 1010, 1010, &wait, &margin));
+  UNIT_TEST_ASSERT(wait == CYCLE_TIME - 10);
+  UNIT_TEST_ASSERT(margin == 0);
+
+  /* Without a measured drift, the margin grows until the phase is lost */
+  UNIT_TEST_ASSERT(phase_predict(&neighbor, CYCLE_TIME, 1000 + 60000UL, 1000 + 60000UL,
+                                 &wait, &margin));
+  UNIT_TEST_ASSERT(margin > 0 && margin < CYCLE_TIME / 2);
+  UNIT_TEST_ASSERT(!phase_predict(&neighbor, CYCLE_TIME, (rtimer_clock_t)(1000 + 3600000UL),
+                                  1000 + 3600000UL, &wait, &margin));
+
+  phase_remove(&neighbor);
+  UNIT_TEST_ASSERT(!phase_predict(&neighbor, CYCLE_TIME, 1010, 1010, &wait, &margin));
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(converge, "The drift of a neighbor is learned");
+
+UNIT_TEST(converge)
+{
+  static const linkaddr_t neighbor = { { 0, 2 } };
+  rtimer_clock_t wait, margin;
+  uint64_t t;
+  uint32_t now;
+  int error;
+
+  UNIT_TEST_BEGIN();
+
+  /* A neighbor running 50 ppm slow, met every two minutes for an hour:
+   * rtimer_clock_t wraps around in between */
+  now = 0;
+  phase_observe(&neighbor, 0, 0, MAC_TX_OK);
+  encounters(&neighbor, 50, &now, 30, 120 * RTIMER_ARCH_SECOND);
+
+  /* Its wake-up after another twenty minutes, when it has moved by 60 ms,
+   * is predicted to within the margin and the ticks that the encounters
+   * were rounded to, and the margin is well below the 60 ms that the
+   * plain prediction would be off */
+  now += 20 * 60 * RTIMER_ARCH_SECOND;
+  UNIT_TEST_ASSERT(phase_predict(&neighbor, CYCLE_TIME, now, now, &wait, &margin));
+  t = next_wakeup(0, 50, (uint64_t)now * TICK);
+  error = (int)(now + wait) - (int)(t / TICK);
+  UNIT_TEST_ASSERT(error <= (int)margin + 2 && -error <= (int)margin + 2);
+  UNIT_TEST_ASSERT(margin < 60 * RTIMER_ARCH_SECOND / 1000 / 2);
+
+  /* A neighbor that reboots is not a drift: it is measured again */
+  phase_observe(&neighbor, now + CYCLE_TIME / 2, now + CYCLE_TIME / 2, MAC_TX_OK);
+  now += CYCLE_TIME / 2;
+  encounters(&neighbor, 50, &now, 1, 120 * RTIMER_ARCH_SECOND);
+  now += 20 * 60 * RTIMER_ARCH_SECOND;
+  UNIT_TEST_ASSERT(!phase_predict(&neighbor, CYCLE_TIME, now, now, &wait, &margin) ||
+                   margin >= 60 * RTIMER_ARCH_SECOND / 1000 / 2);
+
+  phase_remove(&neighbor);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+struct replay_stats {
+  unsigned long transmissions, strobes, misses, full;
+};
+
+/* The phases of the plain prediction, in ticks that do not wrap around */
+static uint32_t plain_phase[NEIGHBORS];
+static uint8_t plain_known[NEIGHBORS];
+
+/* The next wake-up as phase_wait() predicted it before drift correction */
+static int
+plain_predict(int i, uint32_t now, rtimer_clock_t *wait)
+{
+  uint32_t since;
+
+  if(!plain_known[i]) {
+    return 0;
+  }
+  since = (now - plain_phase[i]) % CYCLE_TIME;
+  *wait = since == 0 ? 0 : CYCLE_TIME - since;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Strobes from start until the wake-up of the neighbor, as long as
+ * window allows. Returns the time of the strobe that got through, or 0
+ * on a miss. */
+static uint64_t
+strobe(struct replay_stats *s, int i, uint64_t offset,
+       uint64_t start, uint64_t window)
+{
+  uint64_t wakeup, k;
+
+  /* The neighbor hears the strobe in the air when it wakes up, and
+   * receives the next one */
+  wakeup = next_wakeup(offset, drift_ppm[i], start);
+  k = (wakeup - start + STROBE_PERIOD - 1) / STROBE_PERIOD;
+  if(k * STROBE_PERIOD >= window) {
+    s->strobes += (window + STROBE_PERIOD - 1) / STROBE_PERIOD;
+    return 0;
+  }
+  s->strobes += k + 1;
+  return start + k * STROBE_PERIOD;
+}
+/*---------------------------------------------------------------------------*/
+static void
+replay(int mean_gap, int variant)
+{
+  static linkaddr_t neighbor;
+  struct replay_stats s;
+  struct phase_stats ps;
+  uint64_t offset, now, encounter;
+  uint32_t ticks;
+  rtimer_clock_t wait, margin, guard;
+  int i, known;
+
+  memset(&s, 0, sizeof(s));
+  phase_stats_reset();
+  random_init(1);
+
+  for(i = 0; i < NEIGHBORS; i++) {
+    neighbor.u8[0] = 1;
+    neighbor.u8[1] = i;
+    phase_remove(&neighbor);
+    plain_known[i] = 0;
+    offset = (uint64_t)(random_rand() % CYCLE_TIME) * TICK + random_rand() % TICK;
+
+    for(now = 0; now < HOURS * 3600 * SECOND;) {
+      /* Transmissions half to one and a half mean gaps apart */
+      now += (uint64_t)mean_gap * SECOND / 2 +
+        (((uint32_t)random_rand() << 16 | random_rand()) % ((uint32_t)mean_gap * 1000)) * (SECOND / 1000);
+      ticks = now / TICK;
+      s.transmissions++;
+
+      margin = 0;
+      if(variant == PLAIN) {
+        known = plain_predict(i, ticks, &wait);
+      } else {
+        known = phase_predict(&neighbor, CYCLE_TIME, ticks, ticks, &wait, &margin);
+      }
+
+      encounter = 0;
+      if(known) {
+        /* Start early by the guard time and the margin, and look for
+         * the wake-up that much longer, as contikimac.c */
+        guard = GUARD_TIME + margin;
+        if(wait < guard) {
+          wait += CYCLE_TIME;
+        }
+        now = (uint64_t)(ticks + wait - guard) * TICK;
+        encounter = strobe(&s, i, offset, now,
+                           (uint64_t)(MAX_PHASE_STROBE + 2 * margin) * TICK);
+        if(encounter == 0) {
+          s.misses++;
+          now += (uint64_t)(MAX_PHASE_STROBE + 2 * margin) * TICK;
+          if(variant == DRIFT) {
+            phase_observe(&neighbor, now / TICK, now / TICK, MAC_TX_NOACK);
+          }
+        }
+      }
+      if(encounter == 0) {
+        /* Unknown or missed: the (re)transmission strobes a full cycle */
+        s.full++;
+        encounter = strobe(&s, i, offset, now, (CYCLE_TIME + GUARD_TIME) * TICK);
+      }
+      now = encounter;
+
+      if(variant == PLAIN) {
+        plain_phase[i] = encounter / TICK;
+        plain_known[i] = 1;
+      } else {
+        phase_observe(&neighbor, encounter / TICK, encounter / TICK, MAC_TX_OK);
+      }
+    }
+  }
+
+  printf("gap %4d s, %s: %5.2f strobes/tx, %5.2f%% missed, %5.2f%% full strobes",
+         mean_gap, variant_name[variant],
+         (double)s.strobes / s.transmissions,
+         100.0 * s.misses / s.transmissions,
+         100.0 * s.full / s.transmissions);
+  if(variant == DRIFT) {
+    phase_stats(&ps);
+    printf(", %lu uncertain, correction %4.1f ms, margin %4.1f ms",
+           ps.uncertain,
+           ps.corrected ? 1000.0 * ps.correction / ps.corrected / RTIMER_ARCH_SECOND : 0.0,
+           ps.predictions > ps.uncertain ?
+           1000.0 * ps.margin / (ps.predictions - ps.uncertain) / RTIMER_ARCH_SECOND : 0.0);
+  }
+  printf("\n");
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(phase_drift_process, ev, data)
+{
+  static const int mean_gap[] = { 30, 120, 300, 600, 1200 };
+  int i;
+
+  PROCESS_BEGIN();
+
+  phase_init();
+
+  UNIT_TEST_RUN(unknown);
+  UNIT_TEST_RUN(converge);
+
+  printf("\n");
+  for(i = 0; i < sizeof(mean_gap) / sizeof(mean_gap[0]); i++) {
+    replay(mean_gap[i], PLAIN);
+    replay(mean_gap[i], DRIFT);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
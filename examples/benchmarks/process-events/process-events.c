@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks of the event queues, and a stress test with bursts of
+ *         high priority and normal events.
+ */
+
+#include "contiki.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+
+#define ROUNDS       20000
+#define MAX_BURST    48
+#define HIGH_DATA    0x10000UL
+
+static process_event_t normal_event;
+static process_event_t high_event;
+static uintptr_t received[PROCESS_CONF_NUMEVENTS + PROCESS_CONF_NUMEVENTS_HIGH];
+static unsigned long nreceived;
+static unsigned long high_received;
+
+PROCESS(sink_process, "Event sink");
+PROCESS(process_events_process, "Event queue test");
+AUTOSTART_PROCESSES(&process_events_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(sink_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    if(ev == normal_event || ev == high_event) {
+      if(nreceived < sizeof(received) / sizeof(received[0])) {
+        received[nreceived] = (uintptr_t)data;
+      }
+      nreceived++;
+    }
+    if(ev == high_event) {
+      high_received++;
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+/* Deliver the events that are waiting. The test process itself is
+   running, so it does not receive any events meanwhile. */
+static void
+run(void)
+{
+  int i;
+
+  PROCESS_CONTEXT_BEGIN(&process_events_process);
+  for(i = 0; i < 10000 && process_run() > 0; i++);
+  PROCESS_CONTEXT_END(&process_events_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_once(void)
+{
+  PROCESS_CONTEXT_BEGIN(&process_events_process);
+  process_run();
+  PROCESS_CONTEXT_END(&process_events_process);
+}
+/*---------------------------------------------------------------------------*/
+static int
+post(process_event_t ev, uintptr_t data)
+{
+  if(ev == high_event) {
+    return process_post_high(&sink_process, ev, (process_data_t)data);
+  }
+  return process_post(&sink_process, ev, (process_data_t)data);
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(high_first, "High priority events are delivered first");
+UNIT_TEST_REGISTER(coalesce, "Equal events are merged");
+UNIT_TEST_REGISTER(stress, "Bursts of events");
+
+UNIT_TEST(high_first)
+{
+  UNIT_TEST_BEGIN();
+
+  run();
+  nreceived = 0;
+  UNIT_TEST_ASSERT(post(normal_event, 1) == PROCESS_ERR_OK);
+  UNIT_TEST_ASSERT(post(normal_event, 2) == PROCESS_ERR_OK);
+  UNIT_TEST_ASSERT(post(high_event, HIGH_DATA + 1) == PROCESS_ERR_OK);
+  UNIT_TEST_ASSERT(post(high_event, HIGH_DATA + 2) == PROCESS_ERR_OK);
+  run();
+
+  UNIT_TEST_ASSERT(nreceived == 4);
+  UNIT_TEST_ASSERT(received[0] == HIGH_DATA + 1);
+  UNIT_TEST_ASSERT(received[1] == HIGH_DATA + 2);
+  UNIT_TEST_ASSERT(received[2] == 1);
+  UNIT_TEST_ASSERT(received[3] == 2);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(coalesce)
+{
+  unsigned long dropped, coalesced;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  run();
+  nreceived = 0;
+  dropped = process_dropped_events;
+  coalesced = process_coalesced_events;
+
+  for(i = 0; i < PROCESS_CONF_NUMEVENTS; i++) {
+    UNIT_TEST_ASSERT(post(normal_event, i) == PROCESS_ERR_OK);
+  }
+  UNIT_TEST_ASSERT(process_maxevents == PROCESS_CONF_NUMEVENTS);
+
+  /* The queue is full: an equal event is merged, others are dropped,
+     and the poster is told that the queue is full either way. */
+  UNIT_TEST_ASSERT(post(normal_event, 5) == PROCESS_ERR_FULL);
+  UNIT_TEST_ASSERT(post(normal_event, 1000) == PROCESS_ERR_FULL);
+  UNIT_TEST_ASSERT(process_coalesced_events == coalesced + 1);
+  UNIT_TEST_ASSERT(process_dropped_events == dropped + 1);
+
+  /* The high priority queue is separate, and equal high priority
+     events are merged even when it is not full. */
+  UNIT_TEST_ASSERT(post(high_event, HIGH_DATA + 10) == PROCESS_ERR_OK);
+  UNIT_TEST_ASSERT(post(high_event, HIGH_DATA + 10) == PROCESS_ERR_OK);
+  UNIT_TEST_ASSERT(process_coalesced_events == coalesced + 2);
+  for(i = 1; i < PROCESS_CONF_NUMEVENTS_HIGH; i++) {
+    UNIT_TEST_ASSERT(post(high_event, HIGH_DATA + 10 + i) == PROCESS_ERR_OK);
+  }
+  UNIT_TEST_ASSERT(process_maxevents_high == PROCESS_CONF_NUMEVENTS_HIGH);
+
+  /* When it is full, high priority events go to the normal queue. */
+  UNIT_TEST_ASSERT(post(high_event, HIGH_DATA + 5) == PROCESS_ERR_FULL);
+
+  run();
+  UNIT_TEST_ASSERT(nreceived ==
+                   PROCESS_CONF_NUMEVENTS + PROCESS_CONF_NUMEVENTS_HIGH);
+  UNIT_TEST_ASSERT(received[0] == HIGH_DATA + 10);
+  UNIT_TEST_ASSERT(received[PROCESS_CONF_NUMEVENTS_HIGH] == 0);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(stress)
+{
+  static unsigned long state = 1;
+  unsigned long posted, failed, high_posted, high_failed;
+  unsigned long coalesced;
+  uintptr_t high_data;
+  int round, burst, i;
+
+  UNIT_TEST_BEGIN();
+
+  run();
+  nreceived = high_received = 0;
+  posted = failed = high_posted = high_failed = 0;
+  coalesced = process_coalesced_events;
+  high_data = HIGH_DATA;
+
+  for(round = 0; round < ROUNDS; round++) {
+    state = state * 1103515245UL + 12345;
+    burst = (state >> 8) % MAX_BURST;
+
+    /* A burst of events, as from a radio and sensors under load. One
+       in four is a high priority event, and the other events are
+       often equal to each other. */
+    for(i = 0; i < burst; i++) {
+      state = state * 1103515245UL + 12345;
+      if(((state >> 8) & 3) == 0) {
+        high_posted++;
+        if(post(high_event, ++high_data) != PROCESS_ERR_OK) {
+          high_failed++;
+        }
+      } else {
+        posted++;
+        if(post(normal_event, (state >> 12) % 8) != PROCESS_ERR_OK) {
+          failed++;
+        }
+      }
+    }
+
+    /* Deliver some of the events before the next burst. */
+    state = state * 1103515245UL + 12345;
+    for(i = (state >> 8) % MAX_BURST; i > 0; i--) {
+      run_once();
+    }
+  }
+  run();
+
+  printf("%lu normal events: %lu not posted, %lu of them merged; "
+         "%lu high priority events: %lu dropped\n",
+         posted, failed, process_coalesced_events - coalesced,
+         high_posted, high_failed);
+  printf("largest queue lengths: %u normal, %u high priority\n",
+         process_maxevents, process_maxevents_high);
+
+  /* Every event was delivered, or reported to the poster as not
+     posted, as the high priority events are all different. */
+  UNIT_TEST_ASSERT(nreceived + failed + high_failed ==
+                   posted + high_posted);
+  UNIT_TEST_ASSERT(high_received + high_failed == high_posted);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(process_events_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  normal_event = process_alloc_event();
+  high_event = process_alloc_event();
+  process_start(&sink_process, NULL);
+
+  UNIT_TEST_RUN(high_first);
+  UNIT_TEST_RUN(coalesce);
+  UNIT_TEST_RUN(stress);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks of the process profiler, and a measurement of its
+ *         cost per event. Build with PROFILE=0 for the cost without it.
+ */
+
+#include "contiki.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+
+#define EVENTS    200000UL
+#define WORK      2000
+#define SELF_WORK 1000
+
+static process_event_t work_event;
+static process_event_t call_event;
+static process_event_t other_events[PROCESS_CONF_PROFILE_EVENTS + 4];
+static unsigned long received;
+
+PROCESS(busy_process, "Busy");
+PROCESS(caller_process, "Caller");
+PROCESS(sink_process, "Sink");
+PROCESS(process_profile_process, "Profiler test");
+AUTOSTART_PROCESSES(&process_profile_process);
+/*---------------------------------------------------------------------------*/
+/* Use the CPU for a number of profiler time units. */
+static void
+spin(unsigned long units)
+{
+  unsigned long start;
+
+  start = PROCESS_PROFILE_NOW();
+  while(PROCESS_PROFILE_NOW() - start < units);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(busy_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    if(ev == work_event) {
+      spin((uintptr_t)data);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(caller_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    if(ev == call_event) {
+      spin(SELF_WORK / 2);
+      process_post_synch(&busy_process, work_event, data);
+      spin(SELF_WORK / 2);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(sink_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    received++;
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+/* Deliver the events that are waiting. The test process itself is
+   running, so it does not receive any events meanwhile. */
+static void
+run(void)
+{
+  PROCESS_CONTEXT_BEGIN(&process_profile_process);
+  while(process_run() > 0);
+  PROCESS_CONTEXT_END(&process_profile_process);
+}
+/*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_PROFILE
+static const struct process_profile *
+find_event(process_event_t ev)
+{
+  const struct process_profile *profile;
+  process_event_t e;
+  int i;
+
+  for(i = 0; (profile = process_profile_event(i, &e)) != NULL; i++) {
+    if(e == ev) {
+      return profile;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(attribution, "Time is accounted to processes and events");
+UNIT_TEST_REGISTER(nested, "Synchronous calls are accounted to the callee");
+UNIT_TEST_REGISTER(overflow, "Event types beyond the table are counted");
+
+UNIT_TEST(attribution)
+{
+  const struct process_profile *profile;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  process_profile_reset();
+  for(i = 1; i <= 5; i++) {
+    process_post(&busy_process, work_event, (void *)(uintptr_t)(i * WORK));
+  }
+  run();
+
+  UNIT_TEST_ASSERT(busy_process.profile.calls == 5);
+  UNIT_TEST_ASSERT(busy_process.profile.time >= 15 * WORK);
+  /* The longest call is one call: the four others took at least
+     1 + 2 + 3 + 4 times WORK. Only lower bounds are checked, as the
+     test may be preempted. */
+  UNIT_TEST_ASSERT(busy_process.profile.max >= 5 * WORK);
+  UNIT_TEST_ASSERT(busy_process.profile.time - busy_process.profile.max >=
+                   10 * WORK);
+  UNIT_TEST_ASSERT(caller_process.profile.calls == 0);
+
+  profile = find_event(work_event);
+  UNIT_TEST_ASSERT(profile != NULL);
+  UNIT_TEST_ASSERT(profile->calls == 5);
+  UNIT_TEST_ASSERT(profile->time == busy_process.profile.time);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(nested)
+{
+  UNIT_TEST_BEGIN();
+
+  process_profile_reset();
+  process_post(&caller_process, call_event, (void *)(20 * WORK));
+  run();
+
+  UNIT_TEST_ASSERT(caller_process.profile.calls == 1);
+  UNIT_TEST_ASSERT(busy_process.profile.calls == 1);
+  UNIT_TEST_ASSERT(busy_process.profile.time >= 20 * WORK);
+  UNIT_TEST_ASSERT(caller_process.profile.time >= SELF_WORK);
+  /* Had the callee's time been accounted to the caller too, the caller
+     would have taken longer than the callee. The callee's work is 40
+     times the caller's own, so that preemption does not change the
+     order. */
+  UNIT_TEST_ASSERT(caller_process.profile.time <
+                   busy_process.profile.time);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(overflow)
+{
+  const struct process_profile *profile;
+  process_event_t ev;
+  unsigned long calls;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  process_profile_reset();
+  for(i = 0; i < sizeof(other_events) / sizeof(other_events[0]); i++) {
+    process_post(&sink_process, other_events[i], NULL);
+    run();
+  }
+
+  calls = 0;
+  for(i = 0; (profile = process_profile_event(i, &ev)) != NULL; i++) {
+    calls += profile->calls;
+  }
+  UNIT_TEST_ASSERT(i == PROCESS_CONF_PROFILE_EVENTS);
+  UNIT_TEST_ASSERT(calls == sizeof(other_events) / sizeof(other_events[0]));
+
+  /* The last entry holds the events that did not fit. */
+  profile = process_profile_event(i - 1, &ev);
+  UNIT_TEST_ASSERT(ev == PROCESS_EVENT_NONE);
+  UNIT_TEST_ASSERT(profile->calls == 5);
+
+  UNIT_TEST_END();
+}
+#endif /* PROCESS_CONF_PROFILE */
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(process_profile_process, ev, data)
+{
+  static unsigned long i;
+  clock_time_t start, time;
+
+  PROCESS_BEGIN();
+
+  work_event = process_alloc_event();
+  call_event = process_alloc_event();
+  for(i = 0; i < sizeof(other_events) / sizeof(other_events[0]); i++) {
+    other_events[i] = process_alloc_event();
+  }
+  process_start(&busy_process, NULL);
+  process_start(&caller_process, NULL);
+  process_start(&sink_process, NULL);
+  run();
+
+#if PROCESS_CONF_PROFILE
+  UNIT_TEST_RUN(attribution);
+  UNIT_TEST_RUN(nested);
+  UNIT_TEST_RUN(overflow);
+#endif /* PROCESS_CONF_PROFILE */
+
+  received = 0;
+  start = clock_time();
+  for(i = 0; i < EVENTS; i++) {
+    process_post(&sink_process, PROCESS_EVENT_CONTINUE, NULL);
+    run();
+  }
+  time = clock_time() - start;
+  printf("\nprofiling %s: %lu events in %lu ticks\n",
+         PROCESS_CONF_PROFILE ? "enabled" : "disabled",
+         received, (unsigned long)time);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks of poll and broadcast delivery, and a benchmark of
+ *         the process scheduler as the number of processes grows.
+ */
+
+#include "contiki.h"
+#include "unit-test.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define MAX_PROCESSES 64
+#define ITERATIONS    2000000UL
+
+static struct process processes[MAX_PROCESSES];
+static int started;
+static unsigned long polls[MAX_PROCESSES];
+static unsigned long events[MAX_PROCESSES];
+static volatile unsigned char requested[MAX_PROCESSES];
+static volatile unsigned long interrupts;
+static process_event_t subscribed_event;
+static process_event_t unsubscribed_event;
+static struct process_subscription subscriptions[MAX_PROCESSES];
+
+PROCESS(process_sched_process, "Scheduler benchmark");
+AUTOSTART_PROCESSES(&process_sched_process);
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(idle_thread(struct pt *process_pt, process_event_t ev,
+                      process_data_t data))
+{
+  int i;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_YIELD();
+    i = PROCESS_CURRENT() - processes;
+    if(ev == PROCESS_EVENT_POLL) {
+      requested[i] = 0;
+      polls[i]++;
+    } else if(ev == subscribed_event || ev == unsubscribed_event) {
+      events[i]++;
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+start_processes(int count)
+{
+  for(; started < count; started++) {
+    processes[started].name = "idle";
+    processes[started].thread = idle_thread;
+    process_start(&processes[started], NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Run the scheduler until nothing is left to do. The benchmark process
+   itself is running, so it does not receive any events meanwhile. */
+static void
+run(void)
+{
+  int i;
+
+  PROCESS_CONTEXT_BEGIN(&process_sched_process);
+  for(i = 0; i < 10000 && process_run() > 0; i++);
+  PROCESS_CONTEXT_END(&process_sched_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset_counters(void)
+{
+  memset(polls, 0, sizeof(polls));
+  memset(events, 0, sizeof(events));
+}
+/*---------------------------------------------------------------------------*/
+static void
+interrupt(int sig)
+{
+  int i;
+
+  i = interrupts++ % started;
+  requested[i] = 1;
+  process_poll(&processes[i]);
+}
+/*---------------------------------------------------------------------------*/
+static void
+interrupt_timer(long usec)
+{
+  struct itimerval val;
+
+  memset(&val, 0, sizeof(val));
+  val.it_value.tv_usec = usec;
+  val.it_interval.tv_usec = usec;
+  setitimer(ITIMER_PROF, &val, NULL);
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(poll_once, "A process polled twice is polled once");
+UNIT_TEST_REGISTER(poll_interrupts, "Polls from interrupts are not lost");
+UNIT_TEST_REGISTER(subscribers, "Broadcasts go to subscribers");
+
+UNIT_TEST(poll_once)
+{
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  reset_counters();
+  process_poll(&processes[3]);
+  process_poll(&processes[5]);
+  process_poll(&processes[3]);
+  run();
+  for(i = 0; i < started; i++) {
+    UNIT_TEST_ASSERT(polls[i] == (i == 3 || i == 5));
+  }
+
+  /* A process can be polled again once it has been polled. */
+  process_poll(&processes[3]);
+  run();
+  UNIT_TEST_ASSERT(polls[3] == 2);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(poll_interrupts)
+{
+  unsigned long i;
+  int j;
+
+  UNIT_TEST_BEGIN();
+
+  reset_counters();
+  interrupts = 0;
+  signal(SIGPROF, interrupt);
+  interrupt_timer(20);
+
+  /* Poll from the main loop while the interrupts poll as well. */
+  for(i = 0; interrupts < 300; i++) {
+    j = i % started;
+    requested[j] = 1;
+    process_poll(&processes[j]);
+    process_run();
+  }
+
+  interrupt_timer(0);
+  run();
+
+  printf("%lu polls from interrupts\n", interrupts);
+  UNIT_TEST_ASSERT(interrupts > 0);
+  for(j = 0; j < started; j++) {
+    UNIT_TEST_ASSERT(requested[j] == 0);
+  }
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(subscribers)
+{
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  reset_counters();
+  process_subscribe(&subscriptions[1], subscribed_event, &processes[1]);
+  process_subscribe(&subscriptions[2], subscribed_event, &processes[2]);
+  process_post(PROCESS_BROADCAST, subscribed_event, NULL);
+  process_post(PROCESS_BROADCAST, unsubscribed_event, NULL);
+  run();
+  for(i = 0; i < started; i++) {
+    UNIT_TEST_ASSERT(events[i] == ((i == 1 || i == 2) ? 2 : 1));
+  }
+
+  reset_counters();
+  process_unsubscribe(&subscriptions[1]);
+  process_post(PROCESS_BROADCAST, subscribed_event, NULL);
+  run();
+  for(i = 0; i < started; i++) {
+    UNIT_TEST_ASSERT(events[i] == (i == 2));
+  }
+
+  /* The subscriptions of a process end when it exits. */
+  reset_counters();
+  process_exit(&processes[2]);
+  process_post(PROCESS_BROADCAST, subscribed_event, NULL);
+  run();
+  for(i = 0; i < started; i++) {
+    UNIT_TEST_ASSERT(events[i] == (i != 2));
+  }
+  process_start(&processes[2], NULL);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(int count)
+{
+  clock_time_t start, poll_time, broadcast_time, subscribed_time;
+  unsigned long i;
+
+  start_processes(count);
+  process_subscribe(&subscriptions[0], subscribed_event, &processes[0]);
+
+  start = clock_time();
+  for(i = 0; i < ITERATIONS; i++) {
+    process_poll(&processes[i % count]);
+    process_run();
+  }
+  poll_time = clock_time() - start;
+
+  start = clock_time();
+  for(i = 0; i < ITERATIONS / 10; i++) {
+    process_post(PROCESS_BROADCAST, unsubscribed_event, NULL);
+    process_run();
+  }
+  broadcast_time = clock_time() - start;
+
+  start = clock_time();
+  for(i = 0; i < ITERATIONS / 10; i++) {
+    process_post(PROCESS_BROADCAST, subscribed_event, NULL);
+    process_run();
+  }
+  subscribed_time = clock_time() - start;
+
+  printf("%2d processes: %lu polls in %lu ticks, %lu broadcasts in %lu ticks, "
+         "%lu subscribed broadcasts in %lu ticks\n",
+         count, ITERATIONS, (unsigned long)poll_time,
+         ITERATIONS / 10, (unsigned long)broadcast_time,
+         ITERATIONS / 10, (unsigned long)subscribed_time);
+
+  process_unsubscribe(&subscriptions[0]);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(process_sched_process, ev, data)
+{
+  int count;
+
+  PROCESS_BEGIN();
+
+  subscribed_event = process_alloc_event();
+  unsubscribed_event = process_alloc_event();
+
+  start_processes(8);
+
+  UNIT_TEST_RUN(poll_once);
+  UNIT_TEST_RUN(poll_interrupts);
+  UNIT_TEST_RUN(subscribers);
+
+  printf("\n");
+  for(count = 8; count <= MAX_PROCESSES; count *= 2) {
+    benchmark(count);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks of the real-time task queue, with the native
+ *         rtimer implementation.
+ */
+
+#include "contiki.h"
+#include "unit-test.h"
+
+#include <signal.h>
+#include <stdio.h>
+
+#define TASKS 8
+
+static struct rtimer tasks[TASKS];
+static struct rtimer *volatile executed[2 * TASKS];
+static volatile rtimer_clock_t executed_at[2 * TASKS];
+static volatile int executions;
+static volatile int repeats;
+static volatile int running;
+static volatile unsigned long fired;
+
+PROCESS(rtimer_queue_process, "Real-time task queue test");
+AUTOSTART_PROCESSES(&rtimer_queue_process);
+/*---------------------------------------------------------------------------*/
+static void
+record(struct rtimer *t, void *ptr)
+{
+  if(executions < 2 * TASKS) {
+    executed[executions] = t;
+    executed_at[executions] = RTIMER_NOW();
+    executions++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+repeat(struct rtimer *t, void *ptr)
+{
+  record(t, ptr);
+  if(++repeats < 3) {
+    rtimer_set(t, RTIMER_TIME(t) + 7, 0, repeat, ptr);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+again(struct rtimer *t, void *ptr)
+{
+  fired++;
+  if(running) {
+    rtimer_set(t, RTIMER_TIME(t) + 1, 0, again, ptr);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Keep the timer signal from running tasks while the test inspects the
+   queue. */
+static void
+block_timer(int block)
+{
+  sigset_t set;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGALRM);
+  sigprocmask(block ? SIG_BLOCK : SIG_UNBLOCK, &set, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+cancel_all(void)
+{
+  int i;
+
+  for(i = 0; i < TASKS; i++) {
+    rtimer_cancel(&tasks[i]);
+  }
+  executions = 0;
+  repeats = 0;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(due_order, "Due tasks run in order of time and priority");
+UNIT_TEST_REGISTER(reset_cancel, "Set again and cancel");
+UNIT_TEST_REGISTER(native, "Tasks run by the native timer");
+UNIT_TEST_REGISTER(concurrent, "Set and cancel while the timer runs tasks");
+
+UNIT_TEST(due_order)
+{
+  rtimer_clock_t now;
+
+  UNIT_TEST_BEGIN();
+
+  block_timer(1);
+  cancel_all();
+
+  now = RTIMER_NOW();
+  rtimer_set(&tasks[0], now + 10000, 0, record, NULL);
+  rtimer_set(&tasks[1], now - 3, 0, record, NULL);
+  rtimer_set_with_priority(&tasks[2], now - 3, 0, record, NULL,
+                           RTIMER_PRIORITY_HIGH);
+  rtimer_set(&tasks[3], now - 5, 0, record, NULL);
+  rtimer_set_with_priority(&tasks[4], now - 3, 0, record, NULL,
+                           RTIMER_PRIORITY_LOW);
+
+  /* One call executes every task that is due. */
+  rtimer_run_next();
+  UNIT_TEST_ASSERT(executions == 4);
+  UNIT_TEST_ASSERT(executed[0] == &tasks[3]);
+  UNIT_TEST_ASSERT(executed[1] == &tasks[2]);
+  UNIT_TEST_ASSERT(executed[2] == &tasks[1]);
+  UNIT_TEST_ASSERT(executed[3] == &tasks[4]);
+  UNIT_TEST_ASSERT(rtimer_pending(&tasks[0]));
+  UNIT_TEST_ASSERT(!rtimer_pending(&tasks[1]));
+
+  /* Nothing else is due. */
+  rtimer_run_next();
+  UNIT_TEST_ASSERT(executions == 4);
+
+  cancel_all();
+  block_timer(0);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(reset_cancel)
+{
+  rtimer_clock_t now;
+  clock_time_t start;
+
+  UNIT_TEST_BEGIN();
+
+  block_timer(1);
+
+  now = RTIMER_NOW();
+  rtimer_set(&tasks[0], now + 10000, 0, record, NULL);
+  rtimer_set(&tasks[1], now + 20000, 0, record, NULL);
+
+  /* A pending task that is set again moves; it is not queued twice. */
+  rtimer_set(&tasks[0], now + 30000, 0, record, NULL);
+  rtimer_set(&tasks[0], now - 1, 0, record, NULL);
+  rtimer_run_next();
+  UNIT_TEST_ASSERT(executions == 1 && executed[0] == &tasks[0]);
+  UNIT_TEST_ASSERT(!rtimer_pending(&tasks[0]));
+
+  UNIT_TEST_ASSERT(rtimer_cancel(&tasks[1]));
+  UNIT_TEST_ASSERT(!rtimer_cancel(&tasks[1]));
+  UNIT_TEST_ASSERT(!rtimer_pending(&tasks[1]));
+
+  /* A cancelled task does not run when the timer fires. */
+  rtimer_set(&tasks[1], RTIMER_NOW() + 1, 0, record, NULL);
+  rtimer_cancel(&tasks[1]);
+  block_timer(0);
+  for(start = clock_time(); clock_time() - start < 5;);
+  UNIT_TEST_ASSERT(executions == 1);
+
+  cancel_all();
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(native)
+{
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  /* The tasks were set by the process before this test. */
+  UNIT_TEST_ASSERT(executions == 8);
+  UNIT_TEST_ASSERT(repeats == 3);
+  for(i = 0; i < executions; i++) {
+    UNIT_TEST_ASSERT(executed[i] != &tasks[5]);
+    if(i > 0) {
+      UNIT_TEST_ASSERT(!RTIMER_CLOCK_LT(executed_at[i], executed_at[i - 1]));
+    }
+  }
+  UNIT_TEST_ASSERT(executed[0] == &tasks[7]);
+
+  cancel_all();
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(concurrent)
+{
+  struct rtimer *t;
+  rtimer_clock_t time;
+  clock_time_t start;
+  unsigned long changes;
+  int i, pending;
+
+  UNIT_TEST_BEGIN();
+
+  /* Tasks that set themselves again from the timer signal, every tick,
+     while the process sets and cancels others as fast as it can. The
+     queue must stay intact: no lost, repeated or looping tasks. */
+  running = 1;
+  fired = 0;
+  for(i = 0; i < TASKS / 2; i++) {
+    rtimer_set(&tasks[i], RTIMER_NOW() + 1, 0, again, NULL);
+  }
+  changes = 0;
+  for(start = clock_time(); clock_time() - start < CLOCK_SECOND / 5;) {
+    t = &tasks[TASKS / 2 + changes % (TASKS / 2)];
+    if(changes & 4) {
+      rtimer_cancel(t);
+    } else {
+      rtimer_set(t, RTIMER_NOW() + 1000 + changes % 7, 0, record, NULL);
+    }
+    changes++;
+  }
+  UNIT_TEST_ASSERT(fired > 0);
+
+  /* The self-setting tasks are all still there */
+  pending = 0;
+  for(i = 0; i < TASKS / 2; i++) {
+    pending += rtimer_pending(&tasks[i]);
+  }
+  UNIT_TEST_ASSERT(pending == TASKS / 2);
+
+  running = 0;
+  for(start = clock_time(); clock_time() - start < 5;);
+  for(i = 0; i < TASKS; i++) {
+    rtimer_cancel(&tasks[i]);
+  }
+  UNIT_TEST_ASSERT(!rtimer_next_expiration_time(&time));
+  printf("%lu changes, %lu tasks run by the timer\n", changes, fired);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(rtimer_queue_process, ev, data)
+{
+  static struct etimer et;
+  static const rtimer_clock_t offsets[] = { 40, 20, 50, 30, 10, 25 };
+  rtimer_clock_t now;
+  int i;
+
+  PROCESS_BEGIN();
+
+  UNIT_TEST_RUN(due_order);
+  UNIT_TEST_RUN(reset_cancel);
+
+  /* Let the native timer run a few tasks that were set out of order,
+     and one task that sets itself again. */
+  block_timer(1);
+  now = RTIMER_NOW();
+  for(i = 0; i < 6; i++) {
+    rtimer_set(&tasks[i], now + offsets[i], 0, record, NULL);
+  }
+  rtimer_set(&tasks[7], now + 5, 0, repeat, NULL);
+  rtimer_cancel(&tasks[5]);
+  block_timer(0);
+
+  etimer_set(&et, CLOCK_SECOND / 5);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  UNIT_TEST_RUN(native);
+  UNIT_TEST_RUN(concurrent);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
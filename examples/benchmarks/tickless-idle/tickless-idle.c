@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Tickless idle checks, and a measurement of how often the
+ *         main loop wakes up while a node is idle.
+ */
+
+#include "contiki.h"
+#include "sys/tickless.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+
+#define IDLE_TIME     (5 * CLOCK_SECOND)
+#define CTIMER_PERIOD (CLOCK_SECOND / 10)
+
+static struct etimer et;
+static struct ctimer ct;
+static struct rtimer rt;
+static unsigned long callbacks;
+
+PROCESS(tickless_idle_process, "Tickless idle test");
+AUTOSTART_PROCESSES(&tickless_idle_process);
+/*---------------------------------------------------------------------------*/
+/* Deliver any events that are waiting, so that the next wakeup is
+   only decided by the timers. */
+static void
+run_events(void)
+{
+  int i;
+
+  PROCESS_CONTEXT_BEGIN(&tickless_idle_process);
+  for(i = 0; i < 10000 && process_run() > 0; i++);
+  PROCESS_CONTEXT_END(&tickless_idle_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+rtimer_callback(struct rtimer *t, void *ptr)
+{
+}
+/*---------------------------------------------------------------------------*/
+static void
+ctimer_callback(void *ptr)
+{
+  callbacks++;
+  ctimer_reset(&ct);
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(deadline, "The next wakeup follows the earliest timer");
+
+UNIT_TEST(deadline)
+{
+  clock_time_t ticks;
+
+  UNIT_TEST_BEGIN();
+
+  run_events();
+  UNIT_TEST_ASSERT(!etimer_pending());
+  UNIT_TEST_ASSERT(tickless_next_wakeup() == TICKLESS_MAX_SLEEP);
+
+  /* An event timer. Setting it polls the event timer process, so
+     the main loop does not sleep before that has run. */
+  etimer_set(&et, CLOCK_SECOND / 2);
+  UNIT_TEST_ASSERT(tickless_next_wakeup() == 0);
+  run_events();
+  ticks = tickless_next_wakeup();
+  UNIT_TEST_ASSERT(ticks <= CLOCK_SECOND / 2 &&
+                   ticks >= CLOCK_SECOND / 2 - CLOCK_SECOND / 20);
+
+  /* An earlier callback timer, through the event timer of the
+     ctimer process. */
+  ctimer_set(&ct, CLOCK_SECOND / 4, ctimer_callback, NULL);
+  run_events();
+  ticks = tickless_next_wakeup();
+  UNIT_TEST_ASSERT(ticks <= CLOCK_SECOND / 4 &&
+                   ticks >= CLOCK_SECOND / 4 - CLOCK_SECOND / 20);
+
+  /* An earlier real-time task. */
+  rtimer_set(&rt, RTIMER_NOW() + RTIMER_SECOND / 10, 1,
+             rtimer_callback, NULL);
+  ticks = tickless_next_wakeup();
+  UNIT_TEST_ASSERT(ticks <= CLOCK_SECOND / 10 &&
+                   ticks >= CLOCK_SECOND / 10 - CLOCK_SECOND / 20);
+  rtimer_cancel(&rt);
+
+  /* Pending events need the main loop now. */
+  process_post(&tickless_idle_process, PROCESS_EVENT_CONTINUE, NULL);
+  UNIT_TEST_ASSERT(tickless_next_wakeup() == 0);
+  run_events();
+
+  ctimer_stop(&ct);
+  etimer_stop(&et);
+  UNIT_TEST_ASSERT(tickless_next_wakeup() == TICKLESS_MAX_SLEEP);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tickless_idle_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  UNIT_TEST_RUN(deadline);
+
+  /* Stay idle, except for a periodic callback timer. */
+  callbacks = 0;
+  tickless_reset_stats();
+  ctimer_set(&ct, CTIMER_PERIOD, ctimer_callback, NULL);
+  etimer_set(&et, IDLE_TIME);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  ctimer_stop(&ct);
+
+  printf("\ntickless idle %s: %lu wakeups for %lu callbacks, "
+         "%lu wakeups per hour of idle time\n",
+         TICKLESS_ENABLED ? "enabled" : "disabled",
+         tickless_wakeups(), callbacks, tickless_wakeups_per_hour());
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
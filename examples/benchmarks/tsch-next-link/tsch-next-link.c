@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks that the indexed lookup of the next active TSCH link
+ *         gives the same links as a walk through all links, and a
+ *         benchmark of both.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/mac/mac.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "net/mac/tsch/tsch-slot-operation.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+
+#define SLOTFRAMES  4
+#define LOOKUPS     1000000UL
+#define CHECKS      20000
+
+static const uint16_t sizes[SLOTFRAMES] = { 397, 31, 17, 7 };
+static struct tsch_slotframe *slotframes[SLOTFRAMES];
+
+/* The rest of TSCH */
+struct tsch_link *current_link;
+const linkaddr_t tsch_broadcast_address = { { 0xff, 0xff } };
+int
+tsch_is_locked(void)
+{
+  return 0;
+}
+int
+tsch_get_lock(void)
+{
+  return 1;
+}
+void
+tsch_release_lock(void)
+{
+}
+struct tsch_neighbor *
+tsch_queue_add_nbr(const linkaddr_t *addr)
+{
+  return NULL;
+}
+
+PROCESS(tsch_next_link_process, "TSCH next link benchmark");
+AUTOSTART_PROCESSES(&tsch_next_link_process);
+/*---------------------------------------------------------------------------*/
+/* The lookup walking through all links, as before the index */
+static struct tsch_link *
+walk_next_active_link(struct asn_t *asn, uint16_t *time_offset,
+                      struct tsch_link **backup_link)
+{
+  uint16_t time_to_curr_best = 0;
+  struct tsch_link *curr_best = NULL;
+  struct tsch_link *curr_backup = NULL;
+  int i;
+
+  for(i = 0; i < SLOTFRAMES; i++) {
+    struct tsch_slotframe *sf = slotframes[i];
+    uint16_t timeslot = ASN_MOD(*asn, sf->size);
+    struct tsch_link *l = list_head(sf->links_list);
+    while(l != NULL) {
+      uint16_t time_to_timeslot =
+        l->timeslot > timeslot ?
+        l->timeslot - timeslot :
+        sf->size.val + l->timeslot - timeslot;
+      if(curr_best == NULL || time_to_timeslot < time_to_curr_best) {
+        time_to_curr_best = time_to_timeslot;
+        curr_best = l;
+        curr_backup = NULL;
+      } else if(time_to_timeslot == time_to_curr_best) {
+        struct tsch_link *new_best = NULL;
+        if((curr_best->link_options & LINK_OPTION_TX) == (l->link_options & LINK_OPTION_TX)) {
+          if(l->slotframe_handle < curr_best->slotframe_handle) {
+            new_best = l;
+          }
+        } else {
+          if(l->link_options & LINK_OPTION_TX) {
+            new_best = l;
+          }
+        }
+        if(curr_backup == NULL) {
+          if(new_best != l && (l->link_options & LINK_OPTION_RX)) {
+            curr_backup = l;
+          }
+          if(new_best != curr_best && (curr_best->link_options & LINK_OPTION_RX)) {
+            curr_backup = curr_best;
+          }
+        }
+        if(new_best != NULL) {
+          curr_best = new_best;
+        }
+      }
+      l = list_item_next(l);
+    }
+  }
+  *time_offset = time_to_curr_best;
+  *backup_link = curr_backup;
+  return curr_best;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+random_options(void)
+{
+  switch(random_rand() % 4) {
+  case 0:
+    return LINK_OPTION_TX;
+  case 1:
+    return LINK_OPTION_RX;
+  case 2:
+    return LINK_OPTION_TX | LINK_OPTION_RX | LINK_OPTION_SHARED;
+  default:
+    return LINK_OPTION_RX | LINK_OPTION_TIME_KEEPING;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Add links at random timeslots, until there are n in all. Timeslots
+   that are taken are replaced. */
+static void
+fill_schedule(int n)
+{
+  struct tsch_slotframe *sf;
+  int i, count;
+
+  do {
+    sf = slotframes[random_rand() % SLOTFRAMES];
+    tsch_schedule_add_link(sf, random_options(), LINK_TYPE_NORMAL,
+                           &tsch_broadcast_address,
+                           random_rand() % sf->size.val, 0);
+    count = 0;
+    for(i = 0; i < SLOTFRAMES; i++) {
+      count += list_length(slotframes[i]->links_list);
+    }
+  } while(count < n);
+}
+/*---------------------------------------------------------------------------*/
+static void
+random_asn(struct asn_t *asn)
+{
+  ASN_INIT(*asn, random_rand() & 1,
+           ((uint32_t)random_rand() << 16) | random_rand());
+}
+/*---------------------------------------------------------------------------*/
+static int
+same_as_walk(void)
+{
+  struct tsch_link *link, *backup, *walk_link, *walk_backup;
+  uint16_t offset, walk_offset;
+  struct asn_t asn;
+  int i;
+
+  for(i = 0; i < CHECKS; i++) {
+    random_asn(&asn);
+    link = tsch_schedule_get_next_active_link(&asn, &offset, &backup);
+    walk_link = walk_next_active_link(&asn, &walk_offset, &walk_backup);
+    if(link != walk_link || backup != walk_backup || offset != walk_offset) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_slotframes(void)
+{
+  int i;
+
+  tsch_schedule_remove_all_slotframes();
+  for(i = 0; i < SLOTFRAMES; i++) {
+    slotframes[i] = tsch_schedule_add_slotframe(i, sizes[i]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(equivalence, "Same links as a walk through all links");
+UNIT_TEST_REGISTER(removal, "Same links after links are removed");
+
+UNIT_TEST(equivalence)
+{
+  int n, ok;
+
+  UNIT_TEST_BEGIN();
+
+  random_init(1);
+  ok = 1;
+  for(n = 1; n <= TSCH_SCHEDULE_MAX_LINKS && ok; n *= 2) {
+    create_slotframes();
+    fill_schedule(n);
+    ok = same_as_walk();
+  }
+  UNIT_TEST_ASSERT(ok);
+
+  UNIT_TEST_END();
+}
+UNIT_TEST(removal)
+{
+  struct tsch_link *l;
+  int i, ok;
+
+  UNIT_TEST_BEGIN();
+
+  random_init(2);
+  create_slotframes();
+  fill_schedule(64);
+  ok = 1;
+  for(i = 0; i < 100 && ok; i++) {
+    l = list_head(slotframes[random_rand() % SLOTFRAMES]->links_list);
+    if(l != NULL) {
+      tsch_schedule_remove_link(slotframes[l->slotframe_handle], l);
+    }
+    ok = same_as_walk();
+  }
+  UNIT_TEST_ASSERT(ok);
+
+  /* Without links, there is no next link */
+  create_slotframes();
+  ok = same_as_walk();
+  UNIT_TEST_ASSERT(ok);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(int n)
+{
+  static struct asn_t asns[256];
+  struct tsch_link *backup;
+  clock_time_t start, index_time, walk_time;
+  uint16_t offset;
+  unsigned long i;
+
+  random_init(3);
+  create_slotframes();
+  fill_schedule(n);
+  for(i = 0; i < 256; i++) {
+    random_asn(&asns[i]);
+  }
+
+  start = clock_time();
+  for(i = 0; i < LOOKUPS; i++) {
+    tsch_schedule_get_next_active_link(&asns[i & 255], &offset, &backup);
+  }
+  index_time = clock_time() - start;
+
+  start = clock_time();
+  for(i = 0; i < LOOKUPS; i++) {
+    walk_next_active_link(&asns[i & 255], &offset, &backup);
+  }
+  walk_time = clock_time() - start;
+
+  printf("%3d links: %lu lookups in %lu ticks, %lu ticks walking all links\n",
+         n, LOOKUPS, (unsigned long)index_time, (unsigned long)walk_time);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_next_link_process, ev, data)
+{
+  int n;
+
+  PROCESS_BEGIN();
+
+  tsch_schedule_init();
+
+  UNIT_TEST_RUN(equivalence);
+  UNIT_TEST_RUN(removal);
+
+  printf("\n");
+  for(n = 4; n <= TSCH_SCHEDULE_MAX_LINKS; n *= 2) {
+    benchmark(n);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks that a TSCH frame secured ahead of its slot is the one
+ *         the slot would have built, and simulates the slot timing with
+ *         the frames prepared inside their slot or at the end of the
+ *         previous one.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/mac/frame802154.h"
+#include "net/mac/tsch/tsch-asn.h"
+#include "net/mac/tsch/tsch-security.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define FRAME_LEN  127
+#define MIC_LEN    4
+#define SECURED    20000UL
+
+/* Timing of the 10 ms IEEE 802.15.4e timeslot, in us */
+#define TX_OFFSET     2120
+#define RX_WAIT       2200
+#define TX_ACK_DELAY  1000
+#define MAX_TX        4256
+#define MAX_ACK       2400
+/* The timeslot after the Tx offset */
+#define SLOT_REST     (10000 - TX_OFFSET)
+/* Time between the slot start and the slot operation, and to wake up
+ * before a deadline */
+#define GUARD         100
+/* Length of an enhanced ACK with a time correction IE */
+#define ACK_LEN       17
+/* Time to copy a byte to the radio over SPI */
+#define LOAD_BYTE     2
+/* Duration of a frame, as TSCH_PACKET_DURATION */
+#define DURATION(len) (32 * ((len) + 3))
+
+#define CELLS         1000
+#define MAX_SLOT      65000
+
+/* The rest of TSCH */
+int tsch_is_associated;
+int tsch_is_pan_secured = 1;
+
+PROCESS(tsch_prepare_process, "TSCH frame preparation benchmark");
+AUTOSTART_PROCESSES(&tsch_prepare_process);
+
+static uint8_t frame[FRAME_LEN];
+static int hdr_len;
+static int data_len;
+/* Time to prepare a frame on the simulated MCU, in us */
+static unsigned long prepare_time;
+/*---------------------------------------------------------------------------*/
+static void
+create_frame(void)
+{
+  frame802154_t f;
+  int i;
+
+  memset(&f, 0, sizeof(f));
+  f.fcf.frame_type = FRAME802154_DATAFRAME;
+  f.fcf.security_enabled = 1;
+  f.fcf.panid_compression = 1;
+  f.fcf.frame_version = FRAME802154_IEEE802154E_2012;
+  f.fcf.dest_addr_mode = FRAME802154_LONGADDRMODE;
+  f.fcf.src_addr_mode = FRAME802154_LONGADDRMODE;
+  f.seq = 42;
+  f.dest_pid = 0xabcd;
+  f.dest_addr[0] = 2;
+  f.src_addr[0] = 1;
+  /* ENC-MIC-32 with K2, as data frames in 6TiSCH minimal */
+  f.aux_hdr.security_control.security_level = 5;
+  f.aux_hdr.security_control.key_id_mode = 1;
+  f.aux_hdr.key_index = 2;
+
+  hdr_len = frame802154_create(&f, frame);
+  data_len = FRAME_LEN - MIC_LEN - hdr_len;
+  for(i = 0; i < data_len; i++) {
+    frame[hdr_len + i] = i;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+secure(uint8_t *out, struct asn_t *asn)
+{
+  return tsch_security_secure_frame(frame, out, hdr_len, data_len, asn);
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(ahead, "Frames secured ahead are the slot's frames");
+
+UNIT_TEST(ahead)
+{
+  static uint8_t in_slot[FRAME_LEN];
+  static uint8_t ahead[FRAME_LEN];
+  struct asn_t asn, next_asn;
+
+  UNIT_TEST_BEGIN();
+
+  ASN_INIT(asn, 0, 1000);
+  next_asn = asn;
+  ASN_INC(next_asn, 1);
+
+  /* Secured at the end of the previous slot for the ASN of the next one */
+  UNIT_TEST_ASSERT(secure(ahead, &next_asn) == MIC_LEN);
+  ASN_INC(asn, 1);
+  UNIT_TEST_ASSERT(ASN_EQ(asn, next_asn));
+  UNIT_TEST_ASSERT(secure(in_slot, &asn) == MIC_LEN);
+  UNIT_TEST_ASSERT(memcmp(ahead, in_slot, FRAME_LEN) == 0);
+
+  /* A frame prepared for another slot must not be sent: the nonce differs */
+  ASN_INC(asn, 1);
+  UNIT_TEST_ASSERT(!ASN_EQ(asn, next_asn));
+  secure(in_slot, &asn);
+  UNIT_TEST_ASSERT(memcmp(ahead, in_slot, FRAME_LEN) != 0);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+/* Time after the slot start at which a slot is over */
+static unsigned long
+slot_end(unsigned long tx_offset, int is_tx, int len, int is_broadcast)
+{
+  if(!is_tx) {
+    /* Idle listening */
+    return tx_offset + RX_WAIT / 2;
+  }
+  if(is_broadcast) {
+    return tx_offset + DURATION(len);
+  }
+  return tx_offset + DURATION(len) + TX_ACK_DELAY + DURATION(ACK_LEN);
+}
+/*---------------------------------------------------------------------------*/
+/* Bytes per second sent over a schedule with a Tx link every spacing
+ * slots of the given length, the other slots listening or unscheduled.
+ * Frames are prepared at the end of the previous active slot, as by
+ * prepare_next_slot(), if there is time enough, else in their slot. */
+static unsigned long
+simulate(unsigned long slot_len, int spacing, int listen, int ahead, int *lost)
+{
+  unsigned long tx_offset = slot_len - SLOT_REST;
+  unsigned long end, bytes;
+  /* Number of slots from the previous active slot to the Tx link */
+  int distance = listen ? 1 : spacing;
+  int cell, len, is_broadcast;
+
+  random_init(1);
+  bytes = 0;
+  *lost = 0;
+  /* Active slot before the first Tx link */
+  end = slot_end(tx_offset, distance == spacing, FRAME_LEN, 1);
+  for(cell = 0; cell < CELLS; cell++) {
+    len = 30 + random_rand() % (FRAME_LEN - 30 + 1);
+    is_broadcast = random_rand() % 4 == 0;
+    if((ahead && prepare_time + GUARD <= distance * slot_len - end)
+       || prepare_time + GUARD <= tx_offset) {
+      bytes += len;
+      end = slot_end(tx_offset, 1, len, is_broadcast);
+    } else {
+      /* The Tx deadline is missed, the frame waits for the next link */
+      (*lost)++;
+      end = tx_offset;
+    }
+    if(distance < spacing) {
+      end = slot_end(tx_offset, 0, 0, 0);
+    }
+  }
+  return bytes * 1000000ULL / ((unsigned long long)CELLS * spacing * slot_len);
+}
+/*---------------------------------------------------------------------------*/
+/* The shortest timeslot with no missed Tx deadline */
+static unsigned long
+shortest_slot(int spacing, int listen, int ahead, unsigned long *throughput)
+{
+  unsigned long slot_len;
+  int lost;
+
+  for(slot_len = 10000; slot_len <= MAX_SLOT; slot_len += 100) {
+    *throughput = simulate(slot_len, spacing, listen, ahead, &lost);
+    if(lost == 0) {
+      return slot_len;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+compare(int spacing, int listen)
+{
+  unsigned long in_slot, in_slot_throughput, ahead, ahead_throughput;
+
+  in_slot = shortest_slot(spacing, listen, 0, &in_slot_throughput);
+  ahead = shortest_slot(spacing, listen, 1, &ahead_throughput);
+  printf("  Tx link 1 slot in %d, %s: %5lu us timeslots, %4lu bytes/s in slot, "
+         "%5lu us, %4lu bytes/s ahead\n",
+         spacing, listen ? "listening" : "idle     ",
+         in_slot, in_slot_throughput, ahead, ahead_throughput);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_prepare_process, ev, data)
+{
+  static uint8_t out[FRAME_LEN];
+  struct asn_t asn;
+  clock_time_t start;
+  unsigned long i, slowdown;
+  int spacing;
+
+  PROCESS_BEGIN();
+
+  create_frame();
+
+  UNIT_TEST_RUN(ahead);
+
+  ASN_INIT(asn, 0, 0);
+  start = clock_time();
+  for(i = 0; i < SECURED; i++) {
+    ASN_INC(asn, 1);
+    secure(out, &asn);
+  }
+  start = clock_time() - start;
+  printf("\n%lu %d-byte frames secured in %lu ticks\n",
+         SECURED, FRAME_LEN, (unsigned long)start);
+
+  for(slowdown = 100; slowdown <= 1000; slowdown *= 3) {
+    /* Securing and copying to the radio, on an MCU slowdown times slower */
+    prepare_time = (unsigned long)start * 1000000UL / CLOCK_SECOND * slowdown / SECURED
+      + FRAME_LEN * LOAD_BYTE;
+    printf("MCU %lu times slower, %lu us per frame:\n", slowdown, prepare_time);
+    compare(1, 1);
+    for(spacing = 2; spacing <= 4; spacing += 2) {
+      compare(spacing, 1);
+      compare(spacing, 0);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
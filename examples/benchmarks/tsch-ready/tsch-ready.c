@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Checks that the list of neighbors ready to send over shared
+ *         TSCH links finds a packet whenever a walk through all
+ *         neighbors does, and a benchmark of both.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/packetbuf.h"
+#include "net/mac/mac.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "net/mac/tsch/tsch-slot-operation.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+
+#define NEIGHBORS  64
+#define SLOTS      20000
+#define LOOKUPS    1000000UL
+
+/* The rest of TSCH */
+const linkaddr_t tsch_broadcast_address = { { 0xff, 0xff } };
+const linkaddr_t tsch_eb_address = { { 0xfe, 0xfe } };
+int tsch_is_coordinator;
+int
+tsch_is_locked(void)
+{
+  return 0;
+}
+int
+tsch_get_lock(void)
+{
+  return 1;
+}
+void
+tsch_release_lock(void)
+{
+}
+
+static struct tsch_link shared_link = {
+  .link_options = LINK_OPTION_TX | LINK_OPTION_RX | LINK_OPTION_SHARED,
+};
+static struct tsch_link dedicated_link = {
+  .link_options = LINK_OPTION_TX,
+};
+
+PROCESS(tsch_ready_process, "TSCH ready neighbor benchmark");
+AUTOSTART_PROCESSES(&tsch_ready_process);
+/*---------------------------------------------------------------------------*/
+static void
+address(linkaddr_t *addr, int i)
+{
+  linkaddr_copy(addr, &linkaddr_null);
+  addr->u8[0] = i + 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+add_packet(int i)
+{
+  linkaddr_t addr;
+
+  address(&addr, i);
+  packetbuf_clear();
+  packetbuf_copyfrom("data", 4);
+  return tsch_queue_add_packet(&addr, NULL, NULL) != NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Is there a neighbor that may send over the shared link? */
+static int
+walk_finds_packet(void)
+{
+  linkaddr_t addr;
+  int i;
+
+  for(i = 0; i < NEIGHBORS; i++) {
+    address(&addr, i);
+    if(tsch_queue_get_packet_for_nbr(tsch_queue_get_nbr(&addr), &shared_link)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(ready, "Ready neighbors are found as by a walk");
+
+UNIT_TEST(ready)
+{
+  struct tsch_neighbor *n;
+  struct tsch_packet *p;
+  int slot, ok;
+
+  UNIT_TEST_BEGIN();
+
+  random_init(1);
+  ok = 1;
+  for(slot = 0; slot < SLOTS && ok; slot++) {
+    /* New packets, and now and then, neighbors without packets go */
+    if(random_rand() % 3 == 0) {
+      add_packet(random_rand() % NEIGHBORS);
+    }
+    if(random_rand() % 100 == 0) {
+      tsch_queue_free_unused_neighbors();
+    }
+
+    n = NULL;
+    p = tsch_queue_get_unicast_packet_for_any(&n, &shared_link);
+    if((p != NULL) != walk_finds_packet() ||
+       (p != NULL && tsch_queue_get_packet_for_nbr(n, &shared_link) != p)) {
+      ok = 0;
+    }
+
+    /* Send it, with success or failure as in the slot operation */
+    if(p != NULL) {
+      if(random_rand() % 4 != 0) {
+        tsch_queue_remove_packet_from_queue(n);
+        tsch_queue_free_packet(p);
+        tsch_queue_backoff_reset(n);
+      } else {
+        tsch_queue_backoff_inc(n);
+      }
+    }
+    tsch_queue_update_all_backoff_windows(&tsch_broadcast_address);
+  }
+  UNIT_TEST_ASSERT(ok);
+
+  tsch_queue_reset();
+  tsch_queue_free_unused_neighbors();
+  UNIT_TEST_ASSERT(tsch_queue_get_unicast_packet_for_any(NULL, &shared_link) == NULL);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(int n)
+{
+  clock_time_t start, ready_time, walk_time;
+  unsigned long i;
+  int j;
+
+  /* Only the last of n neighbors has packets */
+  for(j = 0; j < n - 1; j++) {
+    linkaddr_t addr;
+    address(&addr, j);
+    tsch_queue_add_nbr(&addr);
+  }
+  add_packet(n - 1);
+
+  start = clock_time();
+  for(i = 0; i < LOOKUPS; i++) {
+    tsch_queue_get_unicast_packet_for_any(NULL, &shared_link);
+  }
+  ready_time = clock_time() - start;
+
+  start = clock_time();
+  for(i = 0; i < LOOKUPS; i++) {
+    tsch_queue_get_unicast_packet_for_any(NULL, &dedicated_link);
+  }
+  walk_time = clock_time() - start;
+
+  printf("%2d neighbors: %lu lookups in %lu ticks, %lu ticks walking all neighbors\n",
+         n, LOOKUPS, (unsigned long)ready_time, (unsigned long)walk_time);
+
+  tsch_queue_reset();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_ready_process, ev, data)
+{
+  int n;
+
+  PROCESS_BEGIN();
+
+  tsch_queue_init();
+
+  UNIT_TEST_RUN(ready);
+
+  printf("\n");
+  for(n = 4; n <= NEIGHBORS; n *= 2) {
+    benchmark(n);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,476 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+
+/**
+ * \file
+ *         Replays timestamp traces to the TSCH adaptive time
+ *         synchronization: without drift compensation, with the drift
+ *         learned from the time source alone, and with the drift of
+ *         several neighbors fused, for the clock error found at each
+ *         synchronization, which the guard times must cover.
+ *
+ *         A trace has one line per frame heard, in ASN order:
+ *         "<asn> <neighbor> <offset> <time source>", where the offset is
+ *         how many microseconds the clock of the neighbor is ahead of our
+ *         own uncorrected clock, neighbors are numbered from 1 to
+ *         NEIGHBORS, and the time source flag is 1 for frames from the
+ *         time source. Lines starting with # are skipped. A trace file
+ *         given as argument is replayed, or else a synthetic trace.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-adaptive-timesync.h"
+#include "unit-test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Timeslots of 10 ms, and up to 8 neighbors in a trace */
+#define SLOT_US           10000
+#define SLOT_TICKS        US_TO_RTIMERTICKS(SLOT_US)
+#define SLOTS_PER_SECOND  (1000000 / SLOT_US)
+#define NEIGHBORS         8
+
+/* The synthetic trace: six hours in which the time source changes every
+ * half hour among three neighbors */
+#define HOURS             6
+#define SWITCH_PERIOD     (30 * 60)
+#define TRACE_NEIGHBORS   3
+/* Our clock runs fast by 25 ppm, 4 ppm more or less as the temperature
+ * goes up and down every two hours */
+#define BASE_DRIFT        25.0
+#define WANDER_DRIFT      4.0
+#define WANDER_PERIOD     (2 * 3600)
+/* The neighbors follow the network time to within 20 us, and each
+ * timestamp is off by up to 16 us more */
+#define NEIGHBOR_ERROR    20
+#define JITTER            16
+
+/* Drift is in ppm * 256, and the units of the ppm of a time span */
+#define DRIFT_UNIT        (1000L * 1000 * 256)
+
+/* Clock errors are counted in buckets of 4 us */
+#define BUCKET_US         4
+#define BUCKETS           256
+
+extern int contiki_argc;
+extern char **contiki_argv;
+
+/* The rest of TSCH */
+struct asn_t current_asn;
+rtimer_clock_t tsch_timing[tsch_ts_elements_count];
+struct tsch_neighbor *last_timesource_neighbor;
+static struct tsch_neighbor nbrs[NEIGHBORS + 1];
+
+struct record {
+  uint32_t asn;
+  uint8_t neighbor;
+  uint8_t is_time_source;
+  int32_t offset;
+};
+
+enum { NONE, SINGLE, FUSION };
+static const char *variant_name[] = { "no compensation", "time source    ", "fusion         " };
+
+PROCESS(tsch_timesync_process, "TSCH adaptive timesync benchmark");
+AUTOSTART_PROCESSES(&tsch_timesync_process);
+/*---------------------------------------------------------------------------*/
+/* The synthetic trace */
+static struct {
+  double ahead_us;
+  uint32_t asn;
+  uint32_t next[TRACE_NEIGHBORS + 1];
+  int32_t error[TRACE_NEIGHBORS + 1];
+} gen;
+
+static double
+uniform(double low, double high)
+{
+  return low + (high - low) * random_rand() / 65535.0;
+}
+/*---------------------------------------------------------------------------*/
+/* Drift of our clock at that second */
+static double
+our_drift(double t)
+{
+  double phase = t / WANDER_PERIOD - (long)(t / WANDER_PERIOD);
+
+  return BASE_DRIFT + WANDER_DRIFT * (phase < 0.5 ? 4 * phase - 1 : 3 - 4 * phase);
+}
+/*---------------------------------------------------------------------------*/
+static int
+time_source_at(uint32_t asn)
+{
+  return asn / SLOTS_PER_SECOND / SWITCH_PERIOD % TRACE_NEIGHBORS + 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+generate_start(void)
+{
+  int i;
+
+  random_init(1);
+  gen.ahead_us = 0;
+  gen.asn = 0;
+  for(i = 1; i <= TRACE_NEIGHBORS; i++) {
+    gen.next[i] = uniform(1, 16) * SLOTS_PER_SECOND;
+    gen.error[i] = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+generate_next(struct record *r)
+{
+  int i, next;
+
+  /* The next neighbor heard from */
+  next = 1;
+  for(i = 2; i <= TRACE_NEIGHBORS; i++) {
+    if(gen.next[i] < gen.next[next]) {
+      next = i;
+    }
+  }
+  if(gen.next[next] >= HOURS * 3600UL * SLOTS_PER_SECOND) {
+    return 0;
+  }
+
+  gen.ahead_us += our_drift((double)gen.asn / SLOTS_PER_SECOND)
+    * (gen.next[next] - gen.asn) * SLOT_US / 1e6;
+  gen.asn = gen.next[next];
+  gen.error[next] += uniform(-2, 2);
+  gen.error[next] = MAX(-NEIGHBOR_ERROR, MIN(NEIGHBOR_ERROR, gen.error[next]));
+
+  r->asn = gen.asn;
+  r->neighbor = next;
+  r->is_time_source = next == time_source_at(gen.asn);
+  r->offset = (int32_t)(-gen.ahead_us + gen.error[next] + uniform(-JITTER, JITTER));
+
+  /* The time source is heard from with keepalives and their ACKs, the
+   * others with their EBs every 16 s, a fifth of which are lost */
+  if(r->is_time_source) {
+    gen.next[next] += uniform(2, 12) * SLOTS_PER_SECOND;
+  } else {
+    do {
+      gen.next[next] += uniform(14, 18) * SLOTS_PER_SECOND;
+    } while(random_rand() % 5 == 0);
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static FILE *trace;
+
+static void
+trace_start(void)
+{
+  if(trace != NULL) {
+    rewind(trace);
+  } else {
+    generate_start();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+trace_next(struct record *r)
+{
+  char line[80];
+  unsigned long asn;
+  int neighbor, is_time_source;
+  long offset;
+
+  if(trace == NULL) {
+    return generate_next(r);
+  }
+  while(fgets(line, sizeof(line), trace) != NULL) {
+    if(line[0] != '#' &&
+       sscanf(line, "%lu %d %ld %d", &asn, &neighbor, &offset, &is_time_source) == 4 &&
+       neighbor >= 1 && neighbor <= NEIGHBORS) {
+      r->asn = asn;
+      r->neighbor = neighbor;
+      r->offset = offset;
+      r->is_time_source = is_time_source;
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* The drift learned from the time source alone, as tsch-adaptive-timesync.c
+ * did before drift fusion */
+#define NUM_TIMESYNC_ENTRIES 8
+static struct {
+  int source;
+  int32_t drift_ppm;
+  int32_t compensated_ticks;
+  uint32_t asn_since_last_learning;
+  int32_t buffer[NUM_TIMESYNC_ENTRIES];
+  uint8_t count, pos;
+  int32_t remainder;
+  int16_t tick_conversion_error;
+} single;
+
+static void
+single_update(int source, uint32_t time_delta_asn, int32_t drift_correction)
+{
+  uint32_t time_delta_ticks;
+  int32_t last_drift_ppm;
+  int i;
+
+  if(single.source != source) {
+    memset(&single, 0, sizeof(single));
+    single.source = source;
+    return;
+  }
+  single.asn_since_last_learning += time_delta_asn;
+  if(single.asn_since_last_learning < 4 * SLOTS_PER_SECOND) {
+    single.compensated_ticks += drift_correction;
+    return;
+  }
+  time_delta_ticks = single.asn_since_last_learning * SLOT_TICKS;
+  last_drift_ppm = (int32_t)((int64_t)(drift_correction + single.compensated_ticks)
+                             * DRIFT_UNIT / time_delta_ticks);
+  single.buffer[single.pos] = last_drift_ppm;
+  single.pos = (single.pos + 1) % NUM_TIMESYNC_ENTRIES;
+  if(single.count < NUM_TIMESYNC_ENTRIES) {
+    single.count++;
+  }
+  single.drift_ppm = 0;
+  for(i = 0; i < single.count; i++) {
+    single.drift_ppm += single.buffer[i];
+  }
+  single.drift_ppm /= single.count;
+  single.compensated_ticks = 0;
+  single.asn_since_last_learning = 0;
+}
+/*---------------------------------------------------------------------------*/
+static int32_t
+single_compensate(uint32_t time_delta_ticks)
+{
+  int64_t d;
+  int32_t amount, amount_ticks;
+
+  if(single.drift_ppm == 0) {
+    return 0;
+  }
+  d = (int64_t)RTIMERTICKS_TO_US_64(time_delta_ticks) * single.drift_ppm + single.remainder;
+  amount = d / DRIFT_UNIT;
+  single.remainder = (int32_t)(d - (int64_t)amount * DRIFT_UNIT);
+  amount += single.tick_conversion_error;
+  amount_ticks = US_TO_RTIMERTICKS(amount);
+  single.tick_conversion_error = amount - RTIMERTICKS_TO_US(amount_ticks);
+  single.compensated_ticks += amount_ticks;
+  return amount_ticks;
+}
+/*---------------------------------------------------------------------------*/
+struct replay_stats {
+  unsigned long syncs, total_us, max_us, max_after_switch_us;
+  unsigned long buckets[BUCKETS];
+};
+
+/* Replays the trace, and returns the drift estimated at its end */
+static int32_t
+replay(int variant, struct replay_stats *s)
+{
+  struct record r;
+  int64_t applied, correction;
+  uint32_t asn, last_sync_asn, switch_asn, step;
+  unsigned long error_us;
+  int source;
+
+  memset(s, 0, sizeof(*s));
+  memset(&single, 0, sizeof(single));
+  /* A new network: the clock and ASN start over */
+  last_timesource_neighbor = NULL;
+  applied = 0;
+  asn = last_sync_asn = switch_asn = 0;
+  source = 0;
+
+  trace_start();
+  while(trace_next(&r)) {
+    /* Compensate at each slotframe of one second until then */
+    while(asn < r.asn) {
+      step = MIN(r.asn - asn, SLOTS_PER_SECOND);
+      asn += step;
+      current_asn.ls4b = asn;
+      if(variant == SINGLE) {
+        applied += single_compensate(step * SLOT_TICKS);
+      } else if(variant == FUSION) {
+        applied += tsch_timesync_adaptive_compensate(step * SLOT_TICKS);
+      }
+    }
+
+    /* The correction that synchronizes to the neighbor */
+    correction = (r.offset >= 0 ? (int64_t)r.offset * REPLAY_SECOND + 500000 :
+                  (int64_t)r.offset * REPLAY_SECOND - 500000) / 1000000 - applied;
+
+    if(r.is_time_source) {
+      if(r.neighbor != source) {
+        source = r.neighbor;
+        switch_asn = r.asn;
+      }
+      if(last_timesource_neighbor != NULL || variant != FUSION) {
+        error_us = labs(RTIMERTICKS_TO_US((int32_t)correction));
+        s->syncs++;
+        s->total_us += error_us;
+        s->max_us = MAX(s->max_us, error_us);
+        if(r.asn - switch_asn < 10 * 60 * SLOTS_PER_SECOND && s->syncs > 1) {
+          s->max_after_switch_us = MAX(s->max_after_switch_us, error_us);
+        }
+        s->buckets[MIN(error_us / BUCKET_US, BUCKETS - 1)]++;
+      }
+      if(variant == SINGLE) {
+        single_update(r.neighbor, r.asn - last_sync_asn, correction);
+      } else if(variant == FUSION) {
+        tsch_timesync_update(&nbrs[r.neighbor], r.asn - last_sync_asn, correction);
+      }
+      applied += correction;
+      last_sync_asn = r.asn;
+    } else if(variant == FUSION) {
+      tsch_timesync_observe(&nbrs[r.neighbor].addr, correction);
+    }
+  }
+
+  if(variant == SINGLE) {
+    return single.drift_ppm;
+  }
+  return variant == FUSION ? tsch_timesync_drift() : 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_stats(int variant, const struct replay_stats *s)
+{
+  unsigned long count;
+  int i;
+
+  /* The error that 99% of the synchronizations stay within */
+  count = 0;
+  for(i = 0; i < BUCKETS - 1 && count < s->syncs - s->syncs / 100; i++) {
+    count += s->buckets[i];
+  }
+  printf("%s: %lu syncs, clock error mean %3lu us, 99%% %3d us, max %4lu us, "
+         "max in 10 min after a time source change %4lu us\n",
+         variant_name[variant], s->syncs,
+         s->syncs ? s->total_us / s->syncs : 0, i * BUCKET_US,
+         s->max_us, s->max_after_switch_us);
+}
+/*---------------------------------------------------------------------------*/
+static int32_t fused_drift;
+
+UNIT_TEST_REGISTER(learn, "The drift of our clock is learned");
+
+UNIT_TEST(learn)
+{
+  double drift;
+
+  UNIT_TEST_BEGIN();
+
+  /* At the end of the synthetic trace, to within 1 ppm: our clock is
+   * fast, so it is corrected backwards */
+  drift = -our_drift(HOURS * 3600.0);
+  UNIT_TEST_ASSERT(fused_drift > (drift - 1) * 256 && fused_drift < (drift + 1) * 256);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(retain, "The drift stays over time source changes");
+
+UNIT_TEST(retain)
+{
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  /* Another time source takes over the estimate, rather than starting
+   * from none */
+  for(i = 0; i < 5; i++) {
+    current_asn.ls4b += SLOTS_PER_SECOND;
+    tsch_timesync_adaptive_compensate(SLOTS_PER_SECOND * SLOT_TICKS);
+  }
+  tsch_timesync_update(&nbrs[time_source_at(current_asn.ls4b) % TRACE_NEIGHBORS + 1],
+                       5 * SLOTS_PER_SECOND, 0);
+  UNIT_TEST_ASSERT(abs(tsch_timesync_drift() - fused_drift) < 256);
+  fused_drift = tsch_timesync_drift();
+
+  /* So does a new network, with a new clock and ASN */
+  last_timesource_neighbor = NULL;
+  current_asn.ls4b = 0;
+  tsch_timesync_update(&nbrs[1], 0, 0);
+  UNIT_TEST_ASSERT(tsch_timesync_drift() == fused_drift);
+
+  /* A neighbor far off does not count */
+  tsch_timesync_observe(&nbrs[2].addr, 0);
+  current_asn.ls4b += 60 * SLOTS_PER_SECOND;
+  tsch_timesync_observe(&nbrs[2].addr, US_TO_RTIMERTICKS(20000));
+  UNIT_TEST_ASSERT(tsch_timesync_drift() == fused_drift);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_timesync_process, ev, data)
+{
+  static struct replay_stats s;
+  int i;
+
+  PROCESS_BEGIN();
+
+  tsch_timing[tsch_ts_timeslot_length] = SLOT_TICKS;
+  for(i = 1; i <= NEIGHBORS; i++) {
+    nbrs[i].addr.u8[0] = i;
+  }
+  if(contiki_argc > 1) {
+    trace = fopen(contiki_argv[1], "r");
+    if(trace == NULL) {
+      printf("cannot open %s\n", contiki_argv[1]);
+      PROCESS_EXIT();
+    }
+  }
+
+  replay(NONE, &s);
+  print_stats(NONE, &s);
+  replay(SINGLE, &s);
+  print_stats(SINGLE, &s);
+  fused_drift = replay(FUSION, &s);
+  print_stats(FUSION, &s);
+
+  if(trace == NULL) {
+    printf("\n");
+    UNIT_TEST_RUN(learn);
+    UNIT_TEST_RUN(retain);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -75,6 +75,9 @@ extern resource_t
 #if PLATFORM_HAS_LEDS
 extern resource_t res_leds, res_toggle;
 #endif
+#if PROCESS_CONF_PROFILE
+extern resource_t res_profile;
+#endif
 #if PLATFORM_HAS_LIGHT
 #include "dev/light-sensor.h"
 extern resource_t res_light;
@@ -136,6 +139,9 @@ PROCESS_THREAD(er_example_server, ev, data)
 /*  rest_activate_resource(&res_chunks, "test/chunks"); */
 /*  rest_activate_resource(&res_separate, "test/separate"); */
   rest_activate_resource(&res_push, "test/push");
+#if PROCESS_CONF_PROFILE
+  rest_activate_resource(&res_profile, "debug/profile");
+#endif
 /*  rest_activate_resource(&res_event, "sensors/button"); */
 /*  rest_activate_resource(&res_sub, "test/sub"); */
 /*  rest_activate_resource(&res_b1_sep_b2, "test/b1sepb2"); */
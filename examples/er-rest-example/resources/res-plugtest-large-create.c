@@ -56,10 +56,10 @@ RESOURCE(res_plugtest_large_create,
 static void
 res_post_handler(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
 {
-  coap_packet_t *const coap_req = (coap_packet_t *)request;
-
   uint8_t *incoming = NULL;
   size_t len = 0;
+  uint32_t block1_num = 0;
+  uint16_t block1_size = 0;
 
   unsigned int ct = -1;
 
@@ -70,12 +70,13 @@ res_post_handler(void *request, void *response, uint8_t *buffer, uint16_t prefer
     return;
   }
 
+  coap_get_header_block1(request, &block1_num, NULL, &block1_size, NULL);
+
   if((len = REST.get_request_payload(request, (const uint8_t **)&incoming))) {
-    if(coap_req->block1_num * coap_req->block1_size + len <= 2048) {
+    if(block1_num * block1_size + len <= 2048) {
       REST.set_response_status(response, REST.status.CREATED);
       REST.set_header_location(response, "/nirvana");
-      coap_set_header_block1(response, coap_req->block1_num, 0,
-                             coap_req->block1_size);
+      coap_set_header_block1(response, block1_num, 0, block1_size);
     } else {
       REST.set_response_status(response, REST.status.REQUEST_ENTITY_TOO_LARGE);
       const char *error_msg = "2048B max.";
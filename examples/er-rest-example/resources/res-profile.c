@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      CPU time used by each process and by each type of event, as
+ *      measured by the process profiler (PROCESS_CONF_PROFILE)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "rest-engine.h"
+
+#if PROCESS_CONF_PROFILE
+
+static void res_get_handler(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset);
+static void res_delete_handler(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset);
+
+/*
+ * One line per process and per event type, with the number of calls, the
+ * total time and the longest call, in PROCESS_PROFILE_SECOND units. The
+ * representation is larger than a single block, so it is split by offset;
+ * the counters may change between blocks. A DELETE clears the profiles.
+ */
+RESOURCE(res_profile,
+         "title=\"Process profile\";rt=\"Text\"",
+         res_get_handler,
+         NULL,
+         NULL,
+         res_delete_handler);
+
+/* Copy the part of a line that falls within the requested block. */
+static void
+add_line(const char *line, uint8_t *buffer, uint16_t preferred_size,
+         int32_t offset, int32_t *pos, int *len)
+{
+  int32_t line_len, skip;
+
+  line_len = strlen(line);
+  if(*pos + line_len > offset && *len < preferred_size) {
+    skip = offset > *pos ? offset - *pos : 0;
+    line_len -= skip;
+    if(line_len > preferred_size - *len) {
+      line_len = preferred_size - *len;
+    }
+    memcpy(buffer + *len, line + skip, line_len);
+    *len += line_len;
+  }
+  *pos += strlen(line);
+}
+
+static void
+res_get_handler(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  const struct process_profile *profile;
+  struct process *p;
+  process_event_t ev;
+  char line[80];
+  int32_t pos = 0;
+  int len = 0;
+  int i;
+
+  snprintf(line, sizeof(line), "units/s %lu\n",
+           (unsigned long)PROCESS_PROFILE_SECOND);
+  add_line(line, buffer, preferred_size, *offset, &pos, &len);
+
+  for(p = PROCESS_LIST(); p != NULL; p = p->next) {
+    snprintf(line, sizeof(line), "%.30s;%lu;%lu;%lu\n",
+             PROCESS_NAME_STRING(p), p->profile.calls,
+             p->profile.time, p->profile.max);
+    add_line(line, buffer, preferred_size, *offset, &pos, &len);
+  }
+
+  for(i = 0; (profile = process_profile_event(i, &ev)) != NULL; i++) {
+    snprintf(line, sizeof(line), "0x%02x;%lu;%lu;%lu\n",
+             ev, profile->calls, profile->time, profile->max);
+    add_line(line, buffer, preferred_size, *offset, &pos, &len);
+  }
+
+  if(pos <= *offset && *offset > 0) {
+    REST.set_response_status(response, REST.status.BAD_OPTION);
+    /* A block error message should not exceed the minimum block size (16). */
+    const char *error_msg = "BlockOutOfScope";
+    REST.set_response_payload(response, error_msg, strlen(error_msg));
+    return;
+  }
+
+  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
+  REST.set_response_payload(response, buffer, len);
+
+  *offset += len;
+  if(*offset >= pos) {
+    *offset = -1;
+  }
+}
+
+static void
+res_delete_handler(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  process_profile_reset();
+  REST.set_response_status(response, REST.status.DELETED);
+}
+
+#endif /* PROCESS_CONF_PROFILE */
@@ -68,7 +68,7 @@ PROCESS_THREAD(example_shell_process, ev, data)
   shell_irc_init();
   /*shell_ping_init();*/ /* uIP ping */
   shell_power_init();
-  /*shell_profile_init();*/
+  shell_profile_init();
   shell_ps_init();
   /*shell_reboot_init();*/
   shell_rime_debug_init();
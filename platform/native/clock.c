@@ -53,6 +53,16 @@ clock_time(void)
 }
 /*---------------------------------------------------------------------------*/
 unsigned long
+clock_microseconds(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+/*---------------------------------------------------------------------------*/
+unsigned long
 clock_seconds(void)
 {
   struct timeval tv;
@@ -232,6 +232,23 @@ typedef unsigned long clock_time_t;
 
 #define CLOCK_CONF_SECOND 1000
 
+/* The clock is the system time, so the main loop can sleep until the
+   next deadline instead of waking up on every tick. */
+#ifndef TICKLESS_CONF_ENABLED
+#define TICKLESS_CONF_ENABLED 1
+#endif /* TICKLESS_CONF_ENABLED */
+
+/* The process profiler measures in microseconds, as the real-time
+   clock is too coarse for the time spent in a single process call. */
+unsigned long clock_microseconds(void);
+#define PROCESS_CONF_PROFILE_NOW()  clock_microseconds()
+#define PROCESS_CONF_PROFILE_SECOND 1000000UL
+
+/* Software AES with 32-bit operations and a T-table */
+#ifndef AES_128_CONF
+#define AES_128_CONF aes_128_ttable_driver
+#endif /* AES_128_CONF */
+
 #define LOG_CONF_ENABLED 1
 
 #define PROGRAM_HANDLER_CONF_MAX_NUMDSCS 10
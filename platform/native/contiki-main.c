@@ -59,6 +59,7 @@
 #include "ctk/ctk-curses.h"
 
 #include "dev/serial-line.h"
+#include "sys/tickless.h"
 
 #include "net/ip/uip.h"
 
@@ -133,6 +134,9 @@ stdin_handle_fd(fd_set *rset, fd_set *wset)
   if(FD_ISSET(STDIN_FILENO, rset)) {
     if(read(STDIN_FILENO, &c, 1) > 0) {
       serial_line_input_byte(c);
+    } else {
+      /* End of input; stop waking up for it. */
+      select_set_callback(STDIN_FILENO, NULL);
     }
   }
 }
@@ -256,12 +260,29 @@ main(int argc, char **argv)
     int maxfd;
     int i;
     int retval;
+    int idle;
     struct timeval tv;
+    clock_time_t ticks;
 
     retval = process_run();
+    idle = retval == 0;
 
-    tv.tv_sec = 0;
-    tv.tv_usec = retval ? 1 : 1000;
+    if(!idle) {
+      /* Only check the file descriptors. */
+      tv.tv_sec = 0;
+      tv.tv_usec = 0;
+    } else {
+      /* Sleep until the next deadline. Without tickless idle, wake
+         up on every clock tick. */
+      ticks = tickless_idle_begin();
+#if !TICKLESS_ENABLED
+      if(ticks > 1) {
+        ticks = 1;
+      }
+#endif /* !TICKLESS_ENABLED */
+      tv.tv_sec = ticks / CLOCK_SECOND;
+      tv.tv_usec = (ticks % CLOCK_SECOND) * (1000000 / CLOCK_SECOND);
+    }
 
     FD_ZERO(&fdr);
     FD_ZERO(&fdw);
@@ -285,6 +306,9 @@ main(int argc, char **argv)
         }
       }
     }
+    if(idle) {
+      tickless_idle_end();
+    }
 
     etimer_request_poll();
 
@@ -54,6 +54,7 @@
 #include "dev/button-sensor.h"
 #include "dev/adxl345.h"
 #include "sys/clock.h"
+#include "sys/tickless.h"
 #include "dev/uart1_i2c_master.h"
 #include "dev/reset-sensor.h"
 #include "dev/spi.h"
@@ -498,6 +499,10 @@ main(int argc, char **argv)
          were awake. */
       energest_type_set(ENERGEST_TYPE_IRQ, irq_energest);
       watchdog_stop();
+#if TICKLESS_ENABLED
+      /* Stop the clock tick until the next deadline. */
+      clock_set_wakeup(tickless_idle_begin());
+#endif /* TICKLESS_ENABLED */
       _BIS_SR(GIE | SCG0 | SCG1 | CPUOFF); /* LPM3 sleep. This
                                               statement will block
                                               until the CPU is
@@ -510,6 +515,10 @@ main(int argc, char **argv)
       dint();
       irq_energest = energest_type_time(ENERGEST_TYPE_IRQ);
       eint();
+#if TICKLESS_ENABLED
+      clock_update();
+      tickless_idle_end();
+#endif /* TICKLESS_ENABLED */
       watchdog_start();
       ENERGEST_OFF(ENERGEST_TYPE_LPM);
       ENERGEST_ON(ENERGEST_TYPE_CPU);